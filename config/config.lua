@@ -10,7 +10,8 @@ config = {
         show_line_numbers = true,
         word_wrap = true,
         auto_indent = true,
-        highlight_current_line = true
+        highlight_current_line = true,
+        workspace_completion = true -- complete words from every open file and the project
     },
 
     -- theme settings
@@ -28,6 +29,8 @@ config = {
     keybindings = {
         ["Ctrl+S"] = "save_file",
         ["Ctrl+O"] = "open_file",
+        ["Ctrl+P"] = "quick_open",
+        ["Ctrl+Alt+O"] = "workspace_symbol",
         ["Ctrl+N"] = "new_file",
         ["Ctrl+T"] = "new_tab",
         ["Ctrl+W"] = "close_file",
@@ -40,12 +43,19 @@ config = {
         ["Ctrl+A"] = "select_all",
         ["Ctrl+F"] = "find",
         ["Ctrl+H"] = "replace",
+        ["F3"] = "find_next",
+        ["Shift+F3"] = "find_previous",
+        ["Ctrl+Alt+F"] = "find_in_files",
+        ["Ctrl+Alt+Shift+F"] = "find_in_open_files",
+        ["Ctrl+Shift+H"] = "replace_in_files",
         ["F11"] = "toggle_fullscreen",
         ["Ctrl+L"] = "set_language",
         ["Ctrl+Shift+L"] = "redetect_language",
         ["Ctrl+Shift+T"] = "toggle_theme",
         ["Ctrl+Shift+F"] = "format_document",
-        ["F12"] = "toggle_file_tree"
+        ["F12"] = "goto_definition",
+        ["Shift+F12"] = "find_references",
+        ["Ctrl+B"] = "toggle_file_tree"
     },
 
     -- window settings
@@ -56,12 +66,36 @@ config = {
         remember_position = true
     },
 
+    -- project settings
+    project = {
+        index = true, -- build a background file index when a project is opened
+        respect_ignore_files = true, -- skip paths matched by .gitignore, .ignore and .git/info/exclude
+        skip_binary_files = true,
+        cache = true, -- reuse the file list from the last session and only re-read changed directories
+        watch = true, -- keep the index current from inotify, polling directory mtimes past the watch limit
+        trigram_index = false, -- keep an on-disk trigram index to narrow find in files on large trees
+        git_status = true, -- mark modified, untracked and ignored files in the tree, read from .git/index
+        symbol_index = true -- index functions, classes and globals for go to symbol in workspace (Ctrl+Alt+O)
+    },
+
+    -- watch word highlighting, plugins can add words with editor.highlight_word(word, color)
+    highlight = {
+        case_sensitive = true,
+        words = {
+            -- ["TODO"] = "#fabd2f",
+            -- ["FIXME"] = "#fb4934"
+        }
+    },
+
     -- plugin configuration
     plugins = {
         -- global plugin settings
         enabled = true,
         auto_load = true,
         error_recovery = true,
+        lazy_load = true, -- defer plugins with @commands/@events/@filetypes headers until first use
+        hot_reload = true, -- reload a plugin when its file changes on disk
+        defer_loading = true, -- load plugins after the window is first painted
 
         -- individual plugin settings
         autosave = {
@@ -15,6 +15,7 @@
 #include <KTextEditor/Document>
 #include <KTextEditor/View>
 #include <KTextEditor/ConfigInterface>
+#include <KTextEditor/CodeCompletionModel>
 #include <KSyntaxHighlighting/Repository>
 #include <KSyntaxHighlighting/Theme>
 
@@ -34,6 +35,12 @@ public:
     QTextCursor textCursor() const;
     void setTextCursor(const QTextCursor &cursor);
 
+    // 1-based line and column, as shown in the status bar
+    void setCursorPosition(int line, int column);
+    void selectRange(int line, int column, int length);
+    // identifier touching the 1-based position, with its first column in *startColumn
+    QString identifierAt(int line, int column, int *startColumn = nullptr) const;
+
     void setFont(const QFont &font);
     QFont font() const;
     void setTabStopDistance(int distance);
@@ -51,6 +58,9 @@ public:
     void setLineNumbersVisible(bool visible);
     bool lineNumbersVisible() const;
 
+    // replaces the editor's per-document word completion with the given model
+    void setCompletionModel(KTextEditor::CodeCompletionModel *model);
+
     void setAutoIndentEnabled(bool enabled);
     bool autoIndentEnabled() const { return m_autoIndentEnabled; }
 
@@ -79,9 +89,12 @@ public:
 signals:
     void textChanged();
     void cursorPositionChanged();
+    // ctrl+click on the text, 1-based position under the mouse
+    void definitionRequested(int line, int column);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private slots:
     void onTextChanged();
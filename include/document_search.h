@@ -0,0 +1,108 @@
+#ifndef DOCUMENT_SEARCH_H
+#define DOCUMENT_SEARCH_H
+
+#include <QString>
+#include <QVector>
+#include <QRegularExpression>
+#include <KTextEditor/Range>
+
+namespace KTextEditor {
+class Document;
+}
+
+// literal pattern matched against single lines of utf-16 text. candidates
+// for the first character are found sixteen bytes at a time; case
+// insensitive matching compares through a simple case folding table
+class LiteralMatcher
+{
+public:
+    LiteralMatcher();
+    LiteralMatcher(const QString &pattern, bool caseSensitive, bool wholeWord);
+
+    bool isEmpty() const { return m_pattern.isEmpty(); }
+    int length() const { return m_pattern.size(); }
+    QString pattern() const { return m_pattern; }
+    bool caseSensitive() const { return m_caseSensitive; }
+    bool wholeWord() const { return m_wholeWord; }
+
+    // first match starting at or after from, -1 when there is none
+    int indexIn(const QString &text, int from = 0) const;
+    // non-overlapping matches in text
+    int count(const QString &text) const;
+    // text is exactly one match
+    bool matchesExactly(const QString &text) const;
+
+private:
+    QString m_pattern;
+    QVector<ushort> m_folded;
+    bool m_caseSensitive;
+    bool m_wholeWord;
+    // code units that can start a match; more than two means scan through the table
+    QVector<ushort> m_firstUnits;
+
+    const ushort *findCandidate(const ushort *begin, const ushort *end) const;
+    bool matchesAt(const ushort *text) const;
+};
+
+// what the find bar searches for: a literal through LiteralMatcher, or a
+// regular expression matched one line at a time. empty regex matches are
+// skipped so every match covers at least one character
+class SearchPattern
+{
+public:
+    SearchPattern();
+    SearchPattern(const QString &pattern, bool regex, bool caseSensitive, bool wholeWord);
+
+    bool isEmpty() const { return m_pattern.isEmpty(); }
+    bool isValid() const;
+    QString errorString() const;
+
+    QString pattern() const { return m_pattern; }
+    bool isRegex() const { return m_regex; }
+    bool caseSensitive() const { return m_literal.caseSensitive(); }
+    bool wholeWord() const { return m_literal.wholeWord(); }
+
+    // first match starting at or after from, its length in *length; -1 when there is none
+    int indexIn(const QString &text, int from, int *length) const;
+    int count(const QString &text) const;
+    bool matchesExactly(const QString &text) const;
+
+    // text for the match at column of line; regex replacements expand \0-\9, \n, \t and \\
+    QString replacementAt(const QString &line, int column, const QString &replacement) const;
+    // line with every match replaced, and the number of matches in *count
+    QString replaceAll(const QString &line, const QString &replacement, int *count) const;
+
+    bool operator==(const SearchPattern &other) const;
+    bool operator!=(const SearchPattern &other) const { return !(*this == other); }
+
+    // the expression and options a query compiles to; find in files uses it for
+    // every query, so its hits and the replace that verifies them agree on \w and \b
+    static QRegularExpression expressionFor(const QString &pattern, bool regex, bool caseSensitive, bool wholeWord);
+
+private:
+    QString m_pattern;
+    bool m_regex;
+    LiteralMatcher m_literal;
+    QRegularExpression m_expression;
+
+    QString expand(const QRegularExpressionMatch &match, const QString &replacement) const;
+};
+
+// searches over the lines of a KTextEditor document; ranges are 0-based.
+// matches never span lines
+class DocumentSearch
+{
+public:
+    // next match at or after from, wrapping to the top; *wrapped tells which
+    static KTextEditor::Range findNext(KTextEditor::Document *document, const SearchPattern &pattern,
+                                       const KTextEditor::Cursor &from, bool *wrapped = nullptr);
+    // last match starting before from, wrapping to the bottom
+    static KTextEditor::Range findPrevious(KTextEditor::Document *document, const SearchPattern &pattern,
+                                           const KTextEditor::Cursor &from, bool *wrapped = nullptr);
+    // every match of one line, in column order
+    static QVector<KTextEditor::Range> lineMatches(int line, const QString &text, const SearchPattern &pattern);
+    // where text inserted at start ends
+    static KTextEditor::Cursor endOf(const KTextEditor::Cursor &start, const QString &text);
+};
+
+#endif
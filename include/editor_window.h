@@ -23,16 +23,33 @@
 #include <QPushButton>
 #include <QTimer>
 #include <QKeyEvent>
+#include <QShowEvent>
+#include <QWindow>
 #include <QSplitter>
 #include <QTabBar>
+#include <QDockWidget>
 #include <QPainter>
 #include <QStyleOptionTab>
+#include <QProgressDialog>
+#include <QPointer>
 #include "buffer.h"
 #include "lua_bridge.h"
 #include "debug_log.h"
 #include "plugin_manager.h"
 #include "code_editor.h"
 #include "file_tree_widget.h"
+#include "project_indexer.h"
+#include "fuzzy_matcher.h"
+#include "quick_open_dialog.h"
+#include "search_panel.h"
+#include "references_panel.h"
+#include "token_index.h"
+#include "word_completion_model.h"
+#include "document_search.h"
+#include "find_bar.h"
+#include "word_highlighter.h"
+#include "file_transform.h"
+#include "transform_file_dialog.h"
 
 class NoMnemonicTabBar : public QTabBar
 {
@@ -101,6 +118,10 @@ protected:
 
     void keyPressEvent(QKeyEvent *event) override;
 
+    void showEvent(QShowEvent *event) override;
+
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
 
     void onTextChanged();
@@ -131,6 +152,9 @@ private slots:
 
     void updateLuaEditorState();
 
+    void startDeferredPlugins();
+    void onPluginsLoaded(int loadedCount);
+
 private:
 
     NoMnemonicTabWidget* m_tabWidget;
@@ -142,12 +166,38 @@ private:
     LuaBridge *m_luaBridge;
 
     PluginManager *m_pluginManager;
+    bool m_pluginsStarted;
 
     QMap<QString, QShortcut*> m_shortcuts;
 
     QSplitter *m_mainSplitter;
     FileTreeWidget *m_fileTreeWidget;
 
+    ProjectIndexer *m_projectIndexer;
+
+    QuickOpenDialog *m_quickOpenDialog;
+    FuzzyMatcher m_fileMatcher;
+    QSharedPointer<const ProjectFileTable> m_fileMatcherSource;
+
+    QuickOpenDialog *m_symbolDialog;
+    FuzzyMatcher m_symbolMatcher;
+    QSharedPointer<const SymbolTable> m_symbolMatcherSource;
+
+    QDockWidget *m_searchDock;
+    SearchPanel *m_searchPanel;
+
+    QDockWidget *m_referencesDock;
+    ReferencesPanel *m_referencesPanel;
+
+    TokenIndex *m_tokenIndex;
+    WordCompletionModel *m_completionModel;
+
+    FindBar *m_findBar;
+    WordHighlighter *m_wordHighlighter;
+
+    FileTransform *m_fileTransform;
+    QPointer<QProgressDialog> m_transformProgress;
+
     void setupUI();
     void setupMenus();
     void refreshToolsMenu();
@@ -169,10 +219,24 @@ private:
     void detectAndSetLanguage(const QString &filePath);
     QString detectLanguageFromExtension(const QString &filePath);
 
+    void showQuickOpen();
+    void showWorkspaceSymbols();
+    QuickOpenDialog *symbolDialog();
+    QuickOpenItem symbolItem(const SymbolTable &table, int symbol) const;
+    void goToDefinition(CodeEditor *textEdit, int line, int column);
+    void findReferences();
+    void showProjectSearch();
+    void showOpenDocumentsSearch();
+    void showProjectReplace();
+    void showSearchPanel(bool openDocuments);
+    void openSearchHit(const QString &filePath, int line, int column, int length);
+    void openDocumentHit(KTextEditor::Document *document, int line, int column, int length);
+    void transformFile();
+    void reloadTransformedFile(const QString &filePath);
+
     void showFindDialog();
     void showReplaceDialog();
-    void findText(const QString &searchText, bool caseSensitive = false);
-    void replaceText(const QString &searchText, const QString &replaceText, bool replaceAll = false);
+    void showFindBar(bool replace);
 
     void setCurrentLanguage(const QString &language);
 
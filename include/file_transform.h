@@ -0,0 +1,67 @@
+#ifndef FILE_TRANSFORM_H
+#define FILE_TRANSFORM_H
+
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include "project_search.h"
+#include "document_search.h"
+
+class QIODevice;
+
+// find and replace over a file of any size without opening it in the
+// editor. the file is decoded and rewritten a chunk at a time on a worker,
+// into a temporary file that atomically replaces the original once the last
+// chunk is written. text after the last line break of a chunk is carried into
+// the next one, so no match is cut in two
+class FileTransform : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileTransform(QObject *parent = nullptr);
+    ~FileTransform();
+
+    bool start(const QString &filePath, const SearchQuery &query, const QString &replacement);
+    // the original is left untouched
+    void cancel();
+    bool isRunning() const;
+
+    QString lastError() const;
+
+signals:
+    void progress(qint64 bytesRead, qint64 totalBytes);
+    // the file is only rewritten when there was something to replace
+    void finished(qint64 replacements);
+    void failed(const QString &error);
+
+private:
+    struct TransformJob
+    {
+        int generation = 0;
+        QString filePath;
+        SearchQuery query;
+        QString replacement;
+        qint64 replacements = 0;
+    };
+
+    QThreadPool *m_pool;
+    QAtomicInt m_generation;
+    QSharedPointer<TransformJob> m_job;
+    QString m_lastError;
+
+    bool transform(TransformJob *job, QString *error);
+    bool flush(TransformJob *job, const SearchPattern &pattern, QString *pending, int *written, bool final,
+               QIODevice *output, QString *error);
+    bool isCurrent(int generation) const;
+    void setError(const QString &error);
+
+    // text[from, until) with the matches starting in it replaced; a match that
+    // runs past until is taken whole and *consumed says where it ended
+    static QString replaceRange(const SearchPattern &pattern, const QString &text, int from, int until,
+                                const QString &replacement, int *consumed, qint64 *replacements);
+};
+
+#endif
@@ -3,7 +3,6 @@
 
 #include <QWidget>
 #include <QTreeView>
-#include <QFileSystemModel>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -23,6 +22,13 @@
 #include <QDesktopServices>
 #include <QUrl>
 #include <QScrollBar>
+#include <QPersistentModelIndex>
+#include <QShortcut>
+#include <QTimer>
+#include <QPair>
+#include <QHash>
+#include <QList>
+#include "project_tree_model.h"
 
 class FileTreeWidget : public QWidget
 {
@@ -38,6 +44,9 @@ public:
     void setVisible(bool visible);
     void toggleVisibility();
 
+    void setGitStatus(GitStatus *gitStatus);
+    void setWatchService(FileWatchService *watchService);
+
     void setThemeColors(const QColor &background, const QColor &text, const QColor &highlight);
     void updateThemeColors();
 
@@ -61,6 +70,9 @@ private slots:
     void onRefresh();
     void onCollapseAll();
     void onExpandAll();
+    void cancelExpandAll();
+    void processExpandQueue();
+    void onDirectoryLoaded(const QString &dirPath);
 
 private:
     void setupUI();
@@ -69,6 +81,8 @@ private:
     bool isValidProjectPath(const QString &path) const;
     QString getSelectedFilePath() const;
     QModelIndex getSelectedIndex() const;
+    void enqueueChildDirectories(const QModelIndex &parent, int depth);
+    void finishExpandAll();
 
     QVBoxLayout *m_mainLayout;
     QHBoxLayout *m_headerLayout;
@@ -76,7 +90,7 @@ private:
     QPushButton *m_collapseButton;
     QPushButton *m_refreshButton;
     QTreeView *m_treeView;
-    QFileSystemModel *m_fileSystemModel;
+    ProjectTreeModel *m_treeModel;
 
     QMenu *m_contextMenu;
     QAction *m_openAction;
@@ -89,6 +103,13 @@ private:
     QAction *m_collapseAllAction;
     QAction *m_expandAllAction;
 
+    // breadth first expand all; directories still being listed wait in m_expandWaiting
+    QList<QPair<QPersistentModelIndex, int>> m_expandQueue;
+    QHash<QString, int> m_expandWaiting;
+    int m_expandedCount;
+    QTimer *m_expandTimer;
+    QShortcut *m_cancelExpandShortcut;
+
     QString m_rootPath;
     bool m_isVisible;
 
@@ -0,0 +1,86 @@
+#ifndef FILE_WATCH_SERVICE_H
+#define FILE_WATCH_SERVICE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QSocketNotifier>
+
+// one inotify instance watching every indexed directory of the project.
+// events are coalesced into a single report per burst, so a checkout or a
+// build touching thousands of files costs one update. when the kernel's watch
+// limit is reached the service switches to polling directory mtimes
+class FileWatchService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileWatchService(QObject *parent = nullptr);
+    ~FileWatchService();
+
+    // relative directories with the mtimes they were listed at
+    void watchDirectories(const QString &rootPath, const QStringList &directories,
+                          const QVector<qint64> &modified);
+    void clear();
+    QString rootPath() const;
+
+    // absolute directories watched besides the indexed ones, such as an
+    // ignored directory expanded in the file tree; pins outlive clear()
+    void pinDirectory(const QString &absolutePath);
+    void unpinDirectory(const QString &absolutePath);
+
+    bool isPolling() const;
+    int watchCount() const;
+    void setPollInterval(int msec);
+
+signals:
+    // relative paths: directories whose entries changed, files that were written
+    void pathsChanged(const QStringList &directories, const QStringList &files);
+    void eventsLost();
+
+private slots:
+    void readEvents();
+    void addPendingWatches();
+    void flushChanges();
+    void pollDirectories();
+
+private:
+    QString m_rootPath;
+
+    int m_inotifyFd;
+    QSocketNotifier *m_notifier;
+    QSet<QString> m_indexedDirectories;
+    QSet<QString> m_pinnedPaths;
+    QHash<int, QString> m_watchPaths;
+    QHash<QString, int> m_watchDescriptors;
+    QStringList m_pendingWatches;
+    QTimer *m_watchTimer;
+
+    QSet<QString> m_changedDirectories;
+    QSet<QString> m_changedFiles;
+    QTimer *m_flushTimer;
+    QElapsedTimer m_burstTimer;
+
+    bool m_polling;
+    bool m_pollRunning;
+    int m_pollGeneration;
+    QTimer *m_pollTimer;
+    QThreadPool *m_pool;
+    QHash<QString, qint64> m_pollStamps;
+
+    bool relativeDirectory(const QString &absolutePath, QString *directory) const;
+    bool openInotify();
+    void closeInotify();
+    void startPolling();
+    void recordDirectory(const QString &directory);
+    void recordFile(const QString &filePath);
+    void scheduleFlush();
+};
+
+#endif
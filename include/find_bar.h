@@ -0,0 +1,108 @@
+#ifndef FIND_BAR_H
+#define FIND_BAR_H
+
+#include <QWidget>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QLabel>
+#include <QPushButton>
+#include <QTimer>
+#include <QPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QVector>
+#include <QSharedPointer>
+#include <KTextEditor/Range>
+#include <KTextEditor/Attribute>
+#include "code_editor.h"
+#include "document_search.h"
+
+namespace KTextEditor {
+class MovingRange;
+}
+
+// inline find and replace bar under the editor tabs. every keystroke jumps to
+// the next match from where the search began; matches are highlighted only in
+// the visible lines, and the total is counted on a worker over a snapshot of
+// the document, cancelled by the next keystroke
+class FindBar : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FindBar(QWidget *parent = nullptr);
+    ~FindBar();
+
+    void setEditor(CodeEditor *editor);
+    // shows the bar, seeded with text when it is not empty
+    void activate(const QString &text = QString(), bool replace = false);
+    void deactivate();
+
+    void findNext();
+    void findPrevious();
+    void replaceCurrent();
+    // one editing transaction, applied bottom up and rolled back when cancelled
+    void replaceAll();
+
+    QString pattern() const;
+    SearchPattern searchPattern() const;
+
+signals:
+    void statusMessage(const QString &message);
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void onPatternChanged();
+    void refresh();
+    void updateHighlights();
+    void clearHighlights();
+
+private:
+    void setupUI();
+    void jump(bool forward);
+    void select(const KTextEditor::Range &range);
+    void startCount();
+    void publishCount(int generation, int total, int index);
+    void showCount();
+
+    QPointer<CodeEditor> m_editor;
+    QThreadPool *m_pool;
+    QAtomicInt m_generation;
+
+    // typing searches again from here, so a longer pattern refines the same match
+    KTextEditor::Cursor m_anchor;
+    KTextEditor::Range m_current;
+    // -1 while the worker is still counting
+    int m_total;
+    int m_index;
+
+    // lines handed to the counting worker, kept while the document is unchanged
+    QSharedPointer<const QVector<QString>> m_snapshot;
+    KTextEditor::Document *m_snapshotDocument;
+    qint64 m_snapshotRevision;
+
+    QVector<KTextEditor::MovingRange*> m_highlights;
+    KTextEditor::Attribute::Ptr m_highlightAttribute;
+    QTimer *m_refreshTimer;
+
+    QVBoxLayout *m_mainLayout;
+    QLineEdit *m_findEdit;
+    QCheckBox *m_regexCheck;
+    QCheckBox *m_caseCheck;
+    QCheckBox *m_wordCheck;
+    QLabel *m_countLabel;
+    QPushButton *m_previousButton;
+    QPushButton *m_nextButton;
+    QPushButton *m_closeButton;
+    QWidget *m_replaceRow;
+    QLineEdit *m_replaceEdit;
+    QPushButton *m_replaceButton;
+    QPushButton *m_replaceAllButton;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef FUNCTION_TASK_H
+#define FUNCTION_TASK_H
+
+#include <QRunnable>
+#include <functional>
+
+// a QThreadPool job running one function; the pool deletes it when done
+class FunctionTask : public QRunnable
+{
+public:
+    explicit FunctionTask(std::function<void()> work)
+        : m_work(std::move(work))
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        m_work();
+    }
+
+private:
+    std::function<void()> m_work;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef FUZZY_MATCHER_H
+#define FUZZY_MATCHER_H
+
+#include <QString>
+#include <QVector>
+#include <functional>
+
+struct FuzzyMatch
+{
+    int index = -1;
+    int score = 0;
+};
+
+// subsequence matcher for quick open style lists. candidates are case folded
+// into one contiguous buffer with a 64 bit character mask each, so most
+// candidates are rejected by a single AND before any scoring. a query that
+// extends the previous one only rescans the previous survivors
+class FuzzyMatcher
+{
+public:
+    FuzzyMatcher();
+
+    void setCandidates(int count, const std::function<QString(int)> &textAt);
+    void clear();
+    int candidateCount() const;
+
+    QVector<FuzzyMatch> match(const QString &query, int limit);
+
+private:
+    QVector<ushort> m_text;
+    QVector<int> m_offsets;
+    QVector<int> m_basenames;
+    QVector<quint64> m_masks;
+
+    QVector<ushort> m_lastQuery;
+    QVector<int> m_lastCandidates;
+    bool m_hasLastQuery;
+
+    int score(int candidate, const ushort *query, int queryLength) const;
+    void scoreRange(const int *candidates, int count, const ushort *query, int queryLength,
+                    quint64 queryMask, int limit, QVector<int> *matched, QVector<FuzzyMatch> *best) const;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef GIT_STATUS_H
+#define GIT_STATUS_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+class ProjectFileTable;
+
+// one stage entry of .git/index with the stat data git recorded for it
+struct GitIndexEntry
+{
+    QString path;
+    quint32 ctimeSeconds = 0;
+    quint32 mtimeSeconds = 0;
+    quint32 inode = 0;
+    quint32 mode = 0;
+    quint32 size = 0;
+    quint16 flags = 0;
+    quint16 extendedFlags = 0;
+    uchar sha1[20] = {};
+};
+
+// working tree status of the project, read straight from .git/index instead of
+// running git. tracked files are compared by stat data and only hashed when that
+// cannot vouch for them, following git's racy clean rule; project files missing
+// from the index are untracked. scans run on a worker and are patched from
+// watcher events, so only the paths that changed are looked at again
+class GitStatus : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Status { None, Clean, Modified, Untracked, Ignored };
+
+    explicit GitStatus(QObject *parent = nullptr);
+    ~GitStatus();
+
+    void setFileTable(const QSharedPointer<const ProjectFileTable> &files);
+    // paths are relative to the project root, as reported by FileWatchService
+    void updatePaths(const QStringList &directories, const QStringList &files);
+    void clear();
+
+    QString rootPath() const;
+    bool isRepository() const;
+    QString lastError() const;
+
+    // Clean or Modified for tracked files, Untracked for new project files, None otherwise
+    Status fileStatus(const QString &relativePath) const;
+    // Modified when anything below changed or was deleted, Untracked when it only gained files
+    Status directoryStatus(const QString &relativePath) const;
+
+    // reads index versions 2 to 4; paths stay relative to the work tree
+    static bool readIndex(const QString &indexPath, QVector<GitIndexEntry> *entries, QString *error);
+    static QString findGitDirectory(const QString &path, QString *workTree);
+
+signals:
+    void statusChanged();
+
+private:
+    struct Snapshot
+    {
+        QString gitDirectory;
+        // tracked path to its index entry, shared with the worker state
+        QHash<QString, int> tracked;
+        // everything that is not clean; deleted files count as modified
+        QHash<QString, Status> files;
+        QHash<QString, Status> directories;
+    };
+
+    // owned by the worker; m_pool runs one task at a time, in order
+    struct WorkerState
+    {
+        QString rootPath;
+        QString gitDirectory;
+        // project root relative to the work tree, empty or ending in a slash
+        QString prefix;
+        qint64 indexModified = -1;
+        qint64 indexSize = -1;
+        // entries modified in or after this second may be racily clean
+        qint64 indexSeconds = 0;
+        QVector<GitIndexEntry> entries;
+        QHash<QString, int> tracked;
+        QHash<QString, Status> files;
+        QSharedPointer<const ProjectFileTable> table;
+        QString error;
+    };
+
+    QThreadPool *m_pool;
+    QAtomicInt m_generation;
+    QString m_rootPath;
+    QSharedPointer<const Snapshot> m_snapshot;
+    QString m_lastError;
+
+    QFileSystemWatcher *m_gitWatcher;
+    QTimer *m_indexTimer;
+
+    WorkerState m_state;
+
+    void publish(int generation, const QSharedPointer<const Snapshot> &snapshot, const QString &error);
+    void checkIndex();
+
+    // worker side; each returns whether the status may have changed
+    bool openRepository(const QString &rootPath);
+    bool loadIndex(bool force);
+    void scanEntries();
+    void scanUntracked();
+    bool updateEntries(const QStringList &directories, const QStringList &files);
+    Status entryStatus(const GitIndexEntry &entry) const;
+    void postSnapshot(int generation);
+
+    static bool blobMatches(const QString &filePath, bool symlink, const uchar *sha1);
+};
+
+#endif
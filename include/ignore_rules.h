@@ -0,0 +1,61 @@
+#ifndef IGNORE_RULES_H
+#define IGNORE_RULES_H
+
+#include <QString>
+#include <QVector>
+#include <QSharedPointer>
+
+// one line of a .gitignore style file, classified once so the common
+// shapes (exact name, *.ext) skip the general glob matcher
+struct IgnorePattern
+{
+    enum Kind { Literal, Suffix, Glob };
+
+    QString pattern;
+    Kind kind = Glob;
+    bool negated = false;
+    bool directoryOnly = false;
+    bool anchored = false;
+};
+
+// rules read from a single ignore file; paths are relative to the project root
+class IgnoreRuleSet
+{
+public:
+    enum Match { NoMatch, Ignored, Included };
+
+    explicit IgnoreRuleSet(const QString &baseDirectory = QString());
+
+    bool loadFile(const QString &filePath);
+    void addPattern(const QString &line);
+
+    bool isEmpty() const;
+    Match match(const QString &relativePath, bool isDir) const;
+
+    static bool globMatch(const QString &pattern, const QString &text);
+
+private:
+    QString m_baseDirectory;
+    QVector<IgnorePattern> m_patterns;
+};
+
+// stack of rule sets from the project root down to one directory; cheap to copy,
+// so each directory in a walk extends its parent's matcher
+class IgnoreMatcher
+{
+public:
+    IgnoreMatcher() = default;
+
+    IgnoreMatcher withRules(const QSharedPointer<const IgnoreRuleSet> &rules) const;
+    bool isIgnored(const QString &relativePath, bool isDir) const;
+
+    // loads .git/info/exclude, then .gitignore and .ignore of every directory on the way
+    static IgnoreMatcher forDirectory(const QString &rootPath, const QString &relativeDirectory);
+    static IgnoreMatcher loadDirectoryRules(const IgnoreMatcher &parent, const QString &rootPath,
+                                            const QString &relativeDirectory);
+
+private:
+    QVector<QSharedPointer<const IgnoreRuleSet>> m_ruleSets;
+};
+
+#endif
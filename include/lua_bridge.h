@@ -2,10 +2,12 @@
 #define LUA_BRIDGE_H
 
 #include <QString>
+#include <QByteArray>
 #include <QVariantList>
 #include <QObject>
 #include <QMap>
 #include <QPair>
+#include <QList>
 #include <QStringList>
 #include <QTimer>
 
@@ -17,6 +19,17 @@ extern "C" {
 
 class PluginManager;
 
+// registry references captured when a plugin chunk runs in its own environment
+struct LuaPluginEnvironment
+{
+    int environment = LUA_NOREF;
+    int module = LUA_NOREF;
+    int initialize = LUA_NOREF;
+    int cleanup = LUA_NOREF;
+    int saveState = LUA_NOREF;
+    int restoreState = LUA_NOREF;
+};
+
 class LuaBridge : public QObject
 {
     Q_OBJECT
@@ -33,10 +46,24 @@ public:
 
     bool executeString(const QString &luaCode);
 
+    bool loadPluginEnvironment(const QByteArray &chunk, const QString &chunkName,
+                               const QString &pluginName, LuaPluginEnvironment *environment);
+    void releasePluginEnvironment(const QString &pluginName, LuaPluginEnvironment *environment);
+    bool callPluginFunction(int functionRef, const QString &context,
+                            int argumentRef = LUA_NOREF, int *resultRef = nullptr);
+    void releaseReference(int ref);
+
+    static bool compileChunk(const QByteArray &source, const QString &chunkName,
+                             QByteArray *bytecode, QString *error);
+
     void registerEditorAPI();
 
     void emitEvent(const QString &eventName, const QVariantList &args);
 
+    // while deferred, events are buffered and replayed when deferral ends
+    void setEventsDeferred(bool deferred);
+    bool eventsDeferred() const;
+
     void registerEventHandler(const QString &eventName, const QString &handlerFunction);
 
     QString lastError() const;
@@ -53,6 +80,9 @@ public:
 
     QMap<QString, QString> getBasicHighlighterColors();
 
+    // config.highlight.words, word to color
+    QMap<QString, QString> getHighlightWords();
+
     void setEditorText(const QString &text);
     QString getEditorText() const;
     void setEditorCursorPosition(int line, int column);
@@ -72,6 +102,9 @@ signals:
     void cursorMoveRequested(int line, int column);
     void statusMessageRequested(const QString &message);
     void themeChangeRequested(const QString &themeName);
+    void highlightWordRequested(const QString &word, const QString &color);
+    void highlightWordRemovalRequested(const QString &word);
+    void highlightWordsClearRequested();
 
 private:
     lua_State *m_lua;
@@ -84,6 +117,11 @@ private:
 
     QMap<QString, QStringList> m_eventHandlers;
 
+    bool m_eventsDeferred;
+    QList<QPair<QString, QVariantList>> m_deferredEvents;
+
+    void dispatchEvent(const QString &eventName, const QVariantList &args);
+
     QMap<int, QTimer*> m_timers;
     int m_nextTimerId;
 
@@ -93,6 +131,8 @@ private:
 
     void handleLuaError(const QString &context);
 
+    int referenceFunction(int tableIndex, const char *field);
+
     static int lua_openFile(lua_State *L);
     static int lua_saveFile(lua_State *L);
     static int lua_getText(lua_State *L);
@@ -118,6 +158,10 @@ private:
     static int lua_setTheme(lua_State *L);
     static int lua_getTheme(lua_State *L);
     static int lua_toggleTheme(lua_State *L);
+
+    static int lua_highlightWord(lua_State *L);
+    static int lua_unhighlightWord(lua_State *L);
+    static int lua_clearHighlightWords(lua_State *L);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef MULTI_PATTERN_MATCHER_H
+#define MULTI_PATTERN_MATCHER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct PatternMatch
+{
+    int column = 0;
+    int length = 0;
+    // index into the pattern list the matcher was built from
+    int pattern = 0;
+};
+
+// aho-corasick automaton over utf-16 code units. code units are first mapped
+// to the classes that occur in the patterns, and the automaton is expanded to
+// a dense state x class table, so scanning costs one lookup per character
+// however many patterns there are
+class MultiPatternMatcher
+{
+public:
+    MultiPatternMatcher();
+
+    // false when the automaton would be too large; the matcher is then empty
+    bool build(const QStringList &patterns, bool caseSensitive);
+    void clear();
+
+    bool isEmpty() const { return m_lengths.isEmpty(); }
+    int patternCount() const { return m_lengths.size(); }
+    int stateCount() const;
+
+    // leftmost longest matches, not overlapping, in column order
+    QVector<PatternMatch> match(const QString &text) const;
+
+private:
+    // code unit to class, 0 for units no pattern contains
+    QVector<quint16> m_classes;
+    int m_classCount;
+    // next state for state * m_classCount + class
+    QVector<qint32> m_transitions;
+    // pattern ending exactly in a state, or -1
+    QVector<qint32> m_output;
+    // nearest state on the failure chain with an output, 0 for none
+    QVector<qint32> m_outputLink;
+    QVector<int> m_lengths;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef OPEN_DOCUMENT_SEARCH_H
+#define OPEN_DOCUMENT_SEARCH_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <functional>
+#include "project_search.h"
+#include "document_search.h"
+
+namespace KTextEditor {
+class Document;
+}
+
+struct OpenDocument
+{
+    KTextEditor::Document *document = nullptr;
+    // shown as the group of the document's hits; also names it in hitsFound
+    QString label;
+};
+
+// find in the open documents, without touching disk. the lines of every
+// document are snapshotted on the gui thread and searched in parallel, one
+// task per document, with hits streamed back grouped by document. the
+// matches of each document are cached with every line and its hash: repeating
+// a query skips documents whose revision did not move and only rescans the
+// changed lines of the others
+class OpenDocumentSearch : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit OpenDocumentSearch(QObject *parent = nullptr);
+    ~OpenDocumentSearch();
+
+    int start(const QVector<OpenDocument> &documents, const SearchQuery &query);
+    void cancel();
+    bool isRunning() const;
+
+    void setMaxHits(int maxHits);
+    QString lastError() const;
+
+    // document of a label from the last start
+    KTextEditor::Document *document(const QString &label) const;
+
+signals:
+    void hitsFound(int generation, const QVector<SearchHit> &hits);
+    void finished(int generation, int hitCount, int documentsSearched);
+
+private:
+    struct LineMatch
+    {
+        int column = 0;
+        int length = 0;
+    };
+
+    // matches of one document for one pattern
+    struct DocumentMatches
+    {
+        // hash and length of each line
+        QVector<quint64> lineKeys;
+        // the searched text, shared with the snapshot; a key hit only counts when the text agrees
+        QVector<QString> lines;
+        // matches of line i are matches[firstMatch[i]] up to matches[firstMatch[i + 1]]
+        QVector<int> firstMatch;
+        QVector<LineMatch> matches;
+    };
+
+    struct CacheEntry
+    {
+        // tells a document apart from a later one at the same address
+        quint64 serial = 0;
+        SearchPattern pattern;
+        qint64 revision = -1;
+        QSharedPointer<const DocumentMatches> matches;
+    };
+
+    struct SearchJob
+    {
+        int generation = 0;
+        SearchQuery query;
+        int maxHits = 0;
+        QAtomicInt pending;
+        QAtomicInt hitCount;
+        int documentCount = 0;
+    };
+
+    QThreadPool *m_pool;
+    QAtomicInt m_generation;
+    QSharedPointer<SearchJob> m_job;
+    int m_maxHits;
+    QString m_lastError;
+
+    QHash<KTextEditor::Document*, CacheEntry> m_cache;
+    quint64 m_nextSerial;
+    QHash<QString, QPointer<KTextEditor::Document>> m_labels;
+
+    CacheEntry &cacheEntry(KTextEditor::Document *document);
+    void searchSnapshot(const QSharedPointer<SearchJob> &job, KTextEditor::Document *document, quint64 serial,
+                        qint64 revision, const QString &label, const QVector<QString> &lines,
+                        const QSharedPointer<const DocumentMatches> &previous);
+    void storeMatches(KTextEditor::Document *document, quint64 serial, const SearchPattern &pattern,
+                      qint64 revision, const QSharedPointer<const DocumentMatches> &matches);
+    void collectHits(SearchJob *job, const QString &label, const DocumentMatches &matches,
+                     const std::function<QString(int)> &lineText, QVector<SearchHit> *hits);
+    void finishDocument(const QSharedPointer<SearchJob> &job);
+    void postHits(int generation, const QVector<SearchHit> &hits);
+    bool isCurrent(int generation) const;
+
+    static quint64 lineKey(const QString &line);
+};
+
+#endif
@@ -8,8 +8,55 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QTimer>
+#include <QMultiHash>
+#include <QSet>
+#include <QList>
+#include <QFileSystemWatcher>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QVector>
+#include <QSharedPointer>
+#include "lua_bridge.h"
+
+// activation triggers declared in a plugin's leading comment block, e.g.
+//   -- @commands: format_document
+//   -- @events: file_saved
+//   -- @filetypes: cpp, python
+// plugins without any trigger are loaded eagerly at startup. ordering is
+// declared the same way:
+//   -- @depends: autoformat    (must be loaded first, fails without it)
+//   -- @after: theme_switcher  (ordered after it only when both are present)
+struct PluginManifest
+{
+    QString name;
+    QString path;
+    QStringList events;
+    QStringList commands;
+    QStringList fileTypes;
+    QStringList dependencies;
+    QStringList loadAfter;
+
+    bool isLazy() const { return !events.isEmpty() || !commands.isEmpty() || !fileTypes.isEmpty(); }
+};
+
+// result of the off-thread discovery pass: stat, read, manifest and bytecode
+struct PluginSource
+{
+    QString path;
+    bool valid = false;
+    PluginManifest manifest;
+    QByteArray bytecode;
+    QString compileError;
+};
 
-class LuaBridge;
+// one plugin directory scan, shared by the tasks preparing its files
+struct PluginScan
+{
+    int generation = 0;
+    QStringList candidates;
+    QVector<PluginSource> prepared;
+    QAtomicInt pending;
+};
 
 class PluginManager : public QObject
 {
@@ -19,14 +66,22 @@ public:
     explicit PluginManager(LuaBridge *luaBridge, QObject *parent = nullptr);
     ~PluginManager();
 
+    // returns once the scan is started; pluginsLoaded follows when the plugins ran
     bool loadPlugins(const QString &pluginDir);
     bool loadPlugin(const QString &pluginPath);
     void unloadPlugin(const QString &pluginName);
     void reloadPlugins();
+    bool reloadPlugin(const QString &pluginName);
 
     QStringList loadedPlugins() const;
     QStringList availablePlugins() const;
     bool isPluginLoaded(const QString &pluginName) const;
+    bool isPluginPending(const QString &pluginName) const;
+    QStringList pendingPlugins() const;
+
+    void activateForEvent(const QString &eventName);
+    void activateForCommand(const QString &command);
+    void activateForFileType(const QString &fileType);
 
     bool isPluginEnabled(const QString &pluginName) const;
     void setPluginEnabled(const QString &pluginName, bool enabled);
@@ -38,12 +93,18 @@ signals:
 
     void pluginLoaded(const QString &pluginName);
     void pluginUnloaded(const QString &pluginName);
+    void pluginReloaded(const QString &pluginName);
     void pluginError(const QString &pluginName, const QString &error);
+    void pluginsLoaded(int loadedCount);
 
 private slots:
 
     void cleanupFailedPlugins();
 
+    void onPluginFileChanged(const QString &path);
+    void onPluginDirectoryChanged(const QString &path);
+    void processChangedPlugins();
+
 private:
     LuaBridge *m_luaBridge;
     QString m_pluginDirectory;
@@ -54,10 +115,41 @@ private:
     QString m_lastError;
     QTimer *m_cleanupTimer;
 
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_reloadTimer;
+    QSet<QString> m_changedPaths;
+
+    QThreadPool *m_pool;
+    // read by the scan workers to skip files of a superseded scan
+    QAtomicInt m_scanGeneration;
+
+    QMap<QString, PluginSource> m_pluginSources;
+    QMap<QString, LuaPluginEnvironment> m_environments;
+    QMap<QString, QString> m_pendingPlugins;
+    QMultiHash<QString, QString> m_eventTriggers;
+    QMultiHash<QString, QString> m_commandTriggers;
+    QMultiHash<QString, QString> m_fileTypeTriggers;
+    QSet<QString> m_resolvingPlugins;
+
     void scanPluginDirectory(const QString &dir);
+    void postScan(const QSharedPointer<PluginScan> &scan);
+    void finishLoading(int generation, const QVector<PluginSource> &prepared);
     bool isValidPluginFile(const QString &filePath) const;
     QString getPluginNameFromPath(const QString &filePath) const;
 
+    PluginSource preparePlugin(const QString &pluginPath) const;
+    PluginManifest parseManifest(const QString &pluginPath, const QByteArray &source) const;
+    void registerActivationTriggers(const PluginManifest &manifest);
+    void clearActivationTriggers(const QString &pluginName);
+    void activateTriggered(const QMultiHash<QString, QString> &triggers, const QString &key);
+
+    QList<QStringList> buildInitializationWaves(const QStringList &pluginNames);
+    bool loadDependencies(const QString &pluginName);
+    QStringList loadedDependents(const QString &pluginName) const;
+
+    void watchPluginDirectory();
+    QString findPluginPath(const QString &pluginName) const;
+
     bool validatePlugin(const QString &pluginPath);
     bool executePluginFile(const QString &pluginPath);
     bool initializePlugin(const QString &pluginName);
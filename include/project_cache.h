@@ -0,0 +1,22 @@
+#ifndef PROJECT_CACHE_H
+#define PROJECT_CACHE_H
+
+#include <QString>
+#include <QSharedPointer>
+
+class ProjectFileTable;
+
+// on-disk copy of a project's file table, one file per project root under
+// the cache directory. the layout is flat and versioned so a load is a map,
+// a few checks and a copy of the string pools
+class ProjectCache
+{
+public:
+    static QString cachePathFor(const QString &rootPath);
+
+    static bool save(const ProjectFileTable &files, const QString &cachePath, QString *error);
+    static QSharedPointer<const ProjectFileTable> load(const QString &cachePath, const QString &rootPath,
+                                                       quint32 flags);
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef PROJECT_INDEXER_H
+#define PROJECT_INDEXER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include <QVector>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QMutex>
+#include <QAtomicInt>
+#include "ignore_rules.h"
+#include "trigram_index.h"
+#include "file_watch_service.h"
+#include "git_status.h"
+#include "symbol_index.h"
+
+struct ProjectFileRecord
+{
+    quint32 directory = 0;
+    quint32 nameOffset = 0;
+    quint32 nameLength = 0;
+    qint64 size = 0;
+    qint64 lastModified = 0;
+};
+
+// immutable list of project files. directory paths are stored once and file
+// names share a single character pool, so a few hundred thousand entries stay
+// small. files are sorted by directory, then by name. every walked directory
+// is listed, empty ones included, along with the mtimes used to reconcile it
+class ProjectFileTable
+{
+public:
+    QString rootPath() const;
+
+    int fileCount() const;
+    int directoryCount() const;
+
+    QString fileName(int file) const;
+    QString relativePath(int file) const;
+    QString absolutePath(int file) const;
+    int directoryIndex(int file) const;
+    QString directoryPath(int directory) const;
+    qint64 fileSize(int file) const;
+    qint64 lastModified(int file) const;
+
+    int indexOf(const QString &relativePath) const;
+    int directoryIndexOf(const QString &relativePath) const;
+
+    // directory order: '/' sorts below every other character, so a directory is
+    // directly followed by all of its descendants
+    static bool directoryLessThan(const QString &left, const QString &right);
+
+private:
+    friend class ProjectIndexer;
+    friend class ProjectCache;
+
+    QString m_rootPath;
+    quint32 m_flags = 0;
+    QStringList m_directories;
+    QVector<int> m_directoryFirstFile;
+    QVector<qint64> m_directoryModified;
+    QVector<qint64> m_directoryRules;
+    QString m_namePool;
+    QVector<ProjectFileRecord> m_files;
+};
+
+class ProjectIndexer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProjectIndexer(QObject *parent = nullptr);
+    ~ProjectIndexer();
+
+    void setRootPath(const QString &rootPath);
+    QString rootPath() const;
+
+    void rebuild();
+    void cancel();
+    bool isIndexing() const;
+
+    void setRespectIgnoreFiles(bool respect);
+    void setSkipBinaryFiles(bool skip);
+    void setTrigramIndexEnabled(bool enabled);
+    void setCacheEnabled(bool enabled);
+    void setWatchEnabled(bool enabled);
+    void setGitStatusEnabled(bool enabled);
+    void setSymbolIndexEnabled(bool enabled);
+
+    // patches the current table; paths are relative to the root
+    void applyChanges(const QStringList &directories, const QStringList &files);
+
+    FileWatchService *watchService() const;
+
+    // kept in step with files() when enabled, see TrigramIndex
+    TrigramIndex *trigramIndex() const;
+
+    // working tree status of the project, see GitStatus
+    GitStatus *gitStatus() const;
+
+    // functions, classes and globals of the project, see SymbolIndex
+    SymbolIndex *symbolIndex() const;
+
+    // current snapshot; only swapped on the gui thread, safe to hand to workers
+    QSharedPointer<const ProjectFileTable> files() const;
+
+    static bool isBinaryFile(const QString &filePath);
+
+signals:
+    void indexingStarted(const QString &rootPath);
+    void indexReady(int fileCount);
+
+private:
+    struct DirectoryListing
+    {
+        QString relativePath;
+        qint64 directoryModified = 0;
+        qint64 rulesModified = 0;
+        QStringList names;
+        QVector<qint64> sizes;
+        QVector<qint64> modified;
+    };
+
+    struct IndexJob
+    {
+        int id = 0;
+        QString rootPath;
+        bool respectIgnoreFiles = true;
+        bool skipBinaryFiles = true;
+        bool writeCache = false;
+        // table being reconciled; directories whose mtimes match are reused
+        QSharedPointer<const ProjectFileTable> previous;
+        QAtomicInt changed;
+        // set for incremental updates instead of a walk
+        QStringList patchDirectories;
+        QSet<QString> patchFiles;
+        QAtomicInt pending;
+        QAtomicInt cancelled;
+        QMutex mutex;
+        QVector<DirectoryListing> listings;
+    };
+
+    QThreadPool *m_pool;
+    QString m_rootPath;
+    bool m_respectIgnoreFiles;
+    bool m_skipBinaryFiles;
+    bool m_trigramIndexEnabled;
+    bool m_cacheEnabled;
+    bool m_watchEnabled;
+    bool m_gitStatusEnabled;
+    bool m_symbolIndexEnabled;
+    FileWatchService *m_watchService;
+    QSet<QString> m_pendingDirectories;
+    QSet<QString> m_pendingFiles;
+    TrigramIndex *m_trigramIndex;
+    GitStatus *m_gitStatus;
+    SymbolIndex *m_symbolIndex;
+    int m_nextJobId;
+
+    QSharedPointer<IndexJob> m_job;
+    QSharedPointer<const ProjectFileTable> m_files;
+
+    quint32 currentFlags() const;
+    void setFiles(const QSharedPointer<const ProjectFileTable> &files);
+
+    void scheduleDirectory(const QSharedPointer<IndexJob> &job, const QString &relativePath,
+                           const IgnoreMatcher &matcher, bool forceWalk);
+    void walkDirectory(const QSharedPointer<IndexJob> &job, const QString &relativePath,
+                       const IgnoreMatcher &parentMatcher, bool forceWalk);
+    void reuseDirectory(const QSharedPointer<IndexJob> &job, int previousDirectory,
+                        const IgnoreMatcher &matcher, DirectoryListing *listing);
+    void finishDirectory(const QSharedPointer<IndexJob> &job);
+    void startPatch();
+    void patchTable(IndexJob *job);
+    void publish(int jobId, const QSharedPointer<const ProjectFileTable> &files);
+
+    static bool listDirectory(IndexJob *job, const IgnoreMatcher &matcher, DirectoryListing *listing,
+                              QStringList *subdirectories);
+    static bool sameFiles(const ProjectFileTable &previous, int directory, const DirectoryListing &listing);
+    static qint64 rulesModified(const QString &rootPath, const QString &relativePath);
+    static QSharedPointer<ProjectFileTable> buildTable(IndexJob *job);
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef PROJECT_REPLACE_H
+#define PROJECT_REPLACE_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QMutex>
+#include "project_search.h"
+#include "document_search.h"
+
+namespace KTextEditor {
+class Document;
+}
+
+// replaces a chosen set of search hits across the project as one batch.
+// files open in the editor are edited in their documents, one transaction
+// each; the rest are rewritten by worker threads into temporary files next
+// to the originals, which only replace them once every file is ready. each
+// hit is checked against the current text first, and any failure before the
+// batch is done puts every file and document back the way it was
+class ProjectReplace : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProjectReplace(QObject *parent = nullptr);
+    ~ProjectReplace();
+
+    // hits of documents keyed by their path go to the document instead of the disk
+    bool start(const QVector<SearchHit> &hits, const SearchQuery &query, const QString &replacement,
+               const QHash<QString, KTextEditor::Document*> &openDocuments);
+    // stops before anything is committed; a batch already being committed finishes
+    void cancel();
+    bool isRunning() const;
+
+    QString lastError() const;
+
+signals:
+    void progress(int filesDone, int fileCount);
+    void finished(int replacements, int fileCount);
+    void failed(const QString &error);
+
+private:
+    struct LineEdit
+    {
+        int line = 0;
+        QString original;
+        QString replaced;
+    };
+
+    struct DocumentEdit
+    {
+        QPointer<KTextEditor::Document> document;
+        // bottom up, so rewriting one line leaves the numbers of the rest valid
+        QVector<LineEdit> lines;
+        int replacements = 0;
+    };
+
+    struct FileEdit
+    {
+        QString path;
+        QVector<SearchHit> hits;
+        QString temporaryPath;
+        QString backupPath;
+        int replacements = 0;
+    };
+
+    struct ReplaceJob
+    {
+        int generation = 0;
+        SearchQuery query;
+        QString replacement;
+        QVector<FileEdit> files;
+        QVector<DocumentEdit> documents;
+        QAtomicInt nextFile;
+        QAtomicInt pending;
+        QAtomicInt filesDone;
+        QAtomicInt failed;
+        QMutex errorMutex;
+        QString error;
+    };
+
+    QThreadPool *m_pool;
+    QAtomicInt m_generation;
+    QSharedPointer<ReplaceJob> m_job;
+    QString m_lastError;
+
+    bool prepareDocument(KTextEditor::Document *document, const SearchPattern &pattern, const QString &replacement,
+                         QVector<SearchHit> hits, DocumentEdit *edit);
+    void runWorker(const QSharedPointer<ReplaceJob> &job);
+    bool prepareFile(const SearchPattern &pattern, const QString &replacement, FileEdit *file, QString *error);
+    void finishJob(const QSharedPointer<ReplaceJob> &job);
+
+    bool commitFiles(ReplaceJob *job, QString *error);
+    void rollbackFiles(ReplaceJob *job, int committed);
+    bool applyDocuments(ReplaceJob *job, QString *error);
+    void restoreDocument(const DocumentEdit &edit, int applied);
+    void removeFiles(ReplaceJob *job, bool temporary, bool backup);
+
+    void fail(ReplaceJob *job, const QString &error);
+    bool isCurrent(int generation) const;
+    void setError(const QString &error);
+
+    static QString rewriteLine(const SearchPattern &pattern, const QString &text, const QVector<SearchHit> &hits,
+                               int first, int end, const QString &replacement, bool *verified);
+};
+
+#endif
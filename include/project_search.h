@@ -0,0 +1,103 @@
+#ifndef PROJECT_SEARCH_H
+#define PROJECT_SEARCH_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QRegularExpression>
+#include "project_indexer.h"
+#include "trigram_index.h"
+#include "symbol_lexer.h"
+
+struct SearchQuery
+{
+    QString pattern;
+    bool regex = false;
+    bool caseSensitive = false;
+    bool wholeWord = false;
+    // code references: implies case sensitive whole word matching, and in
+    // sources SymbolLexer understands only identifier tokens count
+    bool identifier = false;
+};
+
+struct SearchHit
+{
+    QString path;
+    int line = 0;
+    int column = 0;
+    int length = 0;
+    QString preview;
+    int previewColumn = 0;
+};
+
+// find in files over the project index. files are claimed in small blocks by
+// worker threads, mapped into memory and prefiltered on raw bytes with the
+// query's literal text; only lines containing it are decoded and verified.
+// hits are streamed back per file and a newer search cancels the running one.
+// a trigram index, when given, narrows the files before any are opened
+class ProjectSearch : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProjectSearch(QObject *parent = nullptr);
+    ~ProjectSearch();
+
+    // with an index, only files holding every trigram of the literal are read
+    int start(const QSharedPointer<const ProjectFileTable> &files, const SearchQuery &request,
+              const TrigramIndex *index = nullptr);
+    void cancel();
+    bool isRunning() const;
+
+    void setMaxHits(int maxHits);
+    QString lastError() const;
+
+    // longest run of text every match of the expression must contain
+    static QString requiredLiteral(const QString &pattern);
+    // column is 0-based here; hits carry 1-based columns and a clipped preview
+    static SearchHit makeHit(const QString &path, const QString &text, int lineNumber, int column, int length);
+
+signals:
+    void hitsFound(int generation, const QVector<SearchHit> &hits);
+    void finished(int generation, int hitCount, int filesSearched);
+
+private:
+    struct SearchJob
+    {
+        int generation = 0;
+        QSharedPointer<const ProjectFileTable> files;
+        SearchQuery query;
+        QString expression;
+        QRegularExpression::PatternOptions options;
+        QByteArray literal;
+        bool literalCaseSensitive = true;
+        int maxHits = 0;
+        bool narrowed = false;
+        QVector<int> candidates;
+        QAtomicInt nextFile;
+        QAtomicInt pending;
+        QAtomicInt hitCount;
+        QAtomicInt filesSearched;
+    };
+
+    QThreadPool *m_pool;
+    QAtomicInt m_generation;
+    QSharedPointer<SearchJob> m_job;
+    int m_maxHits;
+    QString m_lastError;
+
+    void runWorker(const QSharedPointer<SearchJob> &job);
+    void searchFile(SearchJob *job, const QRegularExpression &regex, int file, QVector<SearchHit> *hits);
+    void verifyLine(SearchJob *job, const QRegularExpression &regex, const QString &path,
+                    const QString &line, int lineNumber, QVector<SearchHit> *hits);
+    void searchIdentifiers(SearchJob *job, SymbolLexer::Language language, const QString &path,
+                           const char *begin, const char *end, QVector<SearchHit> *hits);
+    void postHits(int generation, const QVector<SearchHit> &hits);
+    bool isCurrent(int generation) const;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef PROJECT_TREE_MODEL_H
+#define PROJECT_TREE_MODEL_H
+
+#include <QAbstractItemModel>
+#include <QFileIconProvider>
+#include <QThreadPool>
+#include <QTimer>
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QIcon>
+#include "git_status.h"
+#include "file_watch_service.h"
+
+struct ProjectTreeEntry
+{
+    QString name;
+    bool isDir = false;
+    bool ignored = false;
+};
+
+// one loaded file or directory; children exist only once the directory was listed
+struct ProjectTreeNode
+{
+    enum State { Unlisted, Listing, Listed };
+
+    QString name;
+    bool isDir = false;
+    bool ignored = false;
+    bool expanded = false;
+    State state = Unlisted;
+    int row = 0;
+    quint64 request = 0;
+
+    ProjectTreeNode *parent = nullptr;
+    QVector<ProjectTreeNode*> children;
+
+    // sorted listing waiting to be inserted in batches
+    QVector<ProjectTreeEntry> pending;
+    int pendingOffset = 0;
+
+    ~ProjectTreeNode() { qDeleteAll(children); }
+};
+
+// lazy replacement for QFileSystemModel: directories are listed on demand by
+// fetchMore, stat and sort run on a worker thread, rows are inserted in batches.
+// the root and expanded directories are relisted from the project's watch service
+class ProjectTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        FilePathRole = Qt::UserRole + 1,
+        IsDirRole,
+        GitStatusRole
+    };
+
+    explicit ProjectTreeModel(QObject *parent = nullptr);
+    ~ProjectTreeModel();
+
+    void setRootPath(const QString &path);
+    QString rootPath() const;
+
+    // decorates rows with GitStatusRole; the status must outlive the model
+    void setGitStatus(GitStatus *gitStatus);
+    // relists watched directories on its changes; the service must outlive the model
+    void setWatchService(FileWatchService *watchService);
+
+    QString filePath(const QModelIndex &index) const;
+    bool isDir(const QModelIndex &index) const;
+    bool isListed(const QModelIndex &index) const;
+    QModelIndex indexForPath(const QString &path) const;
+
+    void setExpanded(const QModelIndex &index, bool expanded);
+    void refresh();
+    void refreshDirectory(const QString &dirPath);
+
+    // drops a directory's loaded subtree; it is listed again on the next expand
+    void releaseChildren(const QModelIndex &index);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    static bool entryLessThan(const ProjectTreeEntry &left, const ProjectTreeEntry &right);
+
+signals:
+    void directoryLoaded(const QString &dirPath);
+
+private slots:
+    void onPathsChanged(const QStringList &directories, const QStringList &files);
+    void processInsertBatches();
+    void onGitStatusChanged();
+
+private:
+    ProjectTreeNode *m_root;
+    QString m_rootPath;
+
+    QThreadPool *m_pool;
+    quint64 m_nextRequest;
+    QHash<quint64, ProjectTreeNode*> m_requests;
+
+    QList<ProjectTreeNode*> m_batchQueue;
+    QTimer *m_batchTimer;
+
+    FileWatchService *m_watchService;
+    QHash<QString, ProjectTreeNode*> m_watchedNodes;
+
+    GitStatus *m_gitStatus;
+
+    QFileIconProvider m_iconProvider;
+    mutable QHash<QString, QIcon> m_iconCache;
+
+    ProjectTreeNode *nodeFor(const QModelIndex &index) const;
+    QModelIndex indexFor(ProjectTreeNode *node) const;
+    QString pathFor(const ProjectTreeNode *node) const;
+    GitStatus::Status gitStatusFor(const ProjectTreeNode *node) const;
+    void emitGitStatusChanged(ProjectTreeNode *node);
+
+    void startListing(ProjectTreeNode *node);
+    void applyListing(quint64 request, const QVector<ProjectTreeEntry> &entries);
+    void mergeListing(ProjectTreeNode *node, const QVector<ProjectTreeEntry> &entries);
+    void insertChild(ProjectTreeNode *node, int row, const ProjectTreeEntry &entry);
+    void removeChild(ProjectTreeNode *node, int row);
+    void renumberChildren(ProjectTreeNode *node, int from);
+
+    void watchNode(ProjectTreeNode *node);
+    void unwatchNode(ProjectTreeNode *node);
+    void forgetNode(ProjectTreeNode *node);
+
+    static QVector<ProjectTreeEntry> listDirectory(const QString &rootPath, const QString &dirPath);
+};
+
+#endif
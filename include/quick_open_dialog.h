@@ -0,0 +1,55 @@
+#ifndef QUICK_OPEN_DIALOG_H
+#define QUICK_OPEN_DIALOG_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QVBoxLayout>
+#include <QVariant>
+#include <QVector>
+#include <functional>
+
+struct QuickOpenItem
+{
+    QString title;
+    QString detail;
+    QVariant data;
+};
+
+// popup with a filter line and a result list. what is listed and what
+// happens on activation is supplied by the caller, so files and symbols
+// share the same panel
+class QuickOpenDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    using Provider = std::function<QVector<QuickOpenItem>(const QString &query)>;
+    using Activator = std::function<void(const QuickOpenItem &item)>;
+
+    explicit QuickOpenDialog(QWidget *parent = nullptr);
+
+    void setProvider(const Provider &provider);
+    void setActivator(const Activator &activator);
+    void setPlaceholderText(const QString &text);
+
+    void popup();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void onQueryChanged(const QString &query);
+    void onItemActivated();
+
+private:
+    QVBoxLayout *m_layout;
+    QLineEdit *m_queryEdit;
+    QListWidget *m_resultList;
+
+    Provider m_provider;
+    Activator m_activator;
+    QVector<QuickOpenItem> m_items;
+};
+
+#endif
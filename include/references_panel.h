@@ -0,0 +1,45 @@
+#ifndef REFERENCES_PANEL_H
+#define REFERENCES_PANEL_H
+
+#include <QWidget>
+#include <QTreeView>
+#include <QVBoxLayout>
+#include <QLabel>
+#include "project_indexer.h"
+#include "project_search.h"
+#include "search_results_model.h"
+
+// find references panel. runs an identifier search over the project, so only
+// real tokens are listed, and groups the hits by file as they stream in
+class ReferencesPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ReferencesPanel(ProjectIndexer *indexer, QWidget *parent = nullptr);
+
+    void findReferences(const QString &name);
+
+signals:
+    void hitActivated(const QString &filePath, int line, int column, int length);
+
+private slots:
+    void onHitsFound(int generation, const QVector<SearchHit> &hits);
+    void onSearchFinished(int generation, int hitCount, int filesSearched);
+    void onResultActivated(const QModelIndex &index);
+
+private:
+    void setupUI();
+
+    ProjectIndexer *m_indexer;
+    ProjectSearch *m_search;
+    SearchResultsModel *m_resultsModel;
+    int m_generation;
+    QString m_name;
+
+    QVBoxLayout *m_mainLayout;
+    QLabel *m_statusLabel;
+    QTreeView *m_resultView;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef SEARCH_PANEL_H
+#define SEARCH_PANEL_H
+
+#include <QWidget>
+#include <QTreeView>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QLabel>
+#include <QTimer>
+#include <QPushButton>
+#include "project_indexer.h"
+#include "project_search.h"
+#include "search_results_model.h"
+#include "open_document_search.h"
+#include "project_replace.h"
+#include <functional>
+
+// find in files panel. searches as the query is typed, with each change
+// cancelling the search in flight, and lists hits as workers report them.
+// the open files scope searches the editor's documents instead of the disk.
+// in replace mode hits get check boxes and the checked ones are replaced as
+// one batch by ProjectReplace
+class SearchPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SearchPanel(ProjectIndexer *indexer, QWidget *parent = nullptr);
+
+    void focusQuery(const QString &text = QString());
+
+    // documents searched in the open files scope, asked for on every search
+    void setDocumentProvider(std::function<QVector<OpenDocument>()> provider);
+    void setOpenDocumentsScope(bool openDocuments);
+    void setReplaceMode(bool replace);
+
+signals:
+    void hitActivated(const QString &filePath, int line, int column, int length);
+    void documentHitActivated(KTextEditor::Document *document, int line, int column, int length);
+    void statusMessage(const QString &message);
+
+private slots:
+    void scheduleSearch();
+    void startSearch();
+    void onHitsFound(int generation, const QVector<SearchHit> &hits);
+    void onSearchFinished(int generation, int hitCount, int filesSearched);
+    void onResultActivated(const QModelIndex &index);
+    void replaceChecked();
+
+private:
+    void setupUI();
+
+    ProjectIndexer *m_indexer;
+    ProjectSearch *m_search;
+    OpenDocumentSearch *m_documentSearch;
+    ProjectReplace *m_replace;
+    std::function<QVector<OpenDocument>()> m_documentProvider;
+    SearchResultsModel *m_resultsModel;
+    int m_generation;
+    bool m_searchingDocuments;
+    // the query behind the listed hits, and whether they are all there
+    SearchQuery m_query;
+    bool m_searchComplete;
+    bool m_truncated;
+
+    QVBoxLayout *m_mainLayout;
+    QLineEdit *m_queryEdit;
+    QCheckBox *m_regexCheck;
+    QCheckBox *m_caseCheck;
+    QCheckBox *m_wordCheck;
+    QCheckBox *m_openFilesCheck;
+    QCheckBox *m_replaceCheck;
+    QWidget *m_replaceRow;
+    QLineEdit *m_replaceEdit;
+    QPushButton *m_replaceButton;
+    QLabel *m_statusLabel;
+    QTreeView *m_resultView;
+    QTimer *m_debounceTimer;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SEARCH_RESULTS_MODEL_H
+#define SEARCH_RESULTS_MODEL_H
+
+#include <QAbstractItemModel>
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include "project_search.h"
+
+// two level model of files and their hits. hits are appended as they stream
+// in from the search workers, so rows are only ever added until clear().
+// when checkable, every hit starts checked and files check all their hits
+class SearchResultsModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    explicit SearchResultsModel(QObject *parent = nullptr);
+
+    void setRootPath(const QString &path);
+    void clear();
+    void appendHits(const QVector<SearchHit> &hits);
+
+    const SearchHit *hitAt(const QModelIndex &index) const;
+    int fileCount() const;
+    int hitCount() const;
+
+    void setCheckable(bool checkable);
+    bool isCheckable() const;
+    QVector<SearchHit> checkedHits() const;
+    int checkedCount() const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+private:
+    struct FileResults
+    {
+        QString path;
+        QString displayPath;
+        QVector<SearchHit> hits;
+        QVector<bool> checked;
+        int checkedCount = 0;
+    };
+
+    void setFileChecked(int fileRow, bool checked);
+
+    QString m_rootPath;
+    QVector<FileResults> m_files;
+    QHash<QString, int> m_fileRows;
+    int m_hitCount;
+    int m_checkedCount;
+    bool m_checkable;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef SYMBOL_INDEX_H
+#define SYMBOL_INDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include "symbol_lexer.h"
+
+class ProjectFileTable;
+
+struct SymbolRecord
+{
+    quint32 nameOffset = 0;
+    quint32 containerOffset = 0;
+    quint32 file = 0;
+    quint32 line = 0;
+    quint16 nameLength = 0;
+    quint16 containerLength = 0;
+    quint16 column = 0;
+    quint8 kind = 0;
+    quint8 flags = 0;
+};
+
+// immutable table of every symbol in the project. names, containers and file
+// paths are interned into one character pool and records are sorted by case
+// folded name, so prefix and exact lookups are binary searches
+class SymbolTable
+{
+public:
+    QString rootPath() const;
+
+    int symbolCount() const;
+
+    QString name(int symbol) const;
+    QString container(int symbol) const;
+    QString relativePath(int symbol) const;
+    QString absolutePath(int symbol) const;
+    int line(int symbol) const;
+    int column(int symbol) const;
+    SourceSymbol::Kind kind(int symbol) const;
+    bool isDeclaration(int symbol) const;
+
+    // symbols in name order; matching ignores case
+    QVector<int> findPrefix(const QString &prefix, int limit) const;
+    // case sensitive, definitions before declarations
+    QVector<int> findExact(const QString &name) const;
+
+    static QString kindName(SourceSymbol::Kind kind);
+
+private:
+    friend class SymbolIndex;
+
+    QString m_rootPath;
+    QString m_pool;
+    QVector<quint32> m_fileOffsets;
+    QVector<quint16> m_fileLengths;
+    QVector<SymbolRecord> m_symbols;
+
+    int lowerBound(const QString &folded) const;
+};
+
+// background symbol index for the project. files are read and parsed with
+// SymbolLexer on a worker; a new file table only re-parses files whose size or
+// mtime moved, and saved files are refreshed one at a time
+class SymbolIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SymbolIndex(QObject *parent = nullptr);
+    ~SymbolIndex();
+
+    void setFileTable(const QSharedPointer<const ProjectFileTable> &files);
+    void updateFiles(const QStringList &filePaths);
+    void clear();
+
+    bool isReady() const;
+
+    // current snapshot; only swapped on the gui thread, safe to hand to workers
+    QSharedPointer<const SymbolTable> symbols() const;
+
+signals:
+    void symbolsReady(int symbolCount);
+
+private:
+    struct FileSymbols
+    {
+        qint64 size = -1;
+        qint64 modified = -1;
+        QVector<SourceSymbol> symbols;
+    };
+
+    // owned by the worker; m_pool runs one task at a time, in order
+    struct WorkerState
+    {
+        QString rootPath;
+        QHash<QString, FileSymbols> files;
+    };
+
+    QThreadPool *m_pool;
+    QAtomicInt m_generation;
+    QString m_rootPath;
+    QSharedPointer<const SymbolTable> m_symbols;
+    bool m_ready;
+
+    WorkerState m_state;
+
+    void publish(int generation, const QSharedPointer<const SymbolTable> &symbols);
+
+    // worker side
+    bool parseFile(const QString &relativePath, qint64 size, qint64 modified, FileSymbols *result) const;
+    QSharedPointer<const SymbolTable> buildTable() const;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SYMBOL_LEXER_H
+#define SYMBOL_LEXER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+struct SourceSymbol
+{
+    enum Kind { Function, Method, Class, Variable };
+
+    QString name;
+    // enclosing class, namespace or table, empty at file scope
+    QString container;
+    Kind kind = Function;
+    // a prototype or member declaration rather than the definition
+    bool declaration = false;
+    int line = 0;
+    int column = 0;
+};
+
+// an occurrence of an identifier token; offset is the byte offset in the source
+struct SourceReference
+{
+    int line = 0;
+    int column = 0;
+    int offset = 0;
+};
+
+// hand written single pass lexers that pull top level declarations out of
+// source files. they skip comments and strings exactly but recognise
+// declarations by shape, so they favour speed over a full parse
+class SymbolLexer
+{
+public:
+    enum Language { Unknown, Cpp, Python, Lua, JavaScript, Go };
+
+    static Language languageFor(const QString &fileName);
+    static bool isIdentifierStart(uchar c);
+    static bool isIdentifierCharacter(uchar c);
+
+    // lines and columns are 1-based, columns counted in utf-16 units
+    static void extract(Language language, const QByteArray &source, QVector<SourceSymbol> *symbols);
+    // identifier tokens equal to name, never matches inside comments or strings
+    static void findIdentifier(Language language, const QByteArray &source, const QByteArray &name,
+                               QVector<SourceReference> *references);
+};
+
+#endif
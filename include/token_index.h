@@ -0,0 +1,127 @@
+#ifndef TOKEN_INDEX_H
+#define TOKEN_INDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+class ProjectFileTable;
+
+namespace KTextEditor {
+class Document;
+class Cursor;
+class Range;
+}
+
+// word frequencies shared by every open document and the project, kept in a
+// trie for completion. nodes live in one array and carry an upper bound of the
+// counts below them, so the most frequent completions of a prefix are found
+// best first without walking the whole subtree. open documents are followed
+// through their edit signals and only the touched lines are tokenized again
+class TokenIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TokenIndex(QObject *parent = nullptr);
+    ~TokenIndex();
+
+    void addDocument(KTextEditor::Document *document);
+    void removeDocument(KTextEditor::Document *document);
+    // file the document was loaded from or saved to; project files open in a
+    // document are counted from it instead of from disk
+    void setDocumentPath(KTextEditor::Document *document, const QString &filePath);
+
+    // project files are counted in the background; a new table of the same root
+    // only reads the files that were added or changed since the last one
+    void setProjectFiles(const QSharedPointer<const ProjectFileTable> &files);
+    void clear();
+
+    // most frequent tokens starting with prefix, case sensitive, prefix itself excluded
+    QStringList complete(const QString &prefix, int limit) const;
+
+    int tokenCount() const;
+    int nodeCount() const;
+
+    static int minimumTokenLength();
+
+private:
+    struct Node
+    {
+        quint32 firstChild = 0;
+        quint32 nextSibling = 0;
+        quint32 count = 0;
+        // never below the largest count in the subtree; may overestimate after removals
+        quint32 maxCount = 0;
+        ushort character = 0;
+    };
+
+    struct DocumentTokens
+    {
+        // token nodes of each line, in line order
+        QVector<QVector<quint32>> lines;
+        // false while the document is too large to follow
+        bool tracked = true;
+        QString filePath;
+    };
+
+    struct ProjectFileTokens
+    {
+        qint64 size = 0;
+        qint64 lastModified = 0;
+        // token nodes of the file with their counts
+        QVector<QPair<quint32, quint32>> tokens;
+    };
+
+    // token counts of one project file, as read by the worker
+    struct ProjectFileCounts
+    {
+        QString relativePath;
+        qint64 size = 0;
+        qint64 lastModified = 0;
+        QHash<QString, int> counts;
+    };
+
+    QThreadPool *m_pool;
+    QAtomicInt m_generation;
+    QString m_projectRoot;
+    QSharedPointer<const ProjectFileTable> m_projectFiles;
+
+    // node 0 is the root; child and sibling links of 0 mean none
+    QVector<Node> m_nodes;
+    int m_tokenCount;
+
+    QHash<KTextEditor::Document*, DocumentTokens> m_documents;
+    // keyed by relative path; files open in a document are left out
+    QHash<QString, ProjectFileTokens> m_projectTokens;
+    qint64 m_projectBytes;
+
+    quint32 insert(const QString &token, quint32 count);
+    void remove(quint32 node, quint32 count);
+    quint32 findChild(quint32 parent, ushort character) const;
+    void resetTrie();
+
+    void scanDocument(KTextEditor::Document *document);
+    QVector<quint32> tokenizeLine(const QString &line);
+    void releaseLines(DocumentTokens *tokens, int first, int count);
+
+    void onTextInserted(KTextEditor::Document *document, const KTextEditor::Cursor &position, const QString &text);
+    void onTextRemoved(KTextEditor::Document *document, const KTextEditor::Range &range, const QString &text);
+    void refreshLines(KTextEditor::Document *document, int firstLine, int oldLineCount, int newLineCount);
+
+    QString projectRelativePath(const QString &filePath) const;
+    QSet<QString> openProjectPaths() const;
+    void dropProjectFile(const QString &relativePath);
+    void countProjectFile(const QString &relativePath);
+    void readProjectFiles(int generation, const QVector<int> &pending);
+    void mergeProjectTokens(int generation, const QVector<ProjectFileCounts> &files);
+};
+
+#endif
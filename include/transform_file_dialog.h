@@ -0,0 +1,41 @@
+#ifndef TRANSFORM_FILE_DIALOG_H
+#define TRANSFORM_FILE_DIALOG_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QDialogButtonBox>
+#include "project_search.h"
+
+// asks for the file and the find and replace of a streaming file transform
+class TransformFileDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit TransformFileDialog(QWidget *parent = nullptr);
+
+    void setFilePath(const QString &filePath);
+    QString filePath() const;
+    SearchQuery query() const;
+    QString replacement() const;
+
+private slots:
+    void browse();
+    void updateButtons();
+
+private:
+    void setupUI();
+
+    QLineEdit *m_pathEdit;
+    QPushButton *m_browseButton;
+    QLineEdit *m_findEdit;
+    QLineEdit *m_replaceEdit;
+    QCheckBox *m_regexCheck;
+    QCheckBox *m_caseCheck;
+    QCheckBox *m_wordCheck;
+    QDialogButtonBox *m_buttons;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <QHash>
+#include <QFile>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+class ProjectFileTable;
+
+// posting lists from ascii folded trigrams to the files containing them.
+// the base index is one flat file under the cache directory, laid out so it
+// can be mapped and searched in place. files that changed since it was
+// written are kept in a small in-memory overlay until the next full build
+class TrigramIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TrigramIndex(QObject *parent = nullptr);
+    ~TrigramIndex();
+
+    void setFileTable(const QSharedPointer<const ProjectFileTable> &files);
+    void updateFiles(const QStringList &filePaths);
+    void clear();
+
+    bool isReady() const;
+    QString lastError() const;
+
+    // files of the given table that may contain the literal; false when the
+    // index cannot narrow the search and every file has to be read
+    bool candidateFiles(const QByteArray &literal, const QSharedPointer<const ProjectFileTable> &files,
+                        QVector<int> *candidates) const;
+
+    static QString indexPathFor(const QString &rootPath);
+    static void extractTrigrams(const char *data, qint64 size, QVector<quint32> *trigrams);
+
+signals:
+    void indexReady(int fileCount);
+
+private:
+    // the base index bytes, either mapped from disk or held in memory
+    struct Storage
+    {
+        QFile file;
+        const uchar *mapped = nullptr;
+        QByteArray buffer;
+        qint64 size = 0;
+
+        const uchar *data() const;
+        ~Storage();
+    };
+
+    struct Snapshot
+    {
+        QSharedPointer<const ProjectFileTable> files;
+        QSharedPointer<Storage> storage;
+        // base file id to index in files, -1 for stale or removed entries
+        QVector<int> baseToTable;
+        // the reverse, -1 for files missing from the base
+        QVector<int> tableToBase;
+        // sorted trigrams of files that changed since the base was written
+        QHash<int, QVector<quint32>> overlay;
+    };
+
+    QThreadPool *m_pool;
+    QAtomicInt m_generation;
+    QSharedPointer<const Snapshot> m_snapshot;
+    QString m_lastError;
+
+    void publish(int generation, const QSharedPointer<const Snapshot> &snapshot, const QString &error);
+
+    // worker side; both give up once the generation moves on
+    QSharedPointer<const Snapshot> reconcile(int generation, const QSharedPointer<const ProjectFileTable> &files,
+                                             const QSharedPointer<const Snapshot> &previous, QString *error) const;
+    QSharedPointer<Storage> buildStorage(int generation, const ProjectFileTable &files, const QString &indexPath,
+                                         QString *error) const;
+
+    static QSharedPointer<Storage> loadStorage(const QString &indexPath);
+    static bool fileTrigrams(const QString &filePath, QVector<quint32> *trigrams);
+    static bool lookup(const Storage &storage, quint32 trigram, const quint32 **postings, int *count);
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef WORD_COMPLETION_MODEL_H
+#define WORD_COMPLETION_MODEL_H
+
+#include <QStringList>
+#include <KTextEditor/CodeCompletionModel>
+#include <KTextEditor/CodeCompletionModelControllerInterface>
+
+class TokenIndex;
+
+// completion model answering from the workspace token index; one instance
+// is registered with every view
+class WordCompletionModel : public KTextEditor::CodeCompletionModel, public KTextEditor::CodeCompletionModelControllerInterface
+{
+    Q_OBJECT
+    Q_INTERFACES(KTextEditor::CodeCompletionModelControllerInterface)
+
+public:
+    explicit WordCompletionModel(TokenIndex *index, QObject *parent = nullptr);
+
+    void completionInvoked(KTextEditor::View *view, const KTextEditor::Range &range,
+                           InvocationType invocationType) override;
+    QVariant data(const QModelIndex &index, int role) const override;
+
+    bool shouldStartCompletion(KTextEditor::View *view, const QString &insertedText, bool userInsertion,
+                               const KTextEditor::Cursor &position) override;
+    KTextEditor::Range updateCompletionRange(KTextEditor::View *view, const KTextEditor::Range &range) override;
+
+private:
+    TokenIndex *m_index;
+    QStringList m_completions;
+    QString m_prefix;
+
+    void query(const QString &prefix);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef WORD_HIGHLIGHTER_H
+#define WORD_HIGHLIGHTER_H
+
+#include <QObject>
+#include <QMap>
+#include <QHash>
+#include <QColor>
+#include <QTimer>
+#include <QVector>
+#include <QStringList>
+#include <KTextEditor/Attribute>
+#include "multi_pattern_matcher.h"
+
+namespace KTextEditor {
+class View;
+class Document;
+class Cursor;
+class Range;
+class MovingRange;
+}
+
+// highlights a user and plugin supplied list of words (log levels, request
+// ids, host names) in every view. the words are compiled into one automaton,
+// and only the lines around the viewport are scanned: scrolling scans the
+// lines that come into view and an edit rescans just the lines it touched
+class WordHighlighter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WordHighlighter(QObject *parent = nullptr);
+    ~WordHighlighter();
+
+    void setCaseSensitive(bool caseSensitive);
+    // adds the word, or changes its color
+    void setWord(const QString &word, const QColor &color);
+    void removeWord(const QString &word);
+    void clearWords();
+    QStringList words() const;
+
+    void addView(KTextEditor::View *view);
+    void removeView(KTextEditor::View *view);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void rebuild();
+    void resetPendingViews();
+    void onContentInvalidated(KTextEditor::Document *document);
+
+private:
+    struct ViewState
+    {
+        // lines scanned so far, empty when last < first
+        int firstLine = 0;
+        int lastLine = -1;
+        // a multi-line edit moved lines around; rescanned once the event loop is back
+        bool pendingReset = false;
+        QVector<KTextEditor::MovingRange*> ranges;
+    };
+
+    QMap<QString, QColor> m_words;
+    bool m_caseSensitive;
+    MultiPatternMatcher m_matcher;
+    // one attribute per pattern, in matcher order
+    QVector<KTextEditor::Attribute::Ptr> m_attributes;
+    QHash<KTextEditor::View*, ViewState> m_views;
+    QTimer *m_rebuildTimer;
+    QTimer *m_resetTimer;
+
+    void updateViewport(KTextEditor::View *view);
+    void resetView(KTextEditor::View *view);
+    void rescanLine(KTextEditor::View *view, int line);
+    void scanLines(KTextEditor::View *view, ViewState *state, int first, int last);
+    void dropRanges(ViewState *state, int first, int last, bool inside);
+
+    void onTextInserted(KTextEditor::Document *document, const KTextEditor::Cursor &position, const QString &text);
+    void onTextRemoved(KTextEditor::Document *document, const KTextEditor::Range &range, const QString &text);
+};
+
+#endif
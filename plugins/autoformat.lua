@@ -1,5 +1,6 @@
 -- Auto-formatter plugin
 -- Uses external formatters only (clang-format, prettier, stylua, etc.)
+-- @commands: format_document
 
 local function debug_print(msg)
     if editor and editor.debug_log then
@@ -1,5 +1,6 @@
 -- autosave plugin
 -- automatically saves files every 30 seconds
+-- @after: autoformat
 
 local function debug_print(msg)
     if editor and editor.debug_log then
@@ -70,6 +71,31 @@ function autosave.cleanup()
     _G["autosave_timer_callback"] = nil
 end
 
+-- hot reload handoff: keep the running timer and counters across a reload
+function autosave.save_state()
+    return {
+        timer_id = autosave.timer_id,
+        enabled = autosave.enabled,
+        interval = autosave.interval,
+        last_save_time = autosave.last_save_time,
+        save_count = autosave.save_count
+    }
+end
+
+function autosave.restore_state(state)
+    if not state then
+        autosave.initialize()
+        return
+    end
+
+    autosave.timer_id = state.timer_id
+    autosave.enabled = state.enabled
+    autosave.interval = state.interval
+    autosave.last_save_time = state.last_save_time
+    autosave.save_count = state.save_count
+    debug_print("Autosave plugin reloaded with existing timer")
+end
+
 -- timer callback - this is called every interval
 function autosave.on_timer()
     if not autosave.enabled then
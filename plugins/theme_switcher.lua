@@ -1,5 +1,6 @@
 -- Theme Switcher Plugin for Loom
 -- Provides functions to switch between available themes
+-- @commands: toggle_theme
 
 -- Plugin metadata
 theme_switcher = {
@@ -133,14 +134,15 @@ function get_current_theme()
     return current_theme
 end
 
--- Register event handlers
-events.connect("theme_changed", "on_theme_changed")
-
 -- Event handler for theme changes
 function on_theme_changed(event_name, theme_name)
     editor.debug_log("Theme changed to: " .. theme_name)
 end
 
+-- Register event handlers
+_G["theme_switcher.on_theme_changed"] = on_theme_changed
+events.connect("theme_changed", "theme_switcher.on_theme_changed")
+
 -- Add functions to the plugin table
 theme_switcher.toggle_theme = toggle_theme
 theme_switcher.switch_to_next_theme = switch_to_next_theme
@@ -149,6 +151,19 @@ theme_switcher.list_themes = list_themes
 theme_switcher.get_current_theme = get_current_theme
 theme_switcher.is_enabled = is_plugin_enabled
 
+-- plugins run in their own environment, so the console helpers are exported explicitly
+local exported_functions = {"toggle_theme", "switch_to_next_theme", "switch_to_theme", "list_themes", "get_current_theme"}
+for _, function_name in ipairs(exported_functions) do
+    _G[function_name] = theme_switcher[function_name]
+end
+
+function theme_switcher.cleanup()
+    for _, function_name in ipairs(exported_functions) do
+        _G[function_name] = nil
+    end
+    _G["theme_switcher.on_theme_changed"] = nil
+end
+
 -- Plugin initialization
 if is_plugin_enabled() then
     editor.debug_log("Theme Switcher plugin loaded and enabled")
@@ -4,6 +4,7 @@
 #include <QtGui/QTextBlock>
 #include <QtWidgets/QScrollBar>
 #include <QtGui/QKeyEvent>
+#include <QtGui/QMouseEvent>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QAction>
 #include <QtCore/QDebug>
@@ -13,6 +14,7 @@
 #include <KTextEditor/ConfigInterface>
 #include <KTextEditor/MarkInterface>
 #include <KTextEditor/MovingInterface>
+#include <KTextEditor/CodeCompletionInterface>
 
 CodeEditor::CodeEditor(QWidget *parent) 
     : QWidget(parent)
@@ -65,6 +67,11 @@ void CodeEditor::setupConnections()
             this, &CodeEditor::onTextChanged);
     connect(m_view, &KTextEditor::View::cursorPositionChanged,
             this, &CodeEditor::onCursorPositionChanged);
+
+    // mouse events land on the view's internal widget, not the view itself
+    if (m_view->focusProxy()) {
+        m_view->focusProxy()->installEventFilter(this);
+    }
 }
 
 void CodeEditor::configureEditor()
@@ -194,6 +201,25 @@ void CodeEditor::setTextCursor(const QTextCursor &cursor)
     Q_UNUSED(cursor)
 }
 
+void CodeEditor::setCursorPosition(int line, int column)
+{
+    if (m_view) {
+        m_view->setCursorPosition(KTextEditor::Cursor(qMax(0, line - 1), qMax(0, column - 1)));
+    }
+}
+
+void CodeEditor::selectRange(int line, int column, int length)
+{
+    if (!m_view) {
+        return;
+    }
+
+    KTextEditor::Cursor start(qMax(0, line - 1), qMax(0, column - 1));
+    KTextEditor::Cursor end(start.line(), start.column() + length);
+    m_view->setSelection(KTextEditor::Range(start, end));
+    m_view->setCursorPosition(end);
+}
+
 void CodeEditor::setFont(const QFont &font)
 {
     if (m_view) {
@@ -272,6 +298,21 @@ bool CodeEditor::lineNumbersVisible() const
     return true;
 }
 
+void CodeEditor::setCompletionModel(KTextEditor::CodeCompletionModel *model)
+{
+    if (!m_view || !model) {
+        return;
+    }
+
+    if (auto completion = qobject_cast<KTextEditor::CodeCompletionInterface*>(m_view)) {
+        completion->registerCompletionModel(model);
+        completion->setAutomaticInvocationEnabled(true);
+    }
+    if (auto config = qobject_cast<KTextEditor::ConfigInterface*>(m_view)) {
+        config->setConfigValue(QStringLiteral("word-completion"), false);
+    }
+}
+
 void CodeEditor::setAutoIndentEnabled(bool enabled)
 {
     m_autoIndentEnabled = enabled;
@@ -391,6 +432,61 @@ void CodeEditor::resizeEvent(QResizeEvent *event)
 
 }
 
+bool CodeEditor::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::MouseButtonPress && m_view && watched == m_view->focusProxy()) {
+        QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
+        if (mouseEvent->button() == Qt::LeftButton && (mouseEvent->modifiers() & Qt::ControlModifier)) {
+            QPoint position = m_view->focusProxy()->mapTo(m_view, mouseEvent->pos());
+            KTextEditor::Cursor cursor = m_view->coordinatesToCursor(position);
+            if (cursor.isValid()) {
+                m_view->setCursorPosition(cursor);
+                emit definitionRequested(cursor.line() + 1, cursor.column() + 1);
+                return true;
+            }
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+QString CodeEditor::identifierAt(int line, int column, int *startColumn) const
+{
+    if (!m_document || line < 1 || line > m_document->lines()) {
+        return QString();
+    }
+
+    const QString text = m_document->line(line - 1);
+    auto isIdentifierCharacter = [](QChar c) {
+        return c.isLetterOrNumber() || c == '_' || c == '$';
+    };
+
+    // the cursor may sit just past the end of the word
+    int start = qBound(0, column - 1, text.size());
+    if ((start == text.size() || !isIdentifierCharacter(text.at(start)))
+        && start > 0 && isIdentifierCharacter(text.at(start - 1))) {
+        --start;
+    }
+    if (start >= text.size() || !isIdentifierCharacter(text.at(start))) {
+        return QString();
+    }
+
+    int end = start;
+    while (start > 0 && isIdentifierCharacter(text.at(start - 1))) {
+        --start;
+    }
+    while (end < text.size() && isIdentifierCharacter(text.at(end))) {
+        ++end;
+    }
+
+    if (text.at(start).isDigit()) {
+        return QString();
+    }
+    if (startColumn) {
+        *startColumn = start + 1;
+    }
+    return text.mid(start, end - start);
+}
+
 void CodeEditor::onTextChanged()
 {
     emit textChanged();
@@ -0,0 +1,442 @@
+// in-document literal search
+// scans utf-16 lines for the pattern's first code unit with sse2 and
+// verifies candidates in place, folding case through a lookup table
+
+#include "document_search.h"
+#include <KTextEditor/Document>
+#include <QtAlgorithms>
+#include <QChar>
+#include <climits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// simple case folding for the basic multilingual plane
+const ushort *foldTable()
+{
+    static const QVector<ushort> table = [] {
+        QVector<ushort> folded(0x10000);
+        for (int c = 0; c < 0x10000; ++c) {
+            folded[c] = QChar(ushort(c)).toCaseFolded().unicode();
+        }
+        return folded;
+    }();
+    return table.constData();
+}
+
+inline bool isWordCharacter(ushort c)
+{
+    return c == '_' || QChar(c).isLetterOrNumber();
+}
+
+// first position in [begin, end) holding a or b
+const ushort *findEither(const ushort *begin, const ushort *end, ushort a, ushort b)
+{
+#if defined(__SSE2__)
+    const __m128i first = _mm_set1_epi16(short(a));
+    const __m128i second = _mm_set1_epi16(short(b));
+    while (end - begin >= 8) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(chunk, first),
+                                                        _mm_cmpeq_epi16(chunk, second)));
+        if (mask) {
+            return begin + qCountTrailingZeroBits(quint32(mask)) / 2;
+        }
+        begin += 8;
+    }
+#endif
+    for (; begin < end; ++begin) {
+        if (*begin == a || *begin == b) {
+            return begin;
+        }
+    }
+    return end;
+}
+
+}
+
+LiteralMatcher::LiteralMatcher()
+    : m_caseSensitive(true)
+    , m_wholeWord(false)
+{
+}
+
+LiteralMatcher::LiteralMatcher(const QString &pattern, bool caseSensitive, bool wholeWord)
+    : m_pattern(pattern)
+    , m_caseSensitive(caseSensitive)
+    , m_wholeWord(wholeWord)
+{
+    if (m_pattern.isEmpty()) {
+        return;
+    }
+
+    const ushort *fold = foldTable();
+    m_folded.reserve(m_pattern.size());
+    for (QChar c : m_pattern) {
+        m_folded.append(m_caseSensitive ? c.unicode() : fold[c.unicode()]);
+    }
+
+    if (m_caseSensitive) {
+        m_firstUnits.append(m_folded.first());
+        return;
+    }
+
+    // every unit folding to the first one, usually just the two ascii cases
+    for (int c = 0; c < 0x10000; ++c) {
+        if (fold[c] == m_folded.first()) {
+            m_firstUnits.append(ushort(c));
+        }
+    }
+}
+
+const ushort *LiteralMatcher::findCandidate(const ushort *begin, const ushort *end) const
+{
+    if (m_firstUnits.size() <= 2) {
+        return findEither(begin, end, m_firstUnits.first(), m_firstUnits.last());
+    }
+
+    const ushort *fold = foldTable();
+    const ushort first = m_folded.first();
+    for (; begin < end; ++begin) {
+        if (fold[*begin] == first) {
+            return begin;
+        }
+    }
+    return end;
+}
+
+bool LiteralMatcher::matchesAt(const ushort *text) const
+{
+    const int length = m_folded.size();
+    if (m_caseSensitive) {
+        for (int i = 1; i < length; ++i) {
+            if (text[i] != m_folded.at(i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const ushort *fold = foldTable();
+    for (int i = 1; i < length; ++i) {
+        if (fold[text[i]] != m_folded.at(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int LiteralMatcher::indexIn(const QString &text, int from) const
+{
+    const int length = m_folded.size();
+    if (length == 0 || from < 0 || text.size() - from < length) {
+        return -1;
+    }
+
+    const ushort *data = text.utf16();
+    const ushort *end = data + text.size();
+    // last place a match can start, plus one
+    const ushort *last = end - length + 1;
+
+    const ushort *cursor = data + from;
+    while (cursor < last) {
+        cursor = findCandidate(cursor, last);
+        if (cursor == last) {
+            break;
+        }
+
+        if (matchesAt(cursor)
+            && (!m_wholeWord
+                || ((cursor == data || !isWordCharacter(cursor[-1]))
+                    && (cursor + length == end || !isWordCharacter(cursor[length]))))) {
+            return int(cursor - data);
+        }
+        ++cursor;
+    }
+    return -1;
+}
+
+int LiteralMatcher::count(const QString &text) const
+{
+    int matches = 0;
+    int column = indexIn(text, 0);
+    while (column >= 0) {
+        ++matches;
+        column = indexIn(text, column + length());
+    }
+    return matches;
+}
+
+bool LiteralMatcher::matchesExactly(const QString &text) const
+{
+    return text.size() == length() && indexIn(text, 0) == 0;
+}
+
+SearchPattern::SearchPattern()
+    : m_regex(false)
+{
+}
+
+SearchPattern::SearchPattern(const QString &pattern, bool regex, bool caseSensitive, bool wholeWord)
+    : m_pattern(pattern)
+    , m_regex(regex)
+    // in regex mode the empty literal only carries the options
+    , m_literal(regex ? QString() : pattern, caseSensitive, wholeWord)
+{
+    if (!m_regex || m_pattern.isEmpty()) {
+        return;
+    }
+
+    m_expression = expressionFor(pattern, regex, caseSensitive, wholeWord);
+    m_expression.optimize();
+}
+
+QRegularExpression SearchPattern::expressionFor(const QString &pattern, bool regex, bool caseSensitive,
+                                                bool wholeWord)
+{
+    QString expression = regex ? pattern : QRegularExpression::escape(pattern);
+    if (wholeWord) {
+        expression = QString("\\b(?:%1)\\b").arg(expression);
+    }
+
+    QRegularExpression::PatternOptions options = QRegularExpression::UseUnicodePropertiesOption;
+    if (!caseSensitive) {
+        options |= QRegularExpression::CaseInsensitiveOption;
+    }
+    return QRegularExpression(expression, options);
+}
+
+bool SearchPattern::isValid() const
+{
+    return !m_regex || m_expression.isValid();
+}
+
+QString SearchPattern::errorString() const
+{
+    return m_regex ? m_expression.errorString() : QString();
+}
+
+int SearchPattern::indexIn(const QString &text, int from, int *length) const
+{
+    if (m_pattern.isEmpty() || from < 0) {
+        return -1;
+    }
+
+    if (!m_regex) {
+        *length = m_literal.length();
+        return m_literal.indexIn(text, from);
+    }
+
+    if (!m_expression.isValid()) {
+        return -1;
+    }
+
+    while (from <= text.size()) {
+        QRegularExpressionMatch match = m_expression.match(text, from);
+        if (!match.hasMatch()) {
+            return -1;
+        }
+        if (match.capturedLength() > 0) {
+            *length = match.capturedLength();
+            return match.capturedStart();
+        }
+        from = match.capturedStart() + 1;
+    }
+    return -1;
+}
+
+int SearchPattern::count(const QString &text) const
+{
+    if (!m_regex) {
+        return m_literal.count(text);
+    }
+
+    int matches = 0;
+    int length = 0;
+    int column = indexIn(text, 0, &length);
+    while (column >= 0) {
+        ++matches;
+        column = indexIn(text, column + length, &length);
+    }
+    return matches;
+}
+
+bool SearchPattern::matchesExactly(const QString &text) const
+{
+    int length = 0;
+    return indexIn(text, 0, &length) == 0 && length == text.size();
+}
+
+QString SearchPattern::expand(const QRegularExpressionMatch &match, const QString &replacement) const
+{
+    QString result;
+    result.reserve(replacement.size());
+
+    for (int i = 0; i < replacement.size(); ++i) {
+        QChar c = replacement.at(i);
+        if (c != QLatin1Char('\\') || i + 1 == replacement.size()) {
+            result.append(c);
+            continue;
+        }
+
+        QChar next = replacement.at(++i);
+        if (next.isDigit()) {
+            result.append(match.captured(next.digitValue()));
+        } else if (next == QLatin1Char('n')) {
+            result.append(QLatin1Char('\n'));
+        } else if (next == QLatin1Char('t')) {
+            result.append(QLatin1Char('\t'));
+        } else {
+            result.append(next);
+        }
+    }
+    return result;
+}
+
+QString SearchPattern::replacementAt(const QString &line, int column, const QString &replacement) const
+{
+    if (!m_regex) {
+        return replacement;
+    }
+
+    QRegularExpressionMatch match = m_expression.match(line, column, QRegularExpression::NormalMatch,
+                                                       QRegularExpression::AnchoredMatchOption);
+    return match.hasMatch() ? expand(match, replacement) : replacement;
+}
+
+QString SearchPattern::replaceAll(const QString &line, const QString &replacement, int *count) const
+{
+    *count = 0;
+
+    QString result;
+    int copied = 0;
+    int length = 0;
+    int column = indexIn(line, 0, &length);
+    while (column >= 0) {
+        if (*count == 0) {
+            result.reserve(line.size());
+        }
+        result.append(line.midRef(copied, column - copied));
+        result.append(replacementAt(line, column, replacement));
+        copied = column + length;
+        ++*count;
+        column = indexIn(line, copied, &length);
+    }
+
+    if (*count == 0) {
+        return line;
+    }
+    result.append(line.midRef(copied));
+    return result;
+}
+
+bool SearchPattern::operator==(const SearchPattern &other) const
+{
+    return m_pattern == other.m_pattern && m_regex == other.m_regex
+        && caseSensitive() == other.caseSensitive() && wholeWord() == other.wholeWord();
+}
+
+KTextEditor::Range DocumentSearch::findNext(KTextEditor::Document *document, const SearchPattern &pattern,
+                                            const KTextEditor::Cursor &from, bool *wrapped)
+{
+    if (wrapped) {
+        *wrapped = false;
+    }
+    if (!document || pattern.isEmpty()) {
+        return KTextEditor::Range::invalid();
+    }
+
+    const int lineCount = document->lines();
+    const int startLine = qBound(0, from.line(), lineCount);
+    int length = 0;
+
+    for (int line = startLine; line < lineCount; ++line) {
+        int column = pattern.indexIn(document->line(line), line == startLine ? qMax(0, from.column()) : 0, &length);
+        if (column >= 0) {
+            return KTextEditor::Range(line, column, line, column + length);
+        }
+    }
+
+    // wrap around: everything before the start position
+    for (int line = 0; line <= startLine && line < lineCount; ++line) {
+        int column = pattern.indexIn(document->line(line), 0, &length);
+        if (column < 0 || (line == startLine && column >= from.column())) {
+            continue;
+        }
+        if (wrapped) {
+            *wrapped = true;
+        }
+        return KTextEditor::Range(line, column, line, column + length);
+    }
+
+    return KTextEditor::Range::invalid();
+}
+
+KTextEditor::Range DocumentSearch::findPrevious(KTextEditor::Document *document, const SearchPattern &pattern,
+                                                const KTextEditor::Cursor &from, bool *wrapped)
+{
+    if (wrapped) {
+        *wrapped = false;
+    }
+    if (!document || pattern.isEmpty()) {
+        return KTextEditor::Range::invalid();
+    }
+
+    const int lineCount = document->lines();
+    const int startLine = qBound(0, from.line(), lineCount - 1);
+
+    // lines are searched forwards, keeping the last match before the limit
+    auto lastBefore = [&](int line, int limit) {
+        const QVector<KTextEditor::Range> matches = lineMatches(line, document->line(line), pattern);
+        for (int i = matches.size() - 1; i >= 0; --i) {
+            if (matches.at(i).start().column() < limit) {
+                return matches.at(i);
+            }
+        }
+        return KTextEditor::Range::invalid();
+    };
+
+    for (int line = startLine; line >= 0; --line) {
+        KTextEditor::Range found = lastBefore(line, line == startLine ? from.column() : INT_MAX);
+        if (found.isValid()) {
+            return found;
+        }
+    }
+
+    for (int line = lineCount - 1; line >= startLine && line >= 0; --line) {
+        KTextEditor::Range found = lastBefore(line, INT_MAX);
+        if (!found.isValid() || (line == startLine && found.start().column() < from.column())) {
+            continue;
+        }
+        if (wrapped) {
+            *wrapped = true;
+        }
+        return found;
+    }
+
+    return KTextEditor::Range::invalid();
+}
+
+QVector<KTextEditor::Range> DocumentSearch::lineMatches(int line, const QString &text, const SearchPattern &pattern)
+{
+    QVector<KTextEditor::Range> matches;
+    int length = 0;
+    int column = pattern.indexIn(text, 0, &length);
+    while (column >= 0) {
+        matches.append(KTextEditor::Range(line, column, line, column + length));
+        column = pattern.indexIn(text, column + length, &length);
+    }
+    return matches;
+}
+
+KTextEditor::Cursor DocumentSearch::endOf(const KTextEditor::Cursor &start, const QString &text)
+{
+    int lastBreak = text.lastIndexOf(QLatin1Char('\n'));
+    if (lastBreak < 0) {
+        return KTextEditor::Cursor(start.line(), start.column() + text.size());
+    }
+    return KTextEditor::Cursor(start.line() + text.count(QLatin1Char('\n')), text.size() - lastBreak - 1);
+}
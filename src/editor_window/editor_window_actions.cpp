@@ -34,7 +34,7 @@ void EditorWindow::setupKeybindings()
         DEBUG_LOG_EDITOR("✓ Registered keybinding:" << keySequence << "->" << action);
     }
 
-    if (keybindings.contains("F12")) {
+    if (keybindings.contains("Ctrl+B")) {
         DEBUG_LOG_EDITOR("✓ toggle_file_tree shortcut found in keybindings");
     } else {
         DEBUG_LOG_EDITOR("✗ toggle_file_tree shortcut NOT found in keybindings");
@@ -59,10 +59,34 @@ void EditorWindow::executeAction(const QString &action)
 
     m_statusBar->showMessage(QString("Action: %1").arg(action), 1000);
 
+    if (m_pluginManager) {
+        m_pluginManager->activateForCommand(action);
+    }
+
     if (action == "save_file") {
         saveFile();
     } else if (action == "open_file") {
         onOpenFile();
+    } else if (action == "quick_open") {
+        showQuickOpen();
+    } else if (action == "workspace_symbol") {
+        showWorkspaceSymbols();
+    } else if (action == "goto_definition") {
+        CodeEditor *textEdit = getCurrentTextEditor();
+        if (textEdit && textEdit->view()) {
+            KTextEditor::Cursor cursor = textEdit->view()->cursorPosition();
+            goToDefinition(textEdit, cursor.line() + 1, cursor.column() + 1);
+        }
+    } else if (action == "find_references") {
+        findReferences();
+    } else if (action == "find_in_files") {
+        showProjectSearch();
+    } else if (action == "find_in_open_files") {
+        showOpenDocumentsSearch();
+    } else if (action == "replace_in_files") {
+        showProjectReplace();
+    } else if (action == "transform_file") {
+        transformFile();
     } else if (action == "new_file") {
         newFile();
     } else if (action == "close_file") {
@@ -91,6 +115,14 @@ void EditorWindow::executeAction(const QString &action)
         newFile();
     } else if (action == "find") {
         showFindDialog();
+    } else if (action == "find_next" || action == "find_previous") {
+        if (m_findBar->pattern().isEmpty()) {
+            showFindDialog();
+        } else if (action == "find_next") {
+            m_findBar->findNext();
+        } else {
+            m_findBar->findPrevious();
+        }
     } else if (action == "replace") {
         showReplaceDialog();
     } else if (action == "toggle_fullscreen") {
@@ -151,118 +183,31 @@ void EditorWindow::executeAction(const QString &action)
 
 void EditorWindow::showFindDialog()
 {
-    CodeEditor* textEdit = getCurrentTextEditor();
-    if (!textEdit) {
-        m_statusBar->showMessage("No text editor available", 2000);
-        return;
-    }
-
-    bool ok;
-    QString searchText = QInputDialog::getText(this, "Find", "Find text:", QLineEdit::Normal, "", &ok);
-
-    if (ok && !searchText.isEmpty()) {
-        findText(searchText);
-    }
+    showFindBar(false);
 }
 
 void EditorWindow::showReplaceDialog()
 {
-    CodeEditor* textEdit = getCurrentTextEditor();
-    if (!textEdit) {
-        m_statusBar->showMessage("No text editor available", 2000);
-        return;
-    }
-
-    bool ok;
-    QString searchText = QInputDialog::getText(this, "Replace", "Find text:", QLineEdit::Normal, "", &ok);
-
-    if (!ok || searchText.isEmpty()) {
-        return;
-    }
-
-    QString replaceWith = QInputDialog::getText(this, "Replace", "Replace with:", QLineEdit::Normal, "", &ok);
-
-    if (ok) {
-
-        QMessageBox::StandardButton reply = QMessageBox::question(this,
-            "Replace", "Replace all occurrences?",
-            QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
-
-        if (reply == QMessageBox::Yes) {
-            replaceText(searchText, replaceWith, true);
-        } else if (reply == QMessageBox::No) {
-            replaceText(searchText, replaceWith, false);
-        }
-    }
+    showFindBar(true);
 }
 
-void EditorWindow::findText(const QString &searchText, bool caseSensitive)
+void EditorWindow::showFindBar(bool replace)
 {
     CodeEditor* textEdit = getCurrentTextEditor();
     if (!textEdit) {
+        m_statusBar->showMessage("No text editor available", 2000);
         return;
     }
 
-    QTextDocument::FindFlags flags = QTextDocument::FindFlags();
-    if (caseSensitive) {
-        flags |= QTextDocument::FindCaseSensitively;
-    }
-
-    QTextCursor cursor = textEdit->textCursor();
-    QTextCursor found = textEdit->document()->find(searchText, cursor, flags);
-
-    if (!found.isNull()) {
-        textEdit->setTextCursor(found);
-        m_statusBar->showMessage(QString("Found: %1").arg(searchText), 2000);
-    } else {
-
-        cursor.movePosition(QTextCursor::Start);
-        found = textEdit->document()->find(searchText, cursor, flags);
-
-        if (!found.isNull()) {
-            textEdit->setTextCursor(found);
-            m_statusBar->showMessage(QString("Found: %1 (wrapped to beginning)").arg(searchText), 2000);
-        } else {
-            m_statusBar->showMessage(QString("Not found: %1").arg(searchText), 2000);
+    // seed the pattern with a single line selection
+    QString selection;
+    if (textEdit->view() && textEdit->view()->selection()) {
+        selection = textEdit->view()->selectionText();
+        if (selection.contains('\n')) {
+            selection.clear();
         }
     }
-}
-
-void EditorWindow::replaceText(const QString &searchText, const QString &replaceText, bool replaceAll)
-{
-    CodeEditor* textEdit = getCurrentTextEditor();
-    if (!textEdit) {
-        return;
-    }
-
-    QTextCursor cursor = textEdit->textCursor();
-    int replacements = 0;
-
-    if (replaceAll) {
-
-        cursor.movePosition(QTextCursor::Start);
-
-        while (true) {
-            QTextCursor found = textEdit->document()->find(searchText, cursor);
-            if (found.isNull()) {
-                break;
-            }
-
-            found.insertText(replaceText);
-            cursor = found;
-            replacements++;
-        }
-
-        m_statusBar->showMessage(QString("Replaced %1 occurrences").arg(replacements), 3000);
-    } else {
 
-        if (cursor.hasSelection() && cursor.selectedText() == searchText) {
-            cursor.insertText(replaceText);
-            replacements = 1;
-            m_statusBar->showMessage("Replaced current occurrence", 2000);
-        } else {
-
-            findText(searchText);
-        }
-    }
+    m_findBar->setEditor(textEdit);
+    m_findBar->activate(selection, replace);
 }
@@ -122,6 +122,35 @@ void EditorWindow::keyPressEvent(QKeyEvent *event)
     QMainWindow::keyPressEvent(event);
 }
 
+void EditorWindow::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
+
+    if (m_pluginsStarted) {
+        return;
+    }
+
+    // the first frame is painted while the window handles its first expose,
+    // so plugins are queued behind that rather than behind show()
+    QWindow *window = windowHandle();
+    if (window && !window->isExposed()) {
+        window->installEventFilter(this);
+    } else {
+        QTimer::singleShot(0, this, &EditorWindow::startDeferredPlugins);
+    }
+}
+
+bool EditorWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    QWindow *window = windowHandle();
+    if (window && watched == window && event->type() == QEvent::Expose && window->isExposed()) {
+        window->removeEventFilter(this);
+        QTimer::singleShot(0, this, &EditorWindow::startDeferredPlugins);
+    }
+
+    return QMainWindow::eventFilter(watched, event);
+}
+
 void EditorWindow::onLuaFileOpenRequested(const QString &filePath)
 {
     openFile(filePath);
@@ -138,6 +167,9 @@ void EditorWindow::onLuaFileSaveRequested(const QString &filePath)
             if (currentIndex >= 0) {
                 updateTabTitle(currentIndex);
                 updateTabModificationIndicator(currentIndex);
+                if (m_tokenIndex) {
+                    m_tokenIndex->setDocumentPath(m_textEditors[currentIndex]->ktextDocument(), filePath);
+                }
             }
             updateWindowTitle();
             updateStatusBar();
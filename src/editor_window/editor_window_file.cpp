@@ -19,6 +19,17 @@ void EditorWindow::openProject(const QString &projectPath)
         m_statusBar->showMessage(QString("Opened project: %1").arg(projectName), 3000);
         DEBUG_LOG_EDITOR("Opened project:" << projectPath);
     }
+
+    if (m_projectIndexer && m_luaBridge->getConfigBool("project.index", true)) {
+        m_projectIndexer->setRespectIgnoreFiles(m_luaBridge->getConfigBool("project.respect_ignore_files", true));
+        m_projectIndexer->setSkipBinaryFiles(m_luaBridge->getConfigBool("project.skip_binary_files", true));
+        m_projectIndexer->setCacheEnabled(m_luaBridge->getConfigBool("project.cache", true));
+        m_projectIndexer->setWatchEnabled(m_luaBridge->getConfigBool("project.watch", true));
+        m_projectIndexer->setTrigramIndexEnabled(m_luaBridge->getConfigBool("project.trigram_index", false));
+        m_projectIndexer->setGitStatusEnabled(m_luaBridge->getConfigBool("project.git_status", true));
+        m_projectIndexer->setSymbolIndexEnabled(m_luaBridge->getConfigBool("project.symbol_index", true));
+        m_projectIndexer->setRootPath(projectPath);
+    }
 }
 
 void EditorWindow::openFile(const QString &filePath)
@@ -66,8 +77,16 @@ void EditorWindow::openFile(const QString &filePath)
         QString content = buffer->content();
         textEdit->setPlainText(content);
 
+        if (m_tokenIndex) {
+            m_tokenIndex->setDocumentPath(textEdit->ktextDocument(), filePath);
+        }
+
         detectAndSetLanguage(filePath);
 
+        if (m_pluginManager) {
+            m_pluginManager->activateForFileType(detectLanguageFromExtension(filePath));
+        }
+
         connect(textEdit, &CodeEditor::textChanged, this, &EditorWindow::onTextChanged);
 
         buffer->setModified(false);
@@ -165,6 +184,10 @@ void EditorWindow::saveFile()
     }
 
     if (m_luaBridge) {
+        if (m_pluginManager && m_luaBridge->getConfigBool("plugins.autoformat.format_on_save", false)) {
+            m_pluginManager->activateForCommand("format_document");
+        }
+
         QString formatScript = R"(
             if autoformat and autoformat.enabled and autoformat.format_on_save then
                 autoformat.format_document()
@@ -206,6 +229,10 @@ void EditorWindow::saveFileAs()
     if (!filePath.isEmpty()) {
 
         if (m_luaBridge) {
+            if (m_pluginManager && m_luaBridge->getConfigBool("plugins.autoformat.format_on_save", false)) {
+                m_pluginManager->activateForCommand("format_document");
+            }
+
             QString formatScript = R"(
                 if autoformat and autoformat.enabled and autoformat.format_on_save then
                     autoformat.format_document()
@@ -219,6 +246,9 @@ void EditorWindow::saveFileAs()
             if (currentIndex >= 0) {
                 updateTabTitle(currentIndex);
                 updateTabModificationIndicator(currentIndex);
+                if (m_tokenIndex) {
+                    m_tokenIndex->setDocumentPath(m_textEditors[currentIndex]->ktextDocument(), filePath);
+                }
             }
             updateWindowTitle();
             updateStatusBar();
@@ -254,11 +284,133 @@ bool EditorWindow::saveCurrentFile()
             m_luaBridge->emitEvent("file_saved", args);
         }
 
+        if (m_projectIndexer) {
+            m_projectIndexer->trigramIndex()->updateFiles(QStringList() << buffer->filePath());
+            m_projectIndexer->symbolIndex()->updateFiles(QStringList() << buffer->filePath());
+
+            // the watcher reports this too, but it may be off or past its watch limit
+            QString relativePath = QDir(m_projectIndexer->rootPath()).relativeFilePath(buffer->filePath());
+            if (!relativePath.startsWith(QLatin1String(".."))) {
+                m_projectIndexer->gitStatus()->updatePaths(QStringList(), QStringList() << relativePath);
+            }
+        }
+
         return true;
     }
     return false;
 }
 
+void EditorWindow::transformFile()
+{
+    if (m_fileTransform && m_fileTransform->isRunning()) {
+        m_statusBar->showMessage("A file transform is already running", 3000);
+        return;
+    }
+
+    TransformFileDialog dialog(this);
+    Buffer* buffer = getCurrentBuffer();
+    if (buffer) {
+        dialog.setFilePath(buffer->filePath());
+    }
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    const QString filePath = QFileInfo(dialog.filePath()).absoluteFilePath();
+    const QString canonicalPath = QFileInfo(filePath).canonicalFilePath();
+
+    // the rewrite goes straight to disk, so unsaved edits in a tab would be lost
+    for (Buffer* openBuffer : m_buffers) {
+        if (openBuffer->isModified() && !openBuffer->filePath().isEmpty()
+            && QFileInfo(openBuffer->filePath()).canonicalFilePath() == canonicalPath) {
+            QMessageBox::warning(this, "Transform File",
+                QString("%1 has unsaved changes. Save or close it first.").arg(QFileInfo(filePath).fileName()));
+            return;
+        }
+    }
+
+    if (!m_fileTransform) {
+        m_fileTransform = new FileTransform(this);
+        connect(m_fileTransform, &FileTransform::progress, this, [this](qint64 bytesRead, qint64 totalBytes) {
+            if (m_transformProgress && totalBytes > 0) {
+                m_transformProgress->setValue(static_cast<int>(bytesRead * 1000 / totalBytes));
+            }
+        });
+        connect(m_fileTransform, &FileTransform::finished, this, [this](qint64 replacements) {
+            const QString filePath = m_transformProgress ? m_transformProgress->property("filePath").toString()
+                                                         : QString();
+            if (m_transformProgress) {
+                m_transformProgress->deleteLater();
+            }
+
+            if (replacements == 0) {
+                m_statusBar->showMessage("No matches, file unchanged", 5000);
+                return;
+            }
+            m_statusBar->showMessage(QString("Replaced %1 occurrence(s) in %2")
+                                     .arg(replacements).arg(QFileInfo(filePath).fileName()), 5000);
+            reloadTransformedFile(filePath);
+        });
+        connect(m_fileTransform, &FileTransform::failed, this, [this](const QString &error) {
+            if (m_transformProgress) {
+                m_transformProgress->deleteLater();
+            }
+            QMessageBox::warning(this, "Transform File", error + "\n\nThe file was not changed.");
+        });
+    }
+
+    if (!m_fileTransform->start(filePath, dialog.query(), dialog.replacement())) {
+        QMessageBox::warning(this, "Transform File", m_fileTransform->lastError());
+        return;
+    }
+
+    // window modal, so the file cannot be reopened or saved from a tab midway
+    m_transformProgress = new QProgressDialog(QString("Transforming %1...").arg(QFileInfo(filePath).fileName()),
+                                              "Cancel", 0, 1000, this);
+    m_transformProgress->setProperty("filePath", filePath);
+    m_transformProgress->setWindowModality(Qt::WindowModal);
+    m_transformProgress->setAutoClose(false);
+    m_transformProgress->setAutoReset(false);
+    m_transformProgress->setMinimumDuration(0);
+    m_transformProgress->setValue(0);
+    connect(m_transformProgress, &QProgressDialog::canceled, this, [this]() {
+        m_fileTransform->cancel();
+        m_transformProgress->deleteLater();
+        m_statusBar->showMessage("Transform cancelled, file unchanged", 5000);
+    });
+}
+
+void EditorWindow::reloadTransformedFile(const QString &filePath)
+{
+    const QString canonicalPath = QFileInfo(filePath).canonicalFilePath();
+    for (int i = 0; i < m_buffers.size(); ++i) {
+        Buffer* buffer = m_buffers[i];
+        if (buffer->filePath().isEmpty() || QFileInfo(buffer->filePath()).canonicalFilePath() != canonicalPath) {
+            continue;
+        }
+
+        if (!buffer->isModified() && buffer->load(buffer->filePath())) {
+            CodeEditor* textEdit = m_textEditors[i];
+            disconnect(textEdit, &CodeEditor::textChanged, this, &EditorWindow::onTextChanged);
+            textEdit->setPlainText(buffer->content());
+            connect(textEdit, &CodeEditor::textChanged, this, &EditorWindow::onTextChanged);
+            buffer->setModified(false);
+            updateTabTitle(i);
+            updateTabModificationIndicator(i);
+        }
+    }
+
+    if (m_projectIndexer) {
+        m_projectIndexer->trigramIndex()->updateFiles(QStringList() << filePath);
+        m_projectIndexer->symbolIndex()->updateFiles(QStringList() << filePath);
+
+        QString relativePath = QDir(m_projectIndexer->rootPath()).relativeFilePath(filePath);
+        if (!relativePath.startsWith(QLatin1String(".."))) {
+            m_projectIndexer->gitStatus()->updatePaths(QStringList(), QStringList() << relativePath);
+        }
+    }
+}
+
 void EditorWindow::updateWindowTitle()
 {
     QString title = "Loom";
@@ -327,19 +479,50 @@ void EditorWindow::loadPlugins()
     if (QDir(pluginDir).exists()) {
         DEBUG_LOG_EDITOR("Loading plugins from directory:" << pluginDir);
         if (m_pluginManager->loadPlugins(pluginDir)) {
-            QStringList loadedPlugins = m_pluginManager->loadedPlugins();
-            LOG_INFO("Plugins loaded successfully:" << loadedPlugins);
-
-            if (!loadedPlugins.isEmpty()) {
-                m_statusBar->showMessage(QString("Loaded %1 plugin(s)").arg(loadedPlugins.size()), 3000);
-            }
-        } else {
-            LOG_ERROR("Failed to load plugins:" << m_luaBridge->lastError());
+            return;
         }
+        LOG_ERROR("Failed to load plugins:" << m_pluginManager->lastError());
     } else {
         DEBUG_LOG_EDITOR("No plugin directory found, continuing without plugins");
     }
 
+    // nothing to wait for, so startup finishes right away
+    onPluginsLoaded(0);
+}
+
+void EditorWindow::startDeferredPlugins()
+{
+    if (m_pluginsStarted) {
+        return;
+    }
+    m_pluginsStarted = true;
+
+    DEBUG_LOG_EDITOR("Window painted, loading deferred plugins");
+    loadPlugins();
+}
+
+void EditorWindow::onPluginsLoaded(int loadedCount)
+{
+    if (loadedCount > 0) {
+        LOG_INFO("Plugins loaded successfully:" << m_pluginManager->loadedPlugins());
+        m_statusBar->showMessage(QString("Loaded %1 plugin(s)").arg(loadedCount), 3000);
+    }
+
+    // files opened before plugins were ready still count for filetype activation
+    if (m_pluginManager) {
+        for (Buffer *buffer : m_buffers) {
+            if (!buffer->filePath().isEmpty()) {
+                m_pluginManager->activateForFileType(detectLanguageFromExtension(buffer->filePath()));
+            }
+        }
+    }
+
+    refreshToolsMenu();
+    updateLuaEditorState();
+
+    if (m_luaBridge) {
+        m_luaBridge->setEventsDeferred(false);
+    }
 }
 
 void EditorWindow::applyConfiguration()
@@ -389,6 +572,17 @@ void EditorWindow::applyConfiguration()
         textEdit->setCurrentLineHighlightEnabled(highlightCurrentLine);
     }
 
+    m_wordHighlighter->setCaseSensitive(m_luaBridge->getConfigBool("highlight.case_sensitive", true));
+    const QMap<QString, QString> highlightWords = m_luaBridge->getHighlightWords();
+    for (auto it = highlightWords.constBegin(); it != highlightWords.constEnd(); ++it) {
+        QColor color(it.value());
+        if (color.isValid()) {
+            m_wordHighlighter->setWord(it.key(), color);
+        } else {
+            LOG_WARNING("Ignoring highlight word" << it.key() << "with invalid color" << it.value());
+        }
+    }
+
     int windowWidth = m_luaBridge->getConfigInt("window.width", 1024);
     int windowHeight = m_luaBridge->getConfigInt("window.height", 768);
 
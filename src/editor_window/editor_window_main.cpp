@@ -5,6 +5,7 @@ EditorWindow::EditorWindow(QWidget *parent)
     , m_tabWidget(nullptr)
     , m_statusBar(nullptr)
     , m_luaBridge(nullptr)
+    , m_pluginsStarted(false)
 {
 
     m_luaBridge = new LuaBridge(this);
@@ -16,10 +17,37 @@ EditorWindow::EditorWindow(QWidget *parent)
 
     m_luaBridge->setPluginManager(m_pluginManager);
 
+    m_quickOpenDialog = nullptr;
+    m_symbolDialog = nullptr;
+    m_searchDock = nullptr;
+    m_searchPanel = nullptr;
+    m_referencesDock = nullptr;
+    m_referencesPanel = nullptr;
+    m_tokenIndex = nullptr;
+    m_completionModel = nullptr;
+    m_findBar = nullptr;
+    m_fileTransform = nullptr;
+
+    m_wordHighlighter = new WordHighlighter(this);
+
+    m_projectIndexer = new ProjectIndexer(this);
+    connect(m_projectIndexer, &ProjectIndexer::indexReady,
+            this, [this](int fileCount) {
+                m_statusBar->showMessage(QString("Indexed %1 project files").arg(fileCount), 3000);
+                if (m_tokenIndex) {
+                    m_tokenIndex->setProjectFiles(m_projectIndexer->files());
+                }
+            });
+
     connect(m_pluginManager, &PluginManager::pluginLoaded,
             this, [this](const QString &pluginName) {
                 m_statusBar->showMessage(QString("Plugin loaded: %1").arg(pluginName), 3000);
             });
+    connect(m_pluginManager, &PluginManager::pluginReloaded,
+            this, [this](const QString &pluginName) {
+                m_statusBar->showMessage(QString("Plugin reloaded: %1").arg(pluginName), 3000);
+            });
+    connect(m_pluginManager, &PluginManager::pluginsLoaded, this, &EditorWindow::onPluginsLoaded);
     connect(m_pluginManager, &PluginManager::pluginError,
             this, [this](const QString &pluginName, const QString &error) {
                 m_statusBar->showMessage(QString("Plugin error (%1): %2").arg(pluginName, error), 5000);
@@ -31,12 +59,24 @@ EditorWindow::EditorWindow(QWidget *parent)
 
     loadConfiguration();
 
+    // needs the loaded config, and has to exist before the first tab
+    if (m_luaBridge->getConfigBool("editor.workspace_completion", true)) {
+        m_tokenIndex = new TokenIndex(this);
+        m_completionModel = new WordCompletionModel(m_tokenIndex, this);
+    }
+
     applyConfiguration();
     setupKeybindings();
 
     setupSyntaxHighlighting();
 
-    loadPlugins();
+    // plugin startup runs after the first paint, see startDeferredPlugins; either
+    // way events wait for the asynchronous scan in onPluginsLoaded
+    m_luaBridge->setEventsDeferred(true);
+    if (!m_luaBridge->getConfigBool("plugins.defer_loading", true)) {
+        loadPlugins();
+        m_pluginsStarted = true;
+    }
 
     setupMenus();
 
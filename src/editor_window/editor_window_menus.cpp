@@ -15,6 +15,16 @@ void EditorWindow::setupMenus()
     connect(openAction, &QAction::triggered, this, &EditorWindow::onOpenFile);
     fileMenu->addAction(openAction);
 
+    QAction *quickOpenAction = new QAction("&Quick Open...", this);
+    quickOpenAction->setStatusTip("Fuzzy find a file in the current project (Ctrl+P)");
+    connect(quickOpenAction, &QAction::triggered, this, &EditorWindow::showQuickOpen);
+    fileMenu->addAction(quickOpenAction);
+
+    QAction *workspaceSymbolAction = new QAction("Go to &Symbol in Workspace...", this);
+    workspaceSymbolAction->setStatusTip("Fuzzy find a function, class or global in the current project (Ctrl+Alt+O)");
+    connect(workspaceSymbolAction, &QAction::triggered, this, &EditorWindow::showWorkspaceSymbols);
+    fileMenu->addAction(workspaceSymbolAction);
+
     fileMenu->addSeparator();
 
     QAction *saveAction = new QAction("&Save", this);
@@ -102,11 +112,59 @@ void EditorWindow::setupMenus()
     connect(findAction, &QAction::triggered, this, &EditorWindow::showFindDialog);
     editMenu->addAction(findAction);
 
+    QAction *findNextAction = new QAction("Find &Next", this);
+    findNextAction->setStatusTip("Jump to the next match of the find bar pattern (F3)");
+    connect(findNextAction, &QAction::triggered, [this]() {
+        executeAction("find_next");
+    });
+    editMenu->addAction(findNextAction);
+
+    QAction *findPreviousAction = new QAction("Find Pre&vious", this);
+    findPreviousAction->setStatusTip("Jump to the previous match of the find bar pattern (Shift+F3)");
+    connect(findPreviousAction, &QAction::triggered, [this]() {
+        executeAction("find_previous");
+    });
+    editMenu->addAction(findPreviousAction);
+
     QAction *replaceAction = new QAction("&Replace", this);
     replaceAction->setStatusTip("Find and replace text in the document");
     connect(replaceAction, &QAction::triggered, this, &EditorWindow::showReplaceDialog);
     editMenu->addAction(replaceAction);
 
+    QAction *findInFilesAction = new QAction("Find in &Files...", this);
+    findInFilesAction->setStatusTip("Search every file in the current project (Ctrl+Alt+F)");
+    connect(findInFilesAction, &QAction::triggered, this, &EditorWindow::showProjectSearch);
+    editMenu->addAction(findInFilesAction);
+
+    QAction *findInOpenFilesAction = new QAction("Find in &Open Files...", this);
+    findInOpenFilesAction->setStatusTip("Search every open tab, including unsaved changes (Ctrl+Alt+Shift+F)");
+    connect(findInOpenFilesAction, &QAction::triggered, this, &EditorWindow::showOpenDocumentsSearch);
+    editMenu->addAction(findInOpenFilesAction);
+
+    QAction *replaceInFilesAction = new QAction("Replace in F&iles...", this);
+    replaceInFilesAction->setStatusTip("Preview and replace matches across the project (Ctrl+Shift+H)");
+    connect(replaceInFilesAction, &QAction::triggered, this, &EditorWindow::showProjectReplace);
+    editMenu->addAction(replaceInFilesAction);
+
+    QAction *transformFileAction = new QAction("&Transform File...", this);
+    transformFileAction->setStatusTip("Find and replace in a file too large to open, without loading it");
+    connect(transformFileAction, &QAction::triggered, this, &EditorWindow::transformFile);
+    editMenu->addAction(transformFileAction);
+
+    editMenu->addSeparator();
+
+    QAction *definitionAction = new QAction("Go to &Definition", this);
+    definitionAction->setStatusTip("Jump to the definition of the symbol under the cursor (F12 or Ctrl+Click)");
+    connect(definitionAction, &QAction::triggered, [this]() {
+        executeAction("goto_definition");
+    });
+    editMenu->addAction(definitionAction);
+
+    QAction *referencesAction = new QAction("Find &References", this);
+    referencesAction->setStatusTip("List every use of the symbol under the cursor in the project (Shift+F12)");
+    connect(referencesAction, &QAction::triggered, this, &EditorWindow::findReferences);
+    editMenu->addAction(referencesAction);
+
     QMenu *viewMenu = menuBar()->addMenu("&View");
 
     QAction *fullscreenAction = new QAction("Toggle &Fullscreen", this);
@@ -136,7 +194,7 @@ void EditorWindow::setupMenus()
     viewMenu->addSeparator();
 
     QAction *toggleFileTreeAction = new QAction("Toggle &File Tree", this);
-    toggleFileTreeAction->setStatusTip("Toggle file tree visibility (F12)");
+    toggleFileTreeAction->setStatusTip("Toggle file tree visibility (Ctrl+B)");
     connect(toggleFileTreeAction, &QAction::triggered, [this]() {
         if (m_fileTreeWidget) {
             bool wasVisible = m_fileTreeWidget->isVisible();
@@ -195,6 +253,9 @@ void EditorWindow::refreshToolsMenu()
         QAction *formatAction = new QAction("&Format Document", this);
         formatAction->setStatusTip("Format the current document using auto-formatter");
         connect(formatAction, &QAction::triggered, [this]() {
+            if (m_pluginManager) {
+                m_pluginManager->activateForCommand("format_document");
+            }
             if (m_luaBridge) {
                 QString formatScript = "if autoformat then autoformat.format_document() end";
                 if (m_luaBridge->executeString(formatScript)) {
@@ -212,6 +273,9 @@ void EditorWindow::refreshToolsMenu()
         QAction *toggleThemeAction = new QAction("&Toggle Theme", this);
         toggleThemeAction->setStatusTip("Switch to the next available theme");
         connect(toggleThemeAction, &QAction::triggered, [this]() {
+            if (m_pluginManager) {
+                m_pluginManager->activateForCommand("toggle_theme");
+            }
             if (m_luaBridge) {
                 m_luaBridge->executeString("toggle_theme()");
             }
@@ -228,9 +292,10 @@ void EditorWindow::refreshToolsMenu()
     reloadPluginsAction->setStatusTip("Reload all plugins from the plugins directory");
     connect(reloadPluginsAction, &QAction::triggered, [this]() {
         if (m_pluginManager) {
+            // events wait for the new plugins, onPluginsLoaded lets them through
+            m_luaBridge->setEventsDeferred(true);
             m_pluginManager->reloadPlugins();
-            QStringList loadedPlugins = m_pluginManager->loadedPlugins();
-            m_statusBar->showMessage(QString("Reloaded %1 plugin(s)").arg(loadedPlugins.size()), 3000);
+            m_statusBar->showMessage("Reloading plugins...", 3000);
 
             refreshToolsMenu();
         }
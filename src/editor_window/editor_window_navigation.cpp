@@ -0,0 +1,316 @@
+#include "editor_window.h"
+
+void EditorWindow::showQuickOpen()
+{
+    if (!m_projectIndexer) {
+        return;
+    }
+
+    QSharedPointer<const ProjectFileTable> files = m_projectIndexer->files();
+    if (files->fileCount() == 0) {
+        if (m_projectIndexer->isIndexing()) {
+            m_statusBar->showMessage("Project index is still being built", 2000);
+        } else {
+            m_statusBar->showMessage("No project open - open a project folder first", 3000);
+        }
+        return;
+    }
+
+    // the matcher keeps its own folded copy, rebuilt only when the index changes
+    if (files != m_fileMatcherSource) {
+        m_fileMatcherSource = files;
+        m_fileMatcher.setCandidates(files->fileCount(), [files](int file) {
+            return files->relativePath(file);
+        });
+    }
+
+    if (!m_quickOpenDialog) {
+        m_quickOpenDialog = new QuickOpenDialog(this);
+        m_quickOpenDialog->setPlaceholderText("Go to file");
+        m_quickOpenDialog->setActivator([this](const QuickOpenItem &item) {
+            openFile(item.data.toString());
+        });
+    }
+
+    m_quickOpenDialog->setProvider([this](const QString &query) {
+        QVector<QuickOpenItem> items;
+        const QSharedPointer<const ProjectFileTable> table = m_fileMatcherSource;
+
+        const QVector<FuzzyMatch> matches = m_fileMatcher.match(query, 50);
+        for (const FuzzyMatch &match : matches) {
+            QuickOpenItem item;
+            item.title = table->fileName(match.index);
+            item.detail = table->directoryPath(table->directoryIndex(match.index));
+            item.data = table->absolutePath(match.index);
+            items.append(item);
+        }
+        return items;
+    });
+
+    m_quickOpenDialog->popup();
+}
+
+void EditorWindow::showWorkspaceSymbols()
+{
+    if (!m_projectIndexer) {
+        return;
+    }
+
+    QSharedPointer<const SymbolTable> symbols = m_projectIndexer->symbolIndex()->symbols();
+    if (!symbols) {
+        if (m_projectIndexer->rootPath().isEmpty()) {
+            m_statusBar->showMessage("No project open - open a project folder first", 3000);
+        } else {
+            m_statusBar->showMessage("Symbol index is still being built", 2000);
+        }
+        return;
+    }
+
+    if (symbols != m_symbolMatcherSource) {
+        m_symbolMatcherSource = symbols;
+        m_symbolMatcher.setCandidates(symbols->symbolCount(), [symbols](int symbol) {
+            return symbols->name(symbol);
+        });
+    }
+
+    QuickOpenDialog *dialog = symbolDialog();
+    dialog->setPlaceholderText("Go to symbol in workspace");
+    dialog->setProvider([this](const QString &query) {
+        QVector<QuickOpenItem> items;
+        const QSharedPointer<const SymbolTable> table = m_symbolMatcherSource;
+
+        const QVector<FuzzyMatch> matches = m_symbolMatcher.match(query, 50);
+        for (const FuzzyMatch &match : matches) {
+            items.append(symbolItem(*table, match.index));
+        }
+        return items;
+    });
+
+    dialog->popup();
+}
+
+QuickOpenDialog *EditorWindow::symbolDialog()
+{
+    if (!m_symbolDialog) {
+        m_symbolDialog = new QuickOpenDialog(this);
+        m_symbolDialog->setActivator([this](const QuickOpenItem &item) {
+            const QVariantList location = item.data.toList();
+            openSearchHit(location.value(0).toString(), location.value(1).toInt(),
+                          location.value(2).toInt(), location.value(3).toInt());
+        });
+    }
+    return m_symbolDialog;
+}
+
+QuickOpenItem EditorWindow::symbolItem(const SymbolTable &table, int symbol) const
+{
+    QString container = table.container(symbol);
+    QString name = table.name(symbol);
+
+    QuickOpenItem item;
+    item.title = name;
+    item.detail = QString("%1%2  %3:%4")
+                      .arg(container.isEmpty() ? QString() : container + "  ",
+                           SymbolTable::kindName(table.kind(symbol)),
+                           table.relativePath(symbol),
+                           QString::number(table.line(symbol)));
+    item.data = QVariantList() << table.absolutePath(symbol) << table.line(symbol)
+                               << table.column(symbol) << name.size();
+    return item;
+}
+
+void EditorWindow::goToDefinition(CodeEditor *textEdit, int line, int column)
+{
+    if (!textEdit || !m_projectIndexer) {
+        return;
+    }
+
+    int startColumn = 0;
+    const QString name = textEdit->identifierAt(line, column, &startColumn);
+    if (name.isEmpty()) {
+        m_statusBar->showMessage("No identifier under the cursor", 2000);
+        return;
+    }
+
+    QSharedPointer<const SymbolTable> symbols = m_projectIndexer->symbolIndex()->symbols();
+    if (!symbols) {
+        m_statusBar->showMessage(m_projectIndexer->rootPath().isEmpty()
+            ? "No project open - open a project folder first" : "Symbol index is still being built", 3000);
+        return;
+    }
+
+    // definitions win; a prototype is only offered when nothing defines the name
+    QVector<int> matches = symbols->findExact(name);
+    QVector<int> definitions;
+    for (int symbol : matches) {
+        if (!symbols->isDeclaration(symbol)) {
+            definitions.append(symbol);
+        }
+    }
+    if (definitions.isEmpty()) {
+        definitions = matches;
+    }
+
+    Buffer *buffer = getCurrentBuffer();
+    const QString currentPath = buffer ? buffer->filePath() : QString();
+
+    // the definition under the cursor is no place to jump to
+    if (definitions.size() > 1) {
+        definitions.erase(std::remove_if(definitions.begin(), definitions.end(), [&](int symbol) {
+            return symbols->line(symbol) == line && symbols->column(symbol) == startColumn
+                && symbols->absolutePath(symbol) == currentPath;
+        }), definitions.end());
+    }
+
+    if (definitions.isEmpty()) {
+        m_statusBar->showMessage(QString("No definition found for %1").arg(name), 3000);
+        return;
+    }
+
+    if (definitions.size() == 1) {
+        int symbol = definitions.first();
+        openSearchHit(symbols->absolutePath(symbol), symbols->line(symbol), symbols->column(symbol), name.size());
+        return;
+    }
+
+    // several candidates: the current file first, then the others in path order
+    std::stable_partition(definitions.begin(), definitions.end(), [&](int symbol) {
+        return symbols->absolutePath(symbol) == currentPath;
+    });
+
+    QVector<QuickOpenItem> candidates;
+    for (int symbol : definitions) {
+        candidates.append(symbolItem(*symbols, symbol));
+    }
+
+    QuickOpenDialog *dialog = symbolDialog();
+    dialog->setPlaceholderText(QString("%1 definitions of %2").arg(candidates.size()).arg(name));
+    dialog->setProvider([candidates](const QString &query) {
+        QVector<QuickOpenItem> items;
+        for (const QuickOpenItem &item : candidates) {
+            if (item.detail.contains(query, Qt::CaseInsensitive)) {
+                items.append(item);
+            }
+        }
+        return items;
+    });
+    dialog->popup();
+}
+
+void EditorWindow::findReferences()
+{
+    CodeEditor *textEdit = getCurrentTextEditor();
+    if (!textEdit || !textEdit->view()) {
+        return;
+    }
+
+    KTextEditor::Cursor cursor = textEdit->view()->cursorPosition();
+    const QString name = textEdit->identifierAt(cursor.line() + 1, cursor.column() + 1);
+    if (name.isEmpty()) {
+        m_statusBar->showMessage("No identifier under the cursor", 2000);
+        return;
+    }
+
+    if (!m_referencesDock) {
+        m_referencesPanel = new ReferencesPanel(m_projectIndexer, this);
+        connect(m_referencesPanel, &ReferencesPanel::hitActivated, this, &EditorWindow::openSearchHit);
+
+        m_referencesDock = new QDockWidget("References", this);
+        m_referencesDock->setObjectName("referencesDock");
+        m_referencesDock->setWidget(m_referencesPanel);
+        addDockWidget(Qt::BottomDockWidgetArea, m_referencesDock);
+    }
+
+    m_referencesDock->show();
+    m_referencesDock->raise();
+    m_referencesPanel->findReferences(name);
+}
+
+void EditorWindow::showProjectSearch()
+{
+    showSearchPanel(false);
+}
+
+void EditorWindow::showOpenDocumentsSearch()
+{
+    showSearchPanel(true);
+}
+
+void EditorWindow::showProjectReplace()
+{
+    showSearchPanel(false);
+    m_searchPanel->setReplaceMode(true);
+}
+
+void EditorWindow::showSearchPanel(bool openDocuments)
+{
+    if (!m_searchDock) {
+        m_searchPanel = new SearchPanel(m_projectIndexer, this);
+        connect(m_searchPanel, &SearchPanel::hitActivated, this, &EditorWindow::openSearchHit);
+        connect(m_searchPanel, &SearchPanel::documentHitActivated, this, &EditorWindow::openDocumentHit);
+        connect(m_searchPanel, &SearchPanel::statusMessage, this, [this](const QString &message) {
+            m_statusBar->showMessage(message, 5000);
+        });
+        m_searchPanel->setDocumentProvider([this]() {
+            QVector<OpenDocument> documents;
+            for (int i = 0; i < m_textEditors.size(); ++i) {
+                OpenDocument open;
+                open.document = m_textEditors[i]->ktextDocument();
+                open.label = m_buffers[i]->filePath();
+                if (open.label.isEmpty()) {
+                    open.label = m_tabWidget->tabText(i);
+                }
+                documents.append(open);
+            }
+            return documents;
+        });
+
+        m_searchDock = new QDockWidget("Find in Files", this);
+        m_searchDock->setObjectName("findInFilesDock");
+        m_searchDock->setWidget(m_searchPanel);
+        addDockWidget(Qt::BottomDockWidgetArea, m_searchDock);
+    }
+
+    // seed the query with the current selection when there is one
+    QString selection;
+    CodeEditor *textEdit = getCurrentTextEditor();
+    if (textEdit && textEdit->view() && textEdit->view()->selection()) {
+        selection = textEdit->view()->selectionText();
+        if (selection.contains('\n')) {
+            selection.clear();
+        }
+    }
+
+    m_searchDock->show();
+    m_searchDock->raise();
+    m_searchPanel->setOpenDocumentsScope(openDocuments);
+    m_searchPanel->focusQuery(selection);
+}
+
+void EditorWindow::openSearchHit(const QString &filePath, int line, int column, int length)
+{
+    openFile(filePath);
+
+    CodeEditor *textEdit = getCurrentTextEditor();
+    if (!textEdit) {
+        return;
+    }
+
+    textEdit->selectRange(line, column, length);
+    textEdit->setFocus();
+}
+
+void EditorWindow::openDocumentHit(KTextEditor::Document *document, int line, int column, int length)
+{
+    for (int i = 0; i < m_textEditors.size(); ++i) {
+        CodeEditor *textEdit = m_textEditors[i];
+        if (textEdit->ktextDocument() != document) {
+            continue;
+        }
+
+        m_tabWidget->setCurrentIndex(i);
+        textEdit->selectRange(line, column, length);
+        textEdit->setFocus();
+        return;
+    }
+}
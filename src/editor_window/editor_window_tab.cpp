@@ -41,12 +41,22 @@ int EditorWindow::createNewTab(const QString &title)
 
     textEdit->setLanguage("text");
 
+    if (m_tokenIndex) {
+        m_tokenIndex->addDocument(textEdit->ktextDocument());
+        textEdit->setCompletionModel(m_completionModel);
+    }
+    m_wordHighlighter->addView(textEdit->view());
+
     DEBUG_LOG_EDITOR("Created KTextEditor-based tab" << (m_tabWidget->count() - 1) << "with language: text");
 
     connect(textEdit, &CodeEditor::textChanged,
             this, &EditorWindow::onTextChanged);
     connect(textEdit, &CodeEditor::cursorPositionChanged,
             this, &EditorWindow::onCursorPositionChanged);
+    connect(textEdit, &CodeEditor::definitionRequested,
+            this, [this, textEdit](int line, int column) {
+                goToDefinition(textEdit, line, column);
+            });
 
     QString escapedTitle = title;
     escapedTitle.replace("&", "&&");
@@ -136,6 +146,9 @@ void EditorWindow::onTabChanged(int index)
     updateLuaEditorState();
 
     CodeEditor* textEdit = getCurrentTextEditor();
+    if (m_findBar) {
+        m_findBar->setEditor(textEdit);
+    }
     if (textEdit) {
         textEdit->setFocus();
     }
@@ -212,6 +225,12 @@ void EditorWindow::closeFile(int index)
     delete m_buffers[index];
     m_buffers.removeAt(index);
 
+    if (m_textEditors[index]) {
+        if (m_tokenIndex) {
+            m_tokenIndex->removeDocument(m_textEditors[index]->ktextDocument());
+        }
+        m_wordHighlighter->removeView(m_textEditors[index]->view());
+    }
     m_textEditors.removeAt(index);
 
     if (m_tabWidget->count() == 0) {
@@ -8,6 +8,8 @@ void EditorWindow::setupUI()
 
     m_fileTreeWidget = new FileTreeWidget(this);
     m_fileTreeWidget->setVisible(false); 
+    m_fileTreeWidget->setGitStatus(m_projectIndexer->gitStatus());
+    m_fileTreeWidget->setWatchService(m_projectIndexer->watchService());
 
     m_tabWidget = new NoMnemonicTabWidget(this);
     m_tabWidget->setTabsClosable(true);
@@ -27,8 +29,21 @@ void EditorWindow::setupUI()
 
     tabBar->setFocusPolicy(Qt::NoFocus);
 
+    // the find bar sits under the tabs and follows the current editor
+    m_findBar = new FindBar(this);
+    connect(m_findBar, &FindBar::statusMessage, this, [this](const QString &message) {
+        m_statusBar->showMessage(message, 3000);
+    });
+
+    QWidget *editorArea = new QWidget(this);
+    QVBoxLayout *editorLayout = new QVBoxLayout(editorArea);
+    editorLayout->setContentsMargins(0, 0, 0, 0);
+    editorLayout->setSpacing(0);
+    editorLayout->addWidget(m_tabWidget, 1);
+    editorLayout->addWidget(m_findBar);
+
     m_mainSplitter->addWidget(m_fileTreeWidget);
-    m_mainSplitter->addWidget(m_tabWidget);
+    m_mainSplitter->addWidget(editorArea);
 
     m_mainSplitter->setStretchFactor(0, 0); 
     m_mainSplitter->setStretchFactor(1, 1); 
@@ -87,5 +102,13 @@ void EditorWindow::connectSignals()
                 this, &EditorWindow::onLuaStatusMessageRequested);
         connect(m_luaBridge, &LuaBridge::themeChangeRequested,
                 this, &EditorWindow::onLuaThemeChangeRequested);
+        connect(m_luaBridge, &LuaBridge::highlightWordRequested,
+                this, [this](const QString &word, const QString &color) {
+                    m_wordHighlighter->setWord(word, color.isEmpty() ? QColor(250, 189, 47, 110) : QColor(color));
+                });
+        connect(m_luaBridge, &LuaBridge::highlightWordRemovalRequested,
+                m_wordHighlighter, &WordHighlighter::removeWord);
+        connect(m_luaBridge, &LuaBridge::highlightWordsClearRequested,
+                m_wordHighlighter, &WordHighlighter::clearWords);
     }
 }
\ No newline at end of file
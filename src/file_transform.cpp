@@ -0,0 +1,301 @@
+// streaming find and replace for files too large to open
+// the input is read and decoded in fixed chunks; complete lines are rewritten
+// and written out, and the unfinished last line waits for the next chunk
+
+#include "file_transform.h"
+#include "function_task.h"
+#include "debug_log.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextCodec>
+#include <QTextDecoder>
+#include <QScopedPointer>
+#include <QElapsedTimer>
+
+namespace {
+
+const qint64 kChunkSize = 4 * 1024 * 1024;
+// a line without a break is cut past this many characters; regex matches have
+// no length bound, so only literals can be matched across such a cut
+const int kMaxLineLength = 16 * 1024 * 1024;
+
+}
+
+FileTransform::FileTransform(QObject *parent)
+    : QObject(parent)
+    , m_pool(new QThreadPool(this))
+    , m_generation(0)
+{
+    m_pool->setMaxThreadCount(1);
+}
+
+FileTransform::~FileTransform()
+{
+    cancel();
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+bool FileTransform::start(const QString &filePath, const SearchQuery &query, const QString &replacement)
+{
+    cancel();
+    m_lastError.clear();
+
+    if (!QFileInfo(filePath).isFile()) {
+        setError(QString("%1 is not a file").arg(filePath));
+        return false;
+    }
+
+    const SearchPattern pattern(query.pattern, query.regex, query.caseSensitive, query.wholeWord);
+    if (pattern.isEmpty() || !pattern.isValid()) {
+        setError("Invalid pattern: " + pattern.errorString());
+        return false;
+    }
+
+    QSharedPointer<TransformJob> job(new TransformJob);
+    job->generation = m_generation.fetchAndAddOrdered(1) + 1;
+    job->filePath = filePath;
+    job->query = query;
+    job->replacement = replacement;
+    m_job = job;
+
+    m_pool->start(new FunctionTask([this, job]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        QString error;
+        const bool transformed = transform(job.data(), &error);
+        const int generation = job->generation;
+        const qint64 replacements = job->replacements;
+
+        if (transformed) {
+            DEBUG_LOG_EDITOR("Transformed" << job->filePath << "with" << replacements << "replacements in"
+                             << timer.elapsed() << "ms");
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, transformed, replacements, error]() {
+            if (!isCurrent(generation)) {
+                return;
+            }
+            m_job.reset();
+            if (transformed) {
+                emit finished(replacements);
+            } else {
+                setError(error);
+                emit failed(error);
+            }
+        }, Qt::QueuedConnection);
+    }));
+
+    return true;
+}
+
+void FileTransform::cancel()
+{
+    if (m_job) {
+        m_generation.fetchAndAddOrdered(1);
+        m_job.reset();
+    }
+}
+
+bool FileTransform::isRunning() const
+{
+    return !m_job.isNull();
+}
+
+QString FileTransform::lastError() const
+{
+    return m_lastError;
+}
+
+bool FileTransform::transform(TransformJob *job, QString *error)
+{
+    const SearchPattern pattern(job->query.pattern, job->query.regex, job->query.caseSensitive,
+                                job->query.wholeWord);
+
+    QFile input(job->filePath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        *error = QString("Cannot read %1: %2").arg(job->filePath, input.errorString());
+        return false;
+    }
+    const qint64 totalBytes = input.size();
+
+    // writes a temporary file next to the original and renames it over on commit
+    QSaveFile output(job->filePath);
+    if (!output.open(QIODevice::WriteOnly)) {
+        *error = QString("Cannot write %1: %2").arg(job->filePath, output.errorString());
+        return false;
+    }
+
+    // the decoder keeps a sequence split between chunks, and a byte order mark as text
+    QScopedPointer<QTextDecoder> decoder(QTextCodec::codecForName("UTF-8")->makeDecoder(QTextCodec::IgnoreHeader));
+
+    QString pending;
+    int written = 0;
+    qint64 bytesRead = 0;
+
+    while (!input.atEnd()) {
+        if (!isCurrent(job->generation)) {
+            output.cancelWriting();
+            return false;
+        }
+
+        const QByteArray chunk = input.read(kChunkSize);
+        if (chunk.isEmpty()) {
+            *error = QString("Cannot read %1: %2").arg(job->filePath, input.errorString());
+            output.cancelWriting();
+            return false;
+        }
+        bytesRead += chunk.size();
+
+        pending.append(decoder->toUnicode(chunk));
+        if (decoder->hasFailure()) {
+            *error = QString("%1 is not valid UTF-8").arg(job->filePath);
+            output.cancelWriting();
+            return false;
+        }
+
+        if (!flush(job, pattern, &pending, &written, false, &output, error)) {
+            output.cancelWriting();
+            return false;
+        }
+
+        const int generation = job->generation;
+        QMetaObject::invokeMethod(this, [this, generation, bytesRead, totalBytes]() {
+            if (isCurrent(generation)) {
+                emit progress(bytesRead, totalBytes);
+            }
+        }, Qt::QueuedConnection);
+    }
+
+    if (decoder->needsMoreData()) {
+        *error = QString("%1 ends in the middle of a UTF-8 sequence").arg(job->filePath);
+        output.cancelWriting();
+        return false;
+    }
+
+    if (!flush(job, pattern, &pending, &written, true, &output, error)) {
+        output.cancelWriting();
+        return false;
+    }
+
+    // nothing to replace, so leave the original and its timestamps alone
+    if (job->replacements == 0) {
+        output.cancelWriting();
+        return true;
+    }
+
+    if (!isCurrent(job->generation)) {
+        output.cancelWriting();
+        return false;
+    }
+
+    if (!output.commit()) {
+        *error = QString("Cannot replace %1: %2").arg(job->filePath, output.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool FileTransform::flush(TransformJob *job, const SearchPattern &pattern, QString *pending, int *written,
+                          bool final, QIODevice *output, QString *error)
+{
+    // the first *written characters of pending are already out; they are only
+    // kept as context for the match that follows them
+    QString result;
+    int consumed = *written;
+
+    const int lastBreak = final ? pending->size() : pending->lastIndexOf(QLatin1Char('\n'));
+    if (lastBreak >= 0) {
+        // up to and including the last break, or everything on the final call
+        const int complete = qMin(lastBreak + 1, pending->size());
+
+        if (!pattern.isRegex()) {
+            // a literal never holds a line break, so whole lines go through at once
+            result = replaceRange(pattern, *pending, *written, lastBreak, job->replacement, &consumed,
+                                  &job->replacements);
+            result.append(pending->midRef(lastBreak, complete - lastBreak));
+        } else {
+            // expressions see one line at a time, without its \r, as the search does
+            int lineStart = 0;
+            while (lineStart < complete) {
+                int lineEnd = pending->indexOf(QLatin1Char('\n'), lineStart);
+                if (lineEnd < 0) {
+                    lineEnd = pending->size();
+                }
+
+                int textEnd = lineEnd;
+                if (textEnd > lineStart && pending->at(textEnd - 1) == QLatin1Char('\r')) {
+                    --textEnd;
+                }
+
+                const QString line = pending->mid(lineStart, textEnd - lineStart);
+                result.append(replaceRange(pattern, line, 0, line.size(), job->replacement, &consumed,
+                                           &job->replacements));
+                result.append(pending->midRef(textEnd, qMin(lineEnd + 1, complete) - textEnd));
+                lineStart = lineEnd + 1;
+            }
+        }
+
+        pending->remove(0, complete);
+        *written = 0;
+    } else if (pending->size() > kMaxLineLength) {
+        if (pattern.isRegex()) {
+            *error = QString("%1 has a line longer than %2 characters; use a literal search on it")
+                         .arg(job->filePath).arg(kMaxLineLength);
+            return false;
+        }
+
+        // a match starting before the cut lies in pending with a character to
+        // spare, so whole word checks see what really follows it
+        int cut = pending->size() - pattern.pattern().size() - 1;
+        if (pending->at(cut).isLowSurrogate()) {
+            --cut;
+        }
+        result = replaceRange(pattern, *pending, *written, cut, job->replacement, &consumed, &job->replacements);
+
+        // one written character stays behind as the context of the next match
+        pending->remove(0, consumed - 1);
+        *written = 1;
+    }
+
+    if (!result.isEmpty()) {
+        const QByteArray bytes = result.toUtf8();
+        if (output->write(bytes) != bytes.size()) {
+            *error = QString("Cannot write %1: %2").arg(job->filePath, output->errorString());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileTransform::isCurrent(int generation) const
+{
+    return m_generation.loadAcquire() == generation;
+}
+
+void FileTransform::setError(const QString &error)
+{
+    m_lastError = error;
+}
+
+QString FileTransform::replaceRange(const SearchPattern &pattern, const QString &text, int from, int until,
+                                    const QString &replacement, int *consumed, qint64 *replacements)
+{
+    QString result;
+    int copied = from;
+    int length = 0;
+    int column = pattern.indexIn(text, from, &length);
+    while (column >= 0 && column < until) {
+        result.append(text.midRef(copied, column - copied));
+        result.append(pattern.replacementAt(text, column, replacement));
+        copied = column + length;
+        ++*replacements;
+        column = pattern.indexIn(text, copied, &length);
+    }
+
+    *consumed = qMax(until, copied);
+    result.append(text.midRef(copied, *consumed - copied));
+    return result;
+}
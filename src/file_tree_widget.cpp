@@ -7,6 +7,56 @@
 #include <QApplication>
 #include <QStandardPaths>
 #include <QSpacerItem>
+#include <QStyledItemDelegate>
+#include <QPainter>
+
+namespace {
+
+// paints git status markers at the right edge of a row and dims ignored entries;
+// the tree's style sheet owns the text colour, so the marker is drawn separately
+class FileTreeItemDelegate : public QStyledItemDelegate
+{
+public:
+    using QStyledItemDelegate::QStyledItemDelegate;
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        int status = index.data(ProjectTreeModel::GitStatusRole).toInt();
+        if (status == GitStatus::Ignored) {
+            painter->save();
+            painter->setOpacity(0.45);
+            QStyledItemDelegate::paint(painter, option, index);
+            painter->restore();
+            return;
+        }
+
+        QStyledItemDelegate::paint(painter, option, index);
+        if (status != GitStatus::Modified && status != GitStatus::Untracked) {
+            return;
+        }
+
+        bool isDir = index.data(ProjectTreeModel::IsDirRole).toBool();
+        QString marker = QStringLiteral("\u2022");
+        if (!isDir) {
+            marker = status == GitStatus::Modified ? QStringLiteral("M") : QStringLiteral("U");
+        }
+        QColor color = status == GitStatus::Modified ? QColor(250, 189, 47) : QColor(184, 187, 38);
+
+        painter->save();
+        painter->setPen(color);
+        painter->drawText(option.rect.adjusted(0, 0, -8, 0), Qt::AlignRight | Qt::AlignVCenter, marker);
+        painter->restore();
+    }
+};
+
+// expand all stops at these limits so huge trees cannot flood the view
+const int kMaxExpandDirectories = 2000;
+const int kMaxExpandDepth = 8;
+// listings requested but not loaded yet, and directories expanded per pass
+const int kMaxExpandListings = 32;
+const int kExpandBatchSize = 64;
+
+}
 
 FileTreeWidget::FileTreeWidget(QWidget *parent)
     : QWidget(parent)
@@ -16,7 +66,7 @@ FileTreeWidget::FileTreeWidget(QWidget *parent)
     , m_collapseButton(nullptr)
     , m_refreshButton(nullptr)
     , m_treeView(nullptr)
-    , m_fileSystemModel(nullptr)
+    , m_treeModel(nullptr)
     , m_contextMenu(nullptr)
     , m_openAction(nullptr)
     , m_openInExplorerAction(nullptr)
@@ -27,6 +77,9 @@ FileTreeWidget::FileTreeWidget(QWidget *parent)
     , m_refreshAction(nullptr)
     , m_collapseAllAction(nullptr)
     , m_expandAllAction(nullptr)
+    , m_expandedCount(0)
+    , m_expandTimer(nullptr)
+    , m_cancelExpandShortcut(nullptr)
     , m_isVisible(true)
     , m_backgroundColor(QColor(40, 37, 34))
     , m_textColor(QColor(146, 131, 116))
@@ -90,24 +143,17 @@ void FileTreeWidget::setupUI()
 
     m_mainLayout->addWidget(headerWidget);
 
-    m_fileSystemModel = new QFileSystemModel(this);
-    m_fileSystemModel->setRootPath("");
-
-    m_fileSystemModel->setFilter(QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot);
+    // lists only expanded directories and sorts them off the gui thread
+    m_treeModel = new ProjectTreeModel(this);
 
     m_treeView = new QTreeView(this);
-    m_treeView->setModel(m_fileSystemModel);
-    m_treeView->setRootIndex(m_fileSystemModel->index(QDir::currentPath()));
-
-    m_treeView->hideColumn(1); 
-    m_treeView->hideColumn(2); 
-    m_treeView->hideColumn(3); 
+    m_treeView->setModel(m_treeModel);
+    m_treeView->setItemDelegate(new FileTreeItemDelegate(m_treeView));
 
     m_treeView->setHeaderHidden(true);
     m_treeView->setIndentation(8);  
     m_treeView->setAnimated(true);
-    m_treeView->setSortingEnabled(true);
-    m_treeView->sortByColumn(0, Qt::AscendingOrder);
+    m_treeView->setUniformRowHeights(true);
     m_treeView->setContextMenuPolicy(Qt::CustomContextMenu);
 
     m_treeView->setContentsMargins(0, 0, 0, 0);
@@ -115,9 +161,41 @@ void FileTreeWidget::setupUI()
     connect(m_treeView, &QTreeView::doubleClicked, this, &FileTreeWidget::onItemDoubleClicked);
     connect(m_treeView, &QTreeView::clicked, this, &FileTreeWidget::onItemClicked);
     connect(m_treeView, &QTreeView::customContextMenuRequested, this, &FileTreeWidget::onCustomContextMenuRequested);
+    connect(m_treeView, &QTreeView::expanded, this, [this](const QModelIndex &index) {
+        m_treeModel->setExpanded(index, true);
+    });
+    connect(m_treeView, &QTreeView::collapsed, this, [this](const QModelIndex &index) {
+        m_treeModel->setExpanded(index, false);
+    });
 
     m_mainLayout->addWidget(m_treeView);
 
+    connect(m_treeModel, &ProjectTreeModel::directoryLoaded, this, &FileTreeWidget::onDirectoryLoaded);
+    connect(m_treeModel, &ProjectTreeModel::rowsRemoved, this, [this]() {
+        // a directory removed while its listing was pending would stall expand all
+        bool pruned = false;
+        for (auto it = m_expandWaiting.begin(); it != m_expandWaiting.end();) {
+            if (m_treeModel->indexForPath(it.key()).isValid()) {
+                ++it;
+            } else {
+                it = m_expandWaiting.erase(it);
+                pruned = true;
+            }
+        }
+        if (pruned) {
+            m_expandTimer->start();
+        }
+    });
+
+    m_expandTimer = new QTimer(this);
+    m_expandTimer->setInterval(0);
+    connect(m_expandTimer, &QTimer::timeout, this, &FileTreeWidget::processExpandQueue);
+
+    m_cancelExpandShortcut = new QShortcut(QKeySequence(Qt::Key_Escape), this);
+    m_cancelExpandShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    m_cancelExpandShortcut->setEnabled(false);
+    connect(m_cancelExpandShortcut, &QShortcut::activated, this, &FileTreeWidget::cancelExpandAll);
+
     setMinimumWidth(200);
     setMaximumWidth(400);
     resize(250, 400);
@@ -181,11 +259,10 @@ void FileTreeWidget::setRootPath(const QString &path)
 
     m_rootPath = QDir(path).absolutePath();
 
-    if (m_fileSystemModel && m_treeView) {
-        QModelIndex rootIndex = m_fileSystemModel->setRootPath(m_rootPath);
-        m_treeView->setRootIndex(rootIndex);
+    cancelExpandAll();
 
-        m_treeView->expand(rootIndex);
+    if (m_treeModel && m_treeView) {
+        m_treeModel->setRootPath(m_rootPath);
     }
 
     updateRootLabel();
@@ -238,7 +315,7 @@ QString FileTreeWidget::getSelectedFilePath() const
 {
     QModelIndex index = getSelectedIndex();
     if (index.isValid()) {
-        return m_fileSystemModel->filePath(index);
+        return m_treeModel->filePath(index);
     }
     return QString();
 }
@@ -258,13 +335,12 @@ void FileTreeWidget::onItemDoubleClicked(const QModelIndex &index)
 {
     if (!index.isValid()) return;
 
-    QString filePath = m_fileSystemModel->filePath(index);
-    QFileInfo fileInfo(filePath);
+    QString filePath = m_treeModel->filePath(index);
 
-    if (fileInfo.isFile()) {
+    if (!m_treeModel->isDir(index)) {
         DEBUG_LOG_EDITOR("File tree: Opening file:" << filePath);
         emit fileOpenRequested(filePath);
-    } else if (fileInfo.isDir()) {
+    } else {
 
         if (m_treeView->isExpanded(index)) {
             m_treeView->collapse(index);
@@ -278,14 +354,13 @@ void FileTreeWidget::onItemClicked(const QModelIndex &index)
 {
     if (!index.isValid()) return;
 
-    QString filePath = m_fileSystemModel->filePath(index);
-    QFileInfo fileInfo(filePath);
+    QString filePath = m_treeModel->filePath(index);
 
-    if (fileInfo.isFile()) {
+    if (!m_treeModel->isDir(index)) {
 
         DEBUG_LOG_EDITOR("File tree: Opening file (single click):" << filePath);
         emit fileOpenRequested(filePath);
-    } else if (fileInfo.isDir()) {
+    } else {
 
         if (m_treeView->isExpanded(index)) {
             m_treeView->collapse(index);
@@ -300,10 +375,7 @@ void FileTreeWidget::onCustomContextMenuRequested(const QPoint &pos)
     QModelIndex index = m_treeView->indexAt(pos);
 
     if (index.isValid()) {
-        QString filePath = m_fileSystemModel->filePath(index);
-        QFileInfo fileInfo(filePath);
-
-        m_openAction->setEnabled(fileInfo.isFile());
+        m_openAction->setEnabled(!m_treeModel->isDir(index));
         m_renameAction->setEnabled(true);
         m_deleteAction->setEnabled(true);
     } else {
@@ -358,7 +430,7 @@ void FileTreeWidget::onNewFile()
             file.close();
             DEBUG_LOG_EDITOR("Created new file:" << fullPath);
 
-            m_treeView->update();
+            m_treeModel->refreshDirectory(parentDir);
 
             emit fileOpenRequested(fullPath);
         } else {
@@ -387,7 +459,7 @@ void FileTreeWidget::onNewFolder()
 
         if (QDir().mkpath(fullPath)) {
             DEBUG_LOG_EDITOR("Created new folder:" << fullPath);
-            m_treeView->update();
+            m_treeModel->refreshDirectory(parentDir);
         } else {
             QMessageBox::warning(this, "Error", "Failed to create folder: " + folderName);
         }
@@ -410,7 +482,7 @@ void FileTreeWidget::onRename()
 
         if (QFile::rename(filePath, newPath)) {
             DEBUG_LOG_EDITOR("Renamed" << filePath << "to" << newPath);
-            m_treeView->update();
+            m_treeModel->refreshDirectory(fileInfo.absolutePath());
         } else {
             QMessageBox::warning(this, "Error", "Failed to rename: " + currentName);
         }
@@ -442,7 +514,7 @@ void FileTreeWidget::onDelete()
 
         if (success) {
             DEBUG_LOG_EDITOR("Deleted" << itemType << ":" << filePath);
-            m_treeView->update();
+            m_treeModel->refreshDirectory(fileInfo.absolutePath());
         } else {
             QMessageBox::warning(this, "Error", "Failed to delete " + itemType + ": " + itemName);
         }
@@ -451,25 +523,135 @@ void FileTreeWidget::onDelete()
 
 void FileTreeWidget::onRefresh()
 {
-    if (m_treeView) {
-        m_treeView->update();
+    if (m_treeModel) {
+        m_treeModel->refresh();
         DEBUG_LOG_EDITOR("File tree refreshed");
     }
 }
 
 void FileTreeWidget::onCollapseAll()
 {
-    if (m_treeView) {
-        m_treeView->collapseAll();
+    if (!m_treeView) {
+        return;
+    }
+
+    cancelExpandAll();
+    m_treeView->collapseAll();
 
-        m_treeView->expand(m_treeView->rootIndex());
+    // collapsed subtrees are dropped so their nodes and watches do not linger
+    for (int row = 0; row < m_treeModel->rowCount(); ++row) {
+        QModelIndex child = m_treeModel->index(row, 0);
+        if (m_treeModel->isDir(child)) {
+            m_treeModel->releaseChildren(child);
+        }
     }
 }
 
 void FileTreeWidget::onExpandAll()
 {
-    if (m_treeView) {
-        m_treeView->expandAll();
+    if (!m_treeView) {
+        return;
+    }
+
+    // QTreeView::expandAll only reaches loaded rows and would list everything at once,
+    // so directories are expanded level by level as their listings arrive
+    cancelExpandAll();
+    enqueueChildDirectories(QModelIndex(), 1);
+    if (m_expandQueue.isEmpty()) {
+        return;
+    }
+
+    m_cancelExpandShortcut->setEnabled(true);
+    m_expandTimer->start();
+    DEBUG_LOG_EDITOR("File tree: expanding all directories");
+}
+
+void FileTreeWidget::cancelExpandAll()
+{
+    if (m_expandQueue.isEmpty() && m_expandWaiting.isEmpty()) {
+        return;
+    }
+
+    DEBUG_LOG_EDITOR("File tree: expand all stopped after" << m_expandedCount << "directories");
+    finishExpandAll();
+}
+
+void FileTreeWidget::finishExpandAll()
+{
+    m_expandTimer->stop();
+    m_expandQueue.clear();
+    m_expandWaiting.clear();
+    m_expandedCount = 0;
+    m_cancelExpandShortcut->setEnabled(false);
+}
+
+void FileTreeWidget::processExpandQueue()
+{
+    int budget = kExpandBatchSize;
+
+    while (budget > 0 && !m_expandQueue.isEmpty() && m_expandWaiting.size() < kMaxExpandListings) {
+        if (m_expandedCount >= kMaxExpandDirectories) {
+            m_expandQueue.clear();
+            break;
+        }
+
+        const QPair<QPersistentModelIndex, int> entry = m_expandQueue.takeFirst();
+        QModelIndex index = entry.first;
+        if (!index.isValid()) {
+            continue;
+        }
+
+        m_treeView->expand(index);
+        ++m_expandedCount;
+        --budget;
+
+        if (m_treeModel->isListed(index)) {
+            enqueueChildDirectories(index, entry.second + 1);
+        } else {
+            if (m_treeModel->canFetchMore(index)) {
+                m_treeModel->fetchMore(index);
+            }
+            m_expandWaiting.insert(m_treeModel->filePath(index), entry.second);
+        }
+    }
+
+    // waiting on listings; onDirectoryLoaded restarts the timer
+    if (m_expandQueue.isEmpty() || m_expandWaiting.size() >= kMaxExpandListings) {
+        m_expandTimer->stop();
+    }
+
+    if (m_expandQueue.isEmpty() && m_expandWaiting.isEmpty()) {
+        DEBUG_LOG_EDITOR("File tree: expanded" << m_expandedCount << "directories");
+        finishExpandAll();
+    }
+}
+
+void FileTreeWidget::onDirectoryLoaded(const QString &dirPath)
+{
+    auto it = m_expandWaiting.find(dirPath);
+    if (it == m_expandWaiting.end()) {
+        return;
+    }
+
+    int depth = it.value();
+    m_expandWaiting.erase(it);
+
+    enqueueChildDirectories(m_treeModel->indexForPath(dirPath), depth + 1);
+    m_expandTimer->start();
+}
+
+void FileTreeWidget::enqueueChildDirectories(const QModelIndex &parent, int depth)
+{
+    if (depth > kMaxExpandDepth) {
+        return;
+    }
+
+    int rows = m_treeModel->rowCount(parent);
+    for (int row = 0; row < rows; ++row) {
+        QModelIndex child = m_treeModel->index(row, 0, parent);
+        if (m_treeModel->isDir(child)) {
+            m_expandQueue.append(qMakePair(QPersistentModelIndex(child), depth));
+        }
     }
 }
 
@@ -486,6 +668,20 @@ void FileTreeWidget::contextMenuEvent(QContextMenuEvent *event)
     }
 }
 
+void FileTreeWidget::setGitStatus(GitStatus *gitStatus)
+{
+    if (m_treeModel) {
+        m_treeModel->setGitStatus(gitStatus);
+    }
+}
+
+void FileTreeWidget::setWatchService(FileWatchService *watchService)
+{
+    if (m_treeModel) {
+        m_treeModel->setWatchService(watchService);
+    }
+}
+
 void FileTreeWidget::setThemeColors(const QColor &background, const QColor &text, const QColor &highlight)
 {
     m_backgroundColor = background;
@@ -0,0 +1,479 @@
+// inotify based watcher for the project index
+// watches are added in batches from the event loop, changes are reported
+// once a burst goes quiet, and ENOSPC switches the service to mtime polling
+
+#include "file_watch_service.h"
+#include "function_task.h"
+#include "debug_log.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFile>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+
+// watches added per event loop pass, so huge trees do not block the ui
+const int kWatchBatch = 2000;
+// a burst is reported once it has been quiet this long, or after kMaxDelay
+const int kQuietPeriod = 150;
+const int kMaxDelay = 1000;
+const int kDefaultPollInterval = 5000;
+
+#ifdef Q_OS_LINUX
+const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE
+    | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+#endif
+
+QString joinPath(const QString &directory, const QString &name)
+{
+    return directory.isEmpty() ? name : directory + QLatin1Char('/') + name;
+}
+
+QString parentPath(const QString &path)
+{
+    int slash = path.lastIndexOf('/');
+    return slash >= 0 ? path.left(slash) : QString();
+}
+
+}
+
+FileWatchService::FileWatchService(QObject *parent)
+    : QObject(parent)
+    , m_inotifyFd(-1)
+    , m_notifier(nullptr)
+    , m_watchTimer(new QTimer(this))
+    , m_flushTimer(new QTimer(this))
+    , m_polling(false)
+    , m_pollRunning(false)
+    , m_pollGeneration(0)
+    , m_pollTimer(new QTimer(this))
+    , m_pool(new QThreadPool(this))
+{
+    m_pool->setMaxThreadCount(1);
+
+    m_watchTimer->setInterval(0);
+    connect(m_watchTimer, &QTimer::timeout, this, &FileWatchService::addPendingWatches);
+
+    m_flushTimer->setSingleShot(true);
+    connect(m_flushTimer, &QTimer::timeout, this, &FileWatchService::flushChanges);
+
+    m_pollTimer->setInterval(kDefaultPollInterval);
+    connect(m_pollTimer, &QTimer::timeout, this, &FileWatchService::pollDirectories);
+}
+
+FileWatchService::~FileWatchService()
+{
+    closeInotify();
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+void FileWatchService::watchDirectories(const QString &rootPath, const QStringList &directories,
+                                        const QVector<qint64> &modified)
+{
+    if (rootPath != m_rootPath) {
+        clear();
+        m_rootPath = rootPath;
+    }
+
+    if (!m_polling && m_inotifyFd < 0 && !openInotify()) {
+        startPolling();
+    }
+
+    m_indexedDirectories.clear();
+    m_indexedDirectories.reserve(directories.size());
+    for (const QString &directory : directories) {
+        m_indexedDirectories.insert(directory);
+    }
+
+    QStringList pinned;
+    for (const QString &absolutePath : qAsConst(m_pinnedPaths)) {
+        QString directory;
+        if (relativeDirectory(absolutePath, &directory) && !m_indexedDirectories.contains(directory)) {
+            pinned.append(directory);
+        }
+    }
+
+    if (m_polling) {
+        // keep known stamps, start new directories from their listed mtime
+        QHash<QString, qint64> stamps;
+        stamps.reserve(directories.size() + pinned.size());
+        for (int i = 0; i < directories.size(); ++i) {
+            stamps.insert(directories.at(i), m_pollStamps.value(directories.at(i), modified.value(i)));
+        }
+        for (const QString &directory : pinned) {
+            QString absolutePath = directory.isEmpty() ? m_rootPath : m_rootPath + QLatin1Char('/') + directory;
+            stamps.insert(directory, m_pollStamps.value(directory,
+                                                        QFileInfo(absolutePath).lastModified().toMSecsSinceEpoch()));
+        }
+        m_pollStamps = stamps;
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    QSet<QString> wanted = m_indexedDirectories;
+    for (const QString &directory : pinned) {
+        wanted.insert(directory);
+    }
+    for (const QString &directory : qAsConst(wanted)) {
+        if (!m_watchDescriptors.contains(directory)) {
+            m_pendingWatches.append(directory);
+        }
+    }
+
+    // directories dropped from the index, ignored ones included, stop being watched
+    for (auto it = m_watchDescriptors.begin(); it != m_watchDescriptors.end();) {
+        if (wanted.contains(it.key())) {
+            ++it;
+            continue;
+        }
+        inotify_rm_watch(m_inotifyFd, it.value());
+        m_watchPaths.remove(it.value());
+        it = m_watchDescriptors.erase(it);
+    }
+
+    if (!m_pendingWatches.isEmpty()) {
+        m_watchTimer->start();
+    }
+#else
+    Q_UNUSED(modified)
+#endif
+}
+
+void FileWatchService::clear()
+{
+    closeInotify();
+
+    m_rootPath.clear();
+    m_indexedDirectories.clear();
+    m_polling = false;
+    m_pollTimer->stop();
+    m_pollStamps.clear();
+    ++m_pollGeneration;
+
+    m_flushTimer->stop();
+    m_changedDirectories.clear();
+    m_changedFiles.clear();
+}
+
+QString FileWatchService::rootPath() const
+{
+    return m_rootPath;
+}
+
+void FileWatchService::pinDirectory(const QString &absolutePath)
+{
+    m_pinnedPaths.insert(absolutePath);
+
+    QString directory;
+    if (!relativeDirectory(absolutePath, &directory)) {
+        return;
+    }
+
+    if (m_polling) {
+        if (!m_pollStamps.contains(directory)) {
+            m_pollStamps.insert(directory, QFileInfo(absolutePath).lastModified().toMSecsSinceEpoch());
+        }
+        return;
+    }
+
+    if (m_inotifyFd >= 0 && !m_watchDescriptors.contains(directory) && !m_pendingWatches.contains(directory)) {
+        m_pendingWatches.append(directory);
+        m_watchTimer->start();
+    }
+}
+
+void FileWatchService::unpinDirectory(const QString &absolutePath)
+{
+    m_pinnedPaths.remove(absolutePath);
+
+    // indexed directories stay watched for the index
+    QString directory;
+    if (!relativeDirectory(absolutePath, &directory) || m_indexedDirectories.contains(directory)) {
+        return;
+    }
+
+    if (m_polling) {
+        m_pollStamps.remove(directory);
+        return;
+    }
+
+    m_pendingWatches.removeAll(directory);
+#ifdef Q_OS_LINUX
+    auto it = m_watchDescriptors.find(directory);
+    if (it != m_watchDescriptors.end()) {
+        inotify_rm_watch(m_inotifyFd, it.value());
+        m_watchPaths.remove(it.value());
+        m_watchDescriptors.erase(it);
+    }
+#endif
+}
+
+bool FileWatchService::relativeDirectory(const QString &absolutePath, QString *directory) const
+{
+    if (m_rootPath.isEmpty()) {
+        return false;
+    }
+    if (absolutePath == m_rootPath) {
+        directory->clear();
+        return true;
+    }
+    if (absolutePath.startsWith(m_rootPath) && absolutePath.at(m_rootPath.size()) == QLatin1Char('/')) {
+        *directory = absolutePath.mid(m_rootPath.size() + 1);
+        return true;
+    }
+    return false;
+}
+
+bool FileWatchService::isPolling() const
+{
+    return m_polling;
+}
+
+int FileWatchService::watchCount() const
+{
+    return m_polling ? m_pollStamps.size() : m_watchDescriptors.size();
+}
+
+void FileWatchService::setPollInterval(int msec)
+{
+    m_pollTimer->setInterval(msec);
+}
+
+bool FileWatchService::openInotify()
+{
+#ifdef Q_OS_LINUX
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        LOG_WARNING("inotify unavailable:" << strerror(errno));
+        return false;
+    }
+
+    m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &FileWatchService::readEvents);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FileWatchService::closeInotify()
+{
+    m_watchTimer->stop();
+    m_pendingWatches.clear();
+    m_watchPaths.clear();
+    m_watchDescriptors.clear();
+
+    delete m_notifier;
+    m_notifier = nullptr;
+
+#ifdef Q_OS_LINUX
+    // closing the descriptor drops every watch at once
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+    }
+#endif
+    m_inotifyFd = -1;
+}
+
+void FileWatchService::addPendingWatches()
+{
+#ifdef Q_OS_LINUX
+    int added = 0;
+    while (!m_pendingWatches.isEmpty() && added < kWatchBatch) {
+        QString directory = m_pendingWatches.takeLast();
+        QString absolutePath = directory.isEmpty() ? m_rootPath : m_rootPath + QLatin1Char('/') + directory;
+
+        int descriptor = inotify_add_watch(m_inotifyFd, QFile::encodeName(absolutePath).constData(), kWatchMask);
+        if (descriptor < 0) {
+            if (errno == ENOSPC) {
+                LOG_WARNING("inotify watch limit reached after" << m_watchDescriptors.size()
+                            << "directories, polling directory mtimes instead");
+                m_pendingWatches.append(directory);
+                startPolling();
+                return;
+            }
+            // gone since it was listed; its parent reports the removal
+            continue;
+        }
+
+        m_watchPaths.insert(descriptor, directory);
+        m_watchDescriptors.insert(directory, descriptor);
+        ++added;
+    }
+
+    if (m_pendingWatches.isEmpty()) {
+        m_watchTimer->stop();
+        DEBUG_LOG_EDITOR("Watching" << m_watchDescriptors.size() << "project directories");
+    }
+#endif
+}
+
+void FileWatchService::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    while (true) {
+        ssize_t length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+
+        for (char *cursor = buffer; cursor < buffer + length;) {
+            const inotify_event *event = reinterpret_cast<const inotify_event*>(cursor);
+            cursor += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                LOG_WARNING("inotify queue overflowed, the project will be reconciled");
+                m_changedDirectories.clear();
+                m_changedFiles.clear();
+                m_flushTimer->stop();
+                emit eventsLost();
+                continue;
+            }
+
+            auto it = m_watchPaths.constFind(event->wd);
+            if (it == m_watchPaths.constEnd()) {
+                continue;
+            }
+            const QString directory = it.value();
+
+            if (event->mask & IN_IGNORED) {
+                m_watchPaths.remove(event->wd);
+                m_watchDescriptors.remove(directory);
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                recordDirectory(directory);
+                if (!directory.isEmpty()) {
+                    recordDirectory(parentPath(directory));
+                }
+                continue;
+            }
+
+            QString name = event->len ? QFile::decodeName(event->name) : QString();
+
+            if (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+                recordDirectory(directory);
+            } else if (event->mask & IN_CLOSE_WRITE) {
+                // rewritten ignore rules change which entries are listed
+                if (name == QLatin1String(".gitignore") || name == QLatin1String(".ignore")) {
+                    recordDirectory(directory);
+                } else {
+                    recordFile(joinPath(directory, name));
+                }
+            }
+        }
+    }
+#endif
+}
+
+void FileWatchService::recordDirectory(const QString &directory)
+{
+    m_changedDirectories.insert(directory);
+    scheduleFlush();
+}
+
+void FileWatchService::recordFile(const QString &filePath)
+{
+    m_changedFiles.insert(filePath);
+    scheduleFlush();
+}
+
+void FileWatchService::scheduleFlush()
+{
+    if (!m_flushTimer->isActive()) {
+        m_burstTimer.start();
+    }
+
+    // keep extending while events arrive, but never past kMaxDelay
+    if (m_burstTimer.elapsed() < kMaxDelay) {
+        m_flushTimer->start(qMin<qint64>(kQuietPeriod, kMaxDelay - m_burstTimer.elapsed()));
+    }
+}
+
+void FileWatchService::flushChanges()
+{
+    if (m_changedDirectories.isEmpty() && m_changedFiles.isEmpty()) {
+        return;
+    }
+
+    QStringList directories = m_changedDirectories.values();
+    QStringList files = m_changedFiles.values();
+    m_changedDirectories.clear();
+    m_changedFiles.clear();
+
+    std::sort(directories.begin(), directories.end());
+    std::sort(files.begin(), files.end());
+
+    DEBUG_LOG_EDITOR("Watcher reports" << directories.size() << "directories and" << files.size() << "files");
+    emit pathsChanged(directories, files);
+}
+
+void FileWatchService::startPolling()
+{
+    // every directory is polled from now on, watched or not
+    QStringList directories = m_watchDescriptors.keys() + m_pendingWatches;
+    closeInotify();
+
+    m_polling = true;
+    for (const QString &directory : directories) {
+        if (!m_pollStamps.contains(directory)) {
+            QString absolutePath = directory.isEmpty() ? m_rootPath : m_rootPath + QLatin1Char('/') + directory;
+            m_pollStamps.insert(directory, QFileInfo(absolutePath).lastModified().toMSecsSinceEpoch());
+        }
+    }
+
+    m_pollTimer->start();
+}
+
+void FileWatchService::pollDirectories()
+{
+    if (m_pollRunning || m_pollStamps.isEmpty()) {
+        return;
+    }
+
+    m_pollRunning = true;
+    int generation = m_pollGeneration;
+    QString rootPath = m_rootPath;
+    QHash<QString, qint64> stamps = m_pollStamps;
+
+    // stat runs on the worker; only directories whose mtime moved come back
+    m_pool->start(new FunctionTask([this, generation, rootPath, stamps]() {
+        QHash<QString, qint64> changed;
+        for (auto it = stamps.constBegin(); it != stamps.constEnd(); ++it) {
+            QString absolutePath = it.key().isEmpty() ? rootPath : rootPath + QLatin1Char('/') + it.key();
+            QFileInfo info(absolutePath);
+            qint64 modified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+            if (modified != it.value()) {
+                changed.insert(it.key(), modified);
+            }
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, changed]() {
+            m_pollRunning = false;
+            if (generation != m_pollGeneration) {
+                return;
+            }
+
+            for (auto it = changed.constBegin(); it != changed.constEnd(); ++it) {
+                m_pollStamps.insert(it.key(), it.value());
+                m_changedDirectories.insert(it.key());
+                if (it.value() < 0 && !it.key().isEmpty()) {
+                    m_changedDirectories.insert(parentPath(it.key()));
+                }
+            }
+            flushChanges();
+        }, Qt::QueuedConnection);
+    }));
+}
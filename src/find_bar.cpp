@@ -0,0 +1,595 @@
+// inline find and replace bar
+// jumps to matches as the pattern is typed, highlights the visible ones
+// with moving ranges and counts the rest on a worker
+
+#include "find_bar.h"
+#include "function_task.h"
+#include "debug_log.h"
+#include <QKeyEvent>
+#include <QProgressDialog>
+#include <KTextEditor/Document>
+#include <KTextEditor/View>
+#include <KTextEditor/MovingInterface>
+#include <KTextEditor/MovingRange>
+#include <KTextEditor/ConfigInterface>
+
+namespace {
+
+// edits are batched before highlights and the count are redone
+const int kRefreshDelay = 100;
+// the worker looks for cancellation every this many lines
+const int kCancelCheckLines = 4096;
+// a very long visible line should not turn into thousands of ranges
+const int kMaxHighlights = 2000;
+// replace all reports progress and checks for cancel every this many lines
+const int kReplaceProgressLines = 4096;
+
+// a rewritten line; the original text is still shared with the undo history
+struct ReplacedLine
+{
+    int line;
+    QString original;
+    KTextEditor::Cursor end;
+};
+
+}
+
+FindBar::FindBar(QWidget *parent)
+    : QWidget(parent)
+    , m_pool(new QThreadPool(this))
+    , m_generation(0)
+    , m_anchor(KTextEditor::Cursor::invalid())
+    , m_current(KTextEditor::Range::invalid())
+    , m_total(0)
+    , m_index(0)
+    , m_snapshotDocument(nullptr)
+    , m_snapshotRevision(-1)
+    , m_refreshTimer(new QTimer(this))
+    , m_mainLayout(nullptr)
+    , m_findEdit(nullptr)
+    , m_regexCheck(nullptr)
+    , m_caseCheck(nullptr)
+    , m_wordCheck(nullptr)
+    , m_countLabel(nullptr)
+    , m_previousButton(nullptr)
+    , m_nextButton(nullptr)
+    , m_closeButton(nullptr)
+    , m_replaceRow(nullptr)
+    , m_replaceEdit(nullptr)
+    , m_replaceButton(nullptr)
+    , m_replaceAllButton(nullptr)
+{
+    m_pool->setMaxThreadCount(1);
+
+    m_refreshTimer->setSingleShot(true);
+    m_refreshTimer->setInterval(kRefreshDelay);
+    connect(m_refreshTimer, &QTimer::timeout, this, &FindBar::refresh);
+
+    setupUI();
+    hide();
+}
+
+FindBar::~FindBar()
+{
+    m_generation.fetchAndAddOrdered(1);
+    clearHighlights();
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+void FindBar::setupUI()
+{
+    m_mainLayout = new QVBoxLayout(this);
+    m_mainLayout->setContentsMargins(4, 2, 4, 2);
+    m_mainLayout->setSpacing(2);
+
+    QHBoxLayout *findLayout = new QHBoxLayout();
+    findLayout->setSpacing(6);
+
+    m_findEdit = new QLineEdit(this);
+    m_findEdit->setPlaceholderText("Find");
+    m_findEdit->setClearButtonEnabled(true);
+    findLayout->addWidget(m_findEdit, 1);
+
+    m_regexCheck = new QCheckBox("Regex", this);
+    m_caseCheck = new QCheckBox("Match case", this);
+    m_wordCheck = new QCheckBox("Whole word", this);
+    findLayout->addWidget(m_regexCheck);
+    findLayout->addWidget(m_caseCheck);
+    findLayout->addWidget(m_wordCheck);
+
+    m_countLabel = new QLabel(this);
+    m_countLabel->setMinimumWidth(90);
+    findLayout->addWidget(m_countLabel);
+
+    m_previousButton = new QPushButton("↑");
+    m_previousButton->setFixedSize(24, 24);
+    m_previousButton->setToolTip("Previous match (Shift+Enter)");
+    findLayout->addWidget(m_previousButton);
+
+    m_nextButton = new QPushButton("↓");
+    m_nextButton->setFixedSize(24, 24);
+    m_nextButton->setToolTip("Next match (Enter)");
+    findLayout->addWidget(m_nextButton);
+
+    m_closeButton = new QPushButton("✕");
+    m_closeButton->setFixedSize(24, 24);
+    m_closeButton->setToolTip("Close (Escape)");
+    findLayout->addWidget(m_closeButton);
+
+    m_mainLayout->addLayout(findLayout);
+
+    m_replaceRow = new QWidget(this);
+    QHBoxLayout *replaceLayout = new QHBoxLayout(m_replaceRow);
+    replaceLayout->setContentsMargins(0, 0, 0, 0);
+    replaceLayout->setSpacing(6);
+
+    m_replaceEdit = new QLineEdit(m_replaceRow);
+    m_replaceEdit->setPlaceholderText("Replace (\\1 for regex groups)");
+    m_replaceEdit->setClearButtonEnabled(true);
+    replaceLayout->addWidget(m_replaceEdit, 1);
+
+    m_replaceButton = new QPushButton("Replace", m_replaceRow);
+    m_replaceAllButton = new QPushButton("Replace All", m_replaceRow);
+    replaceLayout->addWidget(m_replaceButton);
+    replaceLayout->addWidget(m_replaceAllButton);
+
+    m_mainLayout->addWidget(m_replaceRow);
+    m_replaceRow->hide();
+
+    connect(m_findEdit, &QLineEdit::textChanged, this, &FindBar::onPatternChanged);
+    connect(m_regexCheck, &QCheckBox::toggled, this, &FindBar::onPatternChanged);
+    connect(m_caseCheck, &QCheckBox::toggled, this, &FindBar::onPatternChanged);
+    connect(m_wordCheck, &QCheckBox::toggled, this, &FindBar::onPatternChanged);
+    connect(m_previousButton, &QPushButton::clicked, this, &FindBar::findPrevious);
+    connect(m_nextButton, &QPushButton::clicked, this, &FindBar::findNext);
+    connect(m_closeButton, &QPushButton::clicked, this, &FindBar::deactivate);
+    connect(m_replaceButton, &QPushButton::clicked, this, &FindBar::replaceCurrent);
+    connect(m_replaceAllButton, &QPushButton::clicked, this, &FindBar::replaceAll);
+}
+
+void FindBar::setEditor(CodeEditor *editor)
+{
+    if (editor == m_editor) {
+        return;
+    }
+
+    clearHighlights();
+    m_generation.fetchAndAddOrdered(1);
+
+    if (m_editor) {
+        disconnect(m_editor->view(), nullptr, this, nullptr);
+        disconnect(m_editor->ktextDocument(), nullptr, this, nullptr);
+        disconnect(m_editor->ktextDocument(), nullptr, m_refreshTimer, nullptr);
+    }
+
+    m_editor = editor;
+    m_anchor = KTextEditor::Cursor::invalid();
+    m_current = KTextEditor::Range::invalid();
+    if (!m_editor || !m_editor->view()) {
+        return;
+    }
+
+    KTextEditor::View *view = m_editor->view();
+    KTextEditor::Document *document = m_editor->ktextDocument();
+
+    QColor background(255, 200, 0, 90);
+    if (auto config = qobject_cast<KTextEditor::ConfigInterface*>(view)) {
+        QColor configured = config->configValue(QStringLiteral("search-highlight-color")).value<QColor>();
+        if (configured.isValid()) {
+            background = configured;
+        }
+    }
+    m_highlightAttribute = KTextEditor::Attribute::Ptr(new KTextEditor::Attribute());
+    m_highlightAttribute->setBackground(background);
+
+    connect(view, &KTextEditor::View::verticalScrollPositionChanged, this, &FindBar::updateHighlights);
+    connect(document, &KTextEditor::Document::textChanged, m_refreshTimer, QOverload<>::of(&QTimer::start));
+    // moving ranges must be gone before the document drops its content
+    connect(document, SIGNAL(aboutToInvalidateMovingInterfaceContent(KTextEditor::Document*)),
+            this, SLOT(clearHighlights()));
+    connect(document, SIGNAL(aboutToDeleteMovingInterfaceContent(KTextEditor::Document*)),
+            this, SLOT(clearHighlights()));
+
+    if (isVisible()) {
+        refresh();
+    }
+}
+
+void FindBar::activate(const QString &text, bool replace)
+{
+    if (m_editor && m_editor->view()) {
+        KTextEditor::View *view = m_editor->view();
+        m_anchor = view->selection() ? view->selectionRange().start() : view->cursorPosition();
+    }
+
+    m_replaceRow->setVisible(replace);
+    show();
+
+    if (!text.isEmpty() && text != m_findEdit->text()) {
+        m_findEdit->setText(text);
+    } else {
+        refresh();
+    }
+
+    m_findEdit->setFocus();
+    m_findEdit->selectAll();
+}
+
+void FindBar::deactivate()
+{
+    hide();
+    if (m_editor) {
+        m_editor->setFocus();
+    }
+}
+
+void FindBar::hideEvent(QHideEvent *event)
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_refreshTimer->stop();
+    clearHighlights();
+    m_snapshot.reset();
+    QWidget::hideEvent(event);
+}
+
+void FindBar::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Escape) {
+        deactivate();
+        event->accept();
+        return;
+    }
+
+    if (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) {
+        if (m_replaceEdit->hasFocus()) {
+            replaceCurrent();
+        } else if (event->modifiers() & Qt::ShiftModifier) {
+            findPrevious();
+        } else {
+            findNext();
+        }
+        event->accept();
+        return;
+    }
+
+    QWidget::keyPressEvent(event);
+}
+
+QString FindBar::pattern() const
+{
+    return m_findEdit->text();
+}
+
+SearchPattern FindBar::searchPattern() const
+{
+    return SearchPattern(m_findEdit->text(), m_regexCheck->isChecked(), m_caseCheck->isChecked(),
+                         m_wordCheck->isChecked());
+}
+
+void FindBar::onPatternChanged()
+{
+    if (!m_editor || !m_editor->view()) {
+        return;
+    }
+
+    if (!m_anchor.isValid()) {
+        m_anchor = m_editor->view()->cursorPosition();
+    }
+
+    SearchPattern current = searchPattern();
+    m_current = DocumentSearch::findNext(m_editor->ktextDocument(), current, m_anchor);
+    if (m_current.isValid()) {
+        select(m_current);
+    } else if (!current.isEmpty()) {
+        m_editor->view()->setCursorPosition(m_anchor);
+    }
+
+    refresh();
+}
+
+void FindBar::findNext()
+{
+    jump(true);
+}
+
+void FindBar::findPrevious()
+{
+    jump(false);
+}
+
+void FindBar::jump(bool forward)
+{
+    if (!m_editor || !m_editor->view()) {
+        return;
+    }
+
+    SearchPattern current = searchPattern();
+    if (current.isEmpty() || !current.isValid()) {
+        return;
+    }
+
+    KTextEditor::View *view = m_editor->view();
+    const bool fromCurrent = m_current.isValid() && view->selection() && view->selectionRange() == m_current;
+    KTextEditor::Cursor from = view->cursorPosition();
+    if (!forward && view->selection()) {
+        from = view->selectionRange().start();
+    }
+
+    bool wrapped = false;
+    KTextEditor::Range found = forward
+        ? DocumentSearch::findNext(m_editor->ktextDocument(), current, from, &wrapped)
+        : DocumentSearch::findPrevious(m_editor->ktextDocument(), current, from, &wrapped);
+    if (!found.isValid()) {
+        return;
+    }
+
+    m_current = found;
+    m_anchor = found.start();
+    select(found);
+
+    // stepping on from the counted match only moves the index
+    if (fromCurrent && m_total > 0 && m_index > 0) {
+        if (forward) {
+            m_index = wrapped ? 1 : qMin(m_index + 1, m_total);
+        } else {
+            m_index = wrapped ? m_total : qMax(m_index - 1, 1);
+        }
+        showCount();
+    } else {
+        startCount();
+    }
+}
+
+void FindBar::replaceCurrent()
+{
+    if (!m_editor || !m_editor->view()) {
+        return;
+    }
+
+    SearchPattern current = searchPattern();
+    if (current.isEmpty() || !current.isValid() || m_editor->isReadOnly()) {
+        return;
+    }
+
+    KTextEditor::View *view = m_editor->view();
+    KTextEditor::Document *document = m_editor->ktextDocument();
+
+    // only the selected match is replaced; anywhere else this just finds the next one
+    KTextEditor::Range selection = view->selectionRange();
+    if (view->selection() && selection.onSingleLine()) {
+        const QString text = document->line(selection.start().line());
+        int length = 0;
+        if (current.indexIn(text, selection.start().column(), &length) == selection.start().column()
+            && selection.start().column() + length == selection.end().column()) {
+            QString replacement = current.replacementAt(text, selection.start().column(), m_replaceEdit->text());
+            document->replaceText(selection, replacement);
+            // continue after the replacement so it is never matched again
+            view->setCursorPosition(DocumentSearch::endOf(selection.start(), replacement));
+        }
+    }
+
+    jump(true);
+}
+
+void FindBar::replaceAll()
+{
+    if (!m_editor || !m_editor->view()) {
+        return;
+    }
+
+    SearchPattern current = searchPattern();
+    if (current.isEmpty() || !current.isValid() || m_editor->isReadOnly()) {
+        return;
+    }
+
+    m_generation.fetchAndAddOrdered(1);
+    clearHighlights();
+
+    KTextEditor::Document *document = m_editor->ktextDocument();
+    const QString replacement = m_replaceEdit->text();
+    const int lineCount = document->lines();
+
+    QProgressDialog progress("Replacing...", "Cancel", 0, lineCount, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+
+    int replacements = 0;
+    bool cancelled = false;
+    QVector<ReplacedLine> changed;
+
+    {
+        // whole lines are rewritten bottom up, so line numbers still ahead stay valid
+        // and the edit count is bounded by the line count, not the hit count
+        KTextEditor::Document::EditingTransaction transaction(document);
+
+        for (int line = lineCount - 1; line >= 0; --line) {
+            if ((lineCount - line) % kReplaceProgressLines == 0) {
+                progress.setValue(lineCount - line);
+                if (progress.wasCanceled()) {
+                    cancelled = true;
+                    break;
+                }
+            }
+
+            const QString text = document->line(line);
+            int hits = 0;
+            QString replaced = current.replaceAll(text, replacement, &hits);
+            if (hits == 0) {
+                continue;
+            }
+
+            document->replaceText(KTextEditor::Range(line, 0, line, text.size()), replaced);
+            changed.append({ line, text, DocumentSearch::endOf(KTextEditor::Cursor(line, 0), replaced) });
+            replacements += hits;
+        }
+
+        // put the lines back in reverse order; the last one rewritten is the topmost
+        if (cancelled) {
+            for (int i = changed.size() - 1; i >= 0; --i) {
+                const ReplacedLine &entry = changed.at(i);
+                document->replaceText(KTextEditor::Range(KTextEditor::Cursor(entry.line, 0), entry.end), entry.original);
+            }
+        }
+    }
+
+    progress.setValue(lineCount);
+
+    if (cancelled) {
+        emit statusMessage("Replace all cancelled, no changes made");
+    } else {
+        emit statusMessage(QString("Replaced %1 %2 on %3 lines")
+                               .arg(replacements)
+                               .arg(replacements == 1 ? "occurrence" : "occurrences")
+                               .arg(changed.size()));
+    }
+
+    m_current = KTextEditor::Range::invalid();
+    refresh();
+}
+
+void FindBar::select(const KTextEditor::Range &range)
+{
+    m_editor->selectRange(range.start().line() + 1, range.start().column() + 1,
+                          range.end().column() - range.start().column());
+}
+
+void FindBar::refresh()
+{
+    if (!isVisible()) {
+        return;
+    }
+
+    updateHighlights();
+    startCount();
+}
+
+void FindBar::clearHighlights()
+{
+    qDeleteAll(m_highlights);
+    m_highlights.clear();
+}
+
+void FindBar::updateHighlights()
+{
+    clearHighlights();
+    if (!isVisible() || !m_editor || !m_editor->view()) {
+        return;
+    }
+
+    SearchPattern current = searchPattern();
+    KTextEditor::View *view = m_editor->view();
+    KTextEditor::Document *document = m_editor->ktextDocument();
+    auto moving = qobject_cast<KTextEditor::MovingInterface*>(document);
+    if (current.isEmpty() || !current.isValid() || !moving) {
+        return;
+    }
+
+    const int firstLine = qMax(0, view->firstDisplayedLine());
+    const int lastLine = qMin(document->lines() - 1, view->lastDisplayedLine());
+    for (int line = firstLine; line <= lastLine && m_highlights.size() < kMaxHighlights; ++line) {
+        const QVector<KTextEditor::Range> matches = DocumentSearch::lineMatches(line, document->line(line), current);
+        for (const KTextEditor::Range &match : matches) {
+            KTextEditor::MovingRange *range = moving->newMovingRange(match);
+            range->setView(view);
+            range->setAttribute(m_highlightAttribute);
+            range->setZDepth(-10000.0);
+            m_highlights.append(range);
+        }
+    }
+}
+
+void FindBar::startCount()
+{
+    int generation = m_generation.fetchAndAddOrdered(1) + 1;
+
+    SearchPattern current = searchPattern();
+    if (!m_editor || current.isEmpty()) {
+        m_countLabel->clear();
+        m_countLabel->setToolTip(QString());
+        return;
+    }
+    if (!current.isValid()) {
+        m_countLabel->setText("Invalid pattern");
+        m_countLabel->setToolTip(current.errorString());
+        return;
+    }
+    m_countLabel->setToolTip(QString());
+
+    KTextEditor::Document *document = m_editor->ktextDocument();
+    auto moving = qobject_cast<KTextEditor::MovingInterface*>(document);
+    qint64 revision = moving ? moving->revision() : -1;
+
+    // line strings are shared with the document, so the snapshot copies no text
+    if (!m_snapshot || document != m_snapshotDocument || revision < 0 || revision != m_snapshotRevision) {
+        QVector<QString> *lines = new QVector<QString>();
+        const int lineCount = document->lines();
+        lines->reserve(lineCount);
+        for (int line = 0; line < lineCount; ++line) {
+            lines->append(document->line(line));
+        }
+        m_snapshot = QSharedPointer<const QVector<QString>>(lines);
+        m_snapshotDocument = document;
+        m_snapshotRevision = revision;
+    }
+
+    m_total = -1;
+    m_index = 0;
+    m_countLabel->setText("Counting...");
+
+    QSharedPointer<const QVector<QString>> snapshot = m_snapshot;
+    const KTextEditor::Cursor position = m_current.isValid() ? m_current.start() : KTextEditor::Cursor::invalid();
+
+    m_pool->start(new FunctionTask([this, generation, snapshot, current, position]() {
+        int total = 0;
+        int index = 0;
+        const int lineCount = snapshot->size();
+
+        for (int line = 0; line < lineCount; ++line) {
+            if (line % kCancelCheckLines == 0 && generation != m_generation.loadAcquire()) {
+                return;
+            }
+
+            const QString &text = snapshot->at(line);
+            if (line == position.line()) {
+                int length = 0;
+                int column = current.indexIn(text, 0, &length);
+                while (column >= 0) {
+                    ++total;
+                    if (column == position.column()) {
+                        index = total;
+                    }
+                    column = current.indexIn(text, column + length, &length);
+                }
+            } else {
+                total += current.count(text);
+            }
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, total, index]() {
+            publishCount(generation, total, index);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void FindBar::publishCount(int generation, int total, int index)
+{
+    if (generation != m_generation.loadAcquire()) {
+        return;
+    }
+
+    m_total = total;
+    m_index = index;
+    showCount();
+}
+
+void FindBar::showCount()
+{
+    if (m_total == 0) {
+        m_countLabel->setText("No matches");
+    } else if (m_index > 0) {
+        m_countLabel->setText(QString("%1 of %2").arg(m_index).arg(m_total));
+    } else {
+        m_countLabel->setText(QString("%1 %2").arg(m_total).arg(m_total == 1 ? "match" : "matches"));
+    }
+}
@@ -0,0 +1,330 @@
+// fuzzy subsequence matching used by quick open
+// scores favour matches in the file name, at word boundaries and in runs,
+// and large candidate sets are scored on the global thread pool
+
+#include "fuzzy_matcher.h"
+#include "function_task.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <algorithm>
+
+namespace {
+
+// below this many candidates the thread hand-off costs more than it saves
+const int kParallelThreshold = 32768;
+
+const int kMatchBonus = 16;
+const int kBoundaryBonus = 12;
+const int kConsecutiveBonus = 4;
+const int kBasenameBonus = 24;
+
+inline ushort foldCharacter(QChar c)
+{
+    ushort u = c.unicode();
+    if (u < 128) {
+        return (u >= 'A' && u <= 'Z') ? u + ('a' - 'A') : u;
+    }
+    return c.toLower().unicode();
+}
+
+inline int characterBit(ushort c)
+{
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a';
+    }
+    if (c >= '0' && c <= '9') {
+        return 26 + (c - '0');
+    }
+
+    switch (c) {
+    case '_': return 36;
+    case '-': return 37;
+    case '.': return 38;
+    case '/': return 39;
+    case ' ': return 40;
+    default: break;
+    }
+
+    // everything else shares the remaining bits, which only weakens the filter
+    return 41 + (c % 23);
+}
+
+inline bool isBoundary(ushort c)
+{
+    return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+bool isBetter(const FuzzyMatch &left, const FuzzyMatch &right)
+{
+    if (left.score != right.score) {
+        return left.score > right.score;
+    }
+    return left.index < right.index;
+}
+
+// score of the tightest match inside text[from, length), or -1
+int scoreWindow(const ushort *text, int length, int from, const ushort *query, int queryLength)
+{
+    int matched = 0;
+    int end = -1;
+    for (int i = from; i < length; ++i) {
+        if (text[i] == query[matched] && ++matched == queryLength) {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0) {
+        return -1;
+    }
+
+    // walk back from the end to find the shortest window holding the match
+    int start = end;
+    int position = queryLength - 1;
+    for (int i = end; i >= from; --i) {
+        if (text[i] == query[position]) {
+            if (position-- == 0) {
+                start = i;
+                break;
+            }
+        }
+    }
+
+    int score = 0;
+    int run = 0;
+    int last = -2;
+    position = 0;
+    for (int i = start; i <= end && position < queryLength; ++i) {
+        if (text[i] != query[position]) {
+            score -= 1;
+            continue;
+        }
+
+        int bonus = kMatchBonus;
+        if (i == 0 || isBoundary(text[i - 1])) {
+            bonus += kBoundaryBonus;
+        }
+        if (last == i - 1) {
+            ++run;
+            bonus += kConsecutiveBonus * run;
+        } else {
+            run = 0;
+        }
+
+        score += bonus;
+        last = i;
+        ++position;
+    }
+
+    score -= (start - from) / 4;
+    return score;
+}
+
+}
+
+FuzzyMatcher::FuzzyMatcher()
+    : m_hasLastQuery(false)
+{
+}
+
+void FuzzyMatcher::setCandidates(int count, const std::function<QString(int)> &textAt)
+{
+    clear();
+
+    m_offsets.reserve(count + 1);
+    m_basenames.reserve(count);
+    m_masks.reserve(count);
+
+    for (int i = 0; i < count; ++i) {
+        const QString text = textAt(i);
+        m_offsets.append(m_text.size());
+
+        quint64 mask = 0;
+        int basename = 0;
+        for (int j = 0; j < text.size(); ++j) {
+            ushort c = foldCharacter(text.at(j));
+            m_text.append(c);
+            mask |= quint64(1) << characterBit(c);
+            if (c == '/') {
+                basename = j + 1;
+            }
+        }
+
+        m_basenames.append(basename);
+        m_masks.append(mask);
+    }
+    m_offsets.append(m_text.size());
+}
+
+void FuzzyMatcher::clear()
+{
+    m_text.clear();
+    m_offsets.clear();
+    m_basenames.clear();
+    m_masks.clear();
+    m_lastQuery.clear();
+    m_lastCandidates.clear();
+    m_hasLastQuery = false;
+}
+
+int FuzzyMatcher::candidateCount() const
+{
+    return m_masks.size();
+}
+
+QVector<FuzzyMatch> FuzzyMatcher::match(const QString &query, int limit)
+{
+    QVector<ushort> folded;
+    folded.reserve(query.size());
+    for (const QChar c : query) {
+        if (!c.isSpace()) {
+            folded.append(foldCharacter(c));
+        }
+    }
+
+    const int count = candidateCount();
+    QVector<FuzzyMatch> results;
+
+    if (folded.isEmpty()) {
+        m_hasLastQuery = false;
+        m_lastCandidates.clear();
+        for (int i = 0; i < count && i < limit; ++i) {
+            FuzzyMatch match;
+            match.index = i;
+            results.append(match);
+        }
+        return results;
+    }
+
+    quint64 queryMask = 0;
+    for (ushort c : folded) {
+        queryMask |= quint64(1) << characterBit(c);
+    }
+
+    // typing more only ever removes matches, so narrow from the last survivors
+    bool narrowing = m_hasLastQuery && folded.size() >= m_lastQuery.size()
+        && std::equal(m_lastQuery.constBegin(), m_lastQuery.constEnd(), folded.constBegin());
+
+    QVector<int> source;
+    if (narrowing) {
+        source = m_lastCandidates;
+    } else {
+        // branch free pass over the packed masks, which the compiler vectorizes
+        QVector<quint8> passes(count);
+        const quint64 *masks = m_masks.constData();
+        quint8 *out = passes.data();
+        for (int i = 0; i < count; ++i) {
+            out[i] = (masks[i] & queryMask) == queryMask;
+        }
+
+        source.reserve(count / 4);
+        for (int i = 0; i < count; ++i) {
+            if (out[i]) {
+                source.append(i);
+            }
+        }
+    }
+
+    const ushort *queryData = folded.constData();
+    const int queryLength = folded.size();
+
+    QVector<int> matched;
+    QVector<FuzzyMatch> best;
+
+    if (source.size() < kParallelThreshold) {
+        scoreRange(source.constData(), source.size(), queryData, queryLength, queryMask, limit, &matched, &best);
+    } else {
+        int chunks = qMax(2, QThread::idealThreadCount());
+        int chunkSize = (source.size() + chunks - 1) / chunks;
+
+        QVector<QVector<int>> chunkMatched(chunks);
+        QVector<QVector<FuzzyMatch>> chunkBest(chunks);
+        QSemaphore done;
+
+        // chunk 0 runs on this thread while the rest use the global pool
+        for (int chunk = 1; chunk < chunks; ++chunk) {
+            int begin = chunk * chunkSize;
+            int length = qMax(0, qMin(chunkSize, source.size() - begin));
+
+            QThreadPool::globalInstance()->start(new FunctionTask([&, chunk, begin, length]() {
+                scoreRange(source.constData() + begin, length, queryData, queryLength, queryMask, limit,
+                           &chunkMatched[chunk], &chunkBest[chunk]);
+                done.release();
+            }));
+        }
+
+        scoreRange(source.constData(), qMin(chunkSize, source.size()), queryData, queryLength, queryMask, limit,
+                   &chunkMatched[0], &chunkBest[0]);
+        done.acquire(chunks - 1);
+
+        for (int chunk = 0; chunk < chunks; ++chunk) {
+            matched += chunkMatched[chunk];
+            best += chunkBest[chunk];
+        }
+    }
+
+    std::sort(best.begin(), best.end(), isBetter);
+    if (best.size() > limit) {
+        best.resize(limit);
+    }
+
+    m_lastQuery = folded;
+    m_lastCandidates = matched;
+    m_hasLastQuery = true;
+
+    return best;
+}
+
+int FuzzyMatcher::score(int candidate, const ushort *query, int queryLength) const
+{
+    const ushort *text = m_text.constData() + m_offsets.at(candidate);
+    int length = m_offsets.at(candidate + 1) - m_offsets.at(candidate);
+
+    int result = scoreWindow(text, length, m_basenames.at(candidate), query, queryLength);
+    if (result >= 0) {
+        result += kBasenameBonus;
+    } else {
+        result = scoreWindow(text, length, 0, query, queryLength);
+        if (result < 0) {
+            return -1;
+        }
+    }
+
+    // shorter paths win ties between otherwise equal matches
+    return qMax(0, result - length / 16);
+}
+
+void FuzzyMatcher::scoreRange(const int *candidates, int count, const ushort *query, int queryLength,
+                              quint64 queryMask, int limit, QVector<int> *matched, QVector<FuzzyMatch> *best) const
+{
+    const quint64 *masks = m_masks.constData();
+
+    // min-heap on quality keeps the top results without sorting every match
+    best->reserve(limit + 1);
+    for (int i = 0; i < count; ++i) {
+        int candidate = candidates[i];
+        if ((masks[candidate] & queryMask) != queryMask) {
+            continue;
+        }
+
+        int candidateScore = score(candidate, query, queryLength);
+        if (candidateScore < 0) {
+            continue;
+        }
+
+        matched->append(candidate);
+
+        FuzzyMatch match;
+        match.index = candidate;
+        match.score = candidateScore;
+
+        if (best->size() < limit) {
+            best->append(match);
+            std::push_heap(best->begin(), best->end(), isBetter);
+        } else if (limit > 0 && isBetter(match, best->front())) {
+            std::pop_heap(best->begin(), best->end(), isBetter);
+            best->back() = match;
+            std::push_heap(best->begin(), best->end(), isBetter);
+        }
+    }
+}
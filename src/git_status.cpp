@@ -0,0 +1,738 @@
+// native git status for the file tree
+// parses .git/index on a worker, compares stat data the way git does and
+// hashes only the files whose stat data cannot vouch for them
+
+#include "git_status.h"
+#include "function_task.h"
+#include "project_indexer.h"
+#include "debug_log.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kIndexSignature[4] = { 'D', 'I', 'R', 'C' };
+const qint64 kIndexHeaderSize = 12;
+const qint64 kEntryHeaderSize = 62;
+const int kHashSize = 20;
+
+// .git changes arrive in bursts (index.lock, then the rename)
+const int kIndexCheckDelay = 150;
+
+const quint16 kAssumeValidFlag = 0x8000;
+const quint16 kExtendedFlag = 0x4000;
+const quint16 kStageMask = 0x3000;
+const quint16 kSkipWorktreeFlag = 0x4000;
+const quint16 kIntentToAddFlag = 0x2000;
+
+const quint32 kTypeMask = 0170000;
+const quint32 kRegularType = 0100000;
+const quint32 kSymlinkType = 0120000;
+const quint32 kGitlinkType = 0160000;
+const quint32 kDirectoryType = 0040000;
+const quint32 kExecutableBit = 0100;
+
+inline quint32 readBE32(const uchar *data)
+{
+    return (quint32(data[0]) << 24) | (quint32(data[1]) << 16) | (quint32(data[2]) << 8) | quint32(data[3]);
+}
+
+inline quint16 readBE16(const uchar *data)
+{
+    return quint16((data[0] << 8) | data[1]);
+}
+
+// git's offset varint: every continuation byte also adds one, so encodings are unique
+bool readVarint(const uchar *data, qint64 end, qint64 *cursor, quint64 *value)
+{
+    if (*cursor >= end) {
+        return false;
+    }
+
+    uchar c = data[(*cursor)++];
+    quint64 result = c & 127;
+    while (c & 128) {
+        if (*cursor >= end || result > (Q_UINT64_C(1) << 50)) {
+            return false;
+        }
+        c = data[(*cursor)++];
+        result = ((result + 1) << 7) | (c & 127);
+    }
+
+    *value = result;
+    return true;
+}
+
+struct FileStat
+{
+    qint64 ctime = 0;
+    qint64 mtime = 0;
+    quint64 inode = 0;
+    qint64 size = 0;
+    quint32 mode = 0;
+};
+
+bool statFile(const QString &filePath, FileStat *result)
+{
+#ifdef Q_OS_UNIX
+    struct stat buffer;
+    if (::lstat(QFile::encodeName(filePath).constData(), &buffer) != 0) {
+        return false;
+    }
+
+    result->ctime = buffer.st_ctime;
+    result->mtime = buffer.st_mtime;
+    result->inode = buffer.st_ino;
+    result->size = buffer.st_size;
+    result->mode = buffer.st_mode;
+    return true;
+#else
+    QFileInfo info(filePath);
+    if (!info.exists() && !info.isSymLink()) {
+        return false;
+    }
+
+    result->mtime = info.lastModified().toSecsSinceEpoch();
+    result->size = info.size();
+    if (info.isSymLink()) {
+        result->mode = kSymlinkType;
+    } else if (info.isDir()) {
+        result->mode = kDirectoryType;
+    } else {
+        result->mode = kRegularType | (info.isExecutable() ? kExecutableBit : 0);
+    }
+    return true;
+#endif
+}
+
+// the fields git compares in its stat check; the index keeps only their low 32 bits
+bool statMatches(const GitIndexEntry &entry, const FileStat &fileStat)
+{
+    if (quint32(fileStat.mtime) != entry.mtimeSeconds || quint32(fileStat.size) != entry.size) {
+        return false;
+    }
+
+#ifdef Q_OS_UNIX
+    return quint32(fileStat.ctime) == entry.ctimeSeconds && quint32(fileStat.inode) == entry.inode;
+#else
+    return true;
+#endif
+}
+
+bool entryLessThan(const GitIndexEntry &entry, const QString &path)
+{
+    return entry.path < path;
+}
+
+}
+
+GitStatus::GitStatus(QObject *parent)
+    : QObject(parent)
+    , m_pool(new QThreadPool(this))
+    , m_generation(0)
+    , m_gitWatcher(new QFileSystemWatcher(this))
+    , m_indexTimer(new QTimer(this))
+{
+    // tasks share the worker state, so they must run one at a time
+    m_pool->setMaxThreadCount(1);
+
+    m_indexTimer->setSingleShot(true);
+    m_indexTimer->setInterval(kIndexCheckDelay);
+    connect(m_indexTimer, &QTimer::timeout, this, &GitStatus::checkIndex);
+    connect(m_gitWatcher, &QFileSystemWatcher::directoryChanged, this, [this]() {
+        m_indexTimer->start();
+    });
+}
+
+GitStatus::~GitStatus()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+void GitStatus::setFileTable(const QSharedPointer<const ProjectFileTable> &files)
+{
+    if (!files || files->rootPath().isEmpty()) {
+        clear();
+        return;
+    }
+
+    bool reopen = files->rootPath() != m_rootPath;
+    if (reopen) {
+        m_generation.fetchAndAddOrdered(1);
+        m_rootPath = files->rootPath();
+        m_snapshot.reset();
+        m_lastError.clear();
+    }
+
+    int generation = m_generation.loadAcquire();
+    QString rootPath = m_rootPath;
+
+    m_pool->start(new FunctionTask([this, generation, reopen, rootPath, files]() {
+        if (generation != m_generation.loadAcquire()) {
+            return;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        bool rescan = false;
+        if (reopen) {
+            rescan = openRepository(rootPath) && loadIndex(true);
+        } else if (!m_state.gitDirectory.isEmpty()) {
+            rescan = loadIndex(false);
+        }
+
+        // new and removed project files only change the untracked set
+        m_state.table = files;
+        if (rescan) {
+            scanEntries();
+        }
+        scanUntracked();
+
+        if (rescan) {
+            DEBUG_LOG_EDITOR("Git status of" << m_state.entries.size() << "tracked files in"
+                             << timer.elapsed() << "ms");
+        }
+        postSnapshot(generation);
+    }));
+}
+
+void GitStatus::updatePaths(const QStringList &directories, const QStringList &files)
+{
+    if (m_rootPath.isEmpty()) {
+        return;
+    }
+
+    int generation = m_generation.loadAcquire();
+    m_pool->start(new FunctionTask([this, generation, directories, files]() {
+        if (generation != m_generation.loadAcquire() || !updateEntries(directories, files)) {
+            return;
+        }
+        postSnapshot(generation);
+    }));
+}
+
+void GitStatus::clear()
+{
+    int generation = m_generation.fetchAndAddOrdered(1) + 1;
+
+    m_rootPath.clear();
+    m_snapshot.reset();
+    m_lastError.clear();
+    m_indexTimer->stop();
+    if (!m_gitWatcher->directories().isEmpty()) {
+        m_gitWatcher->removePaths(m_gitWatcher->directories());
+    }
+
+    // drop the parsed index on the worker, where it lives
+    m_pool->start(new FunctionTask([this, generation]() {
+        if (generation == m_generation.loadAcquire()) {
+            m_state = WorkerState();
+        }
+    }));
+
+    emit statusChanged();
+}
+
+QString GitStatus::rootPath() const
+{
+    return m_rootPath;
+}
+
+bool GitStatus::isRepository() const
+{
+    return m_snapshot && !m_snapshot->gitDirectory.isEmpty() && m_lastError.isEmpty();
+}
+
+QString GitStatus::lastError() const
+{
+    return m_lastError;
+}
+
+GitStatus::Status GitStatus::fileStatus(const QString &relativePath) const
+{
+    if (!m_snapshot) {
+        return None;
+    }
+
+    auto it = m_snapshot->files.constFind(relativePath);
+    if (it != m_snapshot->files.constEnd()) {
+        return it.value();
+    }
+    return m_snapshot->tracked.contains(relativePath) ? Clean : None;
+}
+
+GitStatus::Status GitStatus::directoryStatus(const QString &relativePath) const
+{
+    return m_snapshot ? m_snapshot->directories.value(relativePath, None) : None;
+}
+
+void GitStatus::publish(int generation, const QSharedPointer<const Snapshot> &snapshot, const QString &error)
+{
+    if (generation != m_generation.loadAcquire()) {
+        return;
+    }
+
+    if (!error.isEmpty() && error != m_lastError) {
+        LOG_WARNING("Git status unavailable:" << error);
+    }
+    m_lastError = error;
+
+    // the index is replaced by renaming index.lock, so the directory is watched
+    if (!m_snapshot || m_snapshot->gitDirectory != snapshot->gitDirectory) {
+        if (!m_gitWatcher->directories().isEmpty()) {
+            m_gitWatcher->removePaths(m_gitWatcher->directories());
+        }
+        if (!snapshot->gitDirectory.isEmpty()) {
+            m_gitWatcher->addPath(snapshot->gitDirectory);
+        }
+    }
+
+    m_snapshot = snapshot;
+    emit statusChanged();
+}
+
+void GitStatus::checkIndex()
+{
+    int generation = m_generation.loadAcquire();
+    m_pool->start(new FunctionTask([this, generation]() {
+        if (generation != m_generation.loadAcquire() || m_state.gitDirectory.isEmpty() || !loadIndex(false)) {
+            return;
+        }
+
+        scanEntries();
+        scanUntracked();
+        postSnapshot(generation);
+    }));
+}
+
+bool GitStatus::openRepository(const QString &rootPath)
+{
+    m_state = WorkerState();
+    m_state.rootPath = rootPath;
+
+    QString workTree;
+    m_state.gitDirectory = findGitDirectory(rootPath, &workTree);
+    if (m_state.gitDirectory.isEmpty()) {
+        return false;
+    }
+
+    // a project opened below the top of the work tree only sees its own entries
+    QString prefix = QDir(workTree).relativeFilePath(rootPath);
+    if (!prefix.isEmpty() && prefix != QLatin1String(".")) {
+        m_state.prefix = prefix + QLatin1Char('/');
+    }
+    return true;
+}
+
+bool GitStatus::loadIndex(bool force)
+{
+    const QString indexPath = m_state.gitDirectory + QLatin1String("/index");
+    QFileInfo info(indexPath);
+    qint64 modified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+    qint64 size = info.exists() ? info.size() : -1;
+
+    if (!force && modified == m_state.indexModified && size == m_state.indexSize) {
+        return false;
+    }
+
+    m_state.indexModified = modified;
+    m_state.indexSize = size;
+    m_state.indexSeconds = modified >= 0 ? modified / 1000 : 0;
+    m_state.entries.clear();
+    m_state.tracked.clear();
+    m_state.error.clear();
+
+    // a repository without commits or staged files has no index yet
+    if (modified < 0) {
+        return true;
+    }
+
+    QVector<GitIndexEntry> entries;
+    if (!readIndex(indexPath, &entries, &m_state.error)) {
+        return true;
+    }
+
+    m_state.entries.reserve(entries.size());
+    for (GitIndexEntry &entry : entries) {
+        // directories of a sparse index only stand for skipped files
+        if ((entry.mode & kTypeMask) == kDirectoryType || !entry.path.startsWith(m_state.prefix)) {
+            continue;
+        }
+        entry.path.remove(0, m_state.prefix.size());
+        m_state.entries.append(entry);
+    }
+
+    // git sorts by bytes; directory lookups below need QString order
+    std::stable_sort(m_state.entries.begin(), m_state.entries.end(),
+                     [](const GitIndexEntry &left, const GitIndexEntry &right) {
+        return left.path < right.path;
+    });
+
+    m_state.tracked.reserve(m_state.entries.size());
+    for (int i = 0; i < m_state.entries.size(); ++i) {
+        m_state.tracked.insert(m_state.entries.at(i).path, i);
+    }
+    return true;
+}
+
+void GitStatus::scanEntries()
+{
+    m_state.files.clear();
+    if (!m_state.error.isEmpty()) {
+        return;
+    }
+
+    for (const GitIndexEntry &entry : qAsConst(m_state.entries)) {
+        Status status = entryStatus(entry);
+        if (status != Clean) {
+            m_state.files.insert(entry.path, status);
+        }
+    }
+}
+
+void GitStatus::scanUntracked()
+{
+    for (auto it = m_state.files.begin(); it != m_state.files.end();) {
+        if (it.value() == Untracked) {
+            it = m_state.files.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    const QSharedPointer<const ProjectFileTable> table = m_state.table;
+    if (m_state.gitDirectory.isEmpty() || !m_state.error.isEmpty() || !table
+        || table->rootPath() != m_state.rootPath) {
+        return;
+    }
+
+    // the table already leaves out ignored files when ignore rules are respected
+    for (int file = 0; file < table->fileCount(); ++file) {
+        QString relativePath = table->relativePath(file);
+        if (!m_state.tracked.contains(relativePath)) {
+            m_state.files.insert(relativePath, Untracked);
+        }
+    }
+}
+
+bool GitStatus::updateEntries(const QStringList &directories, const QStringList &files)
+{
+    if (m_state.gitDirectory.isEmpty() || !m_state.error.isEmpty()) {
+        return false;
+    }
+
+    QVector<int> changed;
+    for (const QString &file : files) {
+        int entry = m_state.tracked.value(file, -1);
+        if (entry >= 0) {
+            changed.append(entry);
+        }
+    }
+
+    const QVector<GitIndexEntry> &entries = m_state.entries;
+    for (const QString &directory : directories) {
+        const QString prefix = directory.isEmpty() ? QString() : directory + QLatin1Char('/');
+
+        // direct children changed with the directory; deeper entries only when a whole
+        // subdirectory was moved or removed, which nothing below it reports
+        QHash<QString, bool> subdirectoryExists;
+        auto it = std::lower_bound(entries.constBegin(), entries.constEnd(), prefix, entryLessThan);
+        for (; it != entries.constEnd() && it->path.startsWith(prefix); ++it) {
+            int slash = it->path.indexOf(QLatin1Char('/'), prefix.size());
+            if (slash >= 0) {
+                QString subdirectory = it->path.left(slash);
+                auto exists = subdirectoryExists.constFind(subdirectory);
+                if (exists == subdirectoryExists.constEnd()) {
+                    exists = subdirectoryExists.insert(subdirectory,
+                        QFileInfo(m_state.rootPath + QLatin1Char('/') + subdirectory).isDir());
+                }
+                if (exists.value()) {
+                    continue;
+                }
+            }
+            changed.append(int(it - entries.constBegin()));
+        }
+    }
+
+    bool updated = false;
+    for (int entry : qAsConst(changed)) {
+        const GitIndexEntry &indexEntry = entries.at(entry);
+        Status status = entryStatus(indexEntry);
+        if (status == m_state.files.value(indexEntry.path, Clean)) {
+            continue;
+        }
+
+        if (status == Clean) {
+            m_state.files.remove(indexEntry.path);
+        } else {
+            m_state.files.insert(indexEntry.path, status);
+        }
+        updated = true;
+    }
+    return updated;
+}
+
+GitStatus::Status GitStatus::entryStatus(const GitIndexEntry &entry) const
+{
+    if ((entry.flags & kAssumeValidFlag) || (entry.extendedFlags & kSkipWorktreeFlag)) {
+        return Clean;
+    }
+    if ((entry.flags & kStageMask) || (entry.extendedFlags & kIntentToAddFlag)) {
+        return Modified;
+    }
+
+    // submodules are checked against their own index
+    quint32 type = entry.mode & kTypeMask;
+    if (type == kGitlinkType) {
+        return Clean;
+    }
+
+    const QString filePath = m_state.rootPath + QLatin1Char('/') + entry.path;
+    FileStat fileStat;
+    if (!statFile(filePath, &fileStat) || (fileStat.mode & kTypeMask) != type) {
+        return Modified;
+    }
+    if (type == kRegularType && (fileStat.mode & kExecutableBit) != (entry.mode & kExecutableBit)) {
+        return Modified;
+    }
+
+    // stat data only vouches for files last written before the index was
+    if (statMatches(entry, fileStat) && qint64(entry.mtimeSeconds) < m_state.indexSeconds) {
+        return Clean;
+    }
+
+    // git writes racily clean entries with size 0, so only a recorded size proves a change
+    if (entry.size != 0 && quint32(fileStat.size) != entry.size) {
+        return Modified;
+    }
+
+    return blobMatches(filePath, type == kSymlinkType, entry.sha1) ? Clean : Modified;
+}
+
+void GitStatus::postSnapshot(int generation)
+{
+    QSharedPointer<Snapshot> snapshot(new Snapshot);
+    snapshot->gitDirectory = m_state.error.isEmpty() ? m_state.gitDirectory : QString();
+    snapshot->tracked = m_state.tracked;
+    snapshot->files = m_state.files;
+
+    // every ancestor of a changed file is marked, modified winning over untracked
+    for (auto it = m_state.files.constBegin(); it != m_state.files.constEnd(); ++it) {
+        Status status = it.value() == Untracked ? Untracked : Modified;
+        QString directory = it.key();
+
+        while (true) {
+            int slash = directory.lastIndexOf(QLatin1Char('/'));
+            directory = slash >= 0 ? directory.left(slash) : QString();
+
+            auto existing = snapshot->directories.constFind(directory);
+            if (existing != snapshot->directories.constEnd()
+                && (existing.value() == Modified || existing.value() == status)) {
+                break;
+            }
+
+            snapshot->directories.insert(directory, status);
+            if (directory.isEmpty()) {
+                break;
+            }
+        }
+    }
+
+    QString error = m_state.error;
+    QMetaObject::invokeMethod(this, [this, generation, snapshot, error]() {
+        publish(generation, snapshot, error);
+    }, Qt::QueuedConnection);
+}
+
+bool GitStatus::readIndex(const QString &indexPath, QVector<GitIndexEntry> *entries, QString *error)
+{
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = QString("Cannot read %1: %2").arg(indexPath, file.errorString());
+        return false;
+    }
+
+    // read through once, front to back
+    const QByteArray bytes = file.readAll();
+    const uchar *data = reinterpret_cast<const uchar*>(bytes.constData());
+    const qint64 end = qint64(bytes.size()) - kHashSize;
+
+    if (end < kIndexHeaderSize || std::memcmp(data, kIndexSignature, sizeof(kIndexSignature)) != 0) {
+        *error = QString("%1 is not a git index").arg(indexPath);
+        return false;
+    }
+
+    quint32 version = readBE32(data + 4);
+    if (version < 2 || version > 4) {
+        *error = QString("Unsupported git index version %1").arg(version);
+        return false;
+    }
+
+    quint32 count = readBE32(data + 8);
+    entries->clear();
+    entries->reserve(int(qMin<qint64>(count, end / kEntryHeaderSize)));
+
+    QByteArray path;
+    qint64 offset = kIndexHeaderSize;
+    for (quint32 i = 0; i < count; ++i) {
+        if (offset + kEntryHeaderSize > end) {
+            *error = QString("Git index is truncated at entry %1").arg(i);
+            return false;
+        }
+
+        const uchar *record = data + offset;
+        GitIndexEntry entry;
+        entry.ctimeSeconds = readBE32(record);
+        entry.mtimeSeconds = readBE32(record + 8);
+        entry.inode = readBE32(record + 20);
+        entry.mode = readBE32(record + 24);
+        entry.size = readBE32(record + 36);
+        std::memcpy(entry.sha1, record + 40, kHashSize);
+        entry.flags = readBE16(record + 60);
+
+        qint64 pathStart = offset + kEntryHeaderSize;
+        if (entry.flags & kExtendedFlag) {
+            if (version < 3 || pathStart + 2 > end) {
+                *error = QString("Git index entry %1 has invalid extended flags").arg(i);
+                return false;
+            }
+            entry.extendedFlags = readBE16(data + pathStart);
+            pathStart += 2;
+        }
+
+        if (version == 4) {
+            // v4 stores how many bytes to drop from the previous path, then the new suffix
+            qint64 cursor = pathStart;
+            quint64 strip = 0;
+            if (!readVarint(data, end, &cursor, &strip) || strip > quint64(path.size())) {
+                *error = QString("Git index entry %1 has an invalid path prefix").arg(i);
+                return false;
+            }
+
+            const uchar *terminator = static_cast<const uchar*>(std::memchr(data + cursor, 0, size_t(end - cursor)));
+            if (!terminator) {
+                *error = QString("Git index entry %1 has an unterminated path").arg(i);
+                return false;
+            }
+
+            path.chop(int(strip));
+            path.append(reinterpret_cast<const char*>(data + cursor), int(terminator - (data + cursor)));
+            offset = (terminator - data) + 1;
+        } else {
+            const uchar *terminator = static_cast<const uchar*>(std::memchr(data + pathStart, 0, size_t(end - pathStart)));
+            if (!terminator) {
+                *error = QString("Git index entry %1 has an unterminated path").arg(i);
+                return false;
+            }
+
+            qint64 pathLength = terminator - (data + pathStart);
+            path = QByteArray(reinterpret_cast<const char*>(data + pathStart), int(pathLength));
+
+            // entries are nul padded to a multiple of 8 bytes, at least one nul
+            offset += ((pathStart - offset) + pathLength + 8) & ~qint64(7);
+        }
+
+        entry.path = QString::fromUtf8(path);
+        entries->append(entry);
+    }
+
+    if (offset > end) {
+        *error = QString("Git index is truncated");
+        return false;
+    }
+
+    // extensions only cache data, except a split index, which moves the entries elsewhere
+    while (offset + 8 <= end) {
+        if (std::memcmp(data + offset, "link", 4) == 0) {
+            *error = QString("Split git indexes are not supported");
+            return false;
+        }
+        offset += 8 + qint64(readBE32(data + offset + 4));
+    }
+
+    return true;
+}
+
+QString GitStatus::findGitDirectory(const QString &path, QString *workTree)
+{
+    QDir directory(path);
+
+    while (true) {
+        QFileInfo dotGit(directory.filePath(".git"));
+        if (dotGit.isDir()) {
+            *workTree = directory.absolutePath();
+            return dotGit.absoluteFilePath();
+        }
+
+        // linked worktrees and submodules point at their git directory from a file
+        if (dotGit.isFile()) {
+            QFile file(dotGit.absoluteFilePath());
+            if (!file.open(QIODevice::ReadOnly)) {
+                return QString();
+            }
+
+            QString line = QString::fromUtf8(file.readLine()).trimmed();
+            if (!line.startsWith(QLatin1String("gitdir:"))) {
+                return QString();
+            }
+
+            *workTree = directory.absolutePath();
+            return QDir(directory.absoluteFilePath(line.mid(7).trimmed())).absolutePath();
+        }
+
+        if (!directory.cdUp()) {
+            return QString();
+        }
+    }
+}
+
+bool GitStatus::blobMatches(const QString &filePath, bool symlink, const uchar *sha1)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    if (symlink) {
+#ifdef Q_OS_UNIX
+        // a link is stored as a blob of its target
+        char target[4096];
+        ssize_t length = ::readlink(QFile::encodeName(filePath).constData(), target, sizeof(target));
+        if (length < 0) {
+            return false;
+        }
+
+        QByteArray header = "blob " + QByteArray::number(qint64(length));
+        header.append('\0');
+        hash.addData(header);
+        hash.addData(target, int(length));
+#else
+        return false;
+#endif
+    } else {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        QByteArray header = "blob " + QByteArray::number(file.size());
+        header.append('\0');
+        hash.addData(header);
+        if (!hash.addData(&file)) {
+            return false;
+        }
+    }
+
+    return std::memcmp(hash.result().constData(), sha1, kHashSize) == 0;
+}
@@ -0,0 +1,336 @@
+// gitignore compatible matching for the project indexer
+// supports negation, directory-only and anchored patterns, character
+// classes and ** across directories
+
+#include "ignore_rules.h"
+#include <QFile>
+#include <QDir>
+#include <QStringList>
+
+namespace {
+
+bool hasGlobCharacters(const QString &text)
+{
+    for (const QChar c : text) {
+        if (c == '*' || c == '?' || c == '[' || c == '\\') {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool matchClass(const QChar *&pattern, const QChar *patternEnd, QChar c, bool *matched)
+{
+    const QChar *p = pattern + 1;
+    bool negate = false;
+    if (p < patternEnd && (*p == '!' || *p == '^')) {
+        negate = true;
+        ++p;
+    }
+
+    bool found = false;
+    bool first = true;
+    while (p < patternEnd && (first || *p != ']')) {
+        first = false;
+        QChar low = *p;
+        if (low == '\\' && p + 1 < patternEnd) {
+            low = *++p;
+        }
+
+        QChar high = low;
+        if (p + 2 < patternEnd && p[1] == '-' && p[2] != ']') {
+            high = p[2];
+            p += 2;
+        }
+
+        if (c >= low && c <= high) {
+            found = true;
+        }
+        ++p;
+    }
+
+    // no closing bracket, so the '[' is literal
+    if (p >= patternEnd) {
+        return false;
+    }
+
+    pattern = p + 1;
+    *matched = (found != negate);
+    return true;
+}
+
+bool matchGlob(const QChar *p, const QChar *pEnd, const QChar *t, const QChar *tEnd)
+{
+    while (p < pEnd) {
+        QChar c = *p;
+
+        if (c == '*') {
+            if (p + 1 < pEnd && p[1] == '*') {
+                p += 2;
+
+                // "**/" matches zero or more whole directories
+                if (p < pEnd && *p == '/') {
+                    ++p;
+                    for (const QChar *s = t; ; ) {
+                        if (matchGlob(p, pEnd, s, tEnd)) {
+                            return true;
+                        }
+                        while (s < tEnd && *s != '/') {
+                            ++s;
+                        }
+                        if (s >= tEnd) {
+                            return false;
+                        }
+                        ++s;
+                    }
+                }
+
+                for (const QChar *s = t; s <= tEnd; ++s) {
+                    if (matchGlob(p, pEnd, s, tEnd)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            ++p;
+            for (const QChar *s = t; ; ++s) {
+                if (matchGlob(p, pEnd, s, tEnd)) {
+                    return true;
+                }
+                if (s >= tEnd || *s == '/') {
+                    return false;
+                }
+            }
+        }
+
+        if (t >= tEnd) {
+            return false;
+        }
+
+        if (c == '?') {
+            if (*t == '/') {
+                return false;
+            }
+            ++p;
+            ++t;
+            continue;
+        }
+
+        if (c == '[') {
+            bool matched = false;
+            if (matchClass(p, pEnd, *t, &matched)) {
+                if (!matched || *t == '/') {
+                    return false;
+                }
+                ++t;
+                continue;
+            }
+        }
+
+        if (c == '\\' && p + 1 < pEnd) {
+            c = *++p;
+        }
+
+        if (*t != c) {
+            return false;
+        }
+        ++p;
+        ++t;
+    }
+
+    return t == tEnd;
+}
+
+}
+
+IgnoreRuleSet::IgnoreRuleSet(const QString &baseDirectory)
+    : m_baseDirectory(baseDirectory)
+{
+}
+
+bool IgnoreRuleSet::loadFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        addPattern(QString::fromUtf8(line));
+    }
+    return true;
+}
+
+void IgnoreRuleSet::addPattern(const QString &line)
+{
+    QString text = line;
+    if (text.endsWith('\r')) {
+        text.chop(1);
+    }
+
+    // trailing spaces are ignored unless escaped
+    while (text.endsWith(' ') && !text.endsWith("\\ ")) {
+        text.chop(1);
+    }
+
+    if (text.isEmpty() || text.startsWith('#')) {
+        return;
+    }
+
+    IgnorePattern pattern;
+
+    if (text.startsWith('!')) {
+        pattern.negated = true;
+        text.remove(0, 1);
+    } else if (text.startsWith("\\!") || text.startsWith("\\#")) {
+        text.remove(0, 1);
+    }
+
+    if (text.endsWith('/')) {
+        pattern.directoryOnly = true;
+        text.chop(1);
+    }
+
+    // a slash anywhere but the end ties the pattern to this file's directory
+    if (text.contains('/')) {
+        pattern.anchored = true;
+        if (text.startsWith('/')) {
+            text.remove(0, 1);
+        }
+    }
+
+    if (text.isEmpty()) {
+        return;
+    }
+
+    if (!pattern.anchored && !hasGlobCharacters(text)) {
+        pattern.kind = IgnorePattern::Literal;
+    } else if (!pattern.anchored && text.startsWith('*') && !hasGlobCharacters(text.mid(1))) {
+        pattern.kind = IgnorePattern::Suffix;
+        text.remove(0, 1);
+    } else {
+        pattern.kind = IgnorePattern::Glob;
+    }
+
+    pattern.pattern = text;
+    m_patterns.append(pattern);
+}
+
+bool IgnoreRuleSet::isEmpty() const
+{
+    return m_patterns.isEmpty();
+}
+
+IgnoreRuleSet::Match IgnoreRuleSet::match(const QString &relativePath, bool isDir) const
+{
+    QString path = relativePath;
+    if (!m_baseDirectory.isEmpty()) {
+        if (!relativePath.startsWith(m_baseDirectory) || relativePath.size() <= m_baseDirectory.size()
+            || relativePath.at(m_baseDirectory.size()) != '/') {
+            return NoMatch;
+        }
+        path = relativePath.mid(m_baseDirectory.size() + 1);
+    }
+
+    int slash = path.lastIndexOf('/');
+    QString name = slash >= 0 ? path.mid(slash + 1) : path;
+
+    // the last matching line wins
+    for (int i = m_patterns.size() - 1; i >= 0; --i) {
+        const IgnorePattern &pattern = m_patterns.at(i);
+
+        if (pattern.directoryOnly && !isDir) {
+            continue;
+        }
+
+        bool matched = false;
+        switch (pattern.kind) {
+        case IgnorePattern::Literal:
+            matched = (name == pattern.pattern);
+            break;
+        case IgnorePattern::Suffix:
+            matched = name.endsWith(pattern.pattern);
+            break;
+        case IgnorePattern::Glob:
+            matched = globMatch(pattern.pattern, pattern.anchored ? path : name);
+            break;
+        }
+
+        if (matched) {
+            return pattern.negated ? Included : Ignored;
+        }
+    }
+
+    return NoMatch;
+}
+
+bool IgnoreRuleSet::globMatch(const QString &pattern, const QString &text)
+{
+    return matchGlob(pattern.constData(), pattern.constData() + pattern.size(),
+                     text.constData(), text.constData() + text.size());
+}
+
+IgnoreMatcher IgnoreMatcher::withRules(const QSharedPointer<const IgnoreRuleSet> &rules) const
+{
+    IgnoreMatcher matcher(*this);
+    if (rules && !rules->isEmpty()) {
+        matcher.m_ruleSets.append(rules);
+    }
+    return matcher;
+}
+
+bool IgnoreMatcher::isIgnored(const QString &relativePath, bool isDir) const
+{
+    // deeper files override shallower ones
+    for (int i = m_ruleSets.size() - 1; i >= 0; --i) {
+        IgnoreRuleSet::Match match = m_ruleSets.at(i)->match(relativePath, isDir);
+        if (match != IgnoreRuleSet::NoMatch) {
+            return match == IgnoreRuleSet::Ignored;
+        }
+    }
+    return false;
+}
+
+IgnoreMatcher IgnoreMatcher::forDirectory(const QString &rootPath, const QString &relativeDirectory)
+{
+    IgnoreMatcher matcher;
+
+    QSharedPointer<IgnoreRuleSet> exclude(new IgnoreRuleSet());
+    exclude->loadFile(QDir(rootPath).filePath(".git/info/exclude"));
+    matcher = matcher.withRules(exclude);
+
+    matcher = loadDirectoryRules(matcher, rootPath, QString());
+
+    QString current;
+    const QStringList parts = relativeDirectory.split('/', QString::SkipEmptyParts);
+    for (const QString &part : parts) {
+        current = current.isEmpty() ? part : current + '/' + part;
+        matcher = loadDirectoryRules(matcher, rootPath, current);
+    }
+
+    return matcher;
+}
+
+IgnoreMatcher IgnoreMatcher::loadDirectoryRules(const IgnoreMatcher &parent, const QString &rootPath,
+                                                const QString &relativeDirectory)
+{
+    QDir directory(relativeDirectory.isEmpty() ? rootPath : QDir(rootPath).filePath(relativeDirectory));
+
+    // .ignore is applied after .gitignore so it can override it, as ripgrep does
+    IgnoreMatcher matcher = parent;
+    for (const char *fileName : {".gitignore", ".ignore"}) {
+        QString filePath = directory.filePath(QString::fromLatin1(fileName));
+        if (!QFile::exists(filePath)) {
+            continue;
+        }
+
+        QSharedPointer<IgnoreRuleSet> rules(new IgnoreRuleSet(relativeDirectory));
+        if (rules->loadFile(filePath)) {
+            matcher = matcher.withRules(rules);
+        }
+    }
+
+    return matcher;
+}
@@ -14,6 +14,7 @@ LuaBridge::LuaBridge(QObject *parent)
     , m_currentCursorPosition(1, 1)
     , m_pluginManager(nullptr)
     , m_nextTimerId(1)
+    , m_eventsDeferred(false)
 {
     g_bridge = this;
 }
@@ -109,6 +110,199 @@ bool LuaBridge::executeString(const QString &luaCode)
     return true;
 }
 
+bool LuaBridge::loadPluginEnvironment(const QByteArray &chunk, const QString &chunkName,
+                                      const QString &pluginName, LuaPluginEnvironment *environment)
+{
+    if (!m_lua) {
+        m_lastError = "Lua state not initialized";
+        return false;
+    }
+
+    int top = lua_gettop(m_lua);
+    QByteArray source = "@" + chunkName.toUtf8();
+    QByteArray name = pluginName.toUtf8();
+
+    if (luaL_loadbuffer(m_lua, chunk.constData(), chunk.size(), source.constData()) != 0) {
+        handleLuaError("Loading plugin chunk");
+        lua_settop(m_lua, top);
+        return false;
+    }
+
+    // plugin globals land in a private table that falls back to _G for reads
+    lua_newtable(m_lua);
+    lua_newtable(m_lua);
+#if LUA_VERSION_NUM >= 502
+    lua_pushglobaltable(m_lua);
+#else
+    lua_pushvalue(m_lua, LUA_GLOBALSINDEX);
+#endif
+    lua_setfield(m_lua, -2, "__index");
+    lua_setmetatable(m_lua, -2);
+
+    lua_pushvalue(m_lua, -1);
+    int environmentRef = luaL_ref(m_lua, LUA_REGISTRYINDEX);
+
+#if LUA_VERSION_NUM >= 502
+    if (!lua_setupvalue(m_lua, -2, 1)) {
+        lua_pop(m_lua, 1);
+    }
+#else
+    lua_setfenv(m_lua, -2);
+#endif
+
+    if (lua_pcall(m_lua, 0, 0, 0) != 0) {
+        handleLuaError("Executing plugin chunk");
+        luaL_unref(m_lua, LUA_REGISTRYINDEX, environmentRef);
+        lua_settop(m_lua, top);
+        return false;
+    }
+
+    LuaPluginEnvironment result;
+    result.environment = environmentRef;
+
+    lua_rawgeti(m_lua, LUA_REGISTRYINDEX, environmentRef);
+    lua_pushstring(m_lua, name.constData());
+    lua_rawget(m_lua, -2);
+
+    if (lua_istable(m_lua, -1)) {
+        int module = lua_gettop(m_lua);
+
+        // the plugin's own table stays reachable as a global for actions and other plugins
+        lua_pushvalue(m_lua, module);
+        lua_setglobal(m_lua, name.constData());
+
+        lua_pushvalue(m_lua, module);
+        result.module = luaL_ref(m_lua, LUA_REGISTRYINDEX);
+
+        result.initialize = referenceFunction(module, "initialize");
+        result.cleanup = referenceFunction(module, "cleanup");
+        result.saveState = referenceFunction(module, "save_state");
+        result.restoreState = referenceFunction(module, "restore_state");
+    }
+
+    lua_settop(m_lua, top);
+
+    *environment = result;
+    DEBUG_LOG_LUA("Plugin loaded into private environment:" << pluginName);
+    return true;
+}
+
+void LuaBridge::releasePluginEnvironment(const QString &pluginName, LuaPluginEnvironment *environment)
+{
+    if (!m_lua || !environment) {
+        return;
+    }
+
+    if (environment->module != LUA_NOREF) {
+        QByteArray name = pluginName.toUtf8();
+        lua_getglobal(m_lua, name.constData());
+        lua_rawgeti(m_lua, LUA_REGISTRYINDEX, environment->module);
+        bool ownsGlobal = lua_rawequal(m_lua, -1, -2);
+        lua_pop(m_lua, 2);
+
+        if (ownsGlobal) {
+            lua_pushnil(m_lua);
+            lua_setglobal(m_lua, name.constData());
+        }
+    }
+
+    releaseReference(environment->initialize);
+    releaseReference(environment->cleanup);
+    releaseReference(environment->saveState);
+    releaseReference(environment->restoreState);
+    releaseReference(environment->module);
+    releaseReference(environment->environment);
+
+    *environment = LuaPluginEnvironment();
+}
+
+bool LuaBridge::callPluginFunction(int functionRef, const QString &context, int argumentRef, int *resultRef)
+{
+    if (!m_lua || functionRef == LUA_NOREF) {
+        return false;
+    }
+
+    int top = lua_gettop(m_lua);
+    lua_rawgeti(m_lua, LUA_REGISTRYINDEX, functionRef);
+
+    int argumentCount = 0;
+    if (argumentRef != LUA_NOREF) {
+        lua_rawgeti(m_lua, LUA_REGISTRYINDEX, argumentRef);
+        argumentCount = 1;
+    }
+
+    if (lua_pcall(m_lua, argumentCount, resultRef ? 1 : 0, 0) != 0) {
+        handleLuaError(context);
+        lua_settop(m_lua, top);
+        return false;
+    }
+
+    if (resultRef) {
+        *resultRef = luaL_ref(m_lua, LUA_REGISTRYINDEX);
+    }
+
+    lua_settop(m_lua, top);
+    return true;
+}
+
+void LuaBridge::releaseReference(int ref)
+{
+    if (m_lua && ref != LUA_NOREF && ref != LUA_REFNIL) {
+        luaL_unref(m_lua, LUA_REGISTRYINDEX, ref);
+    }
+}
+
+int LuaBridge::referenceFunction(int tableIndex, const char *field)
+{
+    lua_getfield(m_lua, tableIndex, field);
+    if (!lua_isfunction(m_lua, -1)) {
+        lua_pop(m_lua, 1);
+        return LUA_NOREF;
+    }
+
+    return luaL_ref(m_lua, LUA_REGISTRYINDEX);
+}
+
+static int writeBytecode(lua_State *, const void *data, size_t size, void *userData)
+{
+    static_cast<QByteArray *>(userData)->append(static_cast<const char *>(data), static_cast<int>(size));
+    return 0;
+}
+
+bool LuaBridge::compileChunk(const QByteArray &source, const QString &chunkName,
+                             QByteArray *bytecode, QString *error)
+{
+    // runs on loader threads, so it works in a throwaway state and never touches g_bridge
+    lua_State *scratch = luaL_newstate();
+    if (!scratch) {
+        if (error) {
+            *error = "Failed to create Lua state";
+        }
+        return false;
+    }
+
+    QByteArray name = "@" + chunkName.toUtf8();
+    bool ok = luaL_loadbuffer(scratch, source.constData(), source.size(), name.constData()) == 0;
+
+    if (ok) {
+        bytecode->clear();
+#if LUA_VERSION_NUM >= 503
+        ok = lua_dump(scratch, writeBytecode, bytecode, 0) == 0;
+#else
+        ok = lua_dump(scratch, writeBytecode, bytecode) == 0;
+#endif
+        if (!ok && error) {
+            *error = "Failed to dump Lua bytecode";
+        }
+    } else if (error) {
+        const char *message = lua_tostring(scratch, -1);
+        *error = QString::fromUtf8(message ? message : "Unknown error");
+    }
+
+    lua_close(scratch);
+    return ok;
+}
+
 void LuaBridge::registerEditorAPI()
 {
     if (!m_lua) {
@@ -141,6 +335,10 @@ void LuaBridge::registerEditorAPI()
     registerFunction("get_theme", lua_getTheme);
     registerFunction("toggle_theme", lua_toggleTheme);
 
+    registerFunction("highlight_word", lua_highlightWord);
+    registerFunction("unhighlight_word", lua_unhighlightWord);
+    registerFunction("clear_highlight_words", lua_clearHighlightWords);
+
     lua_setglobal(m_lua, "editor");
 
     lua_newtable(m_lua);
@@ -172,6 +370,59 @@ void LuaBridge::emitEvent(const QString &eventName, const QVariantList &args)
         return;
     }
 
+    if (m_eventsDeferred) {
+        // only the latest state matters for these, and they fire on every keystroke
+        if (eventName == "text_changed" || eventName == "cursor_moved") {
+            for (int i = m_deferredEvents.size() - 1; i >= 0; --i) {
+                if (m_deferredEvents[i].first == eventName) {
+                    m_deferredEvents.removeAt(i);
+                }
+            }
+        }
+
+        const int maxDeferredEvents = 256;
+        if (m_deferredEvents.size() >= maxDeferredEvents) {
+            m_deferredEvents.removeFirst();
+        }
+
+        m_deferredEvents.append(qMakePair(eventName, args));
+        return;
+    }
+
+    dispatchEvent(eventName, args);
+}
+
+void LuaBridge::setEventsDeferred(bool deferred)
+{
+    if (m_eventsDeferred == deferred) {
+        return;
+    }
+
+    m_eventsDeferred = deferred;
+    if (deferred) {
+        return;
+    }
+
+    const QList<QPair<QString, QVariantList>> events = m_deferredEvents;
+    m_deferredEvents.clear();
+
+    DEBUG_LOG_LUA("Replaying" << events.size() << "deferred events");
+    for (const auto &event : events) {
+        dispatchEvent(event.first, event.second);
+    }
+}
+
+bool LuaBridge::eventsDeferred() const
+{
+    return m_eventsDeferred;
+}
+
+void LuaBridge::dispatchEvent(const QString &eventName, const QVariantList &args)
+{
+    if (m_pluginManager) {
+        m_pluginManager->activateForEvent(eventName);
+    }
+
     QStringList handlers = m_eventHandlers.value(eventName);
 
     for (const QString &handlerFunction : handlers) {
@@ -697,6 +948,50 @@ QMap<QString, QString> LuaBridge::getBasicHighlighterColors()
     return basicHighlighterColors;
 }
 
+QMap<QString, QString> LuaBridge::getHighlightWords()
+{
+    QMap<QString, QString> highlightWords;
+
+    if (!m_lua) {
+        return highlightWords;
+    }
+
+    lua_getglobal(m_lua, "config");
+    if (!lua_istable(m_lua, -1)) {
+        lua_pop(m_lua, 1);
+        return highlightWords;
+    }
+
+    lua_pushstring(m_lua, "highlight");
+    lua_gettable(m_lua, -2);
+    if (!lua_istable(m_lua, -1)) {
+        lua_pop(m_lua, 2);
+        return highlightWords;
+    }
+
+    lua_pushstring(m_lua, "words");
+    lua_gettable(m_lua, -2);
+    if (!lua_istable(m_lua, -1)) {
+        lua_pop(m_lua, 3);
+        DEBUG_LOG_LUA("Highlight words table not found in configuration");
+        return highlightWords;
+    }
+
+    lua_pushnil(m_lua);
+    while (lua_next(m_lua, -2) != 0) {
+        if (lua_type(m_lua, -2) == LUA_TSTRING && lua_isstring(m_lua, -1)) {
+            QString word = QString::fromUtf8(lua_tostring(m_lua, -2));
+            QString color = QString::fromUtf8(lua_tostring(m_lua, -1));
+            highlightWords[word] = color;
+        }
+        lua_pop(m_lua, 1);
+    }
+
+    lua_pop(m_lua, 3);
+
+    return highlightWords;
+}
+
 void LuaBridge::setEditorText(const QString &text)
 {
     DEBUG_LOG_LUA("LuaBridge::setEditorText emitting signal with text:" << text);
@@ -1073,7 +1368,44 @@ int LuaBridge::lua_toggleTheme(lua_State *L)
         return 0;
     }
 
+    if (g_bridge->m_pluginManager) {
+        g_bridge->m_pluginManager->activateForCommand("toggle_theme");
+    }
+
     g_bridge->executeString("toggle_theme()");
 
     return 0;
-}
\ No newline at end of file
+}
+
+int LuaBridge::lua_highlightWord(lua_State *L)
+{
+    if (!g_bridge) {
+        return 0;
+    }
+
+    const char *word = luaL_checkstring(L, 1);
+    const char *color = luaL_optstring(L, 2, "");
+    emit g_bridge->highlightWordRequested(QString::fromUtf8(word), QString::fromUtf8(color));
+    return 0;
+}
+
+int LuaBridge::lua_unhighlightWord(lua_State *L)
+{
+    if (!g_bridge) {
+        return 0;
+    }
+
+    const char *word = luaL_checkstring(L, 1);
+    emit g_bridge->highlightWordRemovalRequested(QString::fromUtf8(word));
+    return 0;
+}
+
+int LuaBridge::lua_clearHighlightWords(lua_State *L)
+{
+    Q_UNUSED(L)
+
+    if (g_bridge) {
+        emit g_bridge->highlightWordsClearRequested();
+    }
+    return 0;
+}
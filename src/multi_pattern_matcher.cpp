@@ -0,0 +1,187 @@
+// aho-corasick multi pattern matcher
+// builds a trie over character classes, fills in failure transitions breadth
+// first and scans text with a single table lookup per code unit
+
+#include "multi_pattern_matcher.h"
+#include "debug_log.h"
+#include <QChar>
+#include <algorithm>
+
+namespace {
+
+// states x classes; past this the table costs more memory than it is worth
+const qint64 kMaxTableEntries = 16 * 1024 * 1024;
+
+inline ushort foldUnit(ushort c, bool caseSensitive)
+{
+    return caseSensitive ? c : QChar(c).toCaseFolded().unicode();
+}
+
+}
+
+MultiPatternMatcher::MultiPatternMatcher()
+    : m_classCount(1)
+{
+}
+
+void MultiPatternMatcher::clear()
+{
+    m_classes.clear();
+    m_classCount = 1;
+    m_transitions.clear();
+    m_output.clear();
+    m_outputLink.clear();
+    m_lengths.clear();
+}
+
+int MultiPatternMatcher::stateCount() const
+{
+    return m_output.size();
+}
+
+bool MultiPatternMatcher::build(const QStringList &patterns, bool caseSensitive)
+{
+    clear();
+
+    // classes for every unit the patterns use; case insensitive patterns use
+    // the folded unit, and every unit folding to it shares its class
+    QVector<quint16> folded(0x10000, 0);
+    int classCount = 1;
+    int trieSize = 1;
+    for (const QString &pattern : patterns) {
+        for (QChar c : pattern) {
+            ushort unit = foldUnit(c.unicode(), caseSensitive);
+            if (!folded[unit]) {
+                folded[unit] = quint16(classCount++);
+            }
+        }
+        trieSize += pattern.size();
+    }
+
+    if (qint64(trieSize) * classCount > kMaxTableEntries) {
+        LOG_WARNING("Too many highlight patterns for the matcher:" << patterns.size() << "patterns,"
+                    << classCount << "distinct characters");
+        return false;
+    }
+
+    m_classCount = classCount;
+    m_classes.resize(0x10000);
+    for (int unit = 0; unit < 0x10000; ++unit) {
+        m_classes[unit] = folded[foldUnit(ushort(unit), caseSensitive)];
+    }
+
+    // trie, with -1 for missing edges
+    m_transitions.fill(-1, m_classCount);
+    m_output.append(-1);
+
+    for (const QString &pattern : patterns) {
+        const int index = m_lengths.size();
+        m_lengths.append(pattern.size());
+        if (pattern.isEmpty()) {
+            continue;
+        }
+
+        int state = 0;
+        for (QChar c : pattern) {
+            const int cls = m_classes.at(c.unicode());
+            int next = m_transitions.at(state * m_classCount + cls);
+            if (next < 0) {
+                next = m_output.size();
+                m_output.append(-1);
+                m_transitions.resize(m_transitions.size() + m_classCount);
+                std::fill(m_transitions.end() - m_classCount, m_transitions.end(), -1);
+                m_transitions[state * m_classCount + cls] = next;
+            }
+            state = next;
+        }
+        // a repeated pattern keeps its first index
+        if (m_output.at(state) < 0) {
+            m_output[state] = index;
+        }
+    }
+
+    // breadth first: missing edges borrow the failure state's edge
+    const int states = m_output.size();
+    QVector<qint32> failure(states, 0);
+    m_outputLink.fill(0, states);
+
+    QVector<qint32> queue;
+    queue.reserve(states);
+    for (int cls = 0; cls < m_classCount; ++cls) {
+        qint32 &next = m_transitions[cls];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.append(next);
+        }
+    }
+
+    for (int head = 0; head < queue.size(); ++head) {
+        const int state = queue.at(head);
+        const int fail = failure.at(state);
+        m_outputLink[state] = m_output.at(fail) >= 0 ? fail : m_outputLink.at(fail);
+
+        for (int cls = 0; cls < m_classCount; ++cls) {
+            qint32 &next = m_transitions[state * m_classCount + cls];
+            const qint32 fallback = m_transitions.at(fail * m_classCount + cls);
+            if (next < 0) {
+                next = fallback;
+            } else {
+                failure[next] = fallback;
+                queue.append(next);
+            }
+        }
+    }
+
+    DEBUG_LOG_EDITOR("Built highlight matcher:" << patterns.size() << "patterns," << states << "states,"
+                     << m_classCount << "classes");
+    return true;
+}
+
+QVector<PatternMatch> MultiPatternMatcher::match(const QString &text) const
+{
+    QVector<PatternMatch> matches;
+    if (isEmpty()) {
+        return matches;
+    }
+
+    const quint16 *classes = m_classes.constData();
+    const qint32 *transitions = m_transitions.constData();
+    const ushort *data = text.utf16();
+    const int size = text.size();
+
+    int state = 0;
+    for (int i = 0; i < size; ++i) {
+        state = transitions[state * m_classCount + classes[data[i]]];
+
+        int output = m_output.at(state) >= 0 ? state : m_outputLink.at(state);
+        while (output > 0) {
+            PatternMatch found;
+            found.pattern = m_output.at(output);
+            found.length = m_lengths.at(found.pattern);
+            found.column = i - found.length + 1;
+            matches.append(found);
+            output = m_outputLink.at(output);
+        }
+    }
+
+    if (matches.size() < 2) {
+        return matches;
+    }
+
+    // leftmost first, longest first, then drop anything overlapping a kept match
+    std::sort(matches.begin(), matches.end(), [](const PatternMatch &a, const PatternMatch &b) {
+        return a.column < b.column || (a.column == b.column && a.length > b.length);
+    });
+
+    int kept = 0;
+    int end = 0;
+    for (const PatternMatch &candidate : matches) {
+        if (candidate.column >= end) {
+            matches[kept++] = candidate;
+            end = candidate.column + candidate.length;
+        }
+    }
+    matches.resize(kept);
+    return matches;
+}
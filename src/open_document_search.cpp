@@ -0,0 +1,339 @@
+// find in open documents
+// each document's lines are snapshotted on the gui thread and searched on
+// the pool; matches are cached per document and reused line by line
+
+#include "open_document_search.h"
+#include "function_task.h"
+#include "debug_log.h"
+#include <QThread>
+#include <KTextEditor/Document>
+#include <KTextEditor/MovingInterface>
+
+namespace {
+
+// lines searched between checks for a newer search
+const int kCancelCheckLines = 1024;
+
+}
+
+OpenDocumentSearch::OpenDocumentSearch(QObject *parent)
+    : QObject(parent)
+    , m_pool(new QThreadPool(this))
+    , m_generation(0)
+    , m_maxHits(20000)
+    , m_nextSerial(0)
+{
+    m_pool->setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+}
+
+OpenDocumentSearch::~OpenDocumentSearch()
+{
+    cancel();
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+int OpenDocumentSearch::start(const QVector<OpenDocument> &documents, const SearchQuery &query)
+{
+    cancel();
+    m_lastError.clear();
+    m_labels.clear();
+
+    if (query.pattern.isEmpty()) {
+        return -1;
+    }
+
+    const SearchPattern pattern(query.pattern, query.regex, query.caseSensitive, query.wholeWord);
+    if (!pattern.isValid()) {
+        m_lastError = pattern.errorString();
+        return -1;
+    }
+
+    QSharedPointer<SearchJob> job(new SearchJob);
+    job->query = query;
+    job->maxHits = m_maxHits;
+    job->generation = m_generation.fetchAndAddOrdered(1) + 1;
+    for (const OpenDocument &open : documents) {
+        if (open.document) {
+            ++job->documentCount;
+        }
+    }
+    // one reference per document and one held until every task is queued
+    job->pending.storeRelease(job->documentCount + 1);
+    m_job = job;
+
+    int cached = 0;
+    for (const OpenDocument &open : documents) {
+        KTextEditor::Document *document = open.document;
+        if (!document) {
+            continue;
+        }
+
+        QString label = open.label;
+        for (int suffix = 2; m_labels.contains(label); ++suffix) {
+            label = QString("%1 (%2)").arg(open.label).arg(suffix);
+        }
+        m_labels.insert(label, document);
+
+        const CacheEntry &entry = cacheEntry(document);
+        auto moving = qobject_cast<KTextEditor::MovingInterface*>(document);
+        const qint64 revision = moving ? moving->revision() : -1;
+        QSharedPointer<const DocumentMatches> previous;
+        if (entry.pattern == pattern) {
+            previous = entry.matches;
+        }
+
+        // untouched since this query last ran: no snapshot, no task
+        if (previous && revision >= 0 && revision == entry.revision) {
+            QVector<SearchHit> hits;
+            collectHits(job.data(), label, *previous, [document](int line) {
+                return document->line(line);
+            }, &hits);
+            if (!hits.isEmpty()) {
+                postHits(job->generation, hits);
+            }
+            finishDocument(job);
+            ++cached;
+            continue;
+        }
+
+        // lines share their storage with the document, so this copies no text
+        const int lineCount = document->lines();
+        QVector<QString> lines;
+        lines.reserve(lineCount);
+        for (int line = 0; line < lineCount; ++line) {
+            lines.append(document->line(line));
+        }
+
+        const quint64 serial = entry.serial;
+        m_pool->start(new FunctionTask([this, job, document, serial, revision, label, lines, previous]() {
+            searchSnapshot(job, document, serial, revision, label, lines, previous);
+        }));
+    }
+
+    DEBUG_LOG_EDITOR("Open document search" << job->generation << "for" << query.pattern << "over"
+                     << job->documentCount << "documents," << cached << "answered from cache");
+
+    finishDocument(job);
+    return job->generation;
+}
+
+void OpenDocumentSearch::cancel()
+{
+    if (m_job) {
+        m_generation.fetchAndAddOrdered(1);
+        m_job.reset();
+    }
+}
+
+bool OpenDocumentSearch::isRunning() const
+{
+    return !m_job.isNull();
+}
+
+void OpenDocumentSearch::setMaxHits(int maxHits)
+{
+    m_maxHits = maxHits;
+}
+
+QString OpenDocumentSearch::lastError() const
+{
+    return m_lastError;
+}
+
+KTextEditor::Document *OpenDocumentSearch::document(const QString &label) const
+{
+    return m_labels.value(label).data();
+}
+
+OpenDocumentSearch::CacheEntry &OpenDocumentSearch::cacheEntry(KTextEditor::Document *document)
+{
+    auto it = m_cache.find(document);
+    if (it != m_cache.end()) {
+        return it.value();
+    }
+
+    CacheEntry entry;
+    entry.serial = ++m_nextSerial;
+    connect(document, &QObject::destroyed, this, [this, document]() {
+        m_cache.remove(document);
+    });
+    return m_cache.insert(document, entry).value();
+}
+
+void OpenDocumentSearch::searchSnapshot(const QSharedPointer<SearchJob> &job, KTextEditor::Document *document,
+                                        quint64 serial, qint64 revision, const QString &label,
+                                        const QVector<QString> &lines,
+                                        const QSharedPointer<const DocumentMatches> &previous)
+{
+    if (!isCurrent(job->generation)) {
+        finishDocument(job);
+        return;
+    }
+
+    const SearchPattern pattern(job->query.pattern, job->query.regex, job->query.caseSensitive,
+                                job->query.wholeWord);
+
+    QSharedPointer<DocumentMatches> matches(new DocumentMatches);
+    matches->lineKeys.reserve(lines.size());
+    matches->lines = lines;
+    matches->firstMatch.reserve(lines.size() + 1);
+
+    // lines that moved since the last run are found by their key
+    QHash<quint64, int> previousLines;
+    bool previousIndexed = false;
+    int reused = 0;
+
+    for (int line = 0; line < lines.size(); ++line) {
+        if (line % kCancelCheckLines == 0 && line > 0 && !isCurrent(job->generation)) {
+            finishDocument(job);
+            return;
+        }
+
+        const QString &text = lines.at(line);
+        const quint64 key = lineKey(text);
+
+        int source = -1;
+        if (previous) {
+            if (line < previous->lineKeys.size() && previous->lineKeys.at(line) == key) {
+                source = line;
+            } else {
+                if (!previousIndexed) {
+                    previousLines.reserve(previous->lineKeys.size());
+                    for (int i = 0; i < previous->lineKeys.size(); ++i) {
+                        previousLines.insert(previous->lineKeys.at(i), i);
+                    }
+                    previousIndexed = true;
+                }
+                source = previousLines.value(key, -1);
+            }
+
+            // keys can collide; a line whose text differs is scanned again
+            if (source >= 0 && previous->lines.at(source) != text) {
+                source = -1;
+            }
+        }
+
+        matches->lineKeys.append(key);
+        matches->firstMatch.append(matches->matches.size());
+
+        if (source >= 0) {
+            const int end = previous->firstMatch.at(source + 1);
+            for (int i = previous->firstMatch.at(source); i < end; ++i) {
+                matches->matches.append(previous->matches.at(i));
+            }
+            ++reused;
+            continue;
+        }
+
+        int length = 0;
+        int column = pattern.indexIn(text, 0, &length);
+        while (column >= 0) {
+            LineMatch match;
+            match.column = column;
+            match.length = length;
+            matches->matches.append(match);
+            column = pattern.indexIn(text, column + length, &length);
+        }
+    }
+    matches->firstMatch.append(matches->matches.size());
+
+    DEBUG_LOG_EDITOR("Searched" << label << ":" << lines.size() - reused << "of" << lines.size() << "lines scanned");
+
+    // the matches stay valid for this revision whether or not the search still runs
+    QSharedPointer<const DocumentMatches> result = matches;
+    QMetaObject::invokeMethod(this, [this, document, serial, pattern, revision, result]() {
+        storeMatches(document, serial, pattern, revision, result);
+    }, Qt::QueuedConnection);
+
+    if (isCurrent(job->generation)) {
+        QVector<SearchHit> hits;
+        collectHits(job.data(), label, *result, [&lines](int line) {
+            return lines.at(line);
+        }, &hits);
+        if (!hits.isEmpty()) {
+            postHits(job->generation, hits);
+        }
+    }
+
+    finishDocument(job);
+}
+
+void OpenDocumentSearch::storeMatches(KTextEditor::Document *document, quint64 serial, const SearchPattern &pattern,
+                                      qint64 revision, const QSharedPointer<const DocumentMatches> &matches)
+{
+    auto it = m_cache.find(document);
+    if (it == m_cache.end() || it->serial != serial) {
+        return;
+    }
+
+    // a slower task for an older revision must not replace newer matches
+    if (it->pattern == pattern && it->matches && it->revision > revision) {
+        return;
+    }
+
+    it->pattern = pattern;
+    it->revision = revision;
+    it->matches = matches;
+}
+
+void OpenDocumentSearch::collectHits(SearchJob *job, const QString &label, const DocumentMatches &matches,
+                                     const std::function<QString(int)> &lineText, QVector<SearchHit> *hits)
+{
+    const int lineCount = matches.lineKeys.size();
+    for (int line = 0; line < lineCount; ++line) {
+        const int first = matches.firstMatch.at(line);
+        const int end = matches.firstMatch.at(line + 1);
+        if (first == end) {
+            continue;
+        }
+
+        const QString text = lineText(line);
+        for (int i = first; i < end; ++i) {
+            if (job->hitCount.fetchAndAddRelaxed(1) >= job->maxHits) {
+                return;
+            }
+            const LineMatch &match = matches.matches.at(i);
+            hits->append(ProjectSearch::makeHit(label, text, line + 1, match.column, match.length));
+        }
+    }
+}
+
+void OpenDocumentSearch::finishDocument(const QSharedPointer<SearchJob> &job)
+{
+    if (job->pending.deref()) {
+        return;
+    }
+
+    const int generation = job->generation;
+    const int hitCount = qMin(job->hitCount.loadAcquire(), job->maxHits);
+    const int documentCount = job->documentCount;
+
+    QMetaObject::invokeMethod(this, [this, generation, hitCount, documentCount]() {
+        if (!isCurrent(generation)) {
+            return;
+        }
+        m_job.reset();
+        emit finished(generation, hitCount, documentCount);
+    }, Qt::QueuedConnection);
+}
+
+void OpenDocumentSearch::postHits(int generation, const QVector<SearchHit> &hits)
+{
+    QMetaObject::invokeMethod(this, [this, generation, hits]() {
+        if (isCurrent(generation)) {
+            emit hitsFound(generation, hits);
+        }
+    }, Qt::QueuedConnection);
+}
+
+bool OpenDocumentSearch::isCurrent(int generation) const
+{
+    return m_generation.loadAcquire() == generation;
+}
+
+quint64 OpenDocumentSearch::lineKey(const QString &line)
+{
+    // the length rides along to make collisions rare; callers still compare the text
+    return (quint64(qHash(line)) << 32) | quint32(line.size());
+}
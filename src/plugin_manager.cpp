@@ -1,14 +1,24 @@
 #include "plugin_manager.h"
+#include "function_task.h"
 #include "lua_bridge.h"
 #include "debug_log.h"
+#include <QFile>
 #include <QFileInfo>
 #include <QDirIterator>
 #include <QCoreApplication>
+#include <QRegularExpression>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
 
 PluginManager::PluginManager(LuaBridge *luaBridge, QObject *parent)
     : QObject(parent)
     , m_luaBridge(luaBridge)
     , m_cleanupTimer(new QTimer(this))
+    , m_watcher(new QFileSystemWatcher(this))
+    , m_reloadTimer(new QTimer(this))
+    , m_pool(new QThreadPool(this))
+    , m_scanGeneration(0)
 {
     if (!m_luaBridge) {
         LOG_ERROR("PluginManager: LuaBridge is null");
@@ -19,13 +29,28 @@ PluginManager::PluginManager(LuaBridge *luaBridge, QObject *parent)
     m_cleanupTimer->setInterval(5000); 
     connect(m_cleanupTimer, &QTimer::timeout, this, &PluginManager::cleanupFailedPlugins);
 
+    // editors save in bursts (truncate, write, rename), so changes are coalesced
+    m_reloadTimer->setSingleShot(true);
+    m_reloadTimer->setInterval(200);
+    connect(m_reloadTimer, &QTimer::timeout, this, &PluginManager::processChangedPlugins);
+
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &PluginManager::onPluginFileChanged);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &PluginManager::onPluginDirectoryChanged);
+
+    // reading and compiling is mostly waiting on the disk
+    m_pool->setMaxThreadCount(qMax(4, QThread::idealThreadCount() * 2));
+
     DEBUG_LOG_PLUGIN("PluginManager initialized");
 }
 
 PluginManager::~PluginManager()
 {
+    m_scanGeneration.fetchAndAddOrdered(1);
+    m_pool->clear();
+    m_pool->waitForDone();
 
-    for (const QString &pluginName : m_loadedPlugins) {
+    const QStringList pluginNames = m_environments.keys();
+    for (const QString &pluginName : pluginNames) {
         cleanupPlugin(pluginName);
     }
 
@@ -46,8 +71,35 @@ bool PluginManager::loadPlugins(const QString &pluginDir)
     DEBUG_LOG_PLUGIN("Loading plugins from directory:" << pluginDir);
 
     scanPluginDirectory(pluginDir);
+    return true;
+}
 
-    int loadedCount = 0;
+void PluginManager::finishLoading(int generation, const QVector<PluginSource> &prepared)
+{
+    // a newer load or reload started meanwhile
+    if (generation != m_scanGeneration.loadAcquire()) {
+        return;
+    }
+
+    for (const PluginSource &source : prepared) {
+        if (!source.valid) {
+            continue;
+        }
+
+        m_availablePlugins.append(source.path);
+        m_pluginSources[source.manifest.name] = source;
+        DEBUG_LOG_PLUGIN("Found plugin file:" << source.path);
+
+        if (!source.compileError.isEmpty()) {
+            DEBUG_LOG_PLUGIN("Plugin precompilation failed, will report on load:" << source.compileError);
+        }
+    }
+
+    DEBUG_LOG_PLUGIN("Scanned plugin directory, found" << m_availablePlugins.size() << "plugin files");
+
+    bool lazyLoad = m_luaBridge ? m_luaBridge->getConfigBool("plugins.lazy_load", true) : true;
+
+    QStringList enabledPlugins;
     for (const QString &pluginPath : m_availablePlugins) {
         QString pluginName = getPluginNameFromPath(pluginPath);
 
@@ -56,13 +108,38 @@ bool PluginManager::loadPlugins(const QString &pluginDir)
             continue;
         }
 
-        if (loadPlugin(pluginPath)) {
-            loadedCount++;
+        enabledPlugins.append(pluginName);
+    }
+
+    // plugins share the main lua state, so each wave initializes in name order;
+    // the concurrent part of startup is the scan in scanPluginDirectory
+    const QList<QStringList> waves = buildInitializationWaves(enabledPlugins);
+
+    int loadedCount = 0;
+    for (int wave = 0; wave < waves.size(); ++wave) {
+        DEBUG_LOG_PLUGIN("Initialization wave" << wave << ":" << waves[wave]);
+
+        for (const QString &pluginName : waves[wave]) {
+            const PluginManifest &manifest = m_pluginSources[pluginName].manifest;
+
+            if (lazyLoad && manifest.isLazy()) {
+                m_pendingPlugins[pluginName] = manifest.path;
+                registerActivationTriggers(manifest);
+                DEBUG_LOG_PLUGIN("Plugin deferred until activation:" << pluginName);
+                continue;
+            }
+
+            if (loadPlugin(manifest.path)) {
+                loadedCount++;
+            }
         }
     }
 
-    LOG_INFO("Loaded" << loadedCount << "plugins out of" << m_availablePlugins.size() << "available");
-    return loadedCount > 0 || m_availablePlugins.isEmpty();
+    watchPluginDirectory();
+
+    LOG_INFO("Loaded" << loadedCount << "plugins out of" << m_availablePlugins.size() << "available,"
+             << m_pendingPlugins.size() << "awaiting activation");
+    emit pluginsLoaded(loadedCount);
 }
 
 bool PluginManager::loadPlugin(const QString &pluginPath)
@@ -74,11 +151,20 @@ bool PluginManager::loadPlugin(const QString &pluginPath)
 
     QString pluginName = getPluginNameFromPath(pluginPath);
 
+    if (m_pendingPlugins.remove(pluginName) > 0) {
+        clearActivationTriggers(pluginName);
+    }
+
     if (m_loadedPlugins.contains(pluginName)) {
         DEBUG_LOG_PLUGIN("Plugin already loaded:" << pluginName);
         return true;
     }
 
+    if (!loadDependencies(pluginName)) {
+        setPluginError(pluginName, m_lastError);
+        return false;
+    }
+
     bool errorRecovery = true;
     if (m_luaBridge) {
         errorRecovery = m_luaBridge->getConfigBool("plugins.error_recovery", true);
@@ -133,11 +219,24 @@ bool PluginManager::loadPlugin(const QString &pluginPath)
 
 void PluginManager::unloadPlugin(const QString &pluginName)
 {
+    if (m_pendingPlugins.remove(pluginName) > 0) {
+        clearActivationTriggers(pluginName);
+        DEBUG_LOG_PLUGIN("Pending plugin dropped:" << pluginName);
+        return;
+    }
+
     if (!m_loadedPlugins.contains(pluginName)) {
         DEBUG_LOG_PLUGIN("Plugin not loaded:" << pluginName);
         return;
     }
 
+    // dependents go first so their cleanup can still reach this plugin
+    const QStringList dependents = loadedDependents(pluginName);
+    for (const QString &dependent : dependents) {
+        DEBUG_LOG_PLUGIN("Unloading" << dependent << "which depends on" << pluginName);
+        unloadPlugin(dependent);
+    }
+
     if (cleanupPlugin(pluginName)) {
         m_loadedPlugins.removeAll(pluginName);
         DEBUG_LOG_PLUGIN("Plugin unloaded successfully:" << pluginName);
@@ -158,10 +257,117 @@ void PluginManager::reloadPlugins()
     }
 
     m_availablePlugins.clear();
+    m_pluginSources.clear();
+    m_pendingPlugins.clear();
+    m_eventTriggers.clear();
+    m_commandTriggers.clear();
+    m_fileTypeTriggers.clear();
+
+    // listeners wait for pluginsLoaded even when there is nothing to scan
+    if (m_pluginDirectory.isEmpty() || !loadPlugins(m_pluginDirectory)) {
+        emit pluginsLoaded(0);
+    }
+}
 
-    if (!m_pluginDirectory.isEmpty()) {
-        loadPlugins(m_pluginDirectory);
+bool PluginManager::reloadPlugin(const QString &pluginName)
+{
+    if (!m_luaBridge) {
+        setError("LuaBridge not available");
+        return false;
     }
+
+    QString pluginPath = findPluginPath(pluginName);
+    if (pluginPath.isEmpty()) {
+        setError(QString("Plugin not found: %1").arg(pluginName));
+        return false;
+    }
+
+    PluginSource source = preparePlugin(pluginPath);
+    if (!source.valid) {
+        unloadPlugin(pluginName);
+        m_availablePlugins.removeAll(pluginPath);
+        m_pluginSources.remove(pluginName);
+        return false;
+    }
+
+    if (!m_availablePlugins.contains(pluginPath)) {
+        m_availablePlugins.append(pluginPath);
+    }
+    m_pluginSources[pluginName] = source;
+
+    if (!isPluginEnabled(pluginName)) {
+        return true;
+    }
+
+    bool lazyLoad = m_luaBridge->getConfigBool("plugins.lazy_load", true);
+
+    if (!m_loadedPlugins.contains(pluginName)) {
+        clearActivationTriggers(pluginName);
+        if (lazyLoad && source.manifest.isLazy()) {
+            m_pendingPlugins[pluginName] = pluginPath;
+            registerActivationTriggers(source.manifest);
+            DEBUG_LOG_PLUGIN("Pending plugin refreshed:" << pluginName);
+            return true;
+        }
+        return loadPlugin(pluginPath);
+    }
+
+    // plugins implementing save_state/restore_state hand their live state over
+    // instead of going through cleanup/initialize, so timers and caches survive.
+    // the old instance stays alive until the new file has run and restored it
+    LuaPluginEnvironment previous = m_environments.take(pluginName);
+    int stateRef = LUA_NOREF;
+    bool handedOff = false;
+
+    if (previous.saveState != LUA_NOREF && previous.restoreState != LUA_NOREF) {
+        handedOff = m_luaBridge->callPluginFunction(previous.saveState,
+                                                    QString("Saving state of plugin %1").arg(pluginName),
+                                                    LUA_NOREF, &stateRef);
+    }
+
+    m_loadedPlugins.removeAll(pluginName);
+
+    auto retirePrevious = [this, &pluginName, &previous]() {
+        if (previous.cleanup != LUA_NOREF
+            && !m_luaBridge->callPluginFunction(previous.cleanup, QString("Cleaning up plugin %1").arg(pluginName))) {
+            DEBUG_LOG_PLUGIN("Plugin cleanup warning:" << m_luaBridge->lastError());
+        }
+        m_luaBridge->releasePluginEnvironment(pluginName, &previous);
+    };
+
+    if (!executePluginFile(pluginPath)) {
+        m_luaBridge->releaseReference(stateRef);
+        retirePrevious();
+        setPluginError(pluginName, QString("Plugin reload failed: %1").arg(m_lastError));
+        return false;
+    }
+
+    int restoreState = m_environments.value(pluginName).restoreState;
+    bool restored = handedOff && restoreState != LUA_NOREF
+        && m_luaBridge->callPluginFunction(restoreState, QString("Restoring state of plugin %1").arg(pluginName),
+                                           stateRef);
+    m_luaBridge->releaseReference(stateRef);
+
+    // nothing took the state over, so the old instance still owns its timers and callbacks
+    if (restored) {
+        m_luaBridge->releasePluginEnvironment(pluginName, &previous);
+    } else {
+        retirePrevious();
+    }
+
+    // the new environment is live either way, so unloading must still reach it
+    m_loadedPlugins.append(pluginName);
+
+    if (!restored && !initializePlugin(pluginName)) {
+        setPluginError(pluginName, QString("Plugin initialization failed: %1").arg(m_lastError));
+        return false;
+    }
+
+    clearPluginError(pluginName);
+
+    LOG_INFO("Plugin reloaded:" << pluginName << (restored ? "(state restored)" : ""));
+    emit pluginReloaded(pluginName);
+    return true;
 }
 
 QStringList PluginManager::loadedPlugins() const
@@ -183,6 +389,31 @@ bool PluginManager::isPluginLoaded(const QString &pluginName) const
     return m_loadedPlugins.contains(pluginName);
 }
 
+bool PluginManager::isPluginPending(const QString &pluginName) const
+{
+    return m_pendingPlugins.contains(pluginName);
+}
+
+QStringList PluginManager::pendingPlugins() const
+{
+    return m_pendingPlugins.keys();
+}
+
+void PluginManager::activateForEvent(const QString &eventName)
+{
+    activateTriggered(m_eventTriggers, eventName);
+}
+
+void PluginManager::activateForCommand(const QString &command)
+{
+    activateTriggered(m_commandTriggers, command);
+}
+
+void PluginManager::activateForFileType(const QString &fileType)
+{
+    activateTriggered(m_fileTypeTriggers, fileType.toLower());
+}
+
 bool PluginManager::isPluginEnabled(const QString &pluginName) const
 {
 
@@ -249,20 +480,147 @@ void PluginManager::cleanupFailedPlugins()
     }
 }
 
-void PluginManager::scanPluginDirectory(const QString &dir)
+void PluginManager::onPluginFileChanged(const QString &path)
 {
-    m_availablePlugins.clear();
+    m_changedPaths.insert(path);
+    m_reloadTimer->start();
+}
 
-    QDirIterator iterator(dir, QStringList() << "*.lua", QDir::Files);
+void PluginManager::onPluginDirectoryChanged(const QString &path)
+{
+    QDirIterator iterator(path, QStringList() << "*.lua", QDir::Files);
     while (iterator.hasNext()) {
         QString filePath = iterator.next();
-        if (isValidPluginFile(filePath)) {
-            m_availablePlugins.append(filePath);
-            DEBUG_LOG_PLUGIN("Found plugin file:" << filePath);
+        if (!m_availablePlugins.contains(filePath)) {
+            m_changedPaths.insert(filePath);
         }
     }
 
-    DEBUG_LOG_PLUGIN("Scanned plugin directory, found" << m_availablePlugins.size() << "plugin files");
+    for (const QString &filePath : m_availablePlugins) {
+        if (!QFileInfo::exists(filePath)) {
+            m_changedPaths.insert(filePath);
+        }
+    }
+
+    if (!m_changedPaths.isEmpty()) {
+        m_reloadTimer->start();
+    }
+}
+
+void PluginManager::processChangedPlugins()
+{
+    const QSet<QString> changedPaths = m_changedPaths;
+    m_changedPaths.clear();
+
+    for (const QString &path : changedPaths) {
+        QString pluginName = getPluginNameFromPath(path);
+
+        if (!QFileInfo::exists(path)) {
+            DEBUG_LOG_PLUGIN("Plugin file removed:" << path);
+            unloadPlugin(pluginName);
+            m_availablePlugins.removeAll(path);
+            m_pluginSources.remove(pluginName);
+            continue;
+        }
+
+        // atomic saves replace the inode, which silently drops the watch
+        if (!m_watcher->files().contains(path)) {
+            m_watcher->addPath(path);
+        }
+
+        DEBUG_LOG_PLUGIN("Plugin file changed, reloading:" << pluginName);
+        reloadPlugin(pluginName);
+    }
+}
+
+void PluginManager::watchPluginDirectory()
+{
+    if (!m_watcher->files().isEmpty()) {
+        m_watcher->removePaths(m_watcher->files());
+    }
+    if (!m_watcher->directories().isEmpty()) {
+        m_watcher->removePaths(m_watcher->directories());
+    }
+
+    if (!m_luaBridge || !m_luaBridge->getConfigBool("plugins.hot_reload", true)) {
+        return;
+    }
+
+    if (!m_pluginDirectory.isEmpty()) {
+        m_watcher->addPath(m_pluginDirectory);
+    }
+    if (!m_availablePlugins.isEmpty()) {
+        m_watcher->addPaths(m_availablePlugins);
+    }
+
+    DEBUG_LOG_PLUGIN("Watching" << m_availablePlugins.size() << "plugin files for changes");
+}
+
+QString PluginManager::findPluginPath(const QString &pluginName) const
+{
+    for (const QString &path : m_availablePlugins) {
+        if (getPluginNameFromPath(path) == pluginName) {
+            return path;
+        }
+    }
+
+    if (!m_pluginDirectory.isEmpty()) {
+        QString candidate = QDir(m_pluginDirectory).filePath(pluginName + ".lua");
+        if (QFileInfo::exists(candidate)) {
+            return candidate;
+        }
+    }
+
+    return QString();
+}
+
+void PluginManager::scanPluginDirectory(const QString &dir)
+{
+    m_availablePlugins.clear();
+    m_pluginSources.clear();
+
+    const int generation = m_scanGeneration.fetchAndAddOrdered(1) + 1;
+
+    // listing, stat, read and compile all run on the pool; each task owns one
+    // slot of the scan, and the last to finish posts the sources back, where
+    // execution in the main lua state happens
+    m_pool->start(new FunctionTask([this, dir, generation]() {
+        QStringList candidates;
+        QDirIterator iterator(dir, QStringList() << "*.lua", QDir::Files);
+        while (iterator.hasNext()) {
+            candidates.append(iterator.next());
+        }
+        candidates.sort();
+
+        QSharedPointer<PluginScan> scan(new PluginScan);
+        scan->generation = generation;
+        scan->candidates = candidates;
+        scan->prepared.resize(candidates.size());
+        scan->pending.storeRelease(candidates.size());
+
+        if (candidates.isEmpty()) {
+            postScan(scan);
+            return;
+        }
+
+        for (int i = 0; i < candidates.size(); ++i) {
+            m_pool->start(new FunctionTask([this, scan, i]() {
+                if (scan->generation == m_scanGeneration.loadAcquire()) {
+                    scan->prepared[i] = preparePlugin(scan->candidates.at(i));
+                }
+                if (!scan->pending.deref()) {
+                    postScan(scan);
+                }
+            }));
+        }
+    }));
+}
+
+void PluginManager::postScan(const QSharedPointer<PluginScan> &scan)
+{
+    QMetaObject::invokeMethod(this, [this, scan]() {
+        finishLoading(scan->generation, scan->prepared);
+    }, Qt::QueuedConnection);
 }
 
 bool PluginManager::isValidPluginFile(const QString &filePath) const
@@ -290,8 +648,275 @@ QString PluginManager::getPluginNameFromPath(const QString &filePath) const
     return fileInfo.baseName();
 }
 
+PluginSource PluginManager::preparePlugin(const QString &pluginPath) const
+{
+    PluginSource source;
+    source.path = pluginPath;
+    source.manifest.name = getPluginNameFromPath(pluginPath);
+    source.manifest.path = pluginPath;
+
+    if (!isValidPluginFile(pluginPath)) {
+        return source;
+    }
+
+    QFile file(pluginPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return source;
+    }
+
+    QByteArray contents = file.readAll();
+    source.valid = true;
+    source.manifest = parseManifest(pluginPath, contents);
+
+    QString error;
+    if (!LuaBridge::compileChunk(contents, pluginPath, &source.bytecode, &error)) {
+        source.bytecode.clear();
+        source.compileError = error;
+    }
+
+    return source;
+}
+
+PluginManifest PluginManager::parseManifest(const QString &pluginPath, const QByteArray &source) const
+{
+    PluginManifest manifest;
+    manifest.name = getPluginNameFromPath(pluginPath);
+    manifest.path = pluginPath;
+
+    // only the leading comment block is inspected; called from loader threads,
+    // so the expressions are kept local rather than shared
+    const QRegularExpression directive("^--\\s*@(\\w+)\\s*:?\\s*(.*)$");
+    const QRegularExpression separator("[,\\s]+");
+
+    const int maxHeaderLines = 64;
+    int lineStart = 0;
+    for (int lineNumber = 0; lineNumber < maxHeaderLines && lineStart < source.size(); ++lineNumber) {
+        int lineEnd = source.indexOf('\n', lineStart);
+        if (lineEnd < 0) {
+            lineEnd = source.size();
+        }
+
+        QString line = QString::fromUtf8(source.constData() + lineStart, lineEnd - lineStart).trimmed();
+        lineStart = lineEnd + 1;
+
+        if (line.isEmpty()) {
+            continue;
+        }
+        if (!line.startsWith("--")) {
+            break;
+        }
+
+        QRegularExpressionMatch match = directive.match(line);
+        if (!match.hasMatch()) {
+            continue;
+        }
+
+        QString key = match.captured(1).toLower();
+        QStringList values = match.captured(2).split(separator, QString::SkipEmptyParts);
+
+        if (key == "events") {
+            manifest.events += values;
+        } else if (key == "commands") {
+            manifest.commands += values;
+        } else if (key == "filetypes") {
+            for (const QString &value : values) {
+                manifest.fileTypes.append(value.toLower());
+            }
+        } else if (key == "depends") {
+            manifest.dependencies += values;
+        } else if (key == "after") {
+            manifest.loadAfter += values;
+        } else {
+            DEBUG_LOG_PLUGIN("Unknown manifest key in" << manifest.name << ":" << key);
+        }
+    }
+
+    return manifest;
+}
+
+void PluginManager::registerActivationTriggers(const PluginManifest &manifest)
+{
+    for (const QString &eventName : manifest.events) {
+        m_eventTriggers.insert(eventName, manifest.name);
+    }
+    for (const QString &command : manifest.commands) {
+        m_commandTriggers.insert(command, manifest.name);
+    }
+    for (const QString &fileType : manifest.fileTypes) {
+        m_fileTypeTriggers.insert(fileType, manifest.name);
+    }
+}
+
+void PluginManager::clearActivationTriggers(const QString &pluginName)
+{
+    auto removeFrom = [&pluginName](QMultiHash<QString, QString> &triggers) {
+        for (auto it = triggers.begin(); it != triggers.end();) {
+            if (it.value() == pluginName) {
+                it = triggers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    };
+
+    removeFrom(m_eventTriggers);
+    removeFrom(m_commandTriggers);
+    removeFrom(m_fileTypeTriggers);
+}
+
+void PluginManager::activateTriggered(const QMultiHash<QString, QString> &triggers, const QString &key)
+{
+    if (m_pendingPlugins.isEmpty()) {
+        return;
+    }
+
+    QStringList pluginNames = triggers.values(key);
+    pluginNames.sort();
+    for (const QString &pluginName : pluginNames) {
+        if (!m_pendingPlugins.contains(pluginName)) {
+            continue;
+        }
+
+        // loadPlugin drops the stub first so triggers fired during initialization do not recurse
+        QString pluginPath = m_pendingPlugins.value(pluginName);
+
+        DEBUG_LOG_PLUGIN("Activating plugin" << pluginName << "on trigger:" << key);
+        loadPlugin(pluginPath);
+    }
+}
+
+QList<QStringList> PluginManager::buildInitializationWaves(const QStringList &pluginNames)
+{
+    QSet<QString> candidates;
+    for (const QString &pluginName : pluginNames) {
+        candidates.insert(pluginName);
+    }
+
+    QMap<QString, int> inDegree;
+    QMap<QString, QStringList> dependents;
+    for (const QString &pluginName : pluginNames) {
+        inDegree[pluginName] = 0;
+    }
+
+    for (const QString &pluginName : pluginNames) {
+        const PluginManifest &manifest = m_pluginSources[pluginName].manifest;
+
+        QStringList edges = manifest.dependencies + manifest.loadAfter;
+        edges.removeDuplicates();
+
+        for (const QString &dependency : edges) {
+            // missing hard dependencies are reported by loadDependencies
+            if (dependency == pluginName || !candidates.contains(dependency)) {
+                continue;
+            }
+            inDegree[pluginName]++;
+            dependents[dependency].append(pluginName);
+        }
+    }
+
+    QList<QStringList> waves;
+    QStringList ready;
+    for (auto it = inDegree.constBegin(); it != inDegree.constEnd(); ++it) {
+        if (it.value() == 0) {
+            ready.append(it.key());
+        }
+    }
+
+    int placed = 0;
+    while (!ready.isEmpty()) {
+        ready.sort();
+        waves.append(ready);
+        placed += ready.size();
+
+        QStringList next;
+        for (const QString &pluginName : ready) {
+            for (const QString &dependent : dependents.value(pluginName)) {
+                if (--inDegree[dependent] == 0) {
+                    next.append(dependent);
+                }
+            }
+        }
+        ready = next;
+    }
+
+    if (placed < pluginNames.size()) {
+        QStringList cycle;
+        for (auto it = inDegree.constBegin(); it != inDegree.constEnd(); ++it) {
+            if (it.value() > 0) {
+                cycle.append(it.key());
+            }
+        }
+
+        for (const QString &pluginName : cycle) {
+            setPluginError(pluginName, QString("Dependency cycle between plugins: %1").arg(cycle.join(", ")));
+        }
+        LOG_ERROR("Plugin dependency cycle, not loading:" << cycle);
+    }
+
+    return waves;
+}
+
+bool PluginManager::loadDependencies(const QString &pluginName)
+{
+    const QStringList dependencies = m_pluginSources.value(pluginName).manifest.dependencies;
+    if (dependencies.isEmpty()) {
+        return true;
+    }
+
+    if (m_resolvingPlugins.contains(pluginName)) {
+        setError(QString("Dependency cycle through plugin: %1").arg(pluginName));
+        return false;
+    }
+
+    m_resolvingPlugins.insert(pluginName);
+
+    bool success = true;
+    for (const QString &dependency : dependencies) {
+        if (m_loadedPlugins.contains(dependency)) {
+            continue;
+        }
+
+        QString dependencyPath = findPluginPath(dependency);
+        if (dependencyPath.isEmpty() || !isPluginEnabled(dependency)) {
+            setError(QString("Missing dependency: %1").arg(dependency));
+            success = false;
+            break;
+        }
+
+        // pending dependencies are activated here, ahead of the plugin needing them
+        DEBUG_LOG_PLUGIN("Loading dependency" << dependency << "for" << pluginName);
+        if (!loadPlugin(dependencyPath)) {
+            setError(QString("Dependency failed to load: %1").arg(dependency));
+            success = false;
+            break;
+        }
+    }
+
+    m_resolvingPlugins.remove(pluginName);
+    return success;
+}
+
+QStringList PluginManager::loadedDependents(const QString &pluginName) const
+{
+    QStringList dependents;
+    for (const QString &loaded : m_loadedPlugins) {
+        if (m_pluginSources.value(loaded).manifest.dependencies.contains(pluginName)) {
+            dependents.append(loaded);
+        }
+    }
+    return dependents;
+}
+
 bool PluginManager::validatePlugin(const QString &pluginPath)
 {
+    auto it = m_pluginSources.constFind(getPluginNameFromPath(pluginPath));
+    if (it != m_pluginSources.constEnd() && it->path == pluginPath) {
+        if (!it->valid) {
+            setError("Invalid plugin file");
+        }
+        return it->valid;
+    }
+
     if (!isValidPluginFile(pluginPath)) {
         setError("Invalid plugin file");
         return false;
@@ -307,11 +932,39 @@ bool PluginManager::executePluginFile(const QString &pluginPath)
         return false;
     }
 
-    if (!m_luaBridge->executeFile(pluginPath)) {
+    QString pluginName = getPluginNameFromPath(pluginPath);
+    QByteArray chunk;
+
+    auto it = m_pluginSources.constFind(pluginName);
+    if (it != m_pluginSources.constEnd() && it->path == pluginPath) {
+        if (!it->compileError.isEmpty()) {
+            setError(QString("Failed to compile plugin file: %1").arg(it->compileError));
+            return false;
+        }
+        chunk = it->bytecode;
+    }
+
+    if (chunk.isEmpty()) {
+        QFile file(pluginPath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            setError(QString("Failed to read plugin file: %1").arg(pluginPath));
+            return false;
+        }
+        chunk = file.readAll();
+    }
+
+    if (m_environments.contains(pluginName)) {
+        m_luaBridge->releasePluginEnvironment(pluginName, &m_environments[pluginName]);
+    }
+
+    LuaPluginEnvironment environment;
+    if (!m_luaBridge->loadPluginEnvironment(chunk, pluginPath, pluginName, &environment)) {
+        m_environments.remove(pluginName);
         setError(QString("Failed to execute plugin file: %1").arg(m_luaBridge->lastError()));
         return false;
     }
 
+    m_environments[pluginName] = environment;
     return true;
 }
 
@@ -322,16 +975,12 @@ bool PluginManager::initializePlugin(const QString &pluginName)
         return false;
     }
 
-    QString initCode = QString(
-        "if %1 and type(%1.initialize) == 'function' then "
-        "  local success, err = pcall(%1.initialize) "
-        "  if not success then "
-        "    error('Plugin initialization failed: ' .. tostring(err)) "
-        "  end "
-        "end"
-    ).arg(pluginName);
+    int initialize = m_environments.value(pluginName).initialize;
+    if (initialize == LUA_NOREF) {
+        return true;
+    }
 
-    if (!m_luaBridge->executeString(initCode)) {
+    if (!m_luaBridge->callPluginFunction(initialize, QString("Initializing plugin %1").arg(pluginName))) {
         setError(QString("Plugin initialization failed: %1").arg(m_luaBridge->lastError()));
         return false;
     }
@@ -347,23 +996,20 @@ bool PluginManager::cleanupPlugin(const QString &pluginName)
         return false;
     }
 
-    QString cleanupCode = QString(
-        "if %1 and type(%1.cleanup) == 'function' then "
-        "  local success, err = pcall(%1.cleanup) "
-        "  if not success then "
-        "    if editor and editor.debug_log then "
-        "      editor.debug_log('Plugin cleanup warning: ' .. tostring(err)) "
-        "    end "
-        "  end "
-        "end "
-        "%1 = nil"
-    ).arg(pluginName);
-
-    if (!m_luaBridge->executeString(cleanupCode)) {
-        setError(QString("Plugin cleanup failed: %1").arg(m_luaBridge->lastError()));
-        return false;
+    auto it = m_environments.find(pluginName);
+    if (it == m_environments.end()) {
+        return true;
+    }
+
+    if (it->cleanup != LUA_NOREF
+        && !m_luaBridge->callPluginFunction(it->cleanup, QString("Cleaning up plugin %1").arg(pluginName))) {
+        DEBUG_LOG_PLUGIN("Plugin cleanup warning:" << m_luaBridge->lastError());
     }
 
+    // dropping the environment releases every global the plugin defined
+    m_luaBridge->releasePluginEnvironment(pluginName, &it.value());
+    m_environments.erase(it);
+
     DEBUG_LOG_PLUGIN("Plugin cleaned up:" << pluginName);
     return true;
 }
@@ -0,0 +1,190 @@
+// persistent project file table
+// written after every index walk and loaded on open so the previous
+// listing is usable before the background reconcile finishes
+
+#include "project_cache.h"
+#include "project_indexer.h"
+#include "debug_log.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <cstring>
+
+namespace {
+
+const char kCacheMagic[4] = { 'L', 'P', 'F', 'C' };
+const quint32 kCacheVersion = 2;
+
+struct CacheHeader
+{
+    char magic[4];
+    quint32 version;
+    quint32 flags;
+    quint32 directoryCount;
+    quint32 fileCount;
+    quint32 namePoolLength;
+    quint32 directoryPoolLength;
+    quint32 rootPathLength;
+};
+
+struct CacheDirectory
+{
+    quint32 pathOffset;
+    quint32 pathLength;
+    quint32 firstFile;
+    quint32 reserved;
+    qint64 modified;
+    qint64 rulesModified;
+};
+
+// header, directories, file records, then the utf-16 root path, directory
+// pool and name pool; every section keeps 8 byte alignment
+inline qint64 alignedPool(quint32 length)
+{
+    return (qint64(length) * 2 + 7) & ~qint64(7);
+}
+
+inline qint64 cacheSize(const CacheHeader *header)
+{
+    return sizeof(CacheHeader)
+        + qint64(header->directoryCount) * sizeof(CacheDirectory)
+        + qint64(header->fileCount) * sizeof(ProjectFileRecord)
+        + alignedPool(header->rootPathLength)
+        + alignedPool(header->directoryPoolLength)
+        + alignedPool(header->namePoolLength);
+}
+
+void appendPool(QByteArray *buffer, const QString &text)
+{
+    buffer->append(reinterpret_cast<const char*>(text.utf16()), text.size() * 2);
+    buffer->append(int(alignedPool(text.size()) - text.size() * 2), '\0');
+}
+
+}
+
+QString ProjectCache::cachePathFor(const QString &rootPath)
+{
+    QByteArray key = QCryptographicHash::hash(QDir(rootPath).absolutePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return QDir(cacheDir).filePath(QString("projects/%1.files").arg(QString::fromLatin1(key)));
+}
+
+bool ProjectCache::save(const ProjectFileTable &files, const QString &cachePath, QString *error)
+{
+    QString directoryPool;
+    QVector<CacheDirectory> directories(files.m_directories.size());
+    for (int i = 0; i < files.m_directories.size(); ++i) {
+        const QString &path = files.m_directories.at(i);
+        directories[i].pathOffset = directoryPool.size();
+        directories[i].pathLength = path.size();
+        directories[i].firstFile = files.m_directoryFirstFile.at(i);
+        directories[i].reserved = 0;
+        directories[i].modified = files.m_directoryModified.at(i);
+        directories[i].rulesModified = files.m_directoryRules.at(i);
+        directoryPool.append(path);
+    }
+
+    CacheHeader header;
+    std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.flags = files.m_flags;
+    header.directoryCount = directories.size();
+    header.fileCount = files.m_files.size();
+    header.namePoolLength = files.m_namePool.size();
+    header.directoryPoolLength = directoryPool.size();
+    header.rootPathLength = files.m_rootPath.size();
+
+    QByteArray buffer;
+    buffer.reserve(int(cacheSize(&header)));
+    buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    buffer.append(reinterpret_cast<const char*>(directories.constData()), directories.size() * sizeof(CacheDirectory));
+    buffer.append(reinterpret_cast<const char*>(files.m_files.constData()), files.m_files.size() * sizeof(ProjectFileRecord));
+    appendPool(&buffer, files.m_rootPath);
+    appendPool(&buffer, directoryPool);
+    appendPool(&buffer, files.m_namePool);
+
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+    QSaveFile output(cachePath);
+    if (!output.open(QIODevice::WriteOnly) || output.write(buffer) != buffer.size() || !output.commit()) {
+        *error = QString("Cannot write %1: %2").arg(cachePath, output.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+QSharedPointer<const ProjectFileTable> ProjectCache::load(const QString &cachePath, const QString &rootPath,
+                                                          quint32 flags)
+{
+    QFile input(cachePath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        return QSharedPointer<const ProjectFileTable>();
+    }
+
+    qint64 size = input.size();
+    if (size < qint64(sizeof(CacheHeader))) {
+        return QSharedPointer<const ProjectFileTable>();
+    }
+
+    const uchar *data = input.map(0, size);
+    if (!data) {
+        return QSharedPointer<const ProjectFileTable>();
+    }
+
+    const CacheHeader *header = reinterpret_cast<const CacheHeader*>(data);
+    if (std::memcmp(header->magic, kCacheMagic, sizeof(kCacheMagic)) != 0 || header->version != kCacheVersion
+        || header->flags != flags || cacheSize(header) != size) {
+        DEBUG_LOG_EDITOR("Ignoring stale project cache" << cachePath);
+        return QSharedPointer<const ProjectFileTable>();
+    }
+
+    const CacheDirectory *directories = reinterpret_cast<const CacheDirectory*>(data + sizeof(CacheHeader));
+    const ProjectFileRecord *records = reinterpret_cast<const ProjectFileRecord*>(directories + header->directoryCount);
+    const uchar *pools = reinterpret_cast<const uchar*>(records + header->fileCount);
+
+    const QChar *rootChars = reinterpret_cast<const QChar*>(pools);
+    const QChar *directoryChars = reinterpret_cast<const QChar*>(pools + alignedPool(header->rootPathLength));
+    const QChar *nameChars = reinterpret_cast<const QChar*>(pools + alignedPool(header->rootPathLength)
+                                                            + alignedPool(header->directoryPoolLength));
+
+    // a moved or copied cache must not describe a different tree
+    if (QString(rootChars, header->rootPathLength) != rootPath) {
+        return QSharedPointer<const ProjectFileTable>();
+    }
+
+    QSharedPointer<ProjectFileTable> table(new ProjectFileTable);
+    table->m_rootPath = rootPath;
+    table->m_flags = flags;
+    table->m_namePool = QString(nameChars, header->namePoolLength);
+    table->m_files = QVector<ProjectFileRecord>(records, records + header->fileCount);
+
+    table->m_directories.reserve(header->directoryCount);
+    table->m_directoryFirstFile.reserve(header->directoryCount + 1);
+    table->m_directoryModified.reserve(header->directoryCount);
+    table->m_directoryRules.reserve(header->directoryCount);
+    for (quint32 i = 0; i < header->directoryCount; ++i) {
+        const CacheDirectory &directory = directories[i];
+        if (qint64(directory.pathOffset) + directory.pathLength > header->directoryPoolLength
+            || directory.firstFile > header->fileCount) {
+            return QSharedPointer<const ProjectFileTable>();
+        }
+
+        table->m_directories.append(QString(directoryChars + directory.pathOffset, directory.pathLength));
+        table->m_directoryFirstFile.append(directory.firstFile);
+        table->m_directoryModified.append(directory.modified);
+        table->m_directoryRules.append(directory.rulesModified);
+    }
+    table->m_directoryFirstFile.append(header->fileCount);
+
+    for (const ProjectFileRecord &record : table->m_files) {
+        if (record.directory >= header->directoryCount
+            || qint64(record.nameOffset) + record.nameLength > header->namePoolLength) {
+            return QSharedPointer<const ProjectFileTable>();
+        }
+    }
+
+    return table;
+}
@@ -0,0 +1,933 @@
+// background project file indexer
+// walks the project on a thread pool, one task per directory, honouring
+// ignore files and skipping binaries, then publishes an immutable file table.
+// a cached table is published first and only directories that changed are re-read
+
+#include "project_indexer.h"
+#include "function_task.h"
+#include "project_cache.h"
+#include "debug_log.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// same window git uses to decide whether a file is binary
+const int kBinaryProbeSize = 8000;
+
+const quint32 kRespectIgnoreFlag = 0x1;
+const quint32 kSkipBinaryFlag = 0x2;
+
+// fewer changed directories than this are always patched in place
+const int kMinPatchDirectories = 64;
+
+}
+
+QString ProjectFileTable::rootPath() const
+{
+    return m_rootPath;
+}
+
+int ProjectFileTable::fileCount() const
+{
+    return m_files.size();
+}
+
+int ProjectFileTable::directoryCount() const
+{
+    return m_directories.size();
+}
+
+QString ProjectFileTable::fileName(int file) const
+{
+    const ProjectFileRecord &record = m_files.at(file);
+    return m_namePool.mid(record.nameOffset, record.nameLength);
+}
+
+QString ProjectFileTable::relativePath(int file) const
+{
+    const QString &directory = m_directories.at(m_files.at(file).directory);
+    if (directory.isEmpty()) {
+        return fileName(file);
+    }
+    return directory + QLatin1Char('/') + fileName(file);
+}
+
+QString ProjectFileTable::absolutePath(int file) const
+{
+    return m_rootPath + QLatin1Char('/') + relativePath(file);
+}
+
+int ProjectFileTable::directoryIndex(int file) const
+{
+    return m_files.at(file).directory;
+}
+
+QString ProjectFileTable::directoryPath(int directory) const
+{
+    return m_directories.at(directory);
+}
+
+qint64 ProjectFileTable::fileSize(int file) const
+{
+    return m_files.at(file).size;
+}
+
+qint64 ProjectFileTable::lastModified(int file) const
+{
+    return m_files.at(file).lastModified;
+}
+
+int ProjectFileTable::indexOf(const QString &relativePath) const
+{
+    int slash = relativePath.lastIndexOf('/');
+    QString directory = slash >= 0 ? relativePath.left(slash) : QString();
+    QString name = relativePath.mid(slash + 1);
+
+    int directoryIndex = directoryIndexOf(directory);
+    if (directoryIndex < 0) {
+        return -1;
+    }
+
+    int low = m_directoryFirstFile.at(directoryIndex);
+    int high = m_directoryFirstFile.at(directoryIndex + 1);
+
+    while (low < high) {
+        int middle = (low + high) / 2;
+        const ProjectFileRecord &record = m_files.at(middle);
+        int result = m_namePool.midRef(record.nameOffset, record.nameLength).compare(name);
+        if (result == 0) {
+            return middle;
+        }
+        if (result < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return -1;
+}
+
+int ProjectFileTable::directoryIndexOf(const QString &relativePath) const
+{
+    auto directoryIt = std::lower_bound(m_directories.constBegin(), m_directories.constEnd(), relativePath,
+                                        directoryLessThan);
+    if (directoryIt == m_directories.constEnd() || *directoryIt != relativePath) {
+        return -1;
+    }
+    return directoryIt - m_directories.constBegin();
+}
+
+bool ProjectFileTable::directoryLessThan(const QString &left, const QString &right)
+{
+    const int length = qMin(left.size(), right.size());
+    for (int i = 0; i < length; ++i) {
+        const ushort leftChar = left.at(i).unicode();
+        const ushort rightChar = right.at(i).unicode();
+        if (leftChar == rightChar) {
+            continue;
+        }
+        if (leftChar == '/') {
+            return true;
+        }
+        if (rightChar == '/') {
+            return false;
+        }
+        return leftChar < rightChar;
+    }
+    return left.size() < right.size();
+}
+
+ProjectIndexer::ProjectIndexer(QObject *parent)
+    : QObject(parent)
+    , m_pool(new QThreadPool(this))
+    , m_respectIgnoreFiles(true)
+    , m_skipBinaryFiles(true)
+    , m_trigramIndexEnabled(false)
+    , m_cacheEnabled(true)
+    , m_watchEnabled(false)
+    , m_gitStatusEnabled(false)
+    , m_symbolIndexEnabled(false)
+    , m_watchService(new FileWatchService(this))
+    , m_trigramIndex(new TrigramIndex(this))
+    , m_gitStatus(new GitStatus(this))
+    , m_symbolIndex(new SymbolIndex(this))
+    , m_nextJobId(0)
+    , m_files(new ProjectFileTable)
+{
+    m_pool->setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+
+    connect(m_watchService, &FileWatchService::pathsChanged, this, &ProjectIndexer::applyChanges);
+    // the kernel dropped events, only a reconcile can tell what changed
+    connect(m_watchService, &FileWatchService::eventsLost, this, &ProjectIndexer::rebuild);
+    connect(m_watchService, &FileWatchService::pathsChanged, this,
+            [this](const QStringList &directories, const QStringList &files) {
+                if (m_gitStatusEnabled) {
+                    m_gitStatus->updatePaths(directories, files);
+                }
+            });
+}
+
+ProjectIndexer::~ProjectIndexer()
+{
+    cancel();
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+void ProjectIndexer::setRootPath(const QString &rootPath)
+{
+    m_rootPath = QDir(rootPath).absolutePath();
+    m_trigramIndex->clear();
+    m_gitStatus->clear();
+    m_symbolIndex->clear();
+    m_watchService->clear();
+    rebuild();
+}
+
+QString ProjectIndexer::rootPath() const
+{
+    return m_rootPath;
+}
+
+void ProjectIndexer::rebuild()
+{
+    cancel();
+
+    // a full reconcile picks up anything the watcher reported
+    m_pendingDirectories.clear();
+    m_pendingFiles.clear();
+
+    if (m_rootPath.isEmpty() || !QDir(m_rootPath).exists()) {
+        return;
+    }
+
+    QSharedPointer<IndexJob> job(new IndexJob);
+    job->id = ++m_nextJobId;
+    job->rootPath = m_rootPath;
+    job->respectIgnoreFiles = m_respectIgnoreFiles;
+    job->skipBinaryFiles = m_skipBinaryFiles;
+    job->writeCache = m_cacheEnabled;
+    m_job = job;
+
+    // reconcile against what we already have, or against the cache on open
+    QSharedPointer<const ProjectFileTable> cached;
+    if (m_files->rootPath() == m_rootPath && m_files->m_flags == currentFlags()) {
+        job->previous = m_files;
+    } else if (m_cacheEnabled) {
+        QElapsedTimer timer;
+        timer.start();
+        cached = ProjectCache::load(ProjectCache::cachePathFor(m_rootPath), m_rootPath, currentFlags());
+        if (cached) {
+            job->previous = cached;
+            LOG_INFO("Loaded" << cached->fileCount() << "cached project files in" << timer.elapsed() << "ms");
+        }
+    }
+
+    IgnoreMatcher matcher;
+    if (job->respectIgnoreFiles) {
+        QSharedPointer<IgnoreRuleSet> exclude(new IgnoreRuleSet());
+        exclude->loadFile(QDir(m_rootPath).filePath(".git/info/exclude"));
+        matcher = matcher.withRules(exclude);
+    }
+
+    DEBUG_LOG_EDITOR("Indexing project:" << m_rootPath << (job->previous ? "(reconciling)" : "(full walk)"));
+    emit indexingStarted(m_rootPath);
+
+    if (cached) {
+        setFiles(cached);
+    }
+
+    scheduleDirectory(job, QString(), matcher, false);
+}
+
+void ProjectIndexer::cancel()
+{
+    if (m_job) {
+        m_job->cancelled.storeRelease(1);
+        m_job.reset();
+    }
+}
+
+bool ProjectIndexer::isIndexing() const
+{
+    return !m_job.isNull();
+}
+
+void ProjectIndexer::setRespectIgnoreFiles(bool respect)
+{
+    m_respectIgnoreFiles = respect;
+}
+
+void ProjectIndexer::setSkipBinaryFiles(bool skip)
+{
+    m_skipBinaryFiles = skip;
+}
+
+void ProjectIndexer::setTrigramIndexEnabled(bool enabled)
+{
+    m_trigramIndexEnabled = enabled;
+    if (!enabled) {
+        m_trigramIndex->clear();
+    }
+}
+
+void ProjectIndexer::setCacheEnabled(bool enabled)
+{
+    m_cacheEnabled = enabled;
+}
+
+void ProjectIndexer::setWatchEnabled(bool enabled)
+{
+    m_watchEnabled = enabled;
+    if (!enabled) {
+        m_watchService->clear();
+    } else if (m_files->rootPath() == m_rootPath && !m_rootPath.isEmpty()) {
+        m_watchService->watchDirectories(m_rootPath, m_files->m_directories, m_files->m_directoryModified);
+    }
+}
+
+void ProjectIndexer::setGitStatusEnabled(bool enabled)
+{
+    m_gitStatusEnabled = enabled;
+    if (!enabled) {
+        m_gitStatus->clear();
+    } else if (m_files->rootPath() == m_rootPath && !m_rootPath.isEmpty()) {
+        m_gitStatus->setFileTable(m_files);
+    }
+}
+
+void ProjectIndexer::setSymbolIndexEnabled(bool enabled)
+{
+    m_symbolIndexEnabled = enabled;
+    if (!enabled) {
+        m_symbolIndex->clear();
+    } else if (m_files->rootPath() == m_rootPath && !m_rootPath.isEmpty()) {
+        m_symbolIndex->setFileTable(m_files);
+    }
+}
+
+FileWatchService *ProjectIndexer::watchService() const
+{
+    return m_watchService;
+}
+
+TrigramIndex *ProjectIndexer::trigramIndex() const
+{
+    return m_trigramIndex;
+}
+
+GitStatus *ProjectIndexer::gitStatus() const
+{
+    return m_gitStatus;
+}
+
+SymbolIndex *ProjectIndexer::symbolIndex() const
+{
+    return m_symbolIndex;
+}
+
+QSharedPointer<const ProjectFileTable> ProjectIndexer::files() const
+{
+    return m_files;
+}
+
+bool ProjectIndexer::isBinaryFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return true;
+    }
+
+    char buffer[kBinaryProbeSize];
+    qint64 length = file.read(buffer, sizeof(buffer));
+    if (length <= 0) {
+        return false;
+    }
+
+    return std::memchr(buffer, 0, static_cast<size_t>(length)) != nullptr;
+}
+
+quint32 ProjectIndexer::currentFlags() const
+{
+    return (m_respectIgnoreFiles ? kRespectIgnoreFlag : 0) | (m_skipBinaryFiles ? kSkipBinaryFlag : 0);
+}
+
+void ProjectIndexer::setFiles(const QSharedPointer<const ProjectFileTable> &files)
+{
+    m_files = files;
+    emit indexReady(files->fileCount());
+
+    if (m_watchEnabled) {
+        m_watchService->watchDirectories(files->rootPath(), files->m_directories, files->m_directoryModified);
+    }
+
+    if (m_trigramIndexEnabled) {
+        m_trigramIndex->setFileTable(files);
+    }
+
+    if (m_gitStatusEnabled) {
+        m_gitStatus->setFileTable(files);
+    }
+
+    if (m_symbolIndexEnabled) {
+        m_symbolIndex->setFileTable(files);
+    }
+}
+
+void ProjectIndexer::scheduleDirectory(const QSharedPointer<IndexJob> &job, const QString &relativePath,
+                                       const IgnoreMatcher &matcher, bool forceWalk)
+{
+    job->pending.ref();
+
+    // the destructor drains the pool, so tasks never outlive the indexer
+    m_pool->start(new FunctionTask([this, job, relativePath, matcher, forceWalk]() {
+        walkDirectory(job, relativePath, matcher, forceWalk);
+        finishDirectory(job);
+    }));
+}
+
+void ProjectIndexer::walkDirectory(const QSharedPointer<IndexJob> &job, const QString &relativePath,
+                                   const IgnoreMatcher &parentMatcher, bool forceWalk)
+{
+    if (job->cancelled.loadAcquire()) {
+        return;
+    }
+
+    IgnoreMatcher matcher = parentMatcher;
+    if (job->respectIgnoreFiles) {
+        matcher = IgnoreMatcher::loadDirectoryRules(parentMatcher, job->rootPath, relativePath);
+    }
+
+    QString absolutePath = relativePath.isEmpty() ? job->rootPath : job->rootPath + QLatin1Char('/') + relativePath;
+
+    DirectoryListing listing;
+    listing.relativePath = relativePath;
+    listing.directoryModified = QFileInfo(absolutePath).lastModified().toMSecsSinceEpoch();
+    if (job->respectIgnoreFiles) {
+        listing.rulesModified = rulesModified(job->rootPath, relativePath);
+    }
+
+    const ProjectFileTable *previous = job->previous.data();
+    int previousDirectory = previous ? previous->directoryIndexOf(relativePath) : -1;
+
+    // changed ignore rules can reach anywhere below, so the subtree is re-read
+    if (previousDirectory >= 0 && previous->m_directoryRules.at(previousDirectory) != listing.rulesModified) {
+        forceWalk = true;
+    }
+
+    // adding, removing or renaming an entry bumps the directory mtime
+    if (previousDirectory >= 0 && !forceWalk
+        && previous->m_directoryModified.at(previousDirectory) == listing.directoryModified) {
+        reuseDirectory(job, previousDirectory, matcher, &listing);
+    } else {
+        if (previous) {
+            job->changed.storeRelease(1);
+        }
+
+        QStringList subdirectories;
+        if (!listDirectory(job.data(), matcher, &listing, &subdirectories)) {
+            return;
+        }
+        for (const QString &subdirectory : subdirectories) {
+            scheduleDirectory(job, subdirectory, matcher, forceWalk);
+        }
+    }
+
+    // empty directories are kept too, their mtimes are needed to reconcile
+    QMutexLocker locker(&job->mutex);
+    job->listings.append(listing);
+}
+
+bool ProjectIndexer::listDirectory(IndexJob *job, const IgnoreMatcher &matcher, DirectoryListing *listing,
+                                   QStringList *subdirectories)
+{
+    const QString &relativePath = listing->relativePath;
+    const ProjectFileTable *previous = job->previous.data();
+    QString absolutePath = relativePath.isEmpty() ? job->rootPath : job->rootPath + QLatin1Char('/') + relativePath;
+
+    QDirIterator iterator(absolutePath, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+    while (iterator.hasNext()) {
+        iterator.next();
+
+        if (job->cancelled.loadAcquire()) {
+            return false;
+        }
+
+        QFileInfo info = iterator.fileInfo();
+        QString name = info.fileName();
+        bool isDir = info.isDir();
+
+        // symlinked directories are not followed, they can loop back into the tree
+        if (name == QLatin1String(".git") || (isDir && info.isSymLink())) {
+            continue;
+        }
+
+        QString childPath = relativePath.isEmpty() ? name : relativePath + QLatin1Char('/') + name;
+        if (job->respectIgnoreFiles && matcher.isIgnored(childPath, isDir)) {
+            continue;
+        }
+
+        if (isDir) {
+            subdirectories->append(childPath);
+            continue;
+        }
+
+        if (!info.isFile()) {
+            continue;
+        }
+
+        qint64 size = info.size();
+        qint64 modified = info.lastModified().toMSecsSinceEpoch();
+
+        // an unchanged file that was listed before is already known to be text
+        if (job->skipBinaryFiles) {
+            int known = previous ? previous->indexOf(childPath) : -1;
+            bool unchanged = known >= 0 && previous->fileSize(known) == size
+                && previous->lastModified(known) == modified;
+            if (!unchanged && isBinaryFile(info.filePath())) {
+                continue;
+            }
+        }
+
+        listing->names.append(name);
+        listing->sizes.append(size);
+        listing->modified.append(modified);
+    }
+
+    return true;
+}
+
+void ProjectIndexer::reuseDirectory(const QSharedPointer<IndexJob> &job, int previousDirectory,
+                                    const IgnoreMatcher &matcher, DirectoryListing *listing)
+{
+    const ProjectFileTable *previous = job->previous.data();
+    const QString &relativePath = listing->relativePath;
+    QString absolutePath = relativePath.isEmpty() ? job->rootPath : job->rootPath + QLatin1Char('/') + relativePath;
+
+    // edits do not touch the directory mtime, so file metadata is refreshed with a stat
+    int first = previous->m_directoryFirstFile.at(previousDirectory);
+    int last = previous->m_directoryFirstFile.at(previousDirectory + 1);
+    for (int file = first; file < last; ++file) {
+        QString name = previous->fileName(file);
+        QFileInfo info(absolutePath + QLatin1Char('/') + name);
+        if (!info.isFile()) {
+            job->changed.storeRelease(1);
+            continue;
+        }
+
+        qint64 size = info.size();
+        qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        if (size != previous->fileSize(file) || modified != previous->lastModified(file)) {
+            job->changed.storeRelease(1);
+        }
+
+        listing->names.append(name);
+        listing->sizes.append(size);
+        listing->modified.append(modified);
+    }
+
+    // descendants form one contiguous run of the directory list, see directoryLessThan
+    QString prefix = relativePath.isEmpty() ? QString() : relativePath + QLatin1Char('/');
+    for (int directory = previousDirectory + 1; directory < previous->m_directories.size(); ++directory) {
+        const QString &path = previous->m_directories.at(directory);
+        if (!path.startsWith(prefix)) {
+            break;
+        }
+        if (path.indexOf(QLatin1Char('/'), prefix.size()) < 0) {
+            scheduleDirectory(job, path, matcher, false);
+        }
+    }
+}
+
+void ProjectIndexer::finishDirectory(const QSharedPointer<IndexJob> &job)
+{
+    if (job->pending.deref()) {
+        return;
+    }
+
+    // last directory of the walk builds the table on this worker
+    if (job->cancelled.loadAcquire()) {
+        return;
+    }
+
+    int jobId = job->id;
+    QSharedPointer<ProjectFileTable> files;
+
+    if (!job->previous || job->changed.loadAcquire()) {
+        files = buildTable(job.data());
+        files->m_flags = (job->respectIgnoreFiles ? kRespectIgnoreFlag : 0)
+            | (job->skipBinaryFiles ? kSkipBinaryFlag : 0);
+
+        if (job->writeCache) {
+            QString error;
+            if (!ProjectCache::save(*files, ProjectCache::cachePathFor(job->rootPath), &error)) {
+                LOG_WARNING("Project cache not saved:" << error);
+            }
+        }
+    }
+
+    QMetaObject::invokeMethod(this, [this, jobId, files]() {
+        publish(jobId, files);
+    }, Qt::QueuedConnection);
+}
+
+void ProjectIndexer::publish(int jobId, const QSharedPointer<const ProjectFileTable> &files)
+{
+    if (!m_job || m_job->id != jobId) {
+        return;
+    }
+
+    m_job.reset();
+
+    // nothing changed since the table already published
+    if (!files) {
+        DEBUG_LOG_EDITOR("Project index is up to date:" << m_files->rootPath());
+        startPatch();
+        return;
+    }
+
+    LOG_INFO("Indexed" << files->fileCount() << "files in" << files->directoryCount()
+             << "directories under" << files->rootPath());
+    setFiles(files);
+
+    // changes reported while this job ran are applied on top of it
+    startPatch();
+}
+
+void ProjectIndexer::applyChanges(const QStringList &directories, const QStringList &files)
+{
+    if (m_rootPath.isEmpty() || m_files->rootPath() != m_rootPath) {
+        return;
+    }
+
+    for (const QString &directory : directories) {
+        m_pendingDirectories.insert(directory);
+    }
+    for (const QString &file : files) {
+        m_pendingFiles.insert(file);
+    }
+
+    // a running walk or patch picks the changes up when it publishes
+    if (!m_job) {
+        startPatch();
+    }
+}
+
+void ProjectIndexer::startPatch()
+{
+    if (m_job || (m_pendingDirectories.isEmpty() && m_pendingFiles.isEmpty())) {
+        return;
+    }
+
+    // past this point patching directory by directory costs more than a reconcile
+    if (m_pendingDirectories.size() > qMax(kMinPatchDirectories, m_files->directoryCount() / 4)) {
+        DEBUG_LOG_EDITOR(m_pendingDirectories.size() << "directories changed, reconciling the whole project");
+        rebuild();
+        return;
+    }
+
+    QSharedPointer<IndexJob> job(new IndexJob);
+    job->id = ++m_nextJobId;
+    job->rootPath = m_rootPath;
+    job->respectIgnoreFiles = m_respectIgnoreFiles;
+    job->skipBinaryFiles = m_skipBinaryFiles;
+    job->writeCache = m_cacheEnabled;
+    job->previous = m_files;
+    job->patchDirectories = m_pendingDirectories.values();
+    job->patchFiles = m_pendingFiles;
+    m_job = job;
+
+    m_pendingDirectories.clear();
+    m_pendingFiles.clear();
+
+    job->pending.ref();
+    m_pool->start(new FunctionTask([this, job]() {
+        patchTable(job.data());
+        finishDirectory(job);
+    }));
+}
+
+void ProjectIndexer::patchTable(IndexJob *job)
+{
+    const ProjectFileTable *previous = job->previous.data();
+
+    auto isUnder = [](const QString &path, const QString &prefix) {
+        return prefix.isEmpty() || path == prefix
+            || (path.startsWith(prefix) && path.at(prefix.size()) == QLatin1Char('/'));
+    };
+
+    // parents first, so a re-read subtree swallows the dirty directories inside it
+    QStringList dirty = job->patchDirectories;
+    std::sort(dirty.begin(), dirty.end(), [](const QString &left, const QString &right) {
+        int leftDepth = left.isEmpty() ? 0 : left.count('/') + 1;
+        int rightDepth = right.isEmpty() ? 0 : right.count('/') + 1;
+        return leftDepth != rightDepth ? leftDepth < rightDepth : left < right;
+    });
+
+    QStringList dropped;
+    QSet<QString> relisted;
+    auto isDropped = [&](const QString &path) {
+        for (const QString &prefix : dropped) {
+            if (isUnder(path, prefix)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto readDirectory = [&](const QString &relativePath, const IgnoreMatcher &matcher, QStringList *subdirectories) {
+        DirectoryListing listing;
+        listing.relativePath = relativePath;
+        QString absolutePath = relativePath.isEmpty() ? job->rootPath : job->rootPath + QLatin1Char('/') + relativePath;
+        listing.directoryModified = QFileInfo(absolutePath).lastModified().toMSecsSinceEpoch();
+        if (job->respectIgnoreFiles) {
+            listing.rulesModified = rulesModified(job->rootPath, relativePath);
+        }
+        listDirectory(job, matcher, &listing, subdirectories);
+        relisted.insert(relativePath);
+        job->listings.append(listing);
+        return listing.rulesModified;
+    };
+
+    // new directories, or ones under changed rules, are walked from scratch
+    auto walkTree = [&](const QString &relativePath, const IgnoreMatcher &parentMatcher) {
+        QVector<QPair<QString, IgnoreMatcher>> stack;
+        stack.append(qMakePair(relativePath, parentMatcher));
+        while (!stack.isEmpty() && !job->cancelled.loadAcquire()) {
+            QPair<QString, IgnoreMatcher> entry = stack.takeLast();
+            IgnoreMatcher matcher = entry.second;
+            if (job->respectIgnoreFiles) {
+                matcher = IgnoreMatcher::loadDirectoryRules(entry.second, job->rootPath, entry.first);
+            }
+
+            QStringList subdirectories;
+            readDirectory(entry.first, matcher, &subdirectories);
+            for (const QString &subdirectory : subdirectories) {
+                stack.append(qMakePair(subdirectory, matcher));
+            }
+        }
+    };
+
+    for (const QString &directory : dirty) {
+        if (job->cancelled.loadAcquire()) {
+            return;
+        }
+        if (isDropped(directory) || relisted.contains(directory)) {
+            continue;
+        }
+
+        // directories the table never had are reached through their parent
+        int previousDirectory = previous->directoryIndexOf(directory);
+        if (previousDirectory < 0) {
+            continue;
+        }
+
+        QString absolutePath = directory.isEmpty() ? job->rootPath : job->rootPath + QLatin1Char('/') + directory;
+        if (!QFileInfo(absolutePath).isDir()) {
+            dropped.append(directory);
+            job->changed.storeRelease(1);
+            continue;
+        }
+
+        IgnoreMatcher matcher;
+        if (job->respectIgnoreFiles) {
+            matcher = IgnoreMatcher::forDirectory(job->rootPath, directory);
+        }
+
+        QStringList subdirectories;
+        qint64 rules = readDirectory(directory, matcher, &subdirectories);
+
+        if (rules != previous->m_directoryRules.at(previousDirectory)) {
+            dropped.append(directory);
+            for (const QString &subdirectory : subdirectories) {
+                walkTree(subdirectory, matcher);
+            }
+            job->changed.storeRelease(1);
+            continue;
+        }
+
+        // build output landing in ignored paths relists a directory without changing it
+        if (!sameFiles(*previous, previousDirectory, job->listings.last())) {
+            job->changed.storeRelease(1);
+        }
+
+        // previous children that are gone now take their subtree with them; the
+        // children are in the contiguous run of descendants that directoryLessThan
+        // keeps right after the directory
+        QString prefix = directory.isEmpty() ? QString() : directory + QLatin1Char('/');
+        for (int child = previousDirectory + 1; child < previous->m_directories.size(); ++child) {
+            const QString &path = previous->m_directories.at(child);
+            if (!path.startsWith(prefix)) {
+                break;
+            }
+            if (path.indexOf(QLatin1Char('/'), prefix.size()) < 0 && !subdirectories.contains(path)) {
+                dropped.append(path);
+                job->changed.storeRelease(1);
+            }
+        }
+
+        for (const QString &subdirectory : subdirectories) {
+            if (previous->directoryIndexOf(subdirectory) < 0) {
+                walkTree(subdirectory, matcher);
+                job->changed.storeRelease(1);
+            }
+        }
+    }
+
+    QSet<QString> writtenDirectories;
+    for (const QString &filePath : job->patchFiles) {
+        int slash = filePath.lastIndexOf('/');
+        writtenDirectories.insert(slash >= 0 ? filePath.left(slash) : QString());
+    }
+
+    // everything else is copied, restating only the files reported as written
+    for (int directory = 0; directory < previous->m_directories.size(); ++directory) {
+        const QString &relativePath = previous->m_directories.at(directory);
+        if (relisted.contains(relativePath) || isDropped(relativePath)) {
+            continue;
+        }
+
+        DirectoryListing listing;
+        listing.relativePath = relativePath;
+        listing.directoryModified = previous->m_directoryModified.at(directory);
+        listing.rulesModified = previous->m_directoryRules.at(directory);
+
+        bool written = writtenDirectories.contains(relativePath);
+        int first = previous->m_directoryFirstFile.at(directory);
+        int last = previous->m_directoryFirstFile.at(directory + 1);
+        for (int file = first; file < last; ++file) {
+            qint64 size = previous->fileSize(file);
+            qint64 modified = previous->lastModified(file);
+
+            if (written) {
+                QString filePath = previous->relativePath(file);
+                if (job->patchFiles.contains(filePath)) {
+                    QFileInfo info(job->rootPath + QLatin1Char('/') + filePath);
+                    job->changed.storeRelease(1);
+                    if (!info.isFile()) {
+                        continue;
+                    }
+                    size = info.size();
+                    modified = info.lastModified().toMSecsSinceEpoch();
+                }
+            }
+
+            listing.names.append(previous->fileName(file));
+            listing.sizes.append(size);
+            listing.modified.append(modified);
+        }
+
+        job->listings.append(listing);
+    }
+}
+
+bool ProjectIndexer::sameFiles(const ProjectFileTable &previous, int directory, const DirectoryListing &listing)
+{
+    int first = previous.m_directoryFirstFile.at(directory);
+    int last = previous.m_directoryFirstFile.at(directory + 1);
+    if (last - first != listing.names.size()) {
+        return false;
+    }
+
+    for (int i = 0; i < listing.names.size(); ++i) {
+        int file = previous.indexOf(listing.relativePath.isEmpty() ? listing.names.at(i)
+                                    : listing.relativePath + QLatin1Char('/') + listing.names.at(i));
+        if (file < 0 || previous.fileSize(file) != listing.sizes.at(i)
+            || previous.lastModified(file) != listing.modified.at(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+qint64 ProjectIndexer::rulesModified(const QString &rootPath, const QString &relativePath)
+{
+    QDir directory(relativePath.isEmpty() ? rootPath : rootPath + QLatin1Char('/') + relativePath);
+
+    QStringList ruleFiles;
+    ruleFiles << ".gitignore" << ".ignore";
+    if (relativePath.isEmpty()) {
+        ruleFiles << ".git/info/exclude";
+    }
+
+    qint64 latest = 0;
+    for (const QString &ruleFile : ruleFiles) {
+        QFileInfo info(directory.filePath(ruleFile));
+        if (info.exists()) {
+            latest = qMax(latest, info.lastModified().toMSecsSinceEpoch());
+        }
+    }
+    return latest;
+}
+
+QSharedPointer<ProjectFileTable> ProjectIndexer::buildTable(IndexJob *job)
+{
+    QSharedPointer<ProjectFileTable> table(new ProjectFileTable);
+    table->m_rootPath = job->rootPath;
+
+    QMutexLocker locker(&job->mutex);
+
+    std::sort(job->listings.begin(), job->listings.end(),
+              [](const DirectoryListing &left, const DirectoryListing &right) {
+                  return ProjectFileTable::directoryLessThan(left.relativePath, right.relativePath);
+              });
+
+    int fileCount = 0;
+    int nameLength = 0;
+    for (const DirectoryListing &listing : job->listings) {
+        fileCount += listing.names.size();
+        for (const QString &name : listing.names) {
+            nameLength += name.size();
+        }
+    }
+
+    table->m_files.reserve(fileCount);
+    table->m_namePool.reserve(nameLength);
+    table->m_directories.reserve(job->listings.size());
+    table->m_directoryFirstFile.reserve(job->listings.size() + 1);
+    table->m_directoryModified.reserve(job->listings.size());
+    table->m_directoryRules.reserve(job->listings.size());
+
+    for (const DirectoryListing &listing : job->listings) {
+        quint32 directory = table->m_directories.size();
+        table->m_directories.append(listing.relativePath);
+        table->m_directoryFirstFile.append(table->m_files.size());
+        table->m_directoryModified.append(listing.directoryModified);
+        table->m_directoryRules.append(listing.rulesModified);
+
+        QVector<int> order(listing.names.size());
+        for (int i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&listing](int left, int right) {
+            return listing.names.at(left) < listing.names.at(right);
+        });
+
+        for (int i : order) {
+            const QString &name = listing.names.at(i);
+
+            ProjectFileRecord record;
+            record.directory = directory;
+            record.nameOffset = table->m_namePool.size();
+            record.nameLength = name.size();
+            record.size = listing.sizes.at(i);
+            record.lastModified = listing.modified.at(i);
+
+            table->m_namePool.append(name);
+            table->m_files.append(record);
+        }
+    }
+    table->m_directoryFirstFile.append(table->m_files.size());
+
+    return table;
+}
@@ -0,0 +1,519 @@
+// project wide replace
+// closed files are rewritten on the pool into temporary files, then swapped
+// in one by one with a hard linked backup of each original; open documents
+// are edited last, so the documents only change once every file has
+
+#include "project_replace.h"
+#include "function_task.h"
+#include "debug_log.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QThread>
+#include <QMutexLocker>
+#include <KTextEditor/Document>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+// progress is posted every this many files
+const int kProgressFiles = 32;
+
+bool hitBefore(const SearchHit &a, const SearchHit &b)
+{
+    return a.line != b.line ? a.line < b.line : a.column < b.column;
+}
+
+// sibling of path, hidden, with the given suffix
+QString siblingPath(const QString &path, const QString &suffix)
+{
+    QFileInfo info(path);
+    return info.dir().filePath(QString(".%1.%2").arg(info.fileName(), suffix));
+}
+
+QString systemError()
+{
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+
+}
+
+ProjectReplace::ProjectReplace(QObject *parent)
+    : QObject(parent)
+    , m_pool(new QThreadPool(this))
+    , m_generation(0)
+{
+    m_pool->setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+}
+
+ProjectReplace::~ProjectReplace()
+{
+    // leaves nothing half done: prepared files are dropped, never committed
+    QSharedPointer<ReplaceJob> job = m_job;
+    cancel();
+    m_pool->clear();
+    m_pool->waitForDone();
+    if (job) {
+        removeFiles(job.data(), true, false);
+    }
+}
+
+bool ProjectReplace::start(const QVector<SearchHit> &hits, const SearchQuery &query, const QString &replacement,
+                           const QHash<QString, KTextEditor::Document*> &openDocuments)
+{
+    cancel();
+    m_lastError.clear();
+
+    if (hits.isEmpty()) {
+        setError("No matches selected");
+        return false;
+    }
+
+    const SearchPattern pattern(query.pattern, query.regex, query.caseSensitive, query.wholeWord);
+    if (pattern.isEmpty() || !pattern.isValid()) {
+        setError("Invalid pattern: " + pattern.errorString());
+        return false;
+    }
+
+    QSharedPointer<ReplaceJob> job(new ReplaceJob);
+    job->query = query;
+    job->replacement = replacement;
+
+    // group by file, keeping the order the hits came in
+    QVector<QVector<SearchHit>> groups;
+    QVector<QString> paths;
+    QHash<QString, int> groupOf;
+    for (const SearchHit &hit : hits) {
+        auto it = groupOf.constFind(hit.path);
+        if (it == groupOf.constEnd()) {
+            it = groupOf.insert(hit.path, groups.size());
+            groups.append(QVector<SearchHit>());
+            paths.append(hit.path);
+        }
+        groups[it.value()].append(hit);
+    }
+
+    // documents are checked now, so a stale buffer fails before any file is touched
+    for (int i = 0; i < groups.size(); ++i) {
+        KTextEditor::Document *document = openDocuments.value(paths.at(i));
+        if (document) {
+            DocumentEdit edit;
+            if (!prepareDocument(document, pattern, replacement, groups.at(i), &edit)) {
+                return false;
+            }
+            job->documents.append(edit);
+            continue;
+        }
+
+        FileEdit file;
+        file.path = paths.at(i);
+        file.hits = groups.at(i);
+        file.temporaryPath = siblingPath(file.path, "loom-replace");
+        file.backupPath = siblingPath(file.path, "loom-backup");
+        job->files.append(file);
+    }
+
+    job->generation = m_generation.fetchAndAddOrdered(1) + 1;
+    m_job = job;
+
+    DEBUG_LOG_EDITOR("Replace" << job->generation << "of" << query.pattern << "in" << job->files.size()
+                     << "files and" << job->documents.size() << "open documents");
+
+    const int workers = qMin(m_pool->maxThreadCount(), job->files.size());
+    if (workers == 0) {
+        QMetaObject::invokeMethod(this, [this, job]() {
+            finishJob(job);
+        }, Qt::QueuedConnection);
+        return true;
+    }
+
+    job->pending.storeRelease(workers);
+    for (int i = 0; i < workers; ++i) {
+        m_pool->start(new FunctionTask([this, job]() {
+            runWorker(job);
+        }));
+    }
+    return true;
+}
+
+void ProjectReplace::cancel()
+{
+    if (m_job) {
+        // workers stop between files; finishJob drops what they wrote
+        m_generation.fetchAndAddOrdered(1);
+        m_job.reset();
+    }
+}
+
+bool ProjectReplace::isRunning() const
+{
+    return !m_job.isNull();
+}
+
+QString ProjectReplace::lastError() const
+{
+    return m_lastError;
+}
+
+bool ProjectReplace::prepareDocument(KTextEditor::Document *document, const SearchPattern &pattern,
+                                     const QString &replacement, QVector<SearchHit> hits, DocumentEdit *edit)
+{
+    const QString path = hits.first().path;
+    if (!document->isReadWrite()) {
+        setError(QString("%1 is read only").arg(path));
+        return false;
+    }
+
+    std::sort(hits.begin(), hits.end(), hitBefore);
+    edit->document = document;
+
+    int end = hits.size();
+    while (end > 0) {
+        int first = end - 1;
+        while (first > 0 && hits.at(first - 1).line == hits.at(end - 1).line) {
+            --first;
+        }
+
+        const int line = hits.at(first).line - 1;
+        bool verified = false;
+        if (line < document->lines()) {
+            LineEdit lineEdit;
+            lineEdit.line = line;
+            lineEdit.original = document->line(line);
+            lineEdit.replaced = rewriteLine(pattern, lineEdit.original, hits, first, end, replacement, &verified);
+            if (verified) {
+                edit->lines.append(lineEdit);
+                edit->replacements += end - first;
+            }
+        }
+        if (!verified) {
+            setError(QString("%1 changed since the search, search again before replacing").arg(path));
+            return false;
+        }
+        end = first;
+    }
+    return true;
+}
+
+void ProjectReplace::runWorker(const QSharedPointer<ReplaceJob> &job)
+{
+    const SearchPattern pattern(job->query.pattern, job->query.regex, job->query.caseSensitive,
+                                job->query.wholeWord);
+    const int fileCount = job->files.size();
+
+    while (isCurrent(job->generation) && !job->failed.loadAcquire()) {
+        const int file = job->nextFile.fetchAndAddRelaxed(1);
+        if (file >= fileCount) {
+            break;
+        }
+
+        QString error;
+        if (!prepareFile(pattern, job->replacement, &job->files[file], &error)) {
+            fail(job.data(), error);
+            break;
+        }
+
+        const int done = job->filesDone.fetchAndAddRelaxed(1) + 1;
+        if (done % kProgressFiles == 0) {
+            const int generation = job->generation;
+            QMetaObject::invokeMethod(this, [this, generation, done, fileCount]() {
+                if (isCurrent(generation)) {
+                    emit progress(done, fileCount);
+                }
+            }, Qt::QueuedConnection);
+        }
+    }
+
+    if (!job->pending.deref()) {
+        QMetaObject::invokeMethod(this, [this, job]() {
+            finishJob(job);
+        }, Qt::QueuedConnection);
+    }
+}
+
+bool ProjectReplace::prepareFile(const SearchPattern &pattern, const QString &replacement, FileEdit *file,
+                                 QString *error)
+{
+    QFile input(file->path);
+    if (!input.open(QIODevice::ReadOnly)) {
+        *error = QString("Could not read %1: %2").arg(file->path, input.errorString());
+        return false;
+    }
+    const QByteArray data = input.readAll();
+    input.close();
+
+    std::sort(file->hits.begin(), file->hits.end(), hitBefore);
+    const QString stale = QString("%1 changed since the search, search again before replacing").arg(file->path);
+
+    // only the lines with hits are decoded; everything between is copied as bytes
+    const char *begin = data.constData();
+    const char *end = begin + data.size();
+    const char *lineStart = begin;
+    const char *copied = begin;
+    int lineNumber = 1;
+
+    QByteArray output;
+    output.reserve(data.size() + data.size() / 8);
+
+    int first = 0;
+    while (first < file->hits.size()) {
+        const int target = file->hits.at(first).line;
+        int last = first + 1;
+        while (last < file->hits.size() && file->hits.at(last).line == target) {
+            ++last;
+        }
+
+        while (lineNumber < target) {
+            const char *newline = static_cast<const char*>(std::memchr(lineStart, '\n', end - lineStart));
+            if (!newline) {
+                *error = stale;
+                return false;
+            }
+            lineStart = newline + 1;
+            ++lineNumber;
+        }
+
+        const char *lineEnd = static_cast<const char*>(std::memchr(lineStart, '\n', end - lineStart));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        if (lineEnd > lineStart && lineEnd[-1] == '\r') {
+            --lineEnd;
+        }
+
+        const QByteArray lineBytes = QByteArray::fromRawData(lineStart, int(lineEnd - lineStart));
+        const QString text = QString::fromUtf8(lineBytes);
+        // decoding must round trip, or rewriting the line would change more than the hits
+        if (text.toUtf8() != lineBytes) {
+            *error = QString("%1 is not valid UTF-8 on line %2").arg(file->path).arg(target);
+            return false;
+        }
+
+        bool verified = false;
+        const QString replaced = rewriteLine(pattern, text, file->hits, first, last, replacement, &verified);
+        if (!verified) {
+            *error = stale;
+            return false;
+        }
+
+        output.append(copied, int(lineStart - copied));
+        output.append(replaced.toUtf8());
+        copied = lineEnd;
+        file->replacements += last - first;
+        first = last;
+    }
+    output.append(copied, int(end - copied));
+
+    QFile temporary(file->temporaryPath);
+    if (!temporary.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = QString("Could not write next to %1: %2").arg(file->path, temporary.errorString());
+        return false;
+    }
+    if (temporary.write(output) != output.size() || !temporary.flush() || ::fsync(temporary.handle()) != 0) {
+        *error = QString("Could not write next to %1: %2").arg(file->path, temporary.errorString());
+        temporary.close();
+        temporary.remove();
+        return false;
+    }
+    temporary.setPermissions(QFile::permissions(file->path));
+    temporary.close();
+    return true;
+}
+
+void ProjectReplace::finishJob(const QSharedPointer<ReplaceJob> &job)
+{
+    if (!isCurrent(job->generation)) {
+        removeFiles(job.data(), true, false);
+        return;
+    }
+    m_job.reset();
+
+    QString error;
+    if (job->failed.loadAcquire()) {
+        removeFiles(job.data(), true, false);
+        error = job->error;
+    } else if (commitFiles(job.data(), &error)) {
+        if (applyDocuments(job.data(), &error)) {
+            removeFiles(job.data(), false, true);
+            error.clear();
+        } else {
+            rollbackFiles(job.data(), job->files.size());
+        }
+    }
+
+    if (!error.isEmpty()) {
+        LOG_WARNING("Replace failed, no files were changed:" << error);
+        setError(error);
+        emit failed(error);
+        return;
+    }
+
+    int replacements = 0;
+    for (const FileEdit &file : job->files) {
+        replacements += file.replacements;
+    }
+    for (const DocumentEdit &edit : job->documents) {
+        replacements += edit.replacements;
+    }
+
+    DEBUG_LOG_EDITOR("Replace" << job->generation << "made" << replacements << "replacements");
+    emit finished(replacements, job->files.size() + job->documents.size());
+}
+
+bool ProjectReplace::commitFiles(ReplaceJob *job, QString *error)
+{
+    for (int i = 0; i < job->files.size(); ++i) {
+        const FileEdit &file = job->files.at(i);
+        const QByteArray path = QFile::encodeName(file.path);
+        const QByteArray temporaryPath = QFile::encodeName(file.temporaryPath);
+        const QByteArray backupPath = QFile::encodeName(file.backupPath);
+
+        // a hard link keeps the original without copying it; rename then swaps
+        // the new content in atomically, so the path never goes missing
+        ::unlink(backupPath.constData());
+        if (::link(path.constData(), backupPath.constData()) != 0
+            && !QFile::copy(file.path, file.backupPath)) {
+            *error = QString("Could not back up %1: %2").arg(file.path, systemError());
+        } else if (std::rename(temporaryPath.constData(), path.constData()) != 0) {
+            *error = QString("Could not replace %1: %2").arg(file.path, systemError());
+            ::unlink(backupPath.constData());
+        } else {
+            continue;
+        }
+
+        rollbackFiles(job, i);
+        removeFiles(job, true, false);
+        return false;
+    }
+    return true;
+}
+
+void ProjectReplace::rollbackFiles(ReplaceJob *job, int committed)
+{
+    for (int i = committed - 1; i >= 0; --i) {
+        const FileEdit &file = job->files.at(i);
+        if (std::rename(QFile::encodeName(file.backupPath).constData(), QFile::encodeName(file.path).constData()) != 0) {
+            LOG_ERROR("Could not restore" << file.path << "from" << file.backupPath << ":" << systemError());
+        }
+    }
+}
+
+bool ProjectReplace::applyDocuments(ReplaceJob *job, QString *error)
+{
+    // the user may have typed while the files were prepared
+    for (const DocumentEdit &edit : job->documents) {
+        if (!edit.document) {
+            *error = "A document was closed during the replace";
+            return false;
+        }
+        for (const LineEdit &line : edit.lines) {
+            if (line.line >= edit.document->lines() || edit.document->line(line.line) != line.original) {
+                *error = QString("%1 was edited during the replace").arg(edit.document->url().toLocalFile());
+                return false;
+            }
+        }
+    }
+
+    for (int i = 0; i < job->documents.size(); ++i) {
+        const DocumentEdit &edit = job->documents.at(i);
+        KTextEditor::Document *document = edit.document;
+
+        int applied = 0;
+        {
+            KTextEditor::Document::EditingTransaction transaction(document);
+            for (const LineEdit &line : edit.lines) {
+                if (!document->replaceText(KTextEditor::Range(line.line, 0, line.line, line.original.size()),
+                                           line.replaced)) {
+                    break;
+                }
+                ++applied;
+            }
+            if (applied < edit.lines.size()) {
+                restoreDocument(edit, applied);
+            }
+        }
+
+        if (applied < edit.lines.size()) {
+            *error = QString("Could not edit %1").arg(document->url().toLocalFile());
+            for (int j = i - 1; j >= 0; --j) {
+                const DocumentEdit &previous = job->documents.at(j);
+                if (previous.document) {
+                    KTextEditor::Document::EditingTransaction transaction(previous.document);
+                    restoreDocument(previous, previous.lines.size());
+                }
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void ProjectReplace::restoreDocument(const DocumentEdit &edit, int applied)
+{
+    // lines went in bottom up, so they come back out top down
+    for (int i = applied - 1; i >= 0; --i) {
+        const LineEdit &line = edit.lines.at(i);
+        const KTextEditor::Cursor start(line.line, 0);
+        edit.document->replaceText(KTextEditor::Range(start, DocumentSearch::endOf(start, line.replaced)),
+                                   line.original);
+    }
+}
+
+void ProjectReplace::removeFiles(ReplaceJob *job, bool temporary, bool backup)
+{
+    for (const FileEdit &file : job->files) {
+        if (temporary) {
+            ::unlink(QFile::encodeName(file.temporaryPath).constData());
+        }
+        if (backup) {
+            ::unlink(QFile::encodeName(file.backupPath).constData());
+        }
+    }
+}
+
+void ProjectReplace::fail(ReplaceJob *job, const QString &error)
+{
+    QMutexLocker locker(&job->errorMutex);
+    if (!job->failed.loadAcquire()) {
+        job->error = error;
+        job->failed.storeRelease(1);
+    }
+}
+
+bool ProjectReplace::isCurrent(int generation) const
+{
+    return m_generation.loadAcquire() == generation;
+}
+
+void ProjectReplace::setError(const QString &error)
+{
+    m_lastError = error;
+}
+
+QString ProjectReplace::rewriteLine(const SearchPattern &pattern, const QString &text, const QVector<SearchHit> &hits,
+                                    int first, int end, const QString &replacement, bool *verified)
+{
+    *verified = false;
+
+    QString result;
+    int copied = 0;
+    for (int i = first; i < end; ++i) {
+        const int column = hits.at(i).column - 1;
+        int length = 0;
+        // the hit must still be a match of the pattern, at the same place and size
+        if (column < copied || pattern.indexIn(text, column, &length) != column || length != hits.at(i).length) {
+            return QString();
+        }
+        result.append(text.midRef(copied, column - copied));
+        result.append(pattern.replacementAt(text, column, replacement));
+        copied = column + length;
+    }
+    result.append(text.midRef(copied));
+
+    *verified = true;
+    return result;
+}
@@ -0,0 +1,537 @@
+// multi-threaded find in files
+// workers map each file, jump between occurrences of the query's literal
+// text with memchr and only decode and verify the lines that contain it
+
+#include "project_search.h"
+#include "function_task.h"
+#include "document_search.h"
+#include "debug_log.h"
+#include <QFile>
+#include <QThread>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// files claimed per visit to the shared counter
+const int kFilesPerClaim = 16;
+// hits are posted when this many are pending, or after kFlushInterval ms
+const int kFlushHits = 256;
+const int kFlushInterval = 50;
+const qint64 kMaxFileSize = 64 * 1024 * 1024;
+const int kPreviewLength = 300;
+
+inline char foldAscii(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+}
+
+bool isAscii(const QByteArray &text)
+{
+    for (char c : text) {
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char *findCaseSensitive(const char *begin, const char *end, const QByteArray &needle)
+{
+    const char first = needle.at(0);
+    const int length = needle.size();
+
+    const char *cursor = begin;
+    while (end - cursor >= length) {
+        const char *candidate = static_cast<const char*>(std::memchr(cursor, first, end - cursor - length + 1));
+        if (!candidate) {
+            return nullptr;
+        }
+        if (std::memcmp(candidate + 1, needle.constData() + 1, length - 1) == 0) {
+            return candidate;
+        }
+        cursor = candidate + 1;
+    }
+    return nullptr;
+}
+
+// needle is already folded to lower case ascii
+const char *findCaseInsensitive(const char *begin, const char *end, const QByteArray &needle)
+{
+    const char lower = needle.at(0);
+    const char upper = (lower >= 'a' && lower <= 'z') ? char(lower - ('a' - 'A')) : lower;
+    const int length = needle.size();
+
+    const char *cursor = begin;
+    while (end - cursor >= length) {
+        const char *last = end - length + 1;
+
+        // memchr for both cases of the first byte and take the nearer hit
+        const char *nextLower = static_cast<const char*>(std::memchr(cursor, lower, last - cursor));
+        const char *nextUpper = upper == lower ? nullptr
+            : static_cast<const char*>(std::memchr(cursor, upper, (nextLower ? nextLower : last) - cursor));
+
+        const char *candidate = nextUpper ? nextUpper : nextLower;
+        if (!candidate) {
+            return nullptr;
+        }
+
+        int i = 1;
+        while (i < length && foldAscii(candidate[i]) == needle.at(i)) {
+            ++i;
+        }
+        if (i == length) {
+            return candidate;
+        }
+        cursor = candidate + 1;
+    }
+    return nullptr;
+}
+
+bool isWordCharacter(QChar c)
+{
+    return c.isLetterOrNumber() || c == '_';
+}
+
+}
+
+ProjectSearch::ProjectSearch(QObject *parent)
+    : QObject(parent)
+    , m_pool(new QThreadPool(this))
+    , m_generation(0)
+    , m_maxHits(20000)
+{
+    m_pool->setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+}
+
+ProjectSearch::~ProjectSearch()
+{
+    cancel();
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+int ProjectSearch::start(const QSharedPointer<const ProjectFileTable> &files, const SearchQuery &request,
+                         const TrigramIndex *index)
+{
+    cancel();
+    m_lastError.clear();
+
+    SearchQuery query = request;
+    if (query.identifier) {
+        query.regex = false;
+        query.caseSensitive = true;
+        query.wholeWord = true;
+    }
+
+    if (!files || query.pattern.isEmpty()) {
+        return -1;
+    }
+
+    QSharedPointer<SearchJob> job(new SearchJob);
+    job->files = files;
+    job->query = query;
+    job->maxHits = m_maxHits;
+
+    const QString literal = query.regex ? requiredLiteral(query.pattern) : query.pattern;
+
+    QRegularExpression regex = SearchPattern::expressionFor(query.pattern, query.regex, query.caseSensitive,
+                                                            query.wholeWord);
+    job->expression = regex.pattern();
+    job->options = regex.patternOptions();
+    if (!regex.isValid()) {
+        m_lastError = regex.errorString();
+        return -1;
+    }
+
+    // folding is byte based, so a case insensitive prefilter needs ascii text
+    job->literal = literal.toUtf8();
+    job->literalCaseSensitive = query.caseSensitive;
+    if (!query.caseSensitive) {
+        if (isAscii(job->literal)) {
+            job->literal = job->literal.toLower();
+        } else {
+            job->literal.clear();
+        }
+    }
+
+    if (index && !job->literal.isEmpty()) {
+        job->narrowed = index->candidateFiles(job->literal, files, &job->candidates);
+    }
+    const int searchCount = job->narrowed ? job->candidates.size() : files->fileCount();
+
+    job->generation = m_generation.fetchAndAddOrdered(1) + 1;
+    m_job = job;
+
+    DEBUG_LOG_EDITOR("Project search" << job->generation << "for" << query.pattern
+                     << "over" << searchCount << "of" << files->fileCount() << "files, prefilter:" << job->literal);
+
+    int workers = qMin(m_pool->maxThreadCount(), qMax(1, searchCount / kFilesPerClaim));
+    job->pending.storeRelease(workers);
+    for (int i = 0; i < workers; ++i) {
+        m_pool->start(new FunctionTask([this, job]() {
+            runWorker(job);
+        }));
+    }
+
+    return job->generation;
+}
+
+void ProjectSearch::cancel()
+{
+    if (m_job) {
+        // workers compare against the counter between files and stop
+        m_generation.fetchAndAddOrdered(1);
+        m_job.reset();
+    }
+}
+
+bool ProjectSearch::isRunning() const
+{
+    return !m_job.isNull();
+}
+
+void ProjectSearch::setMaxHits(int maxHits)
+{
+    m_maxHits = maxHits;
+}
+
+QString ProjectSearch::lastError() const
+{
+    return m_lastError;
+}
+
+QString ProjectSearch::requiredLiteral(const QString &pattern)
+{
+    // alternation and inline options can make any single run optional
+    if (pattern.contains('|') || pattern.contains("(?")) {
+        return QString();
+    }
+
+    QString best;
+    QString current;
+    int depth = 0;
+
+    auto endRun = [&]() {
+        if (current.size() > best.size()) {
+            best = current;
+        }
+        current.clear();
+    };
+
+    const int size = pattern.size();
+    for (int i = 0; i < size; ++i) {
+        QChar c = pattern.at(i);
+
+        if (c == '\\') {
+            if (i + 1 >= size) {
+                break;
+            }
+            c = pattern.at(++i);
+            if (c.isLetterOrNumber()) {
+                // character classes, anchors and back references
+                endRun();
+                continue;
+            }
+        } else if (c == '[') {
+            endRun();
+            ++i;
+            if (i < size && pattern.at(i) == '^') {
+                ++i;
+            }
+            if (i < size && pattern.at(i) == ']') {
+                ++i;
+            }
+            while (i < size && pattern.at(i) != ']') {
+                if (pattern.at(i) == '\\') {
+                    ++i;
+                }
+                ++i;
+            }
+            continue;
+        } else if (c == '(') {
+            endRun();
+            ++depth;
+            continue;
+        } else if (c == ')') {
+            endRun();
+            depth = qMax(0, depth - 1);
+            continue;
+        } else if (c == '{') {
+            endRun();
+            while (i < size && pattern.at(i) != '}') {
+                ++i;
+            }
+            continue;
+        } else if (QString(".^$*+?}").contains(c)) {
+            endRun();
+            continue;
+        }
+
+        // groups may be repeated zero times, so only top level text counts
+        if (depth > 0) {
+            continue;
+        }
+
+        QChar next = i + 1 < size ? pattern.at(i + 1) : QChar();
+        if (next == '*' || next == '?' || next == '{') {
+            endRun();
+            continue;
+        }
+
+        current.append(c);
+        if (next == '+') {
+            endRun();
+        }
+    }
+    endRun();
+
+    return best;
+}
+
+SearchHit ProjectSearch::makeHit(const QString &path, const QString &text, int lineNumber, int column, int length)
+{
+    SearchHit hit;
+    hit.path = path;
+    hit.line = lineNumber;
+    hit.column = column + 1;
+    hit.length = length;
+
+    if (text.size() <= kPreviewLength) {
+        hit.preview = text;
+        hit.previewColumn = column;
+    } else {
+        int start = qMax(0, qMin(column - kPreviewLength / 3, text.size() - kPreviewLength));
+        hit.preview = text.mid(start, kPreviewLength);
+        hit.previewColumn = column - start;
+    }
+    return hit;
+}
+
+void ProjectSearch::runWorker(const QSharedPointer<SearchJob> &job)
+{
+    // each worker compiles its own copy of the expression
+    QRegularExpression regex(job->expression, job->options);
+
+    const int fileCount = job->narrowed ? job->candidates.size() : job->files->fileCount();
+    QVector<SearchHit> hits;
+    QElapsedTimer flushTimer;
+    flushTimer.start();
+
+    while (isCurrent(job->generation) && job->hitCount.loadAcquire() < job->maxHits) {
+        int first = job->nextFile.fetchAndAddRelaxed(kFilesPerClaim);
+        if (first >= fileCount) {
+            break;
+        }
+
+        int last = qMin(first + kFilesPerClaim, fileCount);
+        for (int file = first; file < last && isCurrent(job->generation); ++file) {
+            searchFile(job.data(), regex, job->narrowed ? job->candidates.at(file) : file, &hits);
+
+            // flush between files so one file's hits always arrive together
+            if (hits.size() >= kFlushHits || (!hits.isEmpty() && flushTimer.elapsed() >= kFlushInterval)) {
+                postHits(job->generation, hits);
+                hits.clear();
+                flushTimer.restart();
+            }
+        }
+    }
+
+    if (!hits.isEmpty()) {
+        postHits(job->generation, hits);
+    }
+
+    if (!job->pending.deref()) {
+        int generation = job->generation;
+        int hitCount = qMin(job->hitCount.loadAcquire(), job->maxHits);
+        int filesSearched = job->filesSearched.loadAcquire();
+
+        QMetaObject::invokeMethod(this, [this, generation, hitCount, filesSearched]() {
+            if (!isCurrent(generation)) {
+                return;
+            }
+            m_job.reset();
+            emit finished(generation, hitCount, filesSearched);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void ProjectSearch::searchFile(SearchJob *job, const QRegularExpression &regex, int file, QVector<SearchHit> *hits)
+{
+    const QString path = job->files->absolutePath(file);
+
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    qint64 size = input.size();
+    if (size <= 0 || size > kMaxFileSize) {
+        return;
+    }
+
+    QByteArray buffer;
+    uchar *mapped = input.map(0, size);
+    const char *begin = nullptr;
+    if (mapped) {
+        begin = reinterpret_cast<const char*>(mapped);
+    } else {
+        buffer = input.readAll();
+        begin = buffer.constData();
+        size = buffer.size();
+    }
+    const char *end = begin + size;
+
+    job->filesSearched.ref();
+
+    // identifiers are checked against the file's tokens, which drops hits in
+    // comments and strings; files no lexer knows fall back to whole word
+    if (job->query.identifier) {
+        SymbolLexer::Language language = SymbolLexer::languageFor(path);
+        if (language != SymbolLexer::Unknown) {
+            if (findCaseSensitive(begin, end, job->literal)) {
+                searchIdentifiers(job, language, path, begin, end, hits);
+            }
+            if (mapped) {
+                input.unmap(mapped);
+            }
+            return;
+        }
+    }
+
+    const QByteArray &literal = job->literal;
+    int lineNumber = 1;
+    const char *counted = begin;
+
+    if (!literal.isEmpty()) {
+        const char *cursor = begin;
+        while (cursor < end) {
+            const char *found = job->literalCaseSensitive
+                ? findCaseSensitive(cursor, end, literal)
+                : findCaseInsensitive(cursor, end, literal);
+            if (!found) {
+                break;
+            }
+
+            const char *lineStart = found;
+            while (lineStart > cursor && lineStart[-1] != '\n') {
+                --lineStart;
+            }
+            const char *lineEnd = static_cast<const char*>(std::memchr(found, '\n', end - found));
+            if (!lineEnd) {
+                lineEnd = end;
+            }
+
+            lineNumber += std::count(counted, lineStart, '\n');
+            counted = lineStart;
+
+            verifyLine(job, regex, path, QString::fromUtf8(lineStart, lineEnd - lineStart), lineNumber, hits);
+            cursor = lineEnd + 1;
+        }
+    } else {
+        // no literal to anchor on, every line goes through the expression
+        const char *lineStart = begin;
+        while (lineStart < end) {
+            const char *lineEnd = static_cast<const char*>(std::memchr(lineStart, '\n', end - lineStart));
+            if (!lineEnd) {
+                lineEnd = end;
+            }
+
+            verifyLine(job, regex, path, QString::fromUtf8(lineStart, lineEnd - lineStart), lineNumber, hits);
+            ++lineNumber;
+            lineStart = lineEnd + 1;
+        }
+    }
+
+    if (mapped) {
+        input.unmap(mapped);
+    }
+}
+
+void ProjectSearch::verifyLine(SearchJob *job, const QRegularExpression &regex, const QString &path,
+                               const QString &line, int lineNumber, QVector<SearchHit> *hits)
+{
+    QString text = line;
+    if (text.endsWith('\r')) {
+        text.chop(1);
+    }
+
+    auto addHit = [&](int column, int length) {
+        hits->append(makeHit(path, text, lineNumber, column, length));
+        job->hitCount.ref();
+    };
+
+    if (!job->query.regex && !job->query.wholeWord) {
+        Qt::CaseSensitivity sensitivity = job->query.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+        const QString &pattern = job->query.pattern;
+
+        int from = 0;
+        while ((from = text.indexOf(pattern, from, sensitivity)) >= 0) {
+            addHit(from, pattern.size());
+            from += qMax(1, pattern.size());
+        }
+        return;
+    }
+
+    QRegularExpressionMatchIterator matches = regex.globalMatch(text);
+    while (matches.hasNext()) {
+        QRegularExpressionMatch match = matches.next();
+        if (match.capturedLength() == 0) {
+            continue;
+        }
+
+        int column = match.capturedStart();
+        if (job->query.wholeWord && !job->query.regex) {
+            // \b does not treat '_' as a word character in every engine mode
+            if ((column > 0 && isWordCharacter(text.at(column - 1)))
+                || (match.capturedEnd() < text.size() && isWordCharacter(text.at(match.capturedEnd())))) {
+                continue;
+            }
+        }
+
+        addHit(column, match.capturedLength());
+    }
+}
+
+void ProjectSearch::searchIdentifiers(SearchJob *job, SymbolLexer::Language language, const QString &path,
+                                      const char *begin, const char *end, QVector<SearchHit> *hits)
+{
+    QVector<SourceReference> references;
+    SymbolLexer::findIdentifier(language, QByteArray::fromRawData(begin, int(end - begin)), job->literal,
+                                &references);
+
+    for (const SourceReference &reference : references) {
+        const char *position = begin + reference.offset;
+        const char *lineStart = position;
+        while (lineStart > begin && lineStart[-1] != '\n') {
+            --lineStart;
+        }
+        const char *lineEnd = static_cast<const char*>(std::memchr(position, '\n', end - position));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+
+        QString text = QString::fromUtf8(lineStart, int(lineEnd - lineStart));
+        if (text.endsWith('\r')) {
+            text.chop(1);
+        }
+
+        hits->append(makeHit(path, text, reference.line, reference.column - 1, job->query.pattern.size()));
+        job->hitCount.ref();
+    }
+}
+
+void ProjectSearch::postHits(int generation, const QVector<SearchHit> &hits)
+{
+    QMetaObject::invokeMethod(this, [this, generation, hits]() {
+        if (isCurrent(generation)) {
+            emit hitsFound(generation, hits);
+        }
+    }, Qt::QueuedConnection);
+}
+
+bool ProjectSearch::isCurrent(int generation) const
+{
+    return m_generation.loadAcquire() == generation;
+}
@@ -0,0 +1,699 @@
+// lazy project tree model used by the file tree widget
+// lists directories on expansion using a worker thread and relists only
+// what the user can see, so large repositories stay cheap to open
+
+#include "project_tree_model.h"
+#include "function_task.h"
+#include "ignore_rules.h"
+#include "debug_log.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <algorithm>
+
+namespace {
+
+// rows inserted per event loop pass, keeps huge directories from blocking paint
+const int kInsertBatchSize = 512;
+
+}
+
+ProjectTreeModel::ProjectTreeModel(QObject *parent)
+    : QAbstractItemModel(parent)
+    , m_root(nullptr)
+    , m_pool(new QThreadPool(this))
+    , m_nextRequest(0)
+    , m_batchTimer(new QTimer(this))
+    , m_watchService(nullptr)
+    , m_gitStatus(nullptr)
+{
+    m_pool->setMaxThreadCount(2);
+
+    m_batchTimer->setSingleShot(true);
+    m_batchTimer->setInterval(0);
+    connect(m_batchTimer, &QTimer::timeout, this, &ProjectTreeModel::processInsertBatches);
+}
+
+ProjectTreeModel::~ProjectTreeModel()
+{
+    m_pool->clear();
+    m_pool->waitForDone();
+
+    delete m_root;
+}
+
+void ProjectTreeModel::setRootPath(const QString &path)
+{
+    QString absolutePath = QDir(path).absolutePath();
+    if (m_root && absolutePath == m_rootPath) {
+        return;
+    }
+
+    beginResetModel();
+
+    if (m_root) {
+        forgetNode(m_root);
+        delete m_root;
+    }
+
+    m_rootPath = absolutePath;
+    m_root = new ProjectTreeNode;
+    m_root->name = m_rootPath;
+    m_root->isDir = true;
+    m_root->expanded = true;
+
+    endResetModel();
+
+    startListing(m_root);
+    DEBUG_LOG_EDITOR("Project tree root set to:" << m_rootPath);
+}
+
+QString ProjectTreeModel::rootPath() const
+{
+    return m_rootPath;
+}
+
+void ProjectTreeModel::setGitStatus(GitStatus *gitStatus)
+{
+    if (m_gitStatus) {
+        disconnect(m_gitStatus, nullptr, this, nullptr);
+    }
+
+    m_gitStatus = gitStatus;
+    if (m_gitStatus) {
+        connect(m_gitStatus, &GitStatus::statusChanged, this, &ProjectTreeModel::onGitStatusChanged);
+    }
+    onGitStatusChanged();
+}
+
+void ProjectTreeModel::setWatchService(FileWatchService *watchService)
+{
+    if (m_watchService) {
+        disconnect(m_watchService, nullptr, this, nullptr);
+        for (auto it = m_watchedNodes.constBegin(); it != m_watchedNodes.constEnd(); ++it) {
+            m_watchService->unpinDirectory(it.key());
+        }
+    }
+
+    m_watchService = watchService;
+    if (!m_watchService) {
+        return;
+    }
+
+    connect(m_watchService, &FileWatchService::pathsChanged, this, &ProjectTreeModel::onPathsChanged);
+    // dropped events could hide any change, so everything visible is relisted
+    connect(m_watchService, &FileWatchService::eventsLost, this, &ProjectTreeModel::refresh);
+    for (auto it = m_watchedNodes.constBegin(); it != m_watchedNodes.constEnd(); ++it) {
+        m_watchService->pinDirectory(it.key());
+    }
+}
+
+QString ProjectTreeModel::filePath(const QModelIndex &index) const
+{
+    ProjectTreeNode *node = nodeFor(index);
+    return node ? pathFor(node) : QString();
+}
+
+bool ProjectTreeModel::isDir(const QModelIndex &index) const
+{
+    ProjectTreeNode *node = nodeFor(index);
+    return node && node->isDir;
+}
+
+bool ProjectTreeModel::isListed(const QModelIndex &index) const
+{
+    ProjectTreeNode *node = nodeFor(index);
+    return node && node->state == ProjectTreeNode::Listed;
+}
+
+QModelIndex ProjectTreeModel::indexForPath(const QString &path) const
+{
+    if (!m_root) {
+        return QModelIndex();
+    }
+
+    QString relativePath = QDir(m_rootPath).relativeFilePath(QDir(path).absolutePath());
+    if (relativePath == QLatin1String(".") || relativePath.isEmpty()) {
+        return QModelIndex();
+    }
+
+    ProjectTreeNode *node = m_root;
+    const QStringList parts = relativePath.split('/', QString::SkipEmptyParts);
+    for (const QString &part : parts) {
+        ProjectTreeNode *next = nullptr;
+        for (ProjectTreeNode *child : node->children) {
+            if (child->name == part) {
+                next = child;
+                break;
+            }
+        }
+        if (!next) {
+            return QModelIndex();
+        }
+        node = next;
+    }
+
+    return indexFor(node);
+}
+
+void ProjectTreeModel::setExpanded(const QModelIndex &index, bool expanded)
+{
+    ProjectTreeNode *node = nodeFor(index);
+    if (!node || !node->isDir || node == m_root) {
+        return;
+    }
+
+    node->expanded = expanded;
+
+    if (expanded) {
+        if (node->state == ProjectTreeNode::Listed) {
+            watchNode(node);
+        }
+    } else {
+        unwatchNode(node);
+    }
+}
+
+void ProjectTreeModel::releaseChildren(const QModelIndex &index)
+{
+    ProjectTreeNode *node = nodeFor(index);
+    if (!node || !node->isDir || node == m_root) {
+        return;
+    }
+
+    node->expanded = false;
+    forgetNode(node);
+    node->pending.clear();
+    node->pendingOffset = 0;
+
+    if (!node->children.isEmpty()) {
+        beginRemoveRows(index, 0, node->children.size() - 1);
+        qDeleteAll(node->children);
+        node->children.clear();
+        endRemoveRows();
+    }
+
+    // back to unlisted so the expander shows and fetchMore lists it again
+    node->state = ProjectTreeNode::Unlisted;
+    emit dataChanged(index, index);
+}
+
+void ProjectTreeModel::refresh()
+{
+    const QList<ProjectTreeNode*> nodes = m_watchedNodes.values();
+    for (ProjectTreeNode *node : nodes) {
+        startListing(node);
+    }
+}
+
+void ProjectTreeModel::refreshDirectory(const QString &dirPath)
+{
+    ProjectTreeNode *node = m_watchedNodes.value(QDir(dirPath).absolutePath());
+    if (node) {
+        startListing(node);
+    }
+}
+
+QModelIndex ProjectTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    ProjectTreeNode *parentNode = nodeFor(parent);
+    if (!parentNode || column != 0 || row < 0 || row >= parentNode->children.size()) {
+        return QModelIndex();
+    }
+
+    return createIndex(row, column, parentNode->children.at(row));
+}
+
+QModelIndex ProjectTreeModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return QModelIndex();
+    }
+
+    ProjectTreeNode *node = static_cast<ProjectTreeNode*>(index.internalPointer());
+    return indexFor(node->parent);
+}
+
+int ProjectTreeModel::rowCount(const QModelIndex &parent) const
+{
+    ProjectTreeNode *node = nodeFor(parent);
+    return node ? node->children.size() : 0;
+}
+
+int ProjectTreeModel::columnCount(const QModelIndex &) const
+{
+    return 1;
+}
+
+QVariant ProjectTreeModel::data(const QModelIndex &index, int role) const
+{
+    ProjectTreeNode *node = nodeFor(index);
+    if (!node || node == m_root) {
+        return QVariant();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return node->name;
+    case Qt::ToolTipRole:
+    case FilePathRole:
+        return pathFor(node);
+    case IsDirRole:
+        return node->isDir;
+    case GitStatusRole:
+        return gitStatusFor(node);
+    case Qt::DecorationRole: {
+        if (node->isDir) {
+            return m_iconProvider.icon(QFileIconProvider::Folder);
+        }
+
+        // icon lookup may stat and query mime data, so do it once per suffix
+        QString suffix = QFileInfo(node->name).suffix().toLower();
+        auto it = m_iconCache.constFind(suffix);
+        if (it == m_iconCache.constEnd()) {
+            it = m_iconCache.insert(suffix, m_iconProvider.icon(QFileInfo(pathFor(node))));
+        }
+        return it.value();
+    }
+    default:
+        return QVariant();
+    }
+}
+
+Qt::ItemFlags ProjectTreeModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+
+    Qt::ItemFlags itemFlags = Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+    if (!isDir(index)) {
+        itemFlags |= Qt::ItemNeverHasChildren;
+    }
+    return itemFlags;
+}
+
+bool ProjectTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    ProjectTreeNode *node = nodeFor(parent);
+    if (!node || !node->isDir) {
+        return false;
+    }
+
+    // unlisted directories show an expander until fetchMore proves them empty
+    if (node->state == ProjectTreeNode::Listed) {
+        return !node->children.isEmpty();
+    }
+    return true;
+}
+
+bool ProjectTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    ProjectTreeNode *node = nodeFor(parent);
+    return node && node->isDir && node->state == ProjectTreeNode::Unlisted;
+}
+
+void ProjectTreeModel::fetchMore(const QModelIndex &parent)
+{
+    ProjectTreeNode *node = nodeFor(parent);
+    if (node && node->isDir && node->state == ProjectTreeNode::Unlisted) {
+        startListing(node);
+    }
+}
+
+bool ProjectTreeModel::entryLessThan(const ProjectTreeEntry &left, const ProjectTreeEntry &right)
+{
+    if (left.isDir != right.isDir) {
+        return left.isDir;
+    }
+
+    int result = QString::compare(left.name, right.name, Qt::CaseInsensitive);
+    if (result != 0) {
+        return result < 0;
+    }
+    return left.name < right.name;
+}
+
+void ProjectTreeModel::onPathsChanged(const QStringList &directories, const QStringList &files)
+{
+    Q_UNUSED(files)
+
+    // the service already coalesced the burst, and reports paths under its own root
+    const QString rootPath = m_watchService->rootPath();
+    for (const QString &directory : directories) {
+        const QString path = directory.isEmpty() ? rootPath : rootPath + QLatin1Char('/') + directory;
+        ProjectTreeNode *node = m_watchedNodes.value(path);
+        if (!node) {
+            continue;
+        }
+
+        if (!QFileInfo::exists(path)) {
+            // the parent's own change notification removes the row
+            unwatchNode(node);
+            continue;
+        }
+
+        startListing(node);
+    }
+}
+
+void ProjectTreeModel::processInsertBatches()
+{
+    int budget = kInsertBatchSize;
+
+    while (budget > 0 && !m_batchQueue.isEmpty()) {
+        ProjectTreeNode *node = m_batchQueue.first();
+
+        int remaining = node->pending.size() - node->pendingOffset;
+        int count = qMin(budget, remaining);
+
+        if (count > 0) {
+            int first = node->children.size();
+            beginInsertRows(indexFor(node), first, first + count - 1);
+            node->children.reserve(node->pending.size());
+            for (int i = 0; i < count; ++i) {
+                const ProjectTreeEntry &entry = node->pending.at(node->pendingOffset + i);
+
+                ProjectTreeNode *child = new ProjectTreeNode;
+                child->name = entry.name;
+                child->isDir = entry.isDir;
+                child->ignored = entry.ignored;
+                child->parent = node;
+                child->row = first + i;
+                node->children.append(child);
+            }
+            endInsertRows();
+
+            node->pendingOffset += count;
+            budget -= count;
+        }
+
+        if (node->pendingOffset >= node->pending.size()) {
+            node->pending.clear();
+            node->pendingOffset = 0;
+            node->state = ProjectTreeNode::Listed;
+            m_batchQueue.removeFirst();
+
+            if (node->expanded) {
+                watchNode(node);
+            }
+            emit directoryLoaded(pathFor(node));
+        }
+    }
+
+    if (!m_batchQueue.isEmpty()) {
+        m_batchTimer->start();
+    }
+}
+
+void ProjectTreeModel::onGitStatusChanged()
+{
+    if (m_root) {
+        emitGitStatusChanged(m_root);
+    }
+}
+
+void ProjectTreeModel::emitGitStatusChanged(ProjectTreeNode *node)
+{
+    if (node->children.isEmpty()) {
+        return;
+    }
+
+    // only loaded rows can be showing a decoration
+    QModelIndex parentIndex = indexFor(node);
+    emit dataChanged(index(0, 0, parentIndex), index(node->children.size() - 1, 0, parentIndex),
+                     { GitStatusRole });
+
+    for (ProjectTreeNode *child : node->children) {
+        if (child->isDir) {
+            emitGitStatusChanged(child);
+        }
+    }
+}
+
+GitStatus::Status ProjectTreeModel::gitStatusFor(const ProjectTreeNode *node) const
+{
+    if (!m_gitStatus || !m_gitStatus->isRepository() || m_gitStatus->rootPath() != m_rootPath) {
+        return GitStatus::None;
+    }
+
+    QString relativePath = pathFor(node).mid(m_rootPath.size() + 1);
+    if (node->isDir) {
+        return node->ignored ? GitStatus::Ignored : m_gitStatus->directoryStatus(relativePath);
+    }
+
+    // tracked files stay tracked even when a pattern matches them
+    GitStatus::Status status = m_gitStatus->fileStatus(relativePath);
+    if (node->ignored && (status == GitStatus::None || status == GitStatus::Untracked)) {
+        return GitStatus::Ignored;
+    }
+    return status;
+}
+
+ProjectTreeNode *ProjectTreeModel::nodeFor(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return m_root;
+    }
+    return static_cast<ProjectTreeNode*>(index.internalPointer());
+}
+
+QModelIndex ProjectTreeModel::indexFor(ProjectTreeNode *node) const
+{
+    if (!node || node == m_root) {
+        return QModelIndex();
+    }
+    return createIndex(node->row, 0, node);
+}
+
+QString ProjectTreeModel::pathFor(const ProjectTreeNode *node) const
+{
+    if (!node || node == m_root) {
+        return m_rootPath;
+    }
+
+    QString path = node->name;
+    for (const ProjectTreeNode *ancestor = node->parent; ancestor && ancestor != m_root; ancestor = ancestor->parent) {
+        path.prepend(ancestor->name + QLatin1Char('/'));
+    }
+
+    if (m_rootPath.endsWith(QLatin1Char('/'))) {
+        return m_rootPath + path;
+    }
+    return m_rootPath + QLatin1Char('/') + path;
+}
+
+void ProjectTreeModel::startListing(ProjectTreeNode *node)
+{
+    // a listing still being inserted is left to finish; the watch picks up later changes
+    if (node->state == ProjectTreeNode::Listing && !node->pending.isEmpty()) {
+        return;
+    }
+
+    if (node->request != 0) {
+        m_requests.remove(node->request);
+    }
+
+    node->request = ++m_nextRequest;
+    m_requests.insert(node->request, node);
+    if (node->state == ProjectTreeNode::Unlisted) {
+        node->state = ProjectTreeNode::Listing;
+    }
+
+    QString rootPath = m_rootPath;
+    QString dirPath = pathFor(node);
+    quint64 request = node->request;
+
+    // the destructor waits for the pool, and queued calls to a deleted model are
+    // dropped, so results only ever reach a live model; stale requests are ignored
+    m_pool->start(new FunctionTask([this, rootPath, dirPath, request]() {
+        QVector<ProjectTreeEntry> entries = listDirectory(rootPath, dirPath);
+
+        QMetaObject::invokeMethod(this, [this, request, entries]() {
+            applyListing(request, entries);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void ProjectTreeModel::applyListing(quint64 request, const QVector<ProjectTreeEntry> &entries)
+{
+    ProjectTreeNode *node = m_requests.take(request);
+    if (!node) {
+        return;
+    }
+    node->request = 0;
+
+    if (node->state == ProjectTreeNode::Listed) {
+        mergeListing(node, entries);
+        return;
+    }
+
+    if (entries.isEmpty()) {
+        // no rows to insert, but the view has to drop the expander
+        node->state = ProjectTreeNode::Listed;
+        QModelIndex index = indexFor(node);
+        if (index.isValid()) {
+            emit dataChanged(index, index);
+        }
+        if (node->expanded) {
+            watchNode(node);
+        }
+        emit directoryLoaded(pathFor(node));
+        return;
+    }
+
+    node->pending = entries;
+    node->pendingOffset = 0;
+    m_batchQueue.append(node);
+    m_batchTimer->start();
+}
+
+void ProjectTreeModel::mergeListing(ProjectTreeNode *node, const QVector<ProjectTreeEntry> &entries)
+{
+    // both sides are sorted with entryLessThan, so one pass finds removals and inserts
+    // while unchanged directories keep their loaded subtrees
+    int row = 0;
+    int next = 0;
+
+    while (row < node->children.size() || next < entries.size()) {
+        if (row < node->children.size() && next < entries.size()) {
+            ProjectTreeNode *child = node->children.at(row);
+            const ProjectTreeEntry &entry = entries.at(next);
+
+            if (child->name == entry.name && child->isDir == entry.isDir) {
+                // an edited ignore file can flip entries that stay in place
+                if (child->ignored != entry.ignored) {
+                    child->ignored = entry.ignored;
+                    QModelIndex childIndex = indexFor(child);
+                    emit dataChanged(childIndex, childIndex, { GitStatusRole });
+                }
+                ++row;
+                ++next;
+                continue;
+            }
+
+            ProjectTreeEntry existing;
+            existing.name = child->name;
+            existing.isDir = child->isDir;
+
+            if (entryLessThan(existing, entry)) {
+                removeChild(node, row);
+            } else {
+                insertChild(node, row, entry);
+                ++row;
+                ++next;
+            }
+        } else if (row < node->children.size()) {
+            removeChild(node, row);
+        } else {
+            insertChild(node, row, entries.at(next));
+            ++row;
+            ++next;
+        }
+    }
+}
+
+void ProjectTreeModel::insertChild(ProjectTreeNode *node, int row, const ProjectTreeEntry &entry)
+{
+    beginInsertRows(indexFor(node), row, row);
+
+    ProjectTreeNode *child = new ProjectTreeNode;
+    child->name = entry.name;
+    child->isDir = entry.isDir;
+    child->ignored = entry.ignored;
+    child->parent = node;
+    node->children.insert(row, child);
+    renumberChildren(node, row);
+
+    endInsertRows();
+}
+
+void ProjectTreeModel::removeChild(ProjectTreeNode *node, int row)
+{
+    beginRemoveRows(indexFor(node), row, row);
+
+    ProjectTreeNode *child = node->children.takeAt(row);
+    forgetNode(child);
+    delete child;
+    renumberChildren(node, row);
+
+    endRemoveRows();
+}
+
+void ProjectTreeModel::renumberChildren(ProjectTreeNode *node, int from)
+{
+    for (int i = from; i < node->children.size(); ++i) {
+        node->children[i]->row = i;
+    }
+}
+
+void ProjectTreeModel::watchNode(ProjectTreeNode *node)
+{
+    QString path = pathFor(node);
+    if (m_watchedNodes.contains(path)) {
+        return;
+    }
+
+    m_watchedNodes.insert(path, node);
+    if (m_watchService) {
+        m_watchService->pinDirectory(path);
+    }
+}
+
+void ProjectTreeModel::unwatchNode(ProjectTreeNode *node)
+{
+    QString path = pathFor(node);
+    if (m_watchedNodes.value(path) == node) {
+        m_watchedNodes.remove(path);
+        if (m_watchService) {
+            m_watchService->unpinDirectory(path);
+        }
+    }
+}
+
+void ProjectTreeModel::forgetNode(ProjectTreeNode *node)
+{
+    if (!node->isDir) {
+        return;
+    }
+
+    if (node->request != 0) {
+        m_requests.remove(node->request);
+        node->request = 0;
+    }
+    m_batchQueue.removeAll(node);
+    unwatchNode(node);
+
+    for (ProjectTreeNode *child : node->children) {
+        forgetNode(child);
+    }
+}
+
+QVector<ProjectTreeEntry> ProjectTreeModel::listDirectory(const QString &rootPath, const QString &dirPath)
+{
+    QVector<ProjectTreeEntry> entries;
+
+    // ignore rules are resolved here, off the gui thread, for the ignored decoration
+    QString relativeDirectory = QDir(rootPath).relativeFilePath(dirPath);
+    if (relativeDirectory == QLatin1String(".")) {
+        relativeDirectory.clear();
+    }
+    IgnoreMatcher matcher = IgnoreMatcher::forDirectory(rootPath, relativeDirectory);
+
+    QDirIterator iterator(dirPath, QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot);
+    while (iterator.hasNext()) {
+        iterator.next();
+        QFileInfo info = iterator.fileInfo();
+
+        ProjectTreeEntry entry;
+        entry.name = info.fileName();
+        entry.isDir = info.isDir();
+        QString relativePath = relativeDirectory.isEmpty() ? entry.name
+                                                           : relativeDirectory + QLatin1Char('/') + entry.name;
+        entry.ignored = matcher.isIgnored(relativePath, entry.isDir);
+        entries.append(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), &ProjectTreeModel::entryLessThan);
+    return entries;
+}
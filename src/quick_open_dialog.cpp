@@ -0,0 +1,121 @@
+// quick open popup shared by file and symbol navigation
+// results are recomputed on every keystroke by the caller's provider
+
+#include "quick_open_dialog.h"
+#include <QKeyEvent>
+#include <QApplication>
+
+QuickOpenDialog::QuickOpenDialog(QWidget *parent)
+    : QDialog(parent, Qt::Popup | Qt::FramelessWindowHint)
+    , m_layout(nullptr)
+    , m_queryEdit(nullptr)
+    , m_resultList(nullptr)
+{
+    m_layout = new QVBoxLayout(this);
+    m_layout->setContentsMargins(4, 4, 4, 4);
+    m_layout->setSpacing(4);
+
+    m_queryEdit = new QLineEdit(this);
+    m_queryEdit->installEventFilter(this);
+    m_layout->addWidget(m_queryEdit);
+
+    m_resultList = new QListWidget(this);
+    m_resultList->setUniformItemSizes(true);
+    m_resultList->setFocusPolicy(Qt::NoFocus);
+    m_layout->addWidget(m_resultList);
+
+    connect(m_queryEdit, &QLineEdit::textChanged, this, &QuickOpenDialog::onQueryChanged);
+    connect(m_queryEdit, &QLineEdit::returnPressed, this, &QuickOpenDialog::onItemActivated);
+    connect(m_resultList, &QListWidget::itemActivated, this, &QuickOpenDialog::onItemActivated);
+    connect(m_resultList, &QListWidget::itemClicked, this, &QuickOpenDialog::onItemActivated);
+
+    resize(600, 360);
+}
+
+void QuickOpenDialog::setProvider(const Provider &provider)
+{
+    m_provider = provider;
+}
+
+void QuickOpenDialog::setActivator(const Activator &activator)
+{
+    m_activator = activator;
+}
+
+void QuickOpenDialog::setPlaceholderText(const QString &text)
+{
+    m_queryEdit->setPlaceholderText(text);
+}
+
+void QuickOpenDialog::popup()
+{
+    QWidget *owner = parentWidget();
+    if (owner) {
+        int width = qMin(700, qMax(400, owner->width() / 2));
+        resize(width, height());
+
+        QPoint topCenter = owner->mapToGlobal(QPoint(owner->width() / 2, 0));
+        move(topCenter.x() - width / 2, topCenter.y() + 40);
+    }
+
+    m_queryEdit->clear();
+    onQueryChanged(QString());
+
+    show();
+    raise();
+    activateWindow();
+    m_queryEdit->setFocus();
+}
+
+bool QuickOpenDialog::eventFilter(QObject *watched, QEvent *event)
+{
+    // arrow keys move the selection while focus stays in the query line
+    if (watched == m_queryEdit && event->type() == QEvent::KeyPress) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
+        switch (keyEvent->key()) {
+        case Qt::Key_Up:
+        case Qt::Key_Down:
+        case Qt::Key_PageUp:
+        case Qt::Key_PageDown:
+            QApplication::sendEvent(m_resultList, event);
+            return true;
+        default:
+            break;
+        }
+    }
+
+    return QDialog::eventFilter(watched, event);
+}
+
+void QuickOpenDialog::onQueryChanged(const QString &query)
+{
+    m_items = m_provider ? m_provider(query) : QVector<QuickOpenItem>();
+
+    m_resultList->setUpdatesEnabled(false);
+    m_resultList->clear();
+    for (const QuickOpenItem &item : m_items) {
+        QString text = item.detail.isEmpty() ? item.title : QString("%1    %2").arg(item.title, item.detail);
+        QListWidgetItem *listItem = new QListWidgetItem(text, m_resultList);
+        listItem->setToolTip(item.detail);
+    }
+    m_resultList->setUpdatesEnabled(true);
+
+    if (m_resultList->count() > 0) {
+        m_resultList->setCurrentRow(0);
+    }
+}
+
+void QuickOpenDialog::onItemActivated()
+{
+    int row = m_resultList->currentRow();
+    if (row < 0 || row >= m_items.size()) {
+        return;
+    }
+
+    QuickOpenItem item = m_items.at(row);
+    hide();
+
+    if (m_activator) {
+        m_activator(item);
+    }
+}
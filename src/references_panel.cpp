@@ -0,0 +1,113 @@
+// find references panel
+// an identifier query on ProjectSearch: candidate files come from the trigram
+// index when there is one and every hit is checked against the file's tokens
+
+#include "references_panel.h"
+#include "debug_log.h"
+
+ReferencesPanel::ReferencesPanel(ProjectIndexer *indexer, QWidget *parent)
+    : QWidget(parent)
+    , m_indexer(indexer)
+    , m_search(new ProjectSearch(this))
+    , m_resultsModel(new SearchResultsModel(this))
+    , m_generation(-1)
+    , m_mainLayout(nullptr)
+    , m_statusLabel(nullptr)
+    , m_resultView(nullptr)
+{
+    setupUI();
+
+    connect(m_search, &ProjectSearch::hitsFound, this, &ReferencesPanel::onHitsFound);
+    connect(m_search, &ProjectSearch::finished, this, &ReferencesPanel::onSearchFinished);
+}
+
+void ReferencesPanel::setupUI()
+{
+    m_mainLayout = new QVBoxLayout(this);
+    m_mainLayout->setContentsMargins(4, 4, 4, 4);
+    m_mainLayout->setSpacing(4);
+
+    m_statusLabel = new QLabel(this);
+    m_mainLayout->addWidget(m_statusLabel);
+
+    m_resultView = new QTreeView(this);
+    m_resultView->setModel(m_resultsModel);
+    m_resultView->setHeaderHidden(true);
+    m_resultView->setUniformRowHeights(true);
+    m_resultView->setIndentation(12);
+    m_resultView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_mainLayout->addWidget(m_resultView);
+
+    connect(m_resultView, &QTreeView::activated, this, &ReferencesPanel::onResultActivated);
+    connect(m_resultView, &QTreeView::clicked, this, &ReferencesPanel::onResultActivated);
+
+    // file rows open expanded as they arrive
+    connect(m_resultsModel, &QAbstractItemModel::rowsInserted, this,
+            [this](const QModelIndex &parent, int first, int last) {
+        if (parent.isValid()) {
+            return;
+        }
+        for (int row = first; row <= last; ++row) {
+            m_resultView->expand(m_resultsModel->index(row, 0));
+        }
+    });
+}
+
+void ReferencesPanel::findReferences(const QString &name)
+{
+    m_search->cancel();
+    m_resultsModel->clear();
+    m_name = name;
+
+    if (!m_indexer || m_indexer->files()->fileCount() == 0) {
+        m_generation = -1;
+        m_statusLabel->setText(m_indexer && m_indexer->isIndexing()
+            ? "Project index is still being built" : "No project files indexed");
+        return;
+    }
+
+    QSharedPointer<const ProjectFileTable> files = m_indexer->files();
+    m_resultsModel->setRootPath(files->rootPath());
+
+    SearchQuery query;
+    query.pattern = name;
+    query.identifier = true;
+
+    m_generation = m_search->start(files, query, m_indexer->trigramIndex());
+    if (m_generation < 0) {
+        m_statusLabel->setText("Cannot search: " + m_search->lastError());
+        return;
+    }
+
+    m_statusLabel->setText(QString("Finding references to %1...").arg(name));
+}
+
+void ReferencesPanel::onHitsFound(int generation, const QVector<SearchHit> &hits)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    m_resultsModel->appendHits(hits);
+    m_statusLabel->setText(QString("Finding references to %1... %2 in %3 files")
+                           .arg(m_name).arg(m_resultsModel->hitCount()).arg(m_resultsModel->fileCount()));
+}
+
+void ReferencesPanel::onSearchFinished(int generation, int hitCount, int filesSearched)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    DEBUG_LOG_EDITOR("References to" << m_name << ":" << hitCount << "in" << filesSearched << "files searched");
+    m_statusLabel->setText(QString("%1 references to %2 in %3 files")
+                           .arg(hitCount).arg(m_name).arg(m_resultsModel->fileCount()));
+}
+
+void ReferencesPanel::onResultActivated(const QModelIndex &index)
+{
+    const SearchHit *hit = m_resultsModel->hitAt(index);
+    if (hit) {
+        emit hitActivated(hit->path, hit->line, hit->column, hit->length);
+    }
+}
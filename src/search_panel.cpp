@@ -0,0 +1,377 @@
+// find in files panel
+// queries are debounced, run by ProjectSearch or OpenDocumentSearch on
+// their own pools and the results model grows as hits stream back
+
+#include "search_panel.h"
+#include "debug_log.h"
+#include <QDir>
+#include <KTextEditor/Document>
+
+namespace {
+
+// long enough to skip intermediate keystrokes, short enough to feel live
+const int kSearchDelay = 150;
+// browsing stops early; a replace needs every hit listed, so it allows far more
+const int kBrowseMaxHits = 20000;
+const int kReplaceMaxHits = 500000;
+
+}
+
+SearchPanel::SearchPanel(ProjectIndexer *indexer, QWidget *parent)
+    : QWidget(parent)
+    , m_indexer(indexer)
+    , m_search(new ProjectSearch(this))
+    , m_documentSearch(new OpenDocumentSearch(this))
+    , m_replace(new ProjectReplace(this))
+    , m_resultsModel(new SearchResultsModel(this))
+    , m_generation(-1)
+    , m_searchingDocuments(false)
+    , m_searchComplete(false)
+    , m_truncated(false)
+    , m_mainLayout(nullptr)
+    , m_queryEdit(nullptr)
+    , m_regexCheck(nullptr)
+    , m_caseCheck(nullptr)
+    , m_wordCheck(nullptr)
+    , m_openFilesCheck(nullptr)
+    , m_replaceCheck(nullptr)
+    , m_replaceRow(nullptr)
+    , m_replaceEdit(nullptr)
+    , m_replaceButton(nullptr)
+    , m_statusLabel(nullptr)
+    , m_resultView(nullptr)
+    , m_debounceTimer(new QTimer(this))
+{
+    setupUI();
+
+    m_debounceTimer->setSingleShot(true);
+    m_debounceTimer->setInterval(kSearchDelay);
+    connect(m_debounceTimer, &QTimer::timeout, this, &SearchPanel::startSearch);
+
+    connect(m_search, &ProjectSearch::hitsFound, this, &SearchPanel::onHitsFound);
+    connect(m_search, &ProjectSearch::finished, this, &SearchPanel::onSearchFinished);
+
+    // both searches count generations on their own, so only the one in use gets through
+    connect(m_documentSearch, &OpenDocumentSearch::hitsFound, this,
+            [this](int generation, const QVector<SearchHit> &hits) {
+        if (m_searchingDocuments) {
+            onHitsFound(generation, hits);
+        }
+    });
+    connect(m_documentSearch, &OpenDocumentSearch::finished, this,
+            [this](int generation, int hitCount, int documentsSearched) {
+        if (m_searchingDocuments) {
+            onSearchFinished(generation, hitCount, documentsSearched);
+        }
+    });
+
+    connect(m_replace, &ProjectReplace::progress, this, [this](int filesDone, int fileCount) {
+        m_statusLabel->setText(QString("Replacing... %1 of %2 files written").arg(filesDone).arg(fileCount));
+    });
+    connect(m_replace, &ProjectReplace::finished, this, [this](int replacements, int fileCount) {
+        m_replaceButton->setText("Replace Selected");
+        emit statusMessage(QString("Replaced %1 %2 in %3 files")
+                               .arg(replacements)
+                               .arg(replacements == 1 ? "occurrence" : "occurrences")
+                               .arg(fileCount));
+        // the listed hits are gone or moved
+        startSearch();
+    });
+    connect(m_replace, &ProjectReplace::failed, this, [this](const QString &error) {
+        m_replaceButton->setText("Replace Selected");
+        m_statusLabel->setText("Replace failed, nothing was changed: " + error);
+    });
+
+    // a fresh index means new files, so rerun whatever is in the box
+    if (m_indexer) {
+        connect(m_indexer, &ProjectIndexer::indexReady, this, [this]() {
+            if (!m_queryEdit->text().isEmpty()) {
+                scheduleSearch();
+            }
+        });
+    }
+}
+
+void SearchPanel::setupUI()
+{
+    m_mainLayout = new QVBoxLayout(this);
+    m_mainLayout->setContentsMargins(4, 4, 4, 4);
+    m_mainLayout->setSpacing(4);
+
+    m_queryEdit = new QLineEdit(this);
+    m_queryEdit->setPlaceholderText("Search in project");
+    m_queryEdit->setClearButtonEnabled(true);
+    m_mainLayout->addWidget(m_queryEdit);
+
+    QHBoxLayout *optionsLayout = new QHBoxLayout();
+    optionsLayout->setSpacing(8);
+
+    m_regexCheck = new QCheckBox("Regex", this);
+    m_caseCheck = new QCheckBox("Match case", this);
+    m_wordCheck = new QCheckBox("Whole word", this);
+    m_openFilesCheck = new QCheckBox("Open files", this);
+    m_openFilesCheck->setToolTip("Search the open tabs, including unsaved changes, instead of the project");
+    m_replaceCheck = new QCheckBox("Replace", this);
+    optionsLayout->addWidget(m_regexCheck);
+    optionsLayout->addWidget(m_caseCheck);
+    optionsLayout->addWidget(m_wordCheck);
+    optionsLayout->addWidget(m_openFilesCheck);
+    optionsLayout->addWidget(m_replaceCheck);
+    optionsLayout->addStretch();
+    m_mainLayout->addLayout(optionsLayout);
+
+    m_replaceRow = new QWidget(this);
+    QHBoxLayout *replaceLayout = new QHBoxLayout(m_replaceRow);
+    replaceLayout->setContentsMargins(0, 0, 0, 0);
+    replaceLayout->setSpacing(4);
+    m_replaceEdit = new QLineEdit(m_replaceRow);
+    m_replaceEdit->setPlaceholderText("Replace with");
+    m_replaceEdit->setToolTip("With Regex checked, \\1 to \\9 insert capture groups and \\0 the whole match");
+    m_replaceButton = new QPushButton("Replace Selected", m_replaceRow);
+    m_replaceButton->setToolTip("Replace the checked results in every file as one batch");
+    replaceLayout->addWidget(m_replaceEdit, 1);
+    replaceLayout->addWidget(m_replaceButton);
+    m_replaceRow->setVisible(false);
+    m_mainLayout->addWidget(m_replaceRow);
+
+    m_statusLabel = new QLabel(this);
+    m_mainLayout->addWidget(m_statusLabel);
+
+    m_resultView = new QTreeView(this);
+    m_resultView->setModel(m_resultsModel);
+    m_resultView->setHeaderHidden(true);
+    m_resultView->setUniformRowHeights(true);
+    m_resultView->setIndentation(12);
+    m_resultView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_mainLayout->addWidget(m_resultView);
+
+    connect(m_queryEdit, &QLineEdit::textChanged, this, &SearchPanel::scheduleSearch);
+    connect(m_queryEdit, &QLineEdit::returnPressed, this, &SearchPanel::startSearch);
+    connect(m_regexCheck, &QCheckBox::toggled, this, &SearchPanel::scheduleSearch);
+    connect(m_caseCheck, &QCheckBox::toggled, this, &SearchPanel::scheduleSearch);
+    connect(m_wordCheck, &QCheckBox::toggled, this, &SearchPanel::scheduleSearch);
+    connect(m_openFilesCheck, &QCheckBox::toggled, this, [this](bool openDocuments) {
+        m_queryEdit->setPlaceholderText(openDocuments ? "Search in open files" : "Search in project");
+        scheduleSearch();
+    });
+    connect(m_replaceCheck, &QCheckBox::toggled, this, [this](bool replace) {
+        m_replaceRow->setVisible(replace);
+        m_resultsModel->setCheckable(replace);
+        // the hit limit differs between the modes
+        scheduleSearch();
+    });
+    connect(m_replaceEdit, &QLineEdit::returnPressed, this, &SearchPanel::replaceChecked);
+    connect(m_replaceButton, &QPushButton::clicked, this, &SearchPanel::replaceChecked);
+
+    connect(m_resultView, &QTreeView::activated, this, &SearchPanel::onResultActivated);
+    // a click in replace mode may be meant for a check box
+    connect(m_resultView, &QTreeView::clicked, this, [this](const QModelIndex &index) {
+        if (!m_resultsModel->isCheckable()) {
+            onResultActivated(index);
+        }
+    });
+
+    // file rows open expanded as they arrive
+    connect(m_resultsModel, &QAbstractItemModel::rowsInserted, this,
+            [this](const QModelIndex &parent, int first, int last) {
+        if (parent.isValid()) {
+            return;
+        }
+        for (int row = first; row <= last; ++row) {
+            m_resultView->expand(m_resultsModel->index(row, 0));
+        }
+    });
+}
+
+void SearchPanel::focusQuery(const QString &text)
+{
+    if (!text.isEmpty()) {
+        m_queryEdit->setText(text);
+    }
+    m_queryEdit->setFocus();
+    m_queryEdit->selectAll();
+}
+
+void SearchPanel::setDocumentProvider(std::function<QVector<OpenDocument>()> provider)
+{
+    m_documentProvider = std::move(provider);
+}
+
+void SearchPanel::setOpenDocumentsScope(bool openDocuments)
+{
+    m_openFilesCheck->setChecked(openDocuments);
+}
+
+void SearchPanel::setReplaceMode(bool replace)
+{
+    m_replaceCheck->setChecked(replace);
+}
+
+void SearchPanel::scheduleSearch()
+{
+    // stop the running search now rather than when the timer fires
+    m_search->cancel();
+    m_documentSearch->cancel();
+    m_generation = -1;
+    m_searchComplete = false;
+    m_debounceTimer->start();
+}
+
+void SearchPanel::startSearch()
+{
+    m_debounceTimer->stop();
+    m_search->cancel();
+    m_documentSearch->cancel();
+    m_resultsModel->clear();
+    m_searchComplete = false;
+    m_truncated = false;
+
+    SearchQuery query;
+    query.pattern = m_queryEdit->text();
+    query.regex = m_regexCheck->isChecked();
+    query.caseSensitive = m_caseCheck->isChecked();
+    query.wholeWord = m_wordCheck->isChecked();
+    m_query = query;
+
+    const int maxHits = m_replaceCheck->isChecked() ? kReplaceMaxHits : kBrowseMaxHits;
+    m_search->setMaxHits(maxHits);
+    m_documentSearch->setMaxHits(maxHits);
+
+    if (query.pattern.isEmpty()) {
+        m_generation = -1;
+        m_statusLabel->clear();
+        return;
+    }
+
+    m_searchingDocuments = m_openFilesCheck->isChecked();
+    if (m_searchingDocuments) {
+        const QVector<OpenDocument> documents = m_documentProvider ? m_documentProvider() : QVector<OpenDocument>();
+        m_resultsModel->setRootPath(m_indexer ? m_indexer->files()->rootPath() : QString());
+
+        m_generation = m_documentSearch->start(documents, query);
+        if (m_generation < 0) {
+            m_statusLabel->setText("Invalid pattern: " + m_documentSearch->lastError());
+            return;
+        }
+
+        m_statusLabel->setText("Searching...");
+        return;
+    }
+
+    if (!m_indexer || m_indexer->files()->fileCount() == 0) {
+        m_generation = -1;
+        m_statusLabel->setText(m_indexer && m_indexer->isIndexing()
+            ? "Project index is still being built" : "No project files indexed");
+        return;
+    }
+
+    QSharedPointer<const ProjectFileTable> files = m_indexer->files();
+    m_resultsModel->setRootPath(files->rootPath());
+
+    m_generation = m_search->start(files, query, m_indexer->trigramIndex());
+    if (m_generation < 0) {
+        m_statusLabel->setText("Invalid pattern: " + m_search->lastError());
+        return;
+    }
+
+    m_statusLabel->setText("Searching...");
+}
+
+void SearchPanel::onHitsFound(int generation, const QVector<SearchHit> &hits)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    m_resultsModel->appendHits(hits);
+    m_statusLabel->setText(QString("Searching... %1 results in %2 files")
+                           .arg(m_resultsModel->hitCount()).arg(m_resultsModel->fileCount()));
+}
+
+void SearchPanel::onSearchFinished(int generation, int hitCount, int filesSearched)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    m_searchComplete = true;
+    m_truncated = hitCount >= (m_replaceCheck->isChecked() ? kReplaceMaxHits : kBrowseMaxHits);
+
+    DEBUG_LOG_EDITOR("Search" << generation << "found" << hitCount << "hits in" << filesSearched << "files");
+    m_statusLabel->setText(QString(m_searchingDocuments ? "%1 results in %2 files (%3 open files searched)"
+                                                        : "%1 results in %2 files (%3 searched)")
+                           .arg(hitCount).arg(m_resultsModel->fileCount()).arg(filesSearched));
+}
+
+void SearchPanel::onResultActivated(const QModelIndex &index)
+{
+    const SearchHit *hit = m_resultsModel->hitAt(index);
+    if (!hit) {
+        return;
+    }
+
+    if (m_searchingDocuments) {
+        KTextEditor::Document *document = m_documentSearch->document(hit->path);
+        if (document) {
+            emit documentHitActivated(document, hit->line, hit->column, hit->length);
+        }
+    } else {
+        emit hitActivated(hit->path, hit->line, hit->column, hit->length);
+    }
+}
+
+void SearchPanel::replaceChecked()
+{
+    if (m_replace->isRunning()) {
+        m_replace->cancel();
+        m_replaceButton->setText("Replace Selected");
+        m_statusLabel->setText("Replace cancelled, nothing was changed");
+        return;
+    }
+
+    if (m_generation < 0 || !m_searchComplete) {
+        m_statusLabel->setText("Wait for the search to finish before replacing");
+        return;
+    }
+    if (m_truncated) {
+        m_statusLabel->setText("Too many results to replace, narrow the search first");
+        return;
+    }
+
+    const QVector<SearchHit> hits = m_resultsModel->checkedHits();
+    if (hits.isEmpty()) {
+        m_statusLabel->setText("No results checked");
+        return;
+    }
+
+    // open files are replaced in their documents, unsaved changes and all
+    QHash<QString, KTextEditor::Document*> openDocuments;
+    if (m_searchingDocuments) {
+        for (const SearchHit &hit : hits) {
+            if (openDocuments.contains(hit.path)) {
+                continue;
+            }
+            KTextEditor::Document *document = m_documentSearch->document(hit.path);
+            if (!document) {
+                m_statusLabel->setText(QString("%1 was closed, search again before replacing").arg(hit.path));
+                return;
+            }
+            openDocuments.insert(hit.path, document);
+        }
+    } else if (m_documentProvider) {
+        for (const OpenDocument &open : m_documentProvider()) {
+            const QString path = open.document ? open.document->url().toLocalFile() : QString();
+            if (!path.isEmpty()) {
+                openDocuments.insert(QDir::cleanPath(path), open.document);
+            }
+        }
+    }
+
+    if (!m_replace->start(hits, m_query, m_replaceEdit->text(), openDocuments)) {
+        m_statusLabel->setText("Replace failed, nothing was changed: " + m_replace->lastError());
+        return;
+    }
+
+    m_replaceButton->setText("Cancel");
+    m_statusLabel->setText(QString("Replacing %1 results...").arg(hits.size()));
+}
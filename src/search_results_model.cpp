@@ -0,0 +1,267 @@
+// model behind the find in files panel
+// file rows carry an internal id of 0, hit rows the 1-based row of their file
+
+#include "search_results_model.h"
+#include <QDir>
+
+SearchResultsModel::SearchResultsModel(QObject *parent)
+    : QAbstractItemModel(parent)
+    , m_hitCount(0)
+    , m_checkedCount(0)
+    , m_checkable(false)
+{
+}
+
+void SearchResultsModel::setRootPath(const QString &path)
+{
+    m_rootPath = path;
+}
+
+void SearchResultsModel::clear()
+{
+    beginResetModel();
+    m_files.clear();
+    m_fileRows.clear();
+    m_hitCount = 0;
+    m_checkedCount = 0;
+    endResetModel();
+}
+
+void SearchResultsModel::appendHits(const QVector<SearchHit> &hits)
+{
+    // workers flush whole files, so consecutive hits share a path
+    int begin = 0;
+    while (begin < hits.size()) {
+        const QString &path = hits.at(begin).path;
+        int end = begin + 1;
+        while (end < hits.size() && hits.at(end).path == path) {
+            ++end;
+        }
+
+        auto it = m_fileRows.constFind(path);
+        int fileRow = 0;
+        if (it == m_fileRows.constEnd()) {
+            fileRow = m_files.size();
+            beginInsertRows(QModelIndex(), fileRow, fileRow);
+
+            FileResults file;
+            file.path = path;
+            file.displayPath = m_rootPath.isEmpty() ? path : QDir(m_rootPath).relativeFilePath(path);
+            m_files.append(file);
+            m_fileRows.insert(path, fileRow);
+
+            endInsertRows();
+        } else {
+            fileRow = it.value();
+        }
+
+        FileResults &file = m_files[fileRow];
+        int first = file.hits.size();
+        beginInsertRows(createIndex(fileRow, 0, quintptr(0)), first, first + (end - begin) - 1);
+        for (int i = begin; i < end; ++i) {
+            file.hits.append(hits.at(i));
+            file.checked.append(true);
+        }
+        file.checkedCount += end - begin;
+        m_checkedCount += end - begin;
+        endInsertRows();
+
+        // the hit count is part of the file row's text
+        QModelIndex fileIndex = createIndex(fileRow, 0, quintptr(0));
+        emit dataChanged(fileIndex, fileIndex, {Qt::DisplayRole});
+
+        m_hitCount += end - begin;
+        begin = end;
+    }
+}
+
+const SearchHit *SearchResultsModel::hitAt(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.internalId() == 0) {
+        return nullptr;
+    }
+
+    const FileResults &file = m_files.at(int(index.internalId()) - 1);
+    return &file.hits.at(index.row());
+}
+
+int SearchResultsModel::fileCount() const
+{
+    return m_files.size();
+}
+
+int SearchResultsModel::hitCount() const
+{
+    return m_hitCount;
+}
+
+void SearchResultsModel::setCheckable(bool checkable)
+{
+    if (checkable == m_checkable) {
+        return;
+    }
+
+    // flags and check states change, the rows do not
+    emit layoutAboutToBeChanged();
+    m_checkable = checkable;
+    emit layoutChanged();
+}
+
+bool SearchResultsModel::isCheckable() const
+{
+    return m_checkable;
+}
+
+QVector<SearchHit> SearchResultsModel::checkedHits() const
+{
+    QVector<SearchHit> hits;
+    hits.reserve(m_checkedCount);
+    for (const FileResults &file : m_files) {
+        for (int i = 0; i < file.hits.size(); ++i) {
+            if (file.checked.at(i)) {
+                hits.append(file.hits.at(i));
+            }
+        }
+    }
+    return hits;
+}
+
+int SearchResultsModel::checkedCount() const
+{
+    return m_checkedCount;
+}
+
+QModelIndex SearchResultsModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (column != 0 || row < 0) {
+        return QModelIndex();
+    }
+
+    if (!parent.isValid()) {
+        return row < m_files.size() ? createIndex(row, 0, quintptr(0)) : QModelIndex();
+    }
+
+    if (parent.internalId() != 0 || row >= m_files.at(parent.row()).hits.size()) {
+        return QModelIndex();
+    }
+    return createIndex(row, 0, quintptr(parent.row() + 1));
+}
+
+QModelIndex SearchResultsModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.internalId() == 0) {
+        return QModelIndex();
+    }
+    return createIndex(int(index.internalId()) - 1, 0, quintptr(0));
+}
+
+int SearchResultsModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return m_files.size();
+    }
+    if (parent.internalId() != 0) {
+        return 0;
+    }
+    return m_files.at(parent.row()).hits.size();
+}
+
+int SearchResultsModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return 1;
+}
+
+QVariant SearchResultsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    if (index.internalId() == 0) {
+        const FileResults &file = m_files.at(index.row());
+        switch (role) {
+        case Qt::DisplayRole:
+            return QString("%1 (%2)").arg(file.displayPath).arg(file.hits.size());
+        case Qt::ToolTipRole:
+            return file.path;
+        case Qt::CheckStateRole:
+            if (!m_checkable) {
+                return QVariant();
+            }
+            if (file.checkedCount == file.hits.size()) {
+                return Qt::Checked;
+            }
+            return file.checkedCount == 0 ? Qt::Unchecked : Qt::PartiallyChecked;
+        default:
+            return QVariant();
+        }
+    }
+
+    const SearchHit *hit = hitAt(index);
+    switch (role) {
+    case Qt::DisplayRole:
+        return QString("%1: %2").arg(hit->line).arg(hit->preview.trimmed());
+    case Qt::ToolTipRole:
+        return QString("%1:%2:%3").arg(hit->path).arg(hit->line).arg(hit->column);
+    case Qt::CheckStateRole:
+        if (!m_checkable) {
+            return QVariant();
+        }
+        return m_files.at(int(index.internalId()) - 1).checked.at(index.row()) ? Qt::Checked : Qt::Unchecked;
+    default:
+        return QVariant();
+    }
+}
+
+bool SearchResultsModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || !m_checkable || role != Qt::CheckStateRole) {
+        return false;
+    }
+
+    const bool checked = value.toInt() != Qt::Unchecked;
+    if (index.internalId() == 0) {
+        setFileChecked(index.row(), checked);
+        return true;
+    }
+
+    const int fileRow = int(index.internalId()) - 1;
+    FileResults &file = m_files[fileRow];
+    if (file.checked.at(index.row()) == checked) {
+        return true;
+    }
+
+    file.checked[index.row()] = checked;
+    file.checkedCount += checked ? 1 : -1;
+    m_checkedCount += checked ? 1 : -1;
+
+    QModelIndex fileIndex = createIndex(fileRow, 0, quintptr(0));
+    emit dataChanged(index, index, {Qt::CheckStateRole});
+    emit dataChanged(fileIndex, fileIndex, {Qt::CheckStateRole});
+    return true;
+}
+
+Qt::ItemFlags SearchResultsModel::flags(const QModelIndex &index) const
+{
+    Qt::ItemFlags flags = QAbstractItemModel::flags(index);
+    if (index.isValid() && m_checkable) {
+        flags |= Qt::ItemIsUserCheckable;
+    }
+    return flags;
+}
+
+void SearchResultsModel::setFileChecked(int fileRow, bool checked)
+{
+    FileResults &file = m_files[fileRow];
+    m_checkedCount -= file.checkedCount;
+    file.checked.fill(checked);
+    file.checkedCount = checked ? file.hits.size() : 0;
+    m_checkedCount += file.checkedCount;
+
+    QModelIndex fileIndex = createIndex(fileRow, 0, quintptr(0));
+    emit dataChanged(fileIndex, fileIndex, {Qt::CheckStateRole});
+    if (!file.hits.isEmpty()) {
+        emit dataChanged(index(0, 0, fileIndex), index(file.hits.size() - 1, 0, fileIndex), {Qt::CheckStateRole});
+    }
+}
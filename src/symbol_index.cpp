@@ -0,0 +1,404 @@
+// background symbol index for the workspace symbol picker
+// parses project sources with SymbolLexer on a worker and publishes a sorted,
+// string interned SymbolTable; unchanged files keep their parsed symbols
+
+#include "symbol_index.h"
+#include "function_task.h"
+#include "project_indexer.h"
+#include "debug_log.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QStringRef>
+#include <algorithm>
+
+namespace {
+
+// generated and minified sources rarely hold anything worth jumping to
+const qint64 kMaxFileSize = 2 * 1024 * 1024;
+
+// how often a full pass checks whether it was superseded
+const int kCancelCheckInterval = 64;
+
+const quint8 kDeclarationFlag = 0x1;
+
+}
+
+QString SymbolTable::rootPath() const
+{
+    return m_rootPath;
+}
+
+int SymbolTable::symbolCount() const
+{
+    return m_symbols.size();
+}
+
+QString SymbolTable::name(int symbol) const
+{
+    const SymbolRecord &record = m_symbols.at(symbol);
+    return m_pool.mid(record.nameOffset, record.nameLength);
+}
+
+QString SymbolTable::container(int symbol) const
+{
+    const SymbolRecord &record = m_symbols.at(symbol);
+    return m_pool.mid(record.containerOffset, record.containerLength);
+}
+
+QString SymbolTable::relativePath(int symbol) const
+{
+    quint32 file = m_symbols.at(symbol).file;
+    return m_pool.mid(m_fileOffsets.at(file), m_fileLengths.at(file));
+}
+
+QString SymbolTable::absolutePath(int symbol) const
+{
+    return m_rootPath + QLatin1Char('/') + relativePath(symbol);
+}
+
+int SymbolTable::line(int symbol) const
+{
+    return m_symbols.at(symbol).line;
+}
+
+int SymbolTable::column(int symbol) const
+{
+    return m_symbols.at(symbol).column;
+}
+
+SourceSymbol::Kind SymbolTable::kind(int symbol) const
+{
+    return SourceSymbol::Kind(m_symbols.at(symbol).kind);
+}
+
+bool SymbolTable::isDeclaration(int symbol) const
+{
+    return m_symbols.at(symbol).flags & kDeclarationFlag;
+}
+
+int SymbolTable::lowerBound(const QString &folded) const
+{
+    auto it = std::lower_bound(m_symbols.constBegin(), m_symbols.constEnd(), folded,
+                               [this](const SymbolRecord &record, const QString &key) {
+                                   QStringRef name(&m_pool, int(record.nameOffset), record.nameLength);
+                                   return name.compare(key, Qt::CaseInsensitive) < 0;
+                               });
+    return int(it - m_symbols.constBegin());
+}
+
+QVector<int> SymbolTable::findPrefix(const QString &prefix, int limit) const
+{
+    QVector<int> result;
+    for (int i = lowerBound(prefix); i < m_symbols.size() && result.size() < limit; ++i) {
+        const SymbolRecord &record = m_symbols.at(i);
+        QStringRef name(&m_pool, int(record.nameOffset), record.nameLength);
+        if (!name.startsWith(prefix, Qt::CaseInsensitive)) {
+            break;
+        }
+        result.append(i);
+    }
+    return result;
+}
+
+QVector<int> SymbolTable::findExact(const QString &name) const
+{
+    QVector<int> result;
+    for (int i = lowerBound(name); i < m_symbols.size(); ++i) {
+        const SymbolRecord &record = m_symbols.at(i);
+        QStringRef candidate(&m_pool, int(record.nameOffset), record.nameLength);
+        if (candidate.compare(name, Qt::CaseInsensitive) != 0) {
+            break;
+        }
+        if (candidate == name) {
+            result.append(i);
+        }
+    }
+    return result;
+}
+
+QString SymbolTable::kindName(SourceSymbol::Kind kind)
+{
+    switch (kind) {
+    case SourceSymbol::Function:
+        return QStringLiteral("function");
+    case SourceSymbol::Method:
+        return QStringLiteral("method");
+    case SourceSymbol::Class:
+        return QStringLiteral("type");
+    case SourceSymbol::Variable:
+        return QStringLiteral("variable");
+    }
+    return QString();
+}
+
+SymbolIndex::SymbolIndex(QObject *parent)
+    : QObject(parent)
+    , m_pool(new QThreadPool(this))
+    , m_generation(0)
+    , m_ready(false)
+{
+    // tasks share the worker state, so they must run one at a time
+    m_pool->setMaxThreadCount(1);
+}
+
+SymbolIndex::~SymbolIndex()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+void SymbolIndex::setFileTable(const QSharedPointer<const ProjectFileTable> &files)
+{
+    if (!files || files->rootPath().isEmpty()) {
+        clear();
+        return;
+    }
+
+    if (files->rootPath() != m_rootPath) {
+        m_generation.fetchAndAddOrdered(1);
+        m_rootPath = files->rootPath();
+        m_symbols.reset();
+        m_ready = false;
+    }
+
+    int generation = m_generation.loadAcquire();
+    QString rootPath = m_rootPath;
+
+    m_pool->start(new FunctionTask([this, generation, rootPath, files]() {
+        if (generation != m_generation.loadAcquire()) {
+            return;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        if (m_state.rootPath != rootPath) {
+            m_state = WorkerState();
+            m_state.rootPath = rootPath;
+        }
+
+        // the old state stays intact until the pass completes, so a cancelled
+        // pass leaves nothing half updated
+        QHash<QString, FileSymbols> next;
+        next.reserve(m_state.files.size());
+        int parsed = 0;
+
+        for (int file = 0; file < files->fileCount(); ++file) {
+            if (file % kCancelCheckInterval == 0 && generation != m_generation.loadAcquire()) {
+                return;
+            }
+
+            if (SymbolLexer::languageFor(files->fileName(file)) == SymbolLexer::Unknown) {
+                continue;
+            }
+
+            QString relativePath = files->relativePath(file);
+            qint64 size = files->fileSize(file);
+            qint64 modified = files->lastModified(file);
+
+            auto existing = m_state.files.constFind(relativePath);
+            if (existing != m_state.files.constEnd() && existing->size == size && existing->modified == modified) {
+                next.insert(relativePath, existing.value());
+                continue;
+            }
+
+            FileSymbols symbols;
+            if (parseFile(relativePath, size, modified, &symbols)) {
+                next.insert(relativePath, symbols);
+                ++parsed;
+            }
+        }
+
+        bool changed = parsed > 0 || next.size() != m_state.files.size();
+        m_state.files = next;
+        if (!changed && m_ready) {
+            return;
+        }
+
+        QSharedPointer<const SymbolTable> table = buildTable();
+        DEBUG_LOG_EDITOR("Symbol index:" << table->symbolCount() << "symbols," << parsed << "files parsed in"
+                         << timer.elapsed() << "ms");
+
+        QMetaObject::invokeMethod(this, [this, generation, table]() {
+            publish(generation, table);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void SymbolIndex::updateFiles(const QStringList &filePaths)
+{
+    if (m_rootPath.isEmpty()) {
+        return;
+    }
+
+    QDir root(m_rootPath);
+    QStringList relativePaths;
+    for (const QString &filePath : filePaths) {
+        QString relativePath = root.relativeFilePath(filePath);
+        if (!relativePath.startsWith(QLatin1String("../"))
+            && SymbolLexer::languageFor(relativePath) != SymbolLexer::Unknown) {
+            relativePaths.append(relativePath);
+        }
+    }
+
+    if (relativePaths.isEmpty()) {
+        return;
+    }
+
+    int generation = m_generation.loadAcquire();
+    m_pool->start(new FunctionTask([this, generation, relativePaths]() {
+        if (generation != m_generation.loadAcquire()) {
+            return;
+        }
+
+        for (const QString &relativePath : relativePaths) {
+            QFileInfo info(m_state.rootPath + QLatin1Char('/') + relativePath);
+            FileSymbols symbols;
+            if (!info.isFile() || !parseFile(relativePath, info.size(),
+                                             info.lastModified().toMSecsSinceEpoch(), &symbols)) {
+                m_state.files.remove(relativePath);
+                continue;
+            }
+            m_state.files.insert(relativePath, symbols);
+        }
+
+        QSharedPointer<const SymbolTable> table = buildTable();
+        QMetaObject::invokeMethod(this, [this, generation, table]() {
+            publish(generation, table);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void SymbolIndex::clear()
+{
+    int generation = m_generation.fetchAndAddOrdered(1) + 1;
+
+    m_rootPath.clear();
+    m_symbols.reset();
+    m_ready = false;
+
+    m_pool->start(new FunctionTask([this, generation]() {
+        if (generation == m_generation.loadAcquire()) {
+            m_state = WorkerState();
+        }
+    }));
+}
+
+bool SymbolIndex::isReady() const
+{
+    return m_ready;
+}
+
+QSharedPointer<const SymbolTable> SymbolIndex::symbols() const
+{
+    return m_symbols;
+}
+
+void SymbolIndex::publish(int generation, const QSharedPointer<const SymbolTable> &symbols)
+{
+    if (generation != m_generation.loadAcquire()) {
+        return;
+    }
+
+    m_symbols = symbols;
+    m_ready = true;
+    emit symbolsReady(symbols->symbolCount());
+}
+
+bool SymbolIndex::parseFile(const QString &relativePath, qint64 size, qint64 modified, FileSymbols *result) const
+{
+    result->size = size;
+    result->modified = modified;
+    result->symbols.clear();
+
+    // oversized files are remembered as empty so they are not read again
+    if (size > kMaxFileSize) {
+        return true;
+    }
+
+    QFile file(m_state.rootPath + QLatin1Char('/') + relativePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    SymbolLexer::extract(SymbolLexer::languageFor(relativePath), file.readAll(), &result->symbols);
+    return true;
+}
+
+QSharedPointer<const SymbolTable> SymbolIndex::buildTable() const
+{
+    QSharedPointer<SymbolTable> table(new SymbolTable);
+    table->m_rootPath = m_state.rootPath;
+
+    QHash<QString, quint32> interned;
+    auto intern = [&](const QString &text) -> quint32 {
+        auto it = interned.constFind(text);
+        if (it != interned.constEnd()) {
+            return it.value();
+        }
+        quint32 offset = quint32(table->m_pool.size());
+        table->m_pool += text;
+        interned.insert(text, offset);
+        return offset;
+    };
+
+    for (auto it = m_state.files.constBegin(); it != m_state.files.constEnd(); ++it) {
+        if (it->symbols.isEmpty()) {
+            continue;
+        }
+
+        quint32 file = quint32(table->m_fileOffsets.size());
+        table->m_fileOffsets.append(quint32(table->m_pool.size()));
+        table->m_fileLengths.append(quint16(qMin(it.key().size(), 0xffff)));
+        table->m_pool += it.key();
+
+        for (const SourceSymbol &symbol : it->symbols) {
+            SymbolRecord record;
+            record.nameOffset = intern(symbol.name);
+            record.nameLength = quint16(qMin(symbol.name.size(), 0xffff));
+            record.containerOffset = intern(symbol.container);
+            record.containerLength = quint16(qMin(symbol.container.size(), 0xffff));
+            record.file = file;
+            record.line = quint32(symbol.line);
+            record.column = quint16(qMin(symbol.column, 0xffff));
+            record.kind = quint8(symbol.kind);
+            record.flags = symbol.declaration ? kDeclarationFlag : 0;
+            table->m_symbols.append(record);
+        }
+    }
+
+    const QString &pool = table->m_pool;
+    auto nameOf = [&pool](const SymbolRecord &record) {
+        return QStringRef(&pool, int(record.nameOffset), record.nameLength);
+    };
+    auto pathOf = [&table, &pool](const SymbolRecord &record) {
+        return QStringRef(&pool, int(table->m_fileOffsets.at(record.file)), table->m_fileLengths.at(record.file));
+    };
+
+    std::sort(table->m_symbols.begin(), table->m_symbols.end(),
+              [&](const SymbolRecord &a, const SymbolRecord &b) {
+                  QStringRef nameA = nameOf(a);
+                  QStringRef nameB = nameOf(b);
+                  int order = nameA.compare(nameB, Qt::CaseInsensitive);
+                  if (order == 0) {
+                      order = nameA.compare(nameB, Qt::CaseSensitive);
+                  }
+                  if (order != 0) {
+                      return order < 0;
+                  }
+                  // definitions ahead of declarations, then by location
+                  if ((a.flags & kDeclarationFlag) != (b.flags & kDeclarationFlag)) {
+                      return !(a.flags & kDeclarationFlag);
+                  }
+                  if (a.file != b.file) {
+                      return pathOf(a) < pathOf(b);
+                  }
+                  return a.line < b.line;
+              });
+
+    return table;
+}
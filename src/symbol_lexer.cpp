@@ -0,0 +1,1441 @@
+// native symbol extraction for the workspace symbol index
+// one scanner turns source bytes into tokens, skipping comments, strings and
+// preprocessor lines, then a small recogniser per language picks out declarations
+
+#include "symbol_lexer.h"
+#include <QFileInfo>
+#include <QStringList>
+#include <cstring>
+
+namespace {
+
+struct Token
+{
+    enum Type { Identifier, Punctuation, String, Number };
+
+    Type type = Punctuation;
+    int offset = 0;
+    int length = 0;
+    int line = 0;
+    int column = 0;
+    // first token on its source line
+    bool lineStart = false;
+};
+
+// two character operators kept whole so '=' and ':' tests stay simple
+const char *const kOperators[] = {
+    "::", "->", "=>", "==", "!=", "<=", ">=", "&&", "||", ":=",
+    "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "++", "--"
+};
+
+inline bool isDigit(uchar c)
+{
+    return c >= '0' && c <= '9';
+}
+
+class Scanner
+{
+public:
+    Scanner(SymbolLexer::Language language, const QByteArray &source)
+        : m_language(language)
+        , m_data(source.constData())
+        , m_size(source.size())
+        , m_position(0)
+        , m_line(1)
+        , m_column(1)
+        , m_lineStart(true)
+    {
+    }
+
+    QVector<Token> tokenize()
+    {
+        QVector<Token> tokens;
+        tokens.reserve(m_size / 6);
+
+        while (m_position < m_size) {
+            uchar c = byte(0);
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v') {
+                advance(1);
+                continue;
+            }
+            if (skipComment() || skipPreprocessor()) {
+                continue;
+            }
+
+            Token token;
+            token.offset = m_position;
+            token.line = m_line;
+            token.column = m_column;
+            token.lineStart = m_lineStart;
+            m_lineStart = false;
+
+            if (skipString(tokens)) {
+                token.type = Token::String;
+            } else if (SymbolLexer::isIdentifierStart(c)) {
+                int end = m_position + 1;
+                while (end < m_size && SymbolLexer::isIdentifierCharacter(uchar(m_data[end]))) {
+                    ++end;
+                }
+
+                bool raw = m_language == SymbolLexer::Cpp && end < m_size && m_data[end] == '"'
+                    && m_data[end - 1] == 'R' && end - m_position <= 3;
+                advance(end - m_position);
+                if (raw) {
+                    skipRawString();
+                    token.type = Token::String;
+                } else {
+                    token.type = Token::Identifier;
+                }
+            } else if (isDigit(c) || (c == '.' && isDigit(byte(1)))) {
+                int end = m_position + 1;
+                while (end < m_size) {
+                    uchar d = uchar(m_data[end]);
+                    // c++14 digit separators
+                    if (!SymbolLexer::isIdentifierCharacter(d) && d != '.'
+                        && !(d == '\'' && m_language == SymbolLexer::Cpp)) {
+                        break;
+                    }
+                    ++end;
+                }
+                advance(end - m_position);
+                token.type = Token::Number;
+            } else {
+                token.type = Token::Punctuation;
+                advance(operatorLength());
+            }
+
+            token.length = m_position - token.offset;
+            tokens.append(token);
+        }
+
+        return tokens;
+    }
+
+private:
+    SymbolLexer::Language m_language;
+    const char *m_data;
+    int m_size;
+    int m_position;
+    int m_line;
+    int m_column;
+    bool m_lineStart;
+
+    uchar byte(int ahead) const
+    {
+        int position = m_position + ahead;
+        return position < m_size ? uchar(m_data[position]) : 0;
+    }
+
+    // keeps line and column in step; columns count utf-16 units like the editor
+    void advance(int count)
+    {
+        int end = qMin(m_size, m_position + count);
+        for (; m_position < end; ++m_position) {
+            uchar c = uchar(m_data[m_position]);
+            if (c == '\n') {
+                ++m_line;
+                m_column = 1;
+                m_lineStart = true;
+            } else if ((c & 0xc0) != 0x80) {
+                m_column += c >= 0xf0 ? 2 : 1;
+            }
+        }
+    }
+
+    void skipPast(const char *terminator)
+    {
+        int length = int(std::strlen(terminator));
+        while (m_position < m_size) {
+            if (byte(0) == uchar(terminator[0]) && m_position + length <= m_size
+                && std::memcmp(m_data + m_position, terminator, size_t(length)) == 0) {
+                advance(length);
+                return;
+            }
+            advance(1);
+        }
+    }
+
+    void skipLine()
+    {
+        while (m_position < m_size && byte(0) != '\n') {
+            advance(1);
+        }
+    }
+
+    // level of a lua long bracket [==[ at the cursor, or -1
+    int longBracketLevel(int ahead) const
+    {
+        if (byte(ahead) != '[') {
+            return -1;
+        }
+        int level = 0;
+        while (byte(ahead + 1 + level) == '=') {
+            ++level;
+        }
+        return byte(ahead + 1 + level) == '[' ? level : -1;
+    }
+
+    void skipLongBracket(int level)
+    {
+        QByteArray terminator = "]" + QByteArray(level, '=') + "]";
+        advance(level + 2);
+        skipPast(terminator.constData());
+    }
+
+    bool skipComment()
+    {
+        uchar c = byte(0);
+        switch (m_language) {
+        case SymbolLexer::Python:
+            if (c == '#') {
+                skipLine();
+                return true;
+            }
+            return false;
+        case SymbolLexer::Lua:
+            if (c == '-' && byte(1) == '-') {
+                int level = longBracketLevel(2);
+                advance(2);
+                if (level >= 0) {
+                    skipLongBracket(level);
+                } else {
+                    skipLine();
+                }
+                return true;
+            }
+            return false;
+        default:
+            if (c == '/' && byte(1) == '/') {
+                skipLine();
+                return true;
+            }
+            if (c == '/' && byte(1) == '*') {
+                advance(2);
+                skipPast("*/");
+                return true;
+            }
+            return false;
+        }
+    }
+
+    bool skipPreprocessor()
+    {
+        if (m_language != SymbolLexer::Cpp || byte(0) != '#' || !m_lineStart) {
+            return false;
+        }
+
+        while (m_position < m_size && byte(0) != '\n') {
+            if (byte(0) == '\\' && (byte(1) == '\n' || (byte(1) == '\r' && byte(2) == '\n'))) {
+                advance(byte(1) == '\r' ? 3 : 2);
+                continue;
+            }
+            if (byte(0) == '/' && byte(1) == '*') {
+                advance(2);
+                skipPast("*/");
+                continue;
+            }
+            advance(1);
+        }
+        return true;
+    }
+
+    void skipQuoted(uchar quote, bool multiline)
+    {
+        advance(1);
+        while (m_position < m_size) {
+            uchar d = byte(0);
+            if (d == '\\') {
+                advance(2);
+                continue;
+            }
+            if (d == quote) {
+                advance(1);
+                return;
+            }
+            // unterminated literals stop at the line end instead of eating the file
+            if (d == '\n' && !multiline) {
+                return;
+            }
+            advance(1);
+        }
+    }
+
+    // R"delim( ... )delim", the prefix was already consumed
+    void skipRawString()
+    {
+        advance(1);
+        QByteArray delimiter;
+        while (m_position < m_size && byte(0) != '(' && delimiter.size() < 16) {
+            delimiter.append(char(byte(0)));
+            advance(1);
+        }
+        QByteArray terminator = ")" + delimiter + "\"";
+        skipPast(terminator.constData());
+    }
+
+    bool regexAllowed(const QVector<Token> &tokens) const
+    {
+        if (tokens.isEmpty()) {
+            return true;
+        }
+
+        const Token &last = tokens.last();
+        if (last.type == Token::Number || last.type == Token::String) {
+            return false;
+        }
+        if (last.type == Token::Identifier) {
+            static const char *const keywords[] = {
+                "return", "typeof", "case", "do", "else", "in", "of", "new",
+                "delete", "void", "throw", "yield", "await", "instanceof"
+            };
+            for (const char *keyword : keywords) {
+                if (int(std::strlen(keyword)) == last.length
+                    && std::memcmp(m_data + last.offset, keyword, size_t(last.length)) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uchar c = uchar(m_data[last.offset]);
+        return last.length > 1 || (c != ')' && c != ']' && c != '}');
+    }
+
+    bool skipString(const QVector<Token> &tokens)
+    {
+        uchar c = byte(0);
+
+        if (c == '"' || c == '\'') {
+            if (m_language == SymbolLexer::Python && byte(1) == c && byte(2) == c) {
+                advance(3);
+                const char terminator[4] = { char(c), char(c), char(c), 0 };
+                skipPast(terminator);
+            } else {
+                skipQuoted(c, false);
+            }
+            return true;
+        }
+
+        if (c == '`' && (m_language == SymbolLexer::JavaScript || m_language == SymbolLexer::Go)) {
+            if (m_language == SymbolLexer::Go) {
+                advance(1);
+                skipPast("`");
+            } else {
+                skipQuoted(c, true);
+            }
+            return true;
+        }
+
+        if (c == '[' && m_language == SymbolLexer::Lua) {
+            int level = longBracketLevel(0);
+            if (level >= 0) {
+                skipLongBracket(level);
+                return true;
+            }
+        }
+
+        if (c == '/' && m_language == SymbolLexer::JavaScript && regexAllowed(tokens)) {
+            advance(1);
+            bool inClass = false;
+            while (m_position < m_size) {
+                uchar d = byte(0);
+                if (d == '\\') {
+                    advance(2);
+                    continue;
+                }
+                if (d == '\n') {
+                    break;
+                }
+                if (d == '[') {
+                    inClass = true;
+                } else if (d == ']') {
+                    inClass = false;
+                } else if (d == '/' && !inClass) {
+                    advance(1);
+                    while (m_position < m_size && SymbolLexer::isIdentifierCharacter(byte(0))) {
+                        advance(1);
+                    }
+                    break;
+                }
+                advance(1);
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    int operatorLength() const
+    {
+        if (m_position + 1 >= m_size) {
+            return 1;
+        }
+        for (const char *op : kOperators) {
+            if (m_data[m_position] == op[0] && m_data[m_position + 1] == op[1]) {
+                return 2;
+            }
+        }
+        return 1;
+    }
+};
+
+// shared token helpers for the recognisers
+class Recognizer
+{
+public:
+    Recognizer(const QByteArray &source, const QVector<Token> &tokens, QVector<SourceSymbol> *symbols)
+        : m_data(source.constData())
+        , m_tokens(tokens)
+        , m_count(tokens.size())
+        , m_symbols(symbols)
+    {
+    }
+
+protected:
+    const char *m_data;
+    const QVector<Token> &m_tokens;
+    int m_count;
+    QVector<SourceSymbol> *m_symbols;
+
+    bool valid(int i) const
+    {
+        return i >= 0 && i < m_count;
+    }
+
+    bool isIdentifier(int i) const
+    {
+        return valid(i) && m_tokens.at(i).type == Token::Identifier;
+    }
+
+    bool is(int i, const char *text) const
+    {
+        if (!valid(i)) {
+            return false;
+        }
+        const Token &token = m_tokens.at(i);
+        return token.type != Token::String && int(std::strlen(text)) == token.length
+            && std::memcmp(m_data + token.offset, text, size_t(token.length)) == 0;
+    }
+
+    bool isPunctuation(int i, char c) const
+    {
+        return valid(i) && m_tokens.at(i).type == Token::Punctuation && m_tokens.at(i).length == 1
+            && m_data[m_tokens.at(i).offset] == c;
+    }
+
+    QString text(int i) const
+    {
+        const Token &token = m_tokens.at(i);
+        return QString::fromUtf8(m_data + token.offset, token.length);
+    }
+
+    // index of the bracket closing the one at i, or the last token
+    int matching(int i, char open, char close) const
+    {
+        int depth = 0;
+        for (int j = i; j < m_count; ++j) {
+            if (isPunctuation(j, open)) {
+                ++depth;
+            } else if (isPunctuation(j, close) && --depth == 0) {
+                return j;
+            }
+        }
+        return m_count - 1;
+    }
+
+    void add(int nameToken, const QString &name, const QString &container, SourceSymbol::Kind kind,
+             bool declaration = false)
+    {
+        SourceSymbol symbol;
+        symbol.name = name;
+        symbol.container = container;
+        symbol.kind = kind;
+        symbol.declaration = declaration;
+        symbol.line = m_tokens.at(nameToken).line;
+        symbol.column = m_tokens.at(nameToken).column;
+        m_symbols->append(symbol);
+    }
+};
+
+// c and c++: statements are collected per scope and classified when they end
+// in ';' or open a block. function bodies are skipped by brace matching
+class CppRecognizer : public Recognizer
+{
+public:
+    using Recognizer::Recognizer;
+
+    void run()
+    {
+        int start = 0;
+        int paren = 0;
+
+        for (int i = 0; i < m_count; ++i) {
+            if (m_tokens.at(i).type != Token::Punctuation || m_tokens.at(i).length != 1) {
+                continue;
+            }
+
+            switch (m_data[m_tokens.at(i).offset]) {
+            case '(':
+            case '[':
+                ++paren;
+                break;
+            case ')':
+            case ']':
+                paren = qMax(0, paren - 1);
+                break;
+            case ';':
+                if (paren == 0) {
+                    declaration(start, i);
+                    start = i + 1;
+                }
+                break;
+            case ':':
+                // access specifiers end a statement of their own
+                if (paren == 0 && (is(i - 1, "public") || is(i - 1, "private") || is(i - 1, "protected")
+                                   || is(i - 1, "slots") || is(i - 1, "signals")
+                                   || is(i - 1, "Q_SLOTS") || is(i - 1, "Q_SIGNALS"))) {
+                    start = i + 1;
+                }
+                break;
+            case '{':
+                // typedef struct { ... } Name; is classified at its ';'
+                if (paren > 0 || isInitializerBrace(start, i) || is(skipPrefix(start, i), "typedef")) {
+                    i = matching(i, '{', '}');
+                    break;
+                }
+                if (!openBlock(start, i)) {
+                    i = matching(i, '{', '}');
+                }
+                start = i + 1;
+                paren = 0;
+                break;
+            case '}':
+                if (!m_scopes.isEmpty()) {
+                    m_scopes.removeLast();
+                }
+                start = i + 1;
+                paren = 0;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+private:
+    struct Scope
+    {
+        bool isClass = false;
+        QString name;
+    };
+
+    QVector<Scope> m_scopes;
+
+    bool inClass() const
+    {
+        return !m_scopes.isEmpty() && m_scopes.last().isClass;
+    }
+
+    QString container() const
+    {
+        QString result;
+        for (const Scope &scope : m_scopes) {
+            if (scope.name.isEmpty()) {
+                continue;
+            }
+            if (!result.isEmpty()) {
+                result += QLatin1String("::");
+            }
+            result += scope.name;
+        }
+        return result;
+    }
+
+    static bool isKeyword(const QString &name)
+    {
+        static const char *const keywords[] = {
+            "if", "for", "while", "switch", "catch", "return", "sizeof", "alignof", "decltype",
+            "static_assert", "noexcept", "throw", "new", "delete", "typeid", "defined",
+            "__attribute__", "alignas", "__declspec", "else", "do", "case",
+            // function types inside template arguments, std::function<void()>
+            "void", "int", "char", "bool", "short", "long", "float", "double", "unsigned",
+            "signed", "auto", "const"
+        };
+        for (const char *keyword : keywords) {
+            if (name == QLatin1String(keyword)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // first top level punctuation c in [from, to), skipping bracket groups
+    int find(int from, int to, char c) const
+    {
+        int depth = 0;
+        for (int i = from; i < to; ++i) {
+            if (depth == 0 && isPunctuation(i, c)) {
+                return i;
+            }
+            if (isPunctuation(i, '(') || isPunctuation(i, '[')) {
+                ++depth;
+            } else if (isPunctuation(i, ')') || isPunctuation(i, ']')) {
+                depth = qMax(0, depth - 1);
+            }
+        }
+        return -1;
+    }
+
+    // skips template headers, attributes and specifiers that do not change what is declared
+    int skipPrefix(int start, int end, bool *isExtern = nullptr) const
+    {
+        static const char *const specifiers[] = {
+            "export", "inline", "static", "constexpr", "consteval", "constinit", "virtual",
+            "explicit", "thread_local", "mutable", "register", "Q_INVOKABLE"
+        };
+
+        int i = start;
+        while (i < end) {
+            if (is(i, "template") && isPunctuation(i + 1, '<')) {
+                i = matching(i + 1, '<', '>') + 1;
+                continue;
+            }
+            if (isPunctuation(i, '[') && isPunctuation(i + 1, '[')) {
+                i = matching(i, '[', ']') + 1;
+                continue;
+            }
+            if ((is(i, "__attribute__") || is(i, "alignas") || is(i, "__declspec")) && isPunctuation(i + 1, '(')) {
+                i = matching(i + 1, '(', ')') + 1;
+                continue;
+            }
+            if (is(i, "extern")) {
+                if (isExtern) {
+                    *isExtern = true;
+                }
+                i += valid(i + 1) && m_tokens.at(i + 1).type == Token::String ? 2 : 1;
+                continue;
+            }
+
+            bool specifier = false;
+            for (const char *word : specifiers) {
+                if (is(i, word)) {
+                    specifier = true;
+                    break;
+                }
+            }
+            if (!specifier) {
+                break;
+            }
+            ++i;
+        }
+        return i;
+    }
+
+    // brace that initialises rather than opens a scope: x = {..}, member{..} in an init list
+    bool isInitializerBrace(int start, int brace) const
+    {
+        int previous = brace - 1;
+        if (previous < start) {
+            return false;
+        }
+        if (isPunctuation(previous, '=') || isPunctuation(previous, ',') || is(previous, "return")) {
+            return true;
+        }
+
+        if (isIdentifier(previous) || isPunctuation(previous, '>')) {
+            int close = find(start, brace, ')');
+            int colon = close >= 0 ? find(close, brace, ':') : -1;
+            return colon >= 0 && colon < previous;
+        }
+        return false;
+    }
+
+    // walks back from the token before '(' to the declared name; qualifiers land in *qualifier
+    int declaratorName(int start, int paren, QString *name, QString *qualifier) const
+    {
+        int i = paren - 1;
+
+        // foo<int>( names foo
+        if (isPunctuation(i, '>')) {
+            int depth = 0;
+            for (; i >= start; --i) {
+                if (isPunctuation(i, '>')) {
+                    ++depth;
+                } else if (isPunctuation(i, '<') && --depth == 0) {
+                    break;
+                }
+            }
+            --i;
+        }
+
+        // operator overloads: everything from the keyword to '('
+        for (int j = qMax(start, i - 3); j <= i; ++j) {
+            if (is(j, "operator")) {
+                QString op;
+                for (int k = j + 1; k < paren; ++k) {
+                    op += text(k);
+                }
+                *name = QLatin1String("operator") + op;
+                i = j;
+                break;
+            }
+        }
+
+        if (name->isEmpty()) {
+            if (!isIdentifier(i) || i < start) {
+                return -1;
+            }
+            *name = text(i);
+            if (isKeyword(*name)) {
+                return -1;
+            }
+            if (isPunctuation(i - 1, '~')) {
+                name->prepend(QLatin1Char('~'));
+                --i;
+            }
+        }
+
+        int nameToken = i;
+        QStringList parts;
+        while (is(i - 1, "::") && isIdentifier(i - 2) && i - 2 >= start) {
+            parts.prepend(text(i - 2));
+            i -= 2;
+        }
+        *qualifier = parts.join(QLatin1String("::"));
+
+        // a bare call like MACRO(x) has nothing in front of the name
+        if (i == start && qualifier->isEmpty() && !inClass()) {
+            return -1;
+        }
+        return nameToken;
+    }
+
+    void addFunction(int start, int paren, bool declaration)
+    {
+        // void (*handler)(int) declares a pointer, not a function
+        if (isPunctuation(paren + 1, '*') || isPunctuation(paren + 1, '&') || isPunctuation(paren + 1, '^')) {
+            return;
+        }
+
+        QString name;
+        QString qualifier;
+        int nameToken = declaratorName(start, paren, &name, &qualifier);
+        if (nameToken < 0) {
+            return;
+        }
+
+        if (!qualifier.isEmpty()) {
+            QString outer = container();
+            add(nameToken, name, outer.isEmpty() ? qualifier : outer + QLatin1String("::") + qualifier,
+                SourceSymbol::Method, declaration);
+        } else {
+            add(nameToken, name, container(), inClass() ? SourceSymbol::Method : SourceSymbol::Function,
+                declaration);
+        }
+    }
+
+    int classKeyword(int start, int end) const
+    {
+        for (int i = start; i < end; ++i) {
+            if (isPunctuation(i, '(') || isPunctuation(i, '=')) {
+                return -1;
+            }
+            if (is(i, "class") || is(i, "struct") || is(i, "union") || is(i, "enum")) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // the last identifier before a base list, template arguments or the body
+    int className(int keyword, int end) const
+    {
+        int name = -1;
+        for (int i = keyword + 1; i < end; ++i) {
+            if (isPunctuation(i, ':') || isPunctuation(i, '<')) {
+                break;
+            }
+            if (isIdentifier(i) && !is(i, "final") && !is(i, "class") && !is(i, "struct")) {
+                name = i;
+            }
+        }
+        return name;
+    }
+
+    // returns false when the block is not parsed further and must be skipped
+    bool openBlock(int start, int brace)
+    {
+        // extern "C" { ... } only wraps declarations
+        if (is(start, "extern") && valid(start + 1) && m_tokens.at(start + 1).type == Token::String
+            && start + 2 == brace) {
+            m_scopes.append(Scope());
+            return true;
+        }
+
+        int s = skipPrefix(start, brace);
+        if (s >= brace) {
+            return false;
+        }
+
+        if (is(s, "namespace")) {
+            Scope scope;
+            for (int i = s + 1; i < brace; ++i) {
+                if (isIdentifier(i) && !is(i, "inline")) {
+                    scope.name += text(i);
+                } else if (is(i, "::")) {
+                    scope.name += QLatin1String("::");
+                }
+            }
+            m_scopes.append(scope);
+            return true;
+        }
+
+        int keyword = classKeyword(s, brace);
+        if (keyword >= 0) {
+            int name = className(keyword, brace);
+            if (name < 0) {
+                return false;
+            }
+            add(name, text(name), container(), SourceSymbol::Class);
+
+            // enumerators are not indexed
+            if (is(keyword, "enum")) {
+                return false;
+            }
+
+            Scope scope;
+            scope.isClass = true;
+            scope.name = text(name);
+            m_scopes.append(scope);
+            return true;
+        }
+
+        int paren = find(s, brace, '(');
+        int assign = find(s, brace, '=');
+        if (assign >= 0 && (paren < 0 || assign < paren)) {
+            // auto handler = [](...) { ... };
+            if (!inClass() && isIdentifier(assign - 1) && assign - 1 > s) {
+                add(assign - 1, text(assign - 1), container(), SourceSymbol::Variable);
+            }
+            return false;
+        }
+
+        if (paren >= 0) {
+            addFunction(s, paren, false);
+            return false;
+        }
+
+        // int table{...} at file scope
+        if (!inClass() && isIdentifier(brace - 1) && brace - 1 > s) {
+            add(brace - 1, text(brace - 1), container(), SourceSymbol::Variable);
+        }
+        return false;
+    }
+
+    void declaration(int start, int end)
+    {
+        bool isExtern = false;
+        int s = skipPrefix(start, end, &isExtern);
+        if (s >= end) {
+            return;
+        }
+
+        if (is(s, "typedef")) {
+            int name = -1;
+            int pointer = -1;
+            int depth = 0;
+            for (int i = s + 1; i < end; ++i) {
+                if (isPunctuation(i, '(') || isPunctuation(i, '[')) {
+                    ++depth;
+                } else if (isPunctuation(i, ')') || isPunctuation(i, ']')) {
+                    --depth;
+                } else if (depth == 0 && isIdentifier(i)) {
+                    name = i;
+                } else if (depth == 1 && isIdentifier(i) && isPunctuation(i - 1, '*') && pointer < 0) {
+                    // typedef void (*Callback)(int);
+                    pointer = i;
+                }
+            }
+            if (pointer >= 0) {
+                name = pointer;
+            }
+            if (name >= 0) {
+                add(name, text(name), container(), SourceSymbol::Class);
+            }
+            return;
+        }
+
+        if (is(s, "using")) {
+            if (isIdentifier(s + 1) && isPunctuation(s + 2, '=')) {
+                add(s + 1, text(s + 1), container(), SourceSymbol::Class);
+            }
+            return;
+        }
+
+        static const char *const skipped[] = {
+            "friend", "return", "static_assert", "namespace", "template", "class", "struct",
+            "union", "enum", "goto", "break", "continue"
+        };
+        for (const char *word : skipped) {
+            if (is(s, word)) {
+                return;
+            }
+        }
+
+        int paren = find(s, end, '(');
+        int assign = find(s, end, '=');
+        if (paren >= 0 && (assign < 0 || paren < assign)) {
+            addFunction(s, paren, true);
+            return;
+        }
+
+        // data members are not globals
+        if (inClass()) {
+            return;
+        }
+
+        int terminator = end;
+        for (char c : { '=', '[', ',', ':' }) {
+            int found = find(s, end, c);
+            if (found >= 0 && found < terminator) {
+                terminator = found;
+            }
+        }
+
+        int name = terminator - 1;
+        if (isIdentifier(name) && name > s) {
+            add(name, text(name), container(), SourceSymbol::Variable, isExtern);
+        }
+    }
+};
+
+// python: blocks come from indentation, so only logical line starts matter
+class PythonRecognizer : public Recognizer
+{
+public:
+    using Recognizer::Recognizer;
+
+    void run()
+    {
+        struct Block
+        {
+            int indent;
+            bool isClass;
+            QString name;
+        };
+        QVector<Block> blocks;
+        int depth = 0;
+
+        for (int i = 0; i < m_count; ++i) {
+            const Token &token = m_tokens.at(i);
+
+            if (token.type == Token::Punctuation && token.length == 1) {
+                char c = m_data[token.offset];
+                if (c == '(' || c == '[' || c == '{') {
+                    ++depth;
+                } else if (c == ')' || c == ']' || c == '}') {
+                    depth = qMax(0, depth - 1);
+                }
+            }
+
+            if (!token.lineStart || depth > 0 || token.type != Token::Identifier) {
+                continue;
+            }
+
+            while (!blocks.isEmpty() && blocks.last().indent >= token.column) {
+                blocks.removeLast();
+            }
+
+            int keyword = is(i, "async") ? i + 1 : i;
+            bool isDef = is(keyword, "def");
+            bool isClass = is(keyword, "class");
+
+            if ((isDef || isClass) && isIdentifier(keyword + 1)) {
+                QString name = text(keyword + 1);
+
+                // nested functions are locals; classes and methods keep their container
+                bool visible = blocks.isEmpty() || blocks.last().isClass;
+                if (visible) {
+                    QStringList path;
+                    for (const Block &block : blocks) {
+                        path.append(block.name);
+                    }
+                    SourceSymbol::Kind kind = isClass ? SourceSymbol::Class
+                        : (blocks.isEmpty() ? SourceSymbol::Function : SourceSymbol::Method);
+                    add(keyword + 1, name, path.join(QLatin1Char('.')), kind);
+                }
+
+                Block block;
+                block.indent = token.column;
+                block.isClass = isClass;
+                block.name = name;
+                blocks.append(block);
+                continue;
+            }
+
+            // module level NAME = ... or NAME: type = ...
+            if (blocks.isEmpty() && (isPunctuation(i + 1, '=') || isPunctuation(i + 1, ':'))) {
+                add(i, text(i), QString(), SourceSymbol::Variable);
+            }
+        }
+    }
+};
+
+// lua: blocks are counted by keyword, table constructors by brace
+class LuaRecognizer : public Recognizer
+{
+public:
+    using Recognizer::Recognizer;
+
+    void run()
+    {
+        int block = 0;
+        int paren = 0;
+        // names of the table constructors we are inside, empty when anonymous
+        QStringList tables;
+
+        for (int i = 0; i < m_count; ++i) {
+            const Token &token = m_tokens.at(i);
+
+            if (token.type == Token::Punctuation) {
+                if (isPunctuation(i, '(')) {
+                    ++paren;
+                } else if (isPunctuation(i, ')')) {
+                    paren = qMax(0, paren - 1);
+                } else if (isPunctuation(i, '{')) {
+                    int nameEnd = -1;
+                    if (isPunctuation(i - 1, '=') && isIdentifier(i - 2)) {
+                        nameEnd = i - 2;
+                    }
+                    tables.append(nameEnd >= 0 ? path(nameEnd, nullptr) : QString());
+                } else if (isPunctuation(i, '}') && !tables.isEmpty()) {
+                    tables.removeLast();
+                }
+                continue;
+            }
+
+            if (token.type != Token::Identifier) {
+                continue;
+            }
+
+            if (is(i, "function")) {
+                if (block == 0) {
+                    function(i, tables);
+                }
+                ++block;
+            } else if (is(i, "if") || is(i, "do") || is(i, "repeat")) {
+                ++block;
+            } else if (is(i, "end") || is(i, "until")) {
+                block = qMax(0, block - 1);
+            } else if (block == 0 && paren == 0 && tables.isEmpty() && isStatementStart(i)) {
+                variable(i);
+            }
+        }
+    }
+
+private:
+    bool isStatementStart(int i) const
+    {
+        if (is(i - 1, "local")) {
+            return isStatementStart(i - 1);
+        }
+        return m_tokens.at(i).lineStart || isPunctuation(i - 1, ';');
+    }
+
+    // a.b.c ending at last; *first gets the index of its first name
+    QString path(int last, int *first) const
+    {
+        QString result = text(last);
+        int i = last;
+        while ((isPunctuation(i - 1, '.') || isPunctuation(i - 1, ':')) && isIdentifier(i - 2)) {
+            result.prepend(text(i - 2) + QLatin1Char('.'));
+            i -= 2;
+        }
+        if (first) {
+            *first = i;
+        }
+        return result;
+    }
+
+    void addPath(int nameToken, const QString &fullPath, SourceSymbol::Kind plainKind)
+    {
+        int dot = fullPath.lastIndexOf(QLatin1Char('.'));
+        if (dot < 0) {
+            add(nameToken, fullPath, QString(), plainKind);
+        } else {
+            add(nameToken, fullPath.mid(dot + 1), fullPath.left(dot),
+                plainKind == SourceSymbol::Function ? SourceSymbol::Method : plainKind);
+        }
+    }
+
+    void function(int keyword, const QStringList &tables)
+    {
+        // function a.b:c(...)
+        if (isIdentifier(keyword + 1)) {
+            int last = keyword + 1;
+            while ((isPunctuation(last + 1, '.') || isPunctuation(last + 1, ':')) && isIdentifier(last + 2)) {
+                last += 2;
+            }
+            addPath(last, path(last, nullptr), SourceSymbol::Function);
+            return;
+        }
+
+        // name = function(...), local name = function(...), field = function(...) in a table
+        if (!isPunctuation(keyword - 1, '=') || !isIdentifier(keyword - 2)) {
+            return;
+        }
+
+        int first = 0;
+        QString fullPath = path(keyword - 2, &first);
+        if (!tables.isEmpty()) {
+            if (!(isPunctuation(first - 1, '{') || isPunctuation(first - 1, ',') || isPunctuation(first - 1, ';'))) {
+                return;
+            }
+            for (const QString &table : tables) {
+                if (table.isEmpty()) {
+                    return;
+                }
+            }
+            add(keyword - 2, text(keyword - 2), tables.join(QLatin1Char('.')), SourceSymbol::Method);
+            return;
+        }
+        addPath(keyword - 2, fullPath, SourceSymbol::Function);
+    }
+
+    void variable(int i)
+    {
+        int last = i;
+        while (isPunctuation(last + 1, '.') && isIdentifier(last + 2)) {
+            last += 2;
+        }
+        if (!isPunctuation(last + 1, '=') && !(isPunctuation(last + 1, ',') && is(i - 1, "local"))) {
+            return;
+        }
+
+        // functions assigned this way are picked up at the function keyword
+        int value = last + 2;
+        while (value < m_count && !isPunctuation(value - 1, '=')) {
+            ++value;
+        }
+        if (is(value, "function")) {
+            return;
+        }
+        addPath(last, path(last, nullptr), SourceSymbol::Variable);
+    }
+};
+
+// javascript: top level declarations plus methods of top level classes
+class JavaScriptRecognizer : public Recognizer
+{
+public:
+    using Recognizer::Recognizer;
+
+    void run()
+    {
+        struct ClassScope
+        {
+            QString name;
+            int depth;
+        };
+        QVector<ClassScope> classes;
+        int depth = 0;
+        int paren = 0;
+        bool pendingClass = false;
+        QString pendingName;
+
+        for (int i = 0; i < m_count; ++i) {
+            if (isPunctuation(i, '{')) {
+                ++depth;
+                if (pendingClass && paren == 0) {
+                    classes.append({ pendingName, depth });
+                    pendingClass = false;
+                }
+                continue;
+            }
+            if (isPunctuation(i, '}')) {
+                if (!classes.isEmpty() && classes.last().depth == depth) {
+                    classes.removeLast();
+                }
+                depth = qMax(0, depth - 1);
+                continue;
+            }
+            if (isPunctuation(i, '(')) {
+                ++paren;
+                continue;
+            }
+            if (isPunctuation(i, ')')) {
+                paren = qMax(0, paren - 1);
+                continue;
+            }
+            if (!isIdentifier(i) || isPunctuation(i - 1, '.')) {
+                continue;
+            }
+
+            bool classBody = !classes.isEmpty() && classes.last().depth == depth && paren == 0;
+            if (classBody) {
+                method(i, classes.last().name);
+                continue;
+            }
+
+            if (depth != 0 || paren != 0) {
+                continue;
+            }
+
+            if (is(i, "class")) {
+                pendingClass = true;
+                pendingName.clear();
+                if (isIdentifier(i + 1) && !is(i + 1, "extends")) {
+                    pendingName = text(i + 1);
+                    add(i + 1, pendingName, QString(), SourceSymbol::Class);
+                }
+            } else if (is(i, "function")) {
+                int name = isPunctuation(i + 1, '*') ? i + 2 : i + 1;
+                if (isIdentifier(name)) {
+                    add(name, text(name), QString(), SourceSymbol::Function);
+                }
+            } else if (is(i, "const") || is(i, "let") || is(i, "var")) {
+                if (isIdentifier(i + 1) && isPunctuation(i + 2, '=')) {
+                    add(i + 1, text(i + 1), QString(),
+                        isFunctionValue(i + 3) ? SourceSymbol::Function : SourceSymbol::Variable);
+                }
+            } else if (m_tokens.at(i).lineStart) {
+                assignment(i);
+            }
+        }
+    }
+
+private:
+    bool isFunctionValue(int i) const
+    {
+        if (is(i, "async")) {
+            ++i;
+        }
+        if (is(i, "function")) {
+            return true;
+        }
+        if (isIdentifier(i) && is(i + 1, "=>")) {
+            return true;
+        }
+        if (isPunctuation(i, '(')) {
+            return is(matching(i, '(', ')') + 1, "=>");
+        }
+        return false;
+    }
+
+    // Foo.prototype.bar = function, module.exports.baz = () => ...
+    void assignment(int i)
+    {
+        QStringList parts;
+        parts.append(text(i));
+        int last = i;
+        while (isPunctuation(last + 1, '.') && isIdentifier(last + 2)) {
+            last += 2;
+            parts.append(text(last));
+        }
+        if (parts.size() < 2 || !isPunctuation(last + 1, '=') || !isFunctionValue(last + 2)) {
+            return;
+        }
+
+        QString name = parts.takeLast();
+        parts.removeAll(QStringLiteral("prototype"));
+        if (parts.value(0) == QLatin1String("module")) {
+            parts.removeFirst();
+        }
+        if (parts.value(0) == QLatin1String("exports")) {
+            parts.removeFirst();
+        }
+
+        add(last, name, parts.join(QLatin1Char('.')),
+            parts.isEmpty() ? SourceSymbol::Function : SourceSymbol::Method);
+    }
+
+    void method(int i, const QString &className)
+    {
+        // NAME(...) { or NAME = (...) => in a class body
+        bool call = isPunctuation(i + 1, '(');
+        bool arrow = isPunctuation(i + 1, '=') && isFunctionValue(i + 2);
+        if ((!call && !arrow) || isPunctuation(i - 1, '=')) {
+            return;
+        }
+
+        QString name = text(i);
+        if (name == QLatin1String("if") || name == QLatin1String("for") || name == QLatin1String("while")
+            || name == QLatin1String("switch") || name == QLatin1String("catch")) {
+            return;
+        }
+
+        add(i, name, className, SourceSymbol::Method);
+    }
+};
+
+// go: everything interesting is at brace depth 0
+class GoRecognizer : public Recognizer
+{
+public:
+    using Recognizer::Recognizer;
+
+    void run()
+    {
+        int depth = 0;
+
+        for (int i = 0; i < m_count; ++i) {
+            if (isPunctuation(i, '{')) {
+                ++depth;
+                continue;
+            }
+            if (isPunctuation(i, '}')) {
+                depth = qMax(0, depth - 1);
+                continue;
+            }
+            if (depth != 0 || !isIdentifier(i) || !m_tokens.at(i).lineStart) {
+                continue;
+            }
+
+            if (is(i, "func")) {
+                function(i);
+            } else if (is(i, "type")) {
+                i = declarations(i, SourceSymbol::Class);
+            } else if (is(i, "var") || is(i, "const")) {
+                i = declarations(i, SourceSymbol::Variable);
+            }
+        }
+    }
+
+private:
+    void function(int keyword)
+    {
+        int i = keyword + 1;
+        QString receiver;
+
+        // func (s *Server) Name(...)
+        if (isPunctuation(i, '(')) {
+            int close = matching(i, '(', ')');
+            int square = 0;
+            for (int j = i + 1; j < close; ++j) {
+                if (isPunctuation(j, '[')) {
+                    ++square;
+                } else if (isPunctuation(j, ']')) {
+                    --square;
+                } else if (square == 0 && isIdentifier(j)) {
+                    receiver = text(j);
+                }
+            }
+            i = close + 1;
+        }
+
+        if (isIdentifier(i)) {
+            add(i, text(i), receiver, receiver.isEmpty() ? SourceSymbol::Function : SourceSymbol::Method);
+        }
+    }
+
+    // single declarations or a parenthesised group with one name per line
+    int declarations(int keyword, SourceSymbol::Kind kind)
+    {
+        if (isIdentifier(keyword + 1)) {
+            add(keyword + 1, text(keyword + 1), QString(), kind);
+            return keyword + 1;
+        }
+        if (!isPunctuation(keyword + 1, '(')) {
+            return keyword;
+        }
+
+        int close = matching(keyword + 1, '(', ')');
+        int nested = 0;
+        for (int i = keyword + 2; i < close; ++i) {
+            if (isPunctuation(i, '(') || isPunctuation(i, '{') || isPunctuation(i, '[')) {
+                ++nested;
+            } else if (isPunctuation(i, ')') || isPunctuation(i, '}') || isPunctuation(i, ']')) {
+                --nested;
+            } else if (nested == 0 && isIdentifier(i) && m_tokens.at(i).lineStart) {
+                add(i, text(i), QString(), kind);
+            }
+        }
+        return close;
+    }
+};
+
+}
+
+SymbolLexer::Language SymbolLexer::languageFor(const QString &fileName)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+
+    if (suffix == "c" || suffix == "h" || suffix == "cc" || suffix == "cpp" || suffix == "cxx"
+        || suffix == "hpp" || suffix == "hh" || suffix == "hxx" || suffix == "inl") {
+        return Cpp;
+    }
+    if (suffix == "py" || suffix == "pyw") {
+        return Python;
+    }
+    if (suffix == "lua") {
+        return Lua;
+    }
+    if (suffix == "js" || suffix == "mjs" || suffix == "cjs" || suffix == "jsx") {
+        return JavaScript;
+    }
+    if (suffix == "go") {
+        return Go;
+    }
+    return Unknown;
+}
+
+bool SymbolLexer::isIdentifierStart(uchar c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$' || c >= 0x80;
+}
+
+bool SymbolLexer::isIdentifierCharacter(uchar c)
+{
+    return isIdentifierStart(c) || isDigit(c);
+}
+
+void SymbolLexer::extract(Language language, const QByteArray &source, QVector<SourceSymbol> *symbols)
+{
+    if (language == Unknown) {
+        return;
+    }
+
+    const QVector<Token> tokens = Scanner(language, source).tokenize();
+
+    switch (language) {
+    case Cpp:
+        CppRecognizer(source, tokens, symbols).run();
+        break;
+    case Python:
+        PythonRecognizer(source, tokens, symbols).run();
+        break;
+    case Lua:
+        LuaRecognizer(source, tokens, symbols).run();
+        break;
+    case JavaScript:
+        JavaScriptRecognizer(source, tokens, symbols).run();
+        break;
+    case Go:
+        GoRecognizer(source, tokens, symbols).run();
+        break;
+    case Unknown:
+        break;
+    }
+}
+
+void SymbolLexer::findIdentifier(Language language, const QByteArray &source, const QByteArray &name,
+                                 QVector<SourceReference> *references)
+{
+    if (language == Unknown || name.isEmpty()) {
+        return;
+    }
+
+    const QVector<Token> tokens = Scanner(language, source).tokenize();
+    const char *data = source.constData();
+
+    for (const Token &token : tokens) {
+        if (token.type == Token::Identifier && token.length == name.size()
+            && std::memcmp(data + token.offset, name.constData(), size_t(token.length)) == 0) {
+            SourceReference reference;
+            reference.line = token.line;
+            reference.column = token.column;
+            reference.offset = token.offset;
+            references->append(reference);
+        }
+    }
+}
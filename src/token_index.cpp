@@ -0,0 +1,591 @@
+// workspace token index behind word completion
+// open documents are tokenized line by line and patched from their edit
+// signals; project files are counted per file on a worker and recounted
+// when a new table shows them changed
+
+#include "token_index.h"
+#include "function_task.h"
+#include "project_indexer.h"
+#include "debug_log.h"
+#include <QFile>
+#include <QDir>
+#include <QElapsedTimer>
+#include <KTextEditor/Document>
+#include <algorithm>
+#include <queue>
+
+namespace {
+
+const int kMinTokenLength = 3;
+const int kMaxTokenLength = 80;
+
+// documents past this are left to the editor's own word completion
+const int kMaxDocumentLines = 500000;
+
+const qint64 kMaxFileSize = 1024 * 1024;
+const qint64 kMaxProjectBytes = 256 * 1024 * 1024;
+// project counts are handed to the gui thread in batches of about this many tokens
+const int kBatchTokens = 20000;
+
+// bounds the best first search when stale subtree bounds send it down dead ends
+const int kMaxVisitedNodes = 20000;
+
+inline bool isWordCharacter(ushort c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+}
+
+inline bool isDigit(ushort c)
+{
+    return c >= '0' && c <= '9';
+}
+
+}
+
+TokenIndex::TokenIndex(QObject *parent)
+    : QObject(parent)
+    , m_pool(new QThreadPool(this))
+    , m_generation(0)
+    , m_tokenCount(0)
+    , m_projectBytes(0)
+{
+    m_pool->setMaxThreadCount(1);
+    m_nodes.append(Node());
+}
+
+TokenIndex::~TokenIndex()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+int TokenIndex::minimumTokenLength()
+{
+    return kMinTokenLength;
+}
+
+int TokenIndex::tokenCount() const
+{
+    return m_tokenCount;
+}
+
+int TokenIndex::nodeCount() const
+{
+    return m_nodes.size();
+}
+
+quint32 TokenIndex::findChild(quint32 parent, ushort character) const
+{
+    for (quint32 child = m_nodes.at(parent).firstChild; child; child = m_nodes.at(child).nextSibling) {
+        if (m_nodes.at(child).character == character) {
+            return child;
+        }
+    }
+    return 0;
+}
+
+quint32 TokenIndex::insert(const QString &token, quint32 count)
+{
+    quint32 path[kMaxTokenLength + 1];
+    int depth = 0;
+    quint32 node = 0;
+    path[depth++] = node;
+
+    for (QChar c : token) {
+        quint32 child = findChild(node, c.unicode());
+        if (!child) {
+            child = quint32(m_nodes.size());
+            Node created;
+            created.character = c.unicode();
+            created.nextSibling = m_nodes.at(node).firstChild;
+            m_nodes.append(created);
+            m_nodes[node].firstChild = child;
+        }
+        node = child;
+        path[depth++] = node;
+    }
+
+    Node &leaf = m_nodes[node];
+    leaf.count += count;
+    m_tokenCount += int(count);
+
+    const quint32 total = leaf.count;
+    for (int i = 0; i < depth; ++i) {
+        Node &ancestor = m_nodes[path[i]];
+        ancestor.maxCount = qMax(ancestor.maxCount, total);
+    }
+    return node;
+}
+
+void TokenIndex::remove(quint32 node, quint32 count)
+{
+    // bounds above are left alone; an overestimate only costs search time
+    Node &leaf = m_nodes[node];
+    quint32 removed = qMin(leaf.count, count);
+    leaf.count -= removed;
+    m_tokenCount -= int(removed);
+}
+
+QStringList TokenIndex::complete(const QString &prefix, int limit) const
+{
+    QStringList result;
+    if (prefix.isEmpty() || limit <= 0) {
+        return result;
+    }
+
+    quint32 start = 0;
+    for (QChar c : prefix) {
+        start = findChild(start, c.unicode());
+        if (!start) {
+            return result;
+        }
+    }
+
+    // subtrees are queued by their count bound and tokens by their count, so a
+    // token leaves the queue only once nothing left can beat it
+    struct Entry
+    {
+        quint32 priority;
+        quint32 node;
+        bool token;
+        QString text;
+
+        bool operator<(const Entry &other) const
+        {
+            return priority < other.priority || (priority == other.priority && !token && other.token);
+        }
+    };
+
+    std::priority_queue<Entry> queue;
+    queue.push({ m_nodes.at(start).maxCount, start, false, prefix });
+
+    int visited = 0;
+    while (!queue.empty() && result.size() < limit && visited < kMaxVisitedNodes) {
+        Entry entry = queue.top();
+        queue.pop();
+
+        if (entry.token) {
+            if (entry.node != start) {
+                result.append(entry.text);
+            }
+            continue;
+        }
+
+        ++visited;
+        const Node &node = m_nodes.at(entry.node);
+        if (node.count > 0) {
+            queue.push({ node.count, entry.node, true, entry.text });
+        }
+        for (quint32 child = node.firstChild; child; child = m_nodes.at(child).nextSibling) {
+            const Node &childNode = m_nodes.at(child);
+            if (childNode.maxCount > 0) {
+                queue.push({ childNode.maxCount, child, false, entry.text + QChar(childNode.character) });
+            }
+        }
+    }
+
+    return result;
+}
+
+void TokenIndex::addDocument(KTextEditor::Document *document)
+{
+    if (!document || m_documents.contains(document)) {
+        return;
+    }
+
+    m_documents.insert(document, DocumentTokens());
+
+    connect(document, &KTextEditor::Document::textInserted, this, &TokenIndex::onTextInserted);
+    connect(document, &KTextEditor::Document::textRemoved, this, &TokenIndex::onTextRemoved);
+    connect(document, &KTextEditor::Document::reloaded, this, &TokenIndex::scanDocument);
+    connect(document, &QObject::destroyed, this, [this, document]() {
+        auto it = m_documents.find(document);
+        if (it != m_documents.end()) {
+            releaseLines(&it.value(), 0, it->lines.size());
+            m_documents.erase(it);
+        }
+    });
+
+    scanDocument(document);
+}
+
+void TokenIndex::removeDocument(KTextEditor::Document *document)
+{
+    auto it = m_documents.find(document);
+    if (it == m_documents.end()) {
+        return;
+    }
+
+    const QString filePath = it->filePath;
+    releaseLines(&it.value(), 0, it->lines.size());
+    m_documents.erase(it);
+    disconnect(document, nullptr, this, nullptr);
+
+    // the file is counted from disk again once no document holds it
+    countProjectFile(projectRelativePath(filePath));
+}
+
+void TokenIndex::setDocumentPath(KTextEditor::Document *document, const QString &filePath)
+{
+    auto it = m_documents.find(document);
+    if (it == m_documents.end() || it->filePath == filePath) {
+        return;
+    }
+
+    const QString previous = it->filePath;
+    it->filePath = filePath;
+
+    dropProjectFile(projectRelativePath(filePath));
+    countProjectFile(projectRelativePath(previous));
+}
+
+void TokenIndex::resetTrie()
+{
+    m_nodes.clear();
+    m_nodes.append(Node());
+    m_tokenCount = 0;
+    m_projectTokens.clear();
+    m_projectBytes = 0;
+
+    // line caches point into the old trie, so documents start over
+    for (auto it = m_documents.begin(); it != m_documents.end(); ++it) {
+        it->lines.clear();
+        scanDocument(it.key());
+    }
+}
+
+void TokenIndex::clear()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_projectRoot.clear();
+    m_projectFiles.reset();
+    resetTrie();
+}
+
+void TokenIndex::scanDocument(KTextEditor::Document *document)
+{
+    auto it = m_documents.find(document);
+    if (it == m_documents.end()) {
+        return;
+    }
+
+    DocumentTokens &tokens = it.value();
+    releaseLines(&tokens, 0, tokens.lines.size());
+    tokens.lines.clear();
+
+    const int lineCount = document->lines();
+    tokens.tracked = lineCount <= kMaxDocumentLines;
+    if (!tokens.tracked) {
+        return;
+    }
+
+    tokens.lines.reserve(lineCount);
+    for (int line = 0; line < lineCount; ++line) {
+        tokens.lines.append(tokenizeLine(document->line(line)));
+    }
+}
+
+QVector<quint32> TokenIndex::tokenizeLine(const QString &line)
+{
+    QVector<quint32> nodes;
+    const ushort *text = line.utf16();
+    const int size = line.size();
+
+    int i = 0;
+    while (i < size) {
+        if (!isWordCharacter(text[i])) {
+            ++i;
+            continue;
+        }
+
+        int start = i;
+        while (i < size && isWordCharacter(text[i])) {
+            ++i;
+        }
+
+        int length = i - start;
+        if (length >= kMinTokenLength && length <= kMaxTokenLength && !isDigit(text[start])) {
+            nodes.append(insert(line.mid(start, length), 1));
+        }
+    }
+    return nodes;
+}
+
+void TokenIndex::releaseLines(DocumentTokens *tokens, int first, int count)
+{
+    for (int line = first; line < first + count && line < tokens->lines.size(); ++line) {
+        for (quint32 node : tokens->lines.at(line)) {
+            remove(node, 1);
+        }
+    }
+}
+
+void TokenIndex::onTextInserted(KTextEditor::Document *document, const KTextEditor::Cursor &position,
+                                const QString &text)
+{
+    refreshLines(document, position.line(), 1, 1 + text.count(QLatin1Char('\n')));
+}
+
+void TokenIndex::onTextRemoved(KTextEditor::Document *document, const KTextEditor::Range &range,
+                               const QString &text)
+{
+    Q_UNUSED(text);
+    refreshLines(document, range.start().line(), 1 + range.end().line() - range.start().line(), 1);
+}
+
+void TokenIndex::refreshLines(KTextEditor::Document *document, int firstLine, int oldLineCount, int newLineCount)
+{
+    auto it = m_documents.find(document);
+    if (it == m_documents.end()) {
+        return;
+    }
+
+    DocumentTokens &tokens = it.value();
+    if (!tokens.tracked) {
+        if (document->lines() <= kMaxDocumentLines) {
+            scanDocument(document);
+        }
+        return;
+    }
+
+    // the cache has to describe the document as it was before this edit
+    const int cachedLines = tokens.lines.size();
+    if (firstLine + oldLineCount > cachedLines
+        || cachedLines - oldLineCount + newLineCount != document->lines()
+        || document->lines() > kMaxDocumentLines) {
+        scanDocument(document);
+        return;
+    }
+
+    releaseLines(&tokens, firstLine, oldLineCount);
+
+    if (oldLineCount > newLineCount) {
+        tokens.lines.remove(firstLine + newLineCount, oldLineCount - newLineCount);
+    } else if (newLineCount > oldLineCount) {
+        tokens.lines.insert(firstLine + oldLineCount, newLineCount - oldLineCount, QVector<quint32>());
+    }
+
+    for (int line = firstLine; line < firstLine + newLineCount; ++line) {
+        tokens.lines[line] = tokenizeLine(document->line(line));
+    }
+}
+
+void TokenIndex::setProjectFiles(const QSharedPointer<const ProjectFileTable> &files)
+{
+    if (!files || files->rootPath().isEmpty() || files == m_projectFiles) {
+        return;
+    }
+
+    // a pass still reading the previous table is dropped; whatever it had not
+    // merged yet has no counts below and is queued again
+    int generation = m_generation.fetchAndAddOrdered(1) + 1;
+    if (files->rootPath() != m_projectRoot) {
+        m_projectRoot = files->rootPath();
+        resetTrie();
+    }
+    m_projectFiles = files;
+
+    // counts of files that changed or left the project are dropped before the recount
+    QStringList stale;
+    for (auto it = m_projectTokens.constBegin(); it != m_projectTokens.constEnd(); ++it) {
+        int file = files->indexOf(it.key());
+        if (file < 0 || files->fileSize(file) != it->size || files->lastModified(file) != it->lastModified) {
+            stale.append(it.key());
+        }
+    }
+    for (const QString &relativePath : stale) {
+        dropProjectFile(relativePath);
+    }
+
+    const QSet<QString> open = openProjectPaths();
+    QVector<int> pending;
+    for (int file = 0; file < files->fileCount(); ++file) {
+        qint64 size = files->fileSize(file);
+        if (size <= 0 || size > kMaxFileSize) {
+            continue;
+        }
+
+        QString relativePath = files->relativePath(file);
+        if (!m_projectTokens.contains(relativePath) && !open.contains(relativePath)) {
+            pending.append(file);
+        }
+    }
+
+    readProjectFiles(generation, pending);
+}
+
+QString TokenIndex::projectRelativePath(const QString &filePath) const
+{
+    if (filePath.isEmpty() || m_projectRoot.isEmpty()) {
+        return QString();
+    }
+
+    QString relativePath = QDir(m_projectRoot).relativeFilePath(filePath);
+    if (relativePath.startsWith(QLatin1String("..")) || QDir::isAbsolutePath(relativePath)) {
+        return QString();
+    }
+    return relativePath;
+}
+
+QSet<QString> TokenIndex::openProjectPaths() const
+{
+    QSet<QString> paths;
+    for (auto it = m_documents.constBegin(); it != m_documents.constEnd(); ++it) {
+        QString relativePath = projectRelativePath(it->filePath);
+        if (!relativePath.isEmpty()) {
+            paths.insert(relativePath);
+        }
+    }
+    return paths;
+}
+
+void TokenIndex::dropProjectFile(const QString &relativePath)
+{
+    auto it = m_projectTokens.find(relativePath);
+    if (relativePath.isEmpty() || it == m_projectTokens.end()) {
+        return;
+    }
+
+    for (const auto &token : it->tokens) {
+        remove(token.first, token.second);
+    }
+    m_projectBytes -= it->size;
+    m_projectTokens.erase(it);
+}
+
+void TokenIndex::countProjectFile(const QString &relativePath)
+{
+    if (relativePath.isEmpty() || !m_projectFiles || m_projectTokens.contains(relativePath)
+        || openProjectPaths().contains(relativePath)) {
+        return;
+    }
+
+    int file = m_projectFiles->indexOf(relativePath);
+    if (file < 0 || m_projectFiles->fileSize(file) <= 0 || m_projectFiles->fileSize(file) > kMaxFileSize) {
+        return;
+    }
+
+    readProjectFiles(m_generation.loadAcquire(), QVector<int>() << file);
+}
+
+void TokenIndex::readProjectFiles(int generation, const QVector<int> &pending)
+{
+    if (pending.isEmpty()) {
+        return;
+    }
+
+    QSharedPointer<const ProjectFileTable> files = m_projectFiles;
+    const qint64 budget = kMaxProjectBytes - m_projectBytes;
+
+    m_pool->start(new FunctionTask([this, generation, files, pending, budget]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        QVector<ProjectFileCounts> batch;
+        int batchTokens = 0;
+        qint64 bytesRead = 0;
+
+        auto post = [&]() {
+            QMetaObject::invokeMethod(this, [this, generation, batch]() {
+                mergeProjectTokens(generation, batch);
+            }, Qt::QueuedConnection);
+            batch.clear();
+            batchTokens = 0;
+        };
+
+        QHash<QByteArray, int> counts;
+        for (int file : pending) {
+            if (bytesRead >= budget) {
+                break;
+            }
+            if (generation != m_generation.loadAcquire()) {
+                return;
+            }
+
+            QFile input(files->absolutePath(file));
+            if (!input.open(QIODevice::ReadOnly)) {
+                continue;
+            }
+
+            const QByteArray data = input.readAll();
+            bytesRead += data.size();
+
+            const char *text = data.constData();
+            const int length = data.size();
+            int i = 0;
+            while (i < length) {
+                if (!isWordCharacter(uchar(text[i]))) {
+                    ++i;
+                    continue;
+                }
+
+                int start = i;
+                while (i < length && isWordCharacter(uchar(text[i]))) {
+                    ++i;
+                }
+
+                // byte length bounds the utf-16 length from above, close enough here
+                int tokenLength = i - start;
+                if (tokenLength < kMinTokenLength || tokenLength > kMaxTokenLength || isDigit(uchar(text[start]))) {
+                    continue;
+                }
+
+                QByteArray key = QByteArray::fromRawData(text + start, tokenLength);
+                auto it = counts.find(key);
+                if (it != counts.end()) {
+                    ++it.value();
+                } else {
+                    counts.insert(QByteArray(text + start, tokenLength), 1);
+                }
+            }
+
+            // the table's size and mtime, so the next table can tell whether the file changed
+            ProjectFileCounts result;
+            result.relativePath = files->relativePath(file);
+            result.size = files->fileSize(file);
+            result.lastModified = files->lastModified(file);
+            result.counts.reserve(counts.size());
+            for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+                result.counts.insert(QString::fromUtf8(it.key()), it.value());
+            }
+            batchTokens += counts.size();
+            counts.clear();
+            batch.append(result);
+
+            if (batchTokens >= kBatchTokens) {
+                post();
+            }
+        }
+
+        if (!batch.isEmpty()) {
+            post();
+        }
+
+        DEBUG_LOG_EDITOR("Token index read" << bytesRead << "bytes of project files in" << timer.elapsed() << "ms");
+    }));
+}
+
+void TokenIndex::mergeProjectTokens(int generation, const QVector<ProjectFileCounts> &files)
+{
+    if (generation != m_generation.loadAcquire()) {
+        return;
+    }
+
+    // a file opened, or counted by another pass, while this one read it is skipped
+    const QSet<QString> open = openProjectPaths();
+    for (const ProjectFileCounts &file : files) {
+        if (open.contains(file.relativePath) || m_projectTokens.contains(file.relativePath)) {
+            continue;
+        }
+
+        ProjectFileTokens &tokens = m_projectTokens[file.relativePath];
+        tokens.size = file.size;
+        tokens.lastModified = file.lastModified;
+        tokens.tokens.reserve(file.counts.size());
+        for (auto it = file.counts.constBegin(); it != file.counts.constEnd(); ++it) {
+            tokens.tokens.append(qMakePair(insert(it.key(), quint32(it.value())), quint32(it.value())));
+        }
+        m_projectBytes += file.size;
+    }
+}
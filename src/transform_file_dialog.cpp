@@ -0,0 +1,112 @@
+// transform file dialog
+// collects the target file and the find and replace text; the transform
+// itself is run by FileTransform
+
+#include "transform_file_dialog.h"
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QFileDialog>
+#include <QFileInfo>
+
+TransformFileDialog::TransformFileDialog(QWidget *parent)
+    : QDialog(parent)
+    , m_pathEdit(nullptr)
+    , m_browseButton(nullptr)
+    , m_findEdit(nullptr)
+    , m_replaceEdit(nullptr)
+    , m_regexCheck(nullptr)
+    , m_caseCheck(nullptr)
+    , m_wordCheck(nullptr)
+    , m_buttons(nullptr)
+{
+    setWindowTitle("Transform File");
+    setupUI();
+    updateButtons();
+}
+
+void TransformFileDialog::setupUI()
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    QFormLayout *formLayout = new QFormLayout();
+
+    QHBoxLayout *pathLayout = new QHBoxLayout();
+    m_pathEdit = new QLineEdit(this);
+    m_pathEdit->setPlaceholderText("File to rewrite in place");
+    m_browseButton = new QPushButton("Browse...", this);
+    pathLayout->addWidget(m_pathEdit, 1);
+    pathLayout->addWidget(m_browseButton);
+    formLayout->addRow("File:", pathLayout);
+
+    m_findEdit = new QLineEdit(this);
+    formLayout->addRow("Find:", m_findEdit);
+
+    m_replaceEdit = new QLineEdit(this);
+    m_replaceEdit->setToolTip("With Regex checked, \\1 to \\9 insert capture groups and \\0 the whole match");
+    formLayout->addRow("Replace with:", m_replaceEdit);
+
+    QHBoxLayout *optionsLayout = new QHBoxLayout();
+    m_regexCheck = new QCheckBox("Regex", this);
+    m_caseCheck = new QCheckBox("Match case", this);
+    m_caseCheck->setChecked(true);
+    m_wordCheck = new QCheckBox("Whole word", this);
+    optionsLayout->addWidget(m_regexCheck);
+    optionsLayout->addWidget(m_caseCheck);
+    optionsLayout->addWidget(m_wordCheck);
+    optionsLayout->addStretch();
+    formLayout->addRow(QString(), optionsLayout);
+
+    mainLayout->addLayout(formLayout);
+
+    m_buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    m_buttons->button(QDialogButtonBox::Ok)->setText("Transform");
+    mainLayout->addWidget(m_buttons);
+
+    connect(m_browseButton, &QPushButton::clicked, this, &TransformFileDialog::browse);
+    connect(m_pathEdit, &QLineEdit::textChanged, this, &TransformFileDialog::updateButtons);
+    connect(m_findEdit, &QLineEdit::textChanged, this, &TransformFileDialog::updateButtons);
+    connect(m_buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(m_buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    setMinimumWidth(480);
+}
+
+void TransformFileDialog::setFilePath(const QString &filePath)
+{
+    m_pathEdit->setText(filePath);
+    m_findEdit->setFocus();
+}
+
+QString TransformFileDialog::filePath() const
+{
+    return m_pathEdit->text();
+}
+
+SearchQuery TransformFileDialog::query() const
+{
+    SearchQuery query;
+    query.pattern = m_findEdit->text();
+    query.regex = m_regexCheck->isChecked();
+    query.caseSensitive = m_caseCheck->isChecked();
+    query.wholeWord = m_wordCheck->isChecked();
+    return query;
+}
+
+QString TransformFileDialog::replacement() const
+{
+    return m_replaceEdit->text();
+}
+
+void TransformFileDialog::browse()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, "Transform File", m_pathEdit->text());
+    if (!filePath.isEmpty()) {
+        m_pathEdit->setText(filePath);
+    }
+}
+
+void TransformFileDialog::updateButtons()
+{
+    m_buttons->button(QDialogButtonBox::Ok)->setEnabled(
+        QFileInfo(m_pathEdit->text()).isFile() && !m_findEdit->text().isEmpty());
+}
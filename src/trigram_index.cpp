@@ -0,0 +1,676 @@
+// persistent trigram index used to narrow project search
+// the base file is rebuilt in the background when too much of the project
+// changed, smaller changes are re-read into an in-memory overlay
+
+#include "trigram_index.h"
+#include "function_task.h"
+#include "project_indexer.h"
+#include "debug_log.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QBuffer>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const char kIndexMagic[4] = { 'L', 'T', 'G', 'I' };
+const quint32 kIndexVersion = 1;
+
+// matches the limit of ProjectSearch, larger files are never searched
+const qint64 kMaxFileSize = 64 * 1024 * 1024;
+
+// above this share of changed files a full rebuild beats the overlay
+const int kMinOverlayLimit = 1000;
+const int kOverlayFraction = 8;
+
+struct IndexHeader
+{
+    char magic[4];
+    quint32 version;
+    quint32 fileCount;
+    quint32 trigramCount;
+    quint32 pathBytes;
+    quint32 postingCount;
+};
+
+struct IndexFileEntry
+{
+    quint32 pathOffset;
+    quint32 pathLength;
+    qint64 size;
+    qint64 modified;
+};
+
+struct IndexTrigramEntry
+{
+    quint32 trigram;
+    quint32 offset;
+    quint32 count;
+};
+
+// sections follow the header in this order, each 4 byte aligned:
+// file entries, utf-8 path pool, trigram entries, postings
+inline qint64 alignedPathBytes(quint32 pathBytes)
+{
+    return (qint64(pathBytes) + 3) & ~qint64(3);
+}
+
+inline qint64 trigramTableOffset(const IndexHeader *header)
+{
+    return sizeof(IndexHeader) + qint64(header->fileCount) * sizeof(IndexFileEntry)
+        + alignedPathBytes(header->pathBytes);
+}
+
+inline qint64 postingsOffset(const IndexHeader *header)
+{
+    return trigramTableOffset(header) + qint64(header->trigramCount) * sizeof(IndexTrigramEntry);
+}
+
+// an index that cannot be written to disk is only kept when it is this small
+const qint64 kMaxMemoryIndexSize = 512 * 1024 * 1024;
+
+bool writeBytes(QIODevice *output, const void *data, qint64 size)
+{
+    return output->write(reinterpret_cast<const char*>(data), size) == size;
+}
+
+// lists are released once written, so the peak is the posting lists alone
+bool writeStorage(QIODevice *output, const IndexHeader &header, const QVector<IndexFileEntry> &entries,
+                  const QByteArray &pathPool, const QVector<quint32> &keys,
+                  QHash<quint32, QVector<quint32>> *postings)
+{
+    const char padding[4] = {};
+    if (!writeBytes(output, &header, sizeof(header))
+        || !writeBytes(output, entries.constData(), qint64(entries.size()) * sizeof(IndexFileEntry))
+        || !writeBytes(output, pathPool.constData(), pathPool.size())
+        || !writeBytes(output, padding, alignedPathBytes(header.pathBytes) - header.pathBytes)) {
+        return false;
+    }
+
+    quint32 offset = 0;
+    for (quint32 trigram : keys) {
+        IndexTrigramEntry entry;
+        entry.trigram = trigram;
+        entry.offset = offset;
+        entry.count = postings->value(trigram).size();
+        if (!writeBytes(output, &entry, sizeof(entry))) {
+            return false;
+        }
+        offset += entry.count;
+    }
+
+    for (quint32 trigram : keys) {
+        const QVector<quint32> list = postings->take(trigram);
+        if (!writeBytes(output, list.constData(), qint64(list.size()) * sizeof(quint32))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline uchar foldByte(uchar c)
+{
+    return (c >= 'A' && c <= 'Z') ? uchar(c + ('a' - 'A')) : c;
+}
+
+// smaller list first; each step keeps the entries found in the next list
+void intersectPostings(QVector<quint32> *result, const quint32 *postings, int count)
+{
+    const quint32 *cursor = postings;
+    const quint32 *end = postings + count;
+
+    int kept = 0;
+    for (quint32 file : *result) {
+        cursor = std::lower_bound(cursor, end, file);
+        if (cursor == end) {
+            break;
+        }
+        if (*cursor == file) {
+            (*result)[kept++] = file;
+        }
+    }
+    result->resize(kept);
+}
+
+// index in previous of every file of next, -1 for new files. both tables list
+// files by directory in directoryLessThan order, then by name, so one merge
+// pass pairs them up without a lookup per file
+QVector<int> matchFiles(const ProjectFileTable &previous, const ProjectFileTable &next)
+{
+    QVector<int> matched(next.fileCount(), -1);
+    const int previousCount = previous.fileCount();
+    int old = 0;
+
+    for (int file = 0; file < next.fileCount() && old < previousCount; ++file) {
+        const QString directory = next.directoryPath(next.directoryIndex(file));
+        const QString name = next.fileName(file);
+
+        while (old < previousCount) {
+            const QString oldDirectory = previous.directoryPath(previous.directoryIndex(old));
+            if (oldDirectory == directory) {
+                const QString oldName = previous.fileName(old);
+                if (oldName == name) {
+                    matched[file] = old++;
+                    break;
+                }
+                if (name < oldName) {
+                    break;
+                }
+            } else if (ProjectFileTable::directoryLessThan(directory, oldDirectory)) {
+                break;
+            }
+            ++old;
+        }
+    }
+    return matched;
+}
+
+}
+
+const uchar *TrigramIndex::Storage::data() const
+{
+    return mapped ? mapped : reinterpret_cast<const uchar*>(buffer.constData());
+}
+
+TrigramIndex::Storage::~Storage()
+{
+    if (mapped) {
+        file.unmap(const_cast<uchar*>(mapped));
+    }
+}
+
+TrigramIndex::TrigramIndex(QObject *parent)
+    : QObject(parent)
+    , m_pool(new QThreadPool(this))
+    , m_generation(0)
+{
+    // builds read every project file, one at a time is plenty
+    m_pool->setMaxThreadCount(1);
+}
+
+TrigramIndex::~TrigramIndex()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+void TrigramIndex::setFileTable(const QSharedPointer<const ProjectFileTable> &files)
+{
+    int generation = m_generation.fetchAndAddOrdered(1) + 1;
+
+    if (!files || files->rootPath().isEmpty()) {
+        m_snapshot.reset();
+        return;
+    }
+
+    // the current snapshot seeds the next one, so only files that changed are read
+    QSharedPointer<const Snapshot> previous = m_snapshot;
+    if (previous && previous->files->rootPath() != files->rootPath()) {
+        previous.reset();
+    }
+
+    m_pool->start(new FunctionTask([this, generation, files, previous]() {
+        QString error;
+        QSharedPointer<const Snapshot> snapshot = reconcile(generation, files, previous, &error);
+        if (!snapshot) {
+            if (!error.isEmpty()) {
+                LOG_WARNING("Trigram index not built:" << error);
+            }
+            return;
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, snapshot, error]() {
+            publish(generation, snapshot, error);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void TrigramIndex::updateFiles(const QStringList &filePaths)
+{
+    QSharedPointer<const Snapshot> snapshot = m_snapshot;
+    if (!snapshot) {
+        return;
+    }
+
+    QDir root(snapshot->files->rootPath());
+    QVector<int> changed;
+    for (const QString &filePath : filePaths) {
+        int file = snapshot->files->indexOf(root.relativeFilePath(filePath));
+        if (file >= 0) {
+            changed.append(file);
+        }
+    }
+
+    if (changed.isEmpty()) {
+        return;
+    }
+
+    int generation = m_generation.loadAcquire();
+    m_pool->start(new FunctionTask([this, generation, snapshot, changed]() {
+        QHash<int, QVector<quint32>> trigrams;
+        for (int file : changed) {
+            fileTrigrams(snapshot->files->absolutePath(file), &trigrams[file]);
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, trigrams]() {
+            if (generation != m_generation.loadAcquire() || !m_snapshot) {
+                return;
+            }
+
+            // copy on write; searches may still hold the previous snapshot
+            QSharedPointer<Snapshot> updated(new Snapshot(*m_snapshot));
+            for (auto it = trigrams.constBegin(); it != trigrams.constEnd(); ++it) {
+                int base = updated->tableToBase.at(it.key());
+                if (base >= 0) {
+                    updated->baseToTable[base] = -1;
+                    updated->tableToBase[it.key()] = -1;
+                }
+                updated->overlay.insert(it.key(), it.value());
+            }
+            m_snapshot = updated;
+
+            DEBUG_LOG_EDITOR("Trigram overlay updated," << updated->overlay.size() << "files pending a rebuild");
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void TrigramIndex::clear()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_snapshot.reset();
+}
+
+bool TrigramIndex::isReady() const
+{
+    return !m_snapshot.isNull();
+}
+
+QString TrigramIndex::lastError() const
+{
+    return m_lastError;
+}
+
+bool TrigramIndex::candidateFiles(const QByteArray &literal, const QSharedPointer<const ProjectFileTable> &files,
+                                  QVector<int> *candidates) const
+{
+    QSharedPointer<const Snapshot> snapshot = m_snapshot;
+    if (!snapshot || snapshot->files != files || literal.size() < 3) {
+        return false;
+    }
+
+    QVector<quint32> trigrams;
+    extractTrigrams(literal.constData(), literal.size(), &trigrams);
+    if (trigrams.isEmpty()) {
+        return false;
+    }
+
+    candidates->clear();
+
+    // intersect base posting lists, rarest trigram first
+    struct PostingList
+    {
+        const quint32 *postings;
+        int count;
+    };
+    QVector<PostingList> lists;
+    bool baseMatches = true;
+    for (quint32 trigram : trigrams) {
+        PostingList list;
+        if (!lookup(*snapshot->storage, trigram, &list.postings, &list.count)) {
+            baseMatches = false;
+            break;
+        }
+        lists.append(list);
+    }
+
+    if (baseMatches) {
+        std::sort(lists.begin(), lists.end(), [](const PostingList &left, const PostingList &right) {
+            return left.count < right.count;
+        });
+
+        QVector<quint32> base(lists.first().count);
+        std::copy(lists.first().postings, lists.first().postings + lists.first().count, base.begin());
+        for (int i = 1; i < lists.size() && !base.isEmpty(); ++i) {
+            intersectPostings(&base, lists.at(i).postings, lists.at(i).count);
+        }
+
+        candidates->reserve(base.size());
+        for (quint32 id : base) {
+            int file = snapshot->baseToTable.at(id);
+            if (file >= 0) {
+                candidates->append(file);
+            }
+        }
+    }
+
+    for (auto it = snapshot->overlay.constBegin(); it != snapshot->overlay.constEnd(); ++it) {
+        const QVector<quint32> &fileTrigrams = it.value();
+        bool matches = std::all_of(trigrams.constBegin(), trigrams.constEnd(), [&fileTrigrams](quint32 trigram) {
+            return std::binary_search(fileTrigrams.constBegin(), fileTrigrams.constEnd(), trigram);
+        });
+        if (matches) {
+            candidates->append(it.key());
+        }
+    }
+
+    std::sort(candidates->begin(), candidates->end());
+    return true;
+}
+
+QString TrigramIndex::indexPathFor(const QString &rootPath)
+{
+    QByteArray key = QCryptographicHash::hash(QDir(rootPath).absolutePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return QDir(cacheDir).filePath(QString("trigrams/%1.idx").arg(QString::fromLatin1(key)));
+}
+
+void TrigramIndex::extractTrigrams(const char *data, qint64 size, QVector<quint32> *trigrams)
+{
+    trigrams->clear();
+    if (size < 3) {
+        return;
+    }
+
+    const uchar *bytes = reinterpret_cast<const uchar*>(data);
+    trigrams->reserve(int(qMin<qint64>(size, 1 << 20)));
+
+    quint32 window = (quint32(foldByte(bytes[0])) << 8) | foldByte(bytes[1]);
+    for (qint64 i = 2; i < size; ++i) {
+        window = ((window << 8) | foldByte(bytes[i])) & 0xffffff;
+
+        // a search literal never spans lines, so neither does a trigram
+        if (bytes[i] == '\n' || bytes[i - 1] == '\n' || bytes[i - 2] == '\n') {
+            continue;
+        }
+        trigrams->append(window);
+    }
+
+    std::sort(trigrams->begin(), trigrams->end());
+    trigrams->erase(std::unique(trigrams->begin(), trigrams->end()), trigrams->end());
+}
+
+void TrigramIndex::publish(int generation, const QSharedPointer<const Snapshot> &snapshot, const QString &error)
+{
+    if (generation != m_generation.loadAcquire()) {
+        return;
+    }
+
+    m_snapshot = snapshot;
+    m_lastError = error;
+    if (!error.isEmpty()) {
+        LOG_WARNING("Trigram index kept in memory:" << error);
+    }
+
+    emit indexReady(snapshot->files->fileCount());
+}
+
+QSharedPointer<const TrigramIndex::Snapshot> TrigramIndex::reconcile(int generation,
+    const QSharedPointer<const ProjectFileTable> &files, const QSharedPointer<const Snapshot> &previous,
+    QString *error) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString indexPath = indexPathFor(files->rootPath());
+    QSharedPointer<Snapshot> snapshot(new Snapshot);
+    snapshot->files = files;
+
+    const int fileCount = files->fileCount();
+    snapshot->tableToBase.fill(-1, fileCount);
+    QVector<bool> covered(fileCount, false);
+    int uncovered = fileCount;
+
+    if (previous) {
+        // unchanged files keep their base entry or overlay trigrams from the last snapshot
+        snapshot->storage = previous->storage;
+        snapshot->baseToTable.fill(-1, previous->baseToTable.size());
+
+        const ProjectFileTable &previousFiles = *previous->files;
+        const QVector<int> matched = matchFiles(previousFiles, *files);
+        for (int file = 0; file < fileCount; ++file) {
+            int old = matched.at(file);
+            if (old < 0 || files->fileSize(file) != previousFiles.fileSize(old)
+                || files->lastModified(file) != previousFiles.lastModified(old)) {
+                continue;
+            }
+
+            auto overlay = previous->overlay.constFind(old);
+            if (overlay != previous->overlay.constEnd()) {
+                snapshot->overlay.insert(file, overlay.value());
+            } else if (previous->tableToBase.at(old) >= 0) {
+                int base = previous->tableToBase.at(old);
+                snapshot->baseToTable[base] = file;
+                snapshot->tableToBase[file] = base;
+            } else {
+                continue;
+            }
+            covered[file] = true;
+            --uncovered;
+        }
+    } else {
+        snapshot->storage = loadStorage(indexPath);
+    }
+
+    // entries whose size and mtime still match the table stay in the base
+    if (!previous && snapshot->storage) {
+        const uchar *data = snapshot->storage->data();
+        const IndexHeader *header = reinterpret_cast<const IndexHeader*>(data);
+        const IndexFileEntry *entries = reinterpret_cast<const IndexFileEntry*>(data + sizeof(IndexHeader));
+        const char *pathPool = reinterpret_cast<const char*>(entries + header->fileCount);
+
+        snapshot->baseToTable.fill(-1, header->fileCount);
+        for (quint32 id = 0; id < header->fileCount; ++id) {
+            const IndexFileEntry &entry = entries[id];
+            QString path = QString::fromUtf8(pathPool + entry.pathOffset, entry.pathLength);
+
+            int file = files->indexOf(path);
+            if (file < 0 || covered.at(file) || files->fileSize(file) != entry.size
+                || files->lastModified(file) != entry.modified) {
+                continue;
+            }
+
+            snapshot->baseToTable[id] = file;
+            snapshot->tableToBase[file] = int(id);
+            covered[file] = true;
+            --uncovered;
+        }
+    }
+
+    // overlay entries carried over are just as missing from the base as the files still to read
+    if (!snapshot->storage
+        || uncovered + snapshot->overlay.size() > qMax(kMinOverlayLimit, fileCount / kOverlayFraction)) {
+        snapshot->storage = buildStorage(generation, *files, indexPath, error);
+        if (!snapshot->storage) {
+            return QSharedPointer<const Snapshot>();
+        }
+
+        // a fresh build uses table order for its file ids
+        snapshot->overlay.clear();
+        snapshot->baseToTable.resize(fileCount);
+        for (int file = 0; file < fileCount; ++file) {
+            snapshot->baseToTable[file] = file;
+            snapshot->tableToBase[file] = file;
+        }
+
+        DEBUG_LOG_EDITOR("Built trigram index for" << fileCount << "files in" << timer.elapsed() << "ms");
+        return snapshot;
+    }
+
+    for (int file = 0; file < fileCount; ++file) {
+        if (covered.at(file)) {
+            continue;
+        }
+        if (m_generation.loadAcquire() != generation) {
+            return QSharedPointer<const Snapshot>();
+        }
+        fileTrigrams(files->absolutePath(file), &snapshot->overlay[file]);
+    }
+
+    DEBUG_LOG_EDITOR("Reconciled trigram index," << uncovered << "changed files re-read in" << timer.elapsed() << "ms");
+    return snapshot;
+}
+
+QSharedPointer<TrigramIndex::Storage> TrigramIndex::loadStorage(const QString &indexPath)
+{
+    QSharedPointer<Storage> storage(new Storage);
+    storage->file.setFileName(indexPath);
+    if (!storage->file.open(QIODevice::ReadOnly)) {
+        return QSharedPointer<Storage>();
+    }
+
+    storage->size = storage->file.size();
+    if (storage->size < qint64(sizeof(IndexHeader))) {
+        return QSharedPointer<Storage>();
+    }
+
+    storage->mapped = storage->file.map(0, storage->size);
+    if (!storage->mapped) {
+        return QSharedPointer<Storage>();
+    }
+
+    const IndexHeader *header = reinterpret_cast<const IndexHeader*>(storage->mapped);
+    if (std::memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 || header->version != kIndexVersion
+        || postingsOffset(header) + qint64(header->postingCount) * 4 != storage->size) {
+        DEBUG_LOG_EDITOR("Ignoring stale trigram index" << indexPath);
+        return QSharedPointer<Storage>();
+    }
+
+    return storage;
+}
+
+QSharedPointer<TrigramIndex::Storage> TrigramIndex::buildStorage(int generation, const ProjectFileTable &files,
+                                                                 const QString &indexPath, QString *error) const
+{
+    const int fileCount = files.fileCount();
+
+    // files are visited in id order, so every posting list comes out sorted
+    QHash<quint32, QVector<quint32>> postings;
+    QVector<quint32> trigrams;
+    qint64 postingCount = 0;
+
+    for (int file = 0; file < fileCount; ++file) {
+        if (m_generation.loadAcquire() != generation) {
+            return QSharedPointer<Storage>();
+        }
+
+        if (!fileTrigrams(files.absolutePath(file), &trigrams)) {
+            continue;
+        }
+        for (quint32 trigram : trigrams) {
+            postings[trigram].append(quint32(file));
+        }
+        postingCount += trigrams.size();
+    }
+
+    // trigram entries address the postings with 32 bit offsets
+    if (postingCount > qint64(std::numeric_limits<quint32>::max())) {
+        *error = QString("%1 postings do not fit the index format").arg(postingCount);
+        return QSharedPointer<Storage>();
+    }
+
+    QVector<quint32> keys = postings.keys().toVector();
+    std::sort(keys.begin(), keys.end());
+
+    QByteArray pathPool;
+    QVector<IndexFileEntry> entries(fileCount);
+    for (int file = 0; file < fileCount; ++file) {
+        QByteArray path = files.relativePath(file).toUtf8();
+        entries[file].pathOffset = pathPool.size();
+        entries[file].pathLength = path.size();
+        entries[file].size = files.fileSize(file);
+        entries[file].modified = files.lastModified(file);
+        pathPool.append(path);
+    }
+
+    IndexHeader header;
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.fileCount = fileCount;
+    header.trigramCount = keys.size();
+    header.pathBytes = pathPool.size();
+    header.postingCount = quint32(postingCount);
+
+    // sections go straight to the file, so the index is never held twice
+    QDir().mkpath(QFileInfo(indexPath).absolutePath());
+    QSaveFile output(indexPath);
+    if (output.open(QIODevice::WriteOnly)) {
+        if (!writeStorage(&output, header, entries, pathPool, keys, &postings) || !output.commit()) {
+            *error = QString("Cannot write %1: %2").arg(indexPath, output.errorString());
+            return QSharedPointer<Storage>();
+        }
+
+        QSharedPointer<Storage> mapped = loadStorage(indexPath);
+        if (!mapped) {
+            *error = QString("Cannot map %1").arg(indexPath);
+        }
+        return mapped;
+    }
+
+    // the bytes stay in memory if the cache directory is not writable
+    *error = QString("Cannot write %1: %2").arg(indexPath, output.errorString());
+    if (postingsOffset(&header) + postingCount * qint64(sizeof(quint32)) > kMaxMemoryIndexSize) {
+        return QSharedPointer<Storage>();
+    }
+
+    QSharedPointer<Storage> storage(new Storage);
+    QBuffer buffer(&storage->buffer);
+    buffer.open(QIODevice::WriteOnly);
+    writeStorage(&buffer, header, entries, pathPool, keys, &postings);
+    storage->size = storage->buffer.size();
+    return storage;
+}
+
+bool TrigramIndex::fileTrigrams(const QString &filePath, QVector<quint32> *trigrams)
+{
+    trigrams->clear();
+
+    QFile input(filePath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 size = input.size();
+    if (size > kMaxFileSize) {
+        return false;
+    }
+    if (size < 3) {
+        return true;
+    }
+
+    uchar *mapped = input.map(0, size);
+    if (mapped) {
+        extractTrigrams(reinterpret_cast<const char*>(mapped), size, trigrams);
+        input.unmap(mapped);
+    } else {
+        QByteArray content = input.readAll();
+        extractTrigrams(content.constData(), content.size(), trigrams);
+    }
+    return true;
+}
+
+bool TrigramIndex::lookup(const Storage &storage, quint32 trigram, const quint32 **postings, int *count)
+{
+    const uchar *data = storage.data();
+    const IndexHeader *header = reinterpret_cast<const IndexHeader*>(data);
+    const IndexTrigramEntry *table = reinterpret_cast<const IndexTrigramEntry*>(data + trigramTableOffset(header));
+    const IndexTrigramEntry *tableEnd = table + header->trigramCount;
+
+    const IndexTrigramEntry *entry = std::lower_bound(table, tableEnd, trigram,
+        [](const IndexTrigramEntry &left, quint32 value) {
+            return left.trigram < value;
+        });
+    if (entry == tableEnd || entry->trigram != trigram) {
+        return false;
+    }
+
+    *postings = reinterpret_cast<const quint32*>(data + postingsOffset(header)) + entry->offset;
+    *count = entry->count;
+    return true;
+}
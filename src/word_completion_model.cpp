@@ -0,0 +1,83 @@
+// completion model over the workspace token index
+// the index ranks candidates by frequency, the view only filters what it gets
+
+#include "word_completion_model.h"
+#include "token_index.h"
+#include <KTextEditor/Document>
+#include <KTextEditor/View>
+
+namespace {
+
+const int kMaxCompletions = 50;
+
+}
+
+WordCompletionModel::WordCompletionModel(TokenIndex *index, QObject *parent)
+    : KTextEditor::CodeCompletionModel(parent)
+    , m_index(index)
+{
+}
+
+void WordCompletionModel::completionInvoked(KTextEditor::View *view, const KTextEditor::Range &range,
+                                            InvocationType invocationType)
+{
+    Q_UNUSED(invocationType);
+    query(view->document()->text(range));
+}
+
+void WordCompletionModel::query(const QString &prefix)
+{
+    beginResetModel();
+    m_prefix = prefix;
+    m_completions = m_index->complete(prefix, kMaxCompletions);
+    setRowCount(m_completions.size());
+    endResetModel();
+}
+
+QVariant WordCompletionModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_completions.size()) {
+        return QVariant();
+    }
+
+    if (role == Qt::DisplayRole && index.column() == Name) {
+        return m_completions.at(index.row());
+    }
+    if (role == InheritanceDepth) {
+        // after the language aware models, when any are registered
+        return 10000;
+    }
+    return QVariant();
+}
+
+bool WordCompletionModel::shouldStartCompletion(KTextEditor::View *view, const QString &insertedText,
+                                                bool userInsertion, const KTextEditor::Cursor &position)
+{
+    if (!userInsertion || insertedText.isEmpty()) {
+        return false;
+    }
+
+    const QChar last = insertedText.at(insertedText.size() - 1);
+    if (!last.isLetterOrNumber() && last != QLatin1Char('_')) {
+        return false;
+    }
+
+    const QString line = view->document()->line(position.line());
+    int start = qMin(position.column(), line.size());
+    while (start > 0 && (line.at(start - 1).isLetterOrNumber() || line.at(start - 1) == QLatin1Char('_'))) {
+        --start;
+    }
+    return position.column() - start >= TokenIndex::minimumTokenLength();
+}
+
+KTextEditor::Range WordCompletionModel::updateCompletionRange(KTextEditor::View *view, const KTextEditor::Range &range)
+{
+    KTextEditor::Range updated = CodeCompletionModelControllerInterface::updateCompletionRange(view, range);
+
+    // a full list may have cut off the best matches for the longer prefix
+    const QString prefix = view->document()->text(updated);
+    if (m_completions.size() >= kMaxCompletions && prefix != m_prefix && prefix.startsWith(m_prefix)) {
+        query(prefix);
+    }
+    return updated;
+}
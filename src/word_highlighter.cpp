@@ -0,0 +1,310 @@
+// multi word highlighter
+// scans the lines around each viewport with one aho-corasick pass and marks
+// the matches with moving ranges, so the ranges follow edits by themselves
+
+#include "word_highlighter.h"
+#include "debug_log.h"
+#include <QEvent>
+#include <KTextEditor/View>
+#include <KTextEditor/Document>
+#include <KTextEditor/MovingInterface>
+#include <KTextEditor/MovingRange>
+
+namespace {
+
+// lines scanned beyond each edge of the viewport, so small scrolls find them ready
+const int kViewportMargin = 50;
+
+}
+
+WordHighlighter::WordHighlighter(QObject *parent)
+    : QObject(parent)
+    , m_caseSensitive(true)
+    , m_rebuildTimer(new QTimer(this))
+    , m_resetTimer(new QTimer(this))
+{
+    // many words arrive at once from the config or a plugin, compile them once
+    m_rebuildTimer->setSingleShot(true);
+    m_rebuildTimer->setInterval(0);
+    connect(m_rebuildTimer, &QTimer::timeout, this, &WordHighlighter::rebuild);
+
+    m_resetTimer->setSingleShot(true);
+    m_resetTimer->setInterval(0);
+    connect(m_resetTimer, &QTimer::timeout, this, &WordHighlighter::resetPendingViews);
+}
+
+WordHighlighter::~WordHighlighter()
+{
+    for (auto it = m_views.begin(); it != m_views.end(); ++it) {
+        qDeleteAll(it->ranges);
+    }
+}
+
+void WordHighlighter::setCaseSensitive(bool caseSensitive)
+{
+    if (caseSensitive != m_caseSensitive) {
+        m_caseSensitive = caseSensitive;
+        m_rebuildTimer->start();
+    }
+}
+
+void WordHighlighter::setWord(const QString &word, const QColor &color)
+{
+    if (word.isEmpty() || !color.isValid()) {
+        return;
+    }
+    m_words.insert(word, color);
+    m_rebuildTimer->start();
+}
+
+void WordHighlighter::removeWord(const QString &word)
+{
+    if (m_words.remove(word)) {
+        m_rebuildTimer->start();
+    }
+}
+
+void WordHighlighter::clearWords()
+{
+    if (!m_words.isEmpty()) {
+        m_words.clear();
+        m_rebuildTimer->start();
+    }
+}
+
+QStringList WordHighlighter::words() const
+{
+    return m_words.keys();
+}
+
+void WordHighlighter::rebuild()
+{
+    const QStringList patterns = m_words.keys();
+
+    m_attributes.clear();
+    if (m_matcher.build(patterns, m_caseSensitive)) {
+        for (const QString &pattern : patterns) {
+            KTextEditor::Attribute::Ptr attribute(new KTextEditor::Attribute());
+            attribute->setBackground(m_words.value(pattern));
+            m_attributes.append(attribute);
+        }
+    }
+
+    for (auto it = m_views.begin(); it != m_views.end(); ++it) {
+        resetView(it.key());
+    }
+}
+
+void WordHighlighter::addView(KTextEditor::View *view)
+{
+    if (!view || m_views.contains(view)) {
+        return;
+    }
+
+    m_views.insert(view, ViewState());
+
+    KTextEditor::Document *document = view->document();
+    connect(view, &KTextEditor::View::verticalScrollPositionChanged, this, &WordHighlighter::updateViewport);
+    connect(view, &QObject::destroyed, this, [this, view]() {
+        auto it = m_views.find(view);
+        if (it != m_views.end()) {
+            qDeleteAll(it->ranges);
+            m_views.erase(it);
+        }
+    });
+    view->installEventFilter(this);
+
+    connect(document, &KTextEditor::Document::textInserted, this, &WordHighlighter::onTextInserted,
+            Qt::UniqueConnection);
+    connect(document, &KTextEditor::Document::textRemoved, this, &WordHighlighter::onTextRemoved,
+            Qt::UniqueConnection);
+    // moving ranges must be gone before the document drops its content
+    connect(document, SIGNAL(aboutToInvalidateMovingInterfaceContent(KTextEditor::Document*)),
+            this, SLOT(onContentInvalidated(KTextEditor::Document*)), Qt::UniqueConnection);
+    connect(document, SIGNAL(aboutToDeleteMovingInterfaceContent(KTextEditor::Document*)),
+            this, SLOT(onContentInvalidated(KTextEditor::Document*)), Qt::UniqueConnection);
+
+    updateViewport(view);
+}
+
+void WordHighlighter::removeView(KTextEditor::View *view)
+{
+    auto it = m_views.find(view);
+    if (it == m_views.end()) {
+        return;
+    }
+
+    qDeleteAll(it->ranges);
+    m_views.erase(it);
+
+    view->removeEventFilter(this);
+    disconnect(view, nullptr, this, nullptr);
+    disconnect(view->document(), nullptr, this, nullptr);
+}
+
+bool WordHighlighter::eventFilter(QObject *watched, QEvent *event)
+{
+    // a taller view shows lines no scroll signal announced
+    if (event->type() == QEvent::Resize) {
+        if (auto view = qobject_cast<KTextEditor::View*>(watched)) {
+            updateViewport(view);
+        }
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void WordHighlighter::onContentInvalidated(KTextEditor::Document *document)
+{
+    for (auto it = m_views.begin(); it != m_views.end(); ++it) {
+        if (it.key()->document() == document) {
+            qDeleteAll(it->ranges);
+            it->ranges.clear();
+            it->firstLine = 0;
+            it->lastLine = -1;
+            it->pendingReset = true;
+        }
+    }
+    m_resetTimer->start();
+}
+
+void WordHighlighter::updateViewport(KTextEditor::View *view)
+{
+    auto it = m_views.find(view);
+    if (it == m_views.end() || it->pendingReset) {
+        return;
+    }
+
+    ViewState &state = it.value();
+    if (m_matcher.isEmpty() || m_attributes.isEmpty()) {
+        dropRanges(&state, 0, -1, false);
+        state.firstLine = 0;
+        state.lastLine = -1;
+        return;
+    }
+
+    const int lastDocumentLine = view->document()->lines() - 1;
+    const int first = qMax(0, view->firstDisplayedLine() - kViewportMargin);
+    const int last = qMin(lastDocumentLine, view->lastDisplayedLine() + kViewportMargin);
+
+    dropRanges(&state, first, last, false);
+
+    if (state.lastLine < state.firstLine || last < state.firstLine || first > state.lastLine) {
+        scanLines(view, &state, first, last);
+    } else {
+        // only the lines that came into view
+        if (first < state.firstLine) {
+            scanLines(view, &state, first, state.firstLine - 1);
+        }
+        if (last > state.lastLine) {
+            scanLines(view, &state, state.lastLine + 1, last);
+        }
+    }
+
+    state.firstLine = first;
+    state.lastLine = last;
+}
+
+void WordHighlighter::resetView(KTextEditor::View *view)
+{
+    auto it = m_views.find(view);
+    if (it == m_views.end()) {
+        return;
+    }
+
+    qDeleteAll(it->ranges);
+    it->ranges.clear();
+    it->firstLine = 0;
+    it->lastLine = -1;
+    it->pendingReset = false;
+    updateViewport(view);
+}
+
+void WordHighlighter::resetPendingViews()
+{
+    for (auto it = m_views.begin(); it != m_views.end(); ++it) {
+        if (it->pendingReset) {
+            resetView(it.key());
+        }
+    }
+}
+
+void WordHighlighter::rescanLine(KTextEditor::View *view, int line)
+{
+    auto it = m_views.find(view);
+    if (it == m_views.end() || it->pendingReset || line < it->firstLine || line > it->lastLine) {
+        return;
+    }
+
+    dropRanges(&it.value(), line, line, true);
+    scanLines(view, &it.value(), line, line);
+}
+
+void WordHighlighter::scanLines(KTextEditor::View *view, ViewState *state, int first, int last)
+{
+    KTextEditor::Document *document = view->document();
+    auto moving = qobject_cast<KTextEditor::MovingInterface*>(document);
+    if (!moving) {
+        return;
+    }
+
+    for (int line = first; line <= last; ++line) {
+        const QVector<PatternMatch> matches = m_matcher.match(document->line(line));
+        for (const PatternMatch &match : matches) {
+            KTextEditor::MovingRange *range = moving->newMovingRange(
+                KTextEditor::Range(line, match.column, line, match.column + match.length));
+            range->setView(view);
+            range->setAttribute(m_attributes.at(match.pattern));
+            range->setZDepth(-100.0);
+            state->ranges.append(range);
+        }
+    }
+}
+
+void WordHighlighter::dropRanges(ViewState *state, int first, int last, bool inside)
+{
+    int kept = 0;
+    for (KTextEditor::MovingRange *range : state->ranges) {
+        const int line = range->start().line();
+        const bool within = line >= first && line <= last;
+        if (within == inside || range->isEmpty()) {
+            delete range;
+        } else {
+            state->ranges[kept++] = range;
+        }
+    }
+    state->ranges.resize(kept);
+}
+
+void WordHighlighter::onTextInserted(KTextEditor::Document *document, const KTextEditor::Cursor &position,
+                                     const QString &text)
+{
+    const bool multiLine = text.contains(QLatin1Char('\n'));
+    for (auto it = m_views.begin(); it != m_views.end(); ++it) {
+        if (it.key()->document() != document) {
+            continue;
+        }
+        if (multiLine) {
+            it->pendingReset = true;
+            m_resetTimer->start();
+        } else {
+            rescanLine(it.key(), position.line());
+        }
+    }
+}
+
+void WordHighlighter::onTextRemoved(KTextEditor::Document *document, const KTextEditor::Range &range,
+                                    const QString &text)
+{
+    Q_UNUSED(text);
+    for (auto it = m_views.begin(); it != m_views.end(); ++it) {
+        if (it.key()->document() != document) {
+            continue;
+        }
+        if (!range.onSingleLine()) {
+            it->pendingReset = true;
+            m_resetTimer->start();
+        } else {
+            rescanLine(it.key(), range.start().line());
+        }
+    }
+}